@@ -69,6 +69,14 @@ struct UA_ServerNetworkLayer {
     void (*deleteMembers)(UA_ServerNetworkLayer *nl);
 };
 
+/**
+ * Nodestore
+ * ---------
+ * The nodes of the server are kept in a nodestore. Custom nodestore backends
+ * implement the interface defined in the internal header ua_nodestore.h. */
+struct UA_NodeStore;
+typedef struct UA_NodeStore UA_NodeStore;
+
 /**
  * Server Configuration
  * --------------------
@@ -90,6 +98,10 @@ typedef struct {
 
 typedef struct {
     UA_UInt16 nThreads; /* only if multithreading is enabled */
+    size_t parallelItemsThreshold; /* Read, Write, Browse and Call requests with
+                                    * more items are processed in parallel by
+                                    * the worker threads (only if
+                                    * multithreading is enabled). 0 -> never */
     UA_Logger logger;
 
     /* Server Description */
@@ -121,10 +133,21 @@ typedef struct {
     UA_UInt32Range keepAliveCountLimits;
     UA_UInt32 maxNotificationsPerPublish;
     UA_UInt32 maxRetransmissionQueueSize; /* 0 -> unlimited size */
+    size_t maxRetransmissionBytes; /* Budget for the retransmission queues of
+                                    * all subscriptions. 0 -> unlimited */
 
     /* Limits for MonitoredItems */
     UA_DoubleRange samplingIntervalLimits;
     UA_UInt32Range queueSizeLimits; /* Negotiated with the client */
+
+    /* Cache for values read from data sources. Used for reads with a maxAge
+     * and for sampling. 0 -> no caching */
+    size_t maxReadCacheEntries;
+
+    /* Nodestore backend. The server takes ownership and deletes the nodestore
+     * with the server. So a configuration with a nodestore can only be used
+     * for one server. NULL -> the default nodestore is created */
+    UA_NodeStore *nodestore;
 } UA_ServerConfig;
 
 /* Add a new namespace to the server. Returns the index of the new namespace */
@@ -168,6 +191,32 @@ UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal);
  * UA_Server_run) */
 UA_StatusCode UA_EXPORT UA_Server_run_shutdown(UA_Server *server);
 
+/**
+ * Address Space Snapshots
+ * -----------------------
+ * A snapshot is a binary image of the address space (nodes, references and
+ * namespace array). Loading a snapshot replaces the nodes that are created
+ * during UA_Server_new and is much faster than building the address space
+ * again, as the nodes are decoded in bulk without the consistency checks of
+ * the AddNodes service. So the image must be created by UA_Server_saveSnapshot
+ * of the same library version. Images of other versions are rejected.
+ *
+ * The values of data sources and the callbacks (data sources, value callbacks,
+ * methods and lifecycle management) are not part of the snapshot. They are
+ * taken over from the nodes of the current address space with the same NodeId
+ * and NodeClass, so that the data sources of namespace zero keep working.
+ *
+ * The snapshot is not changed during loading. It can be the content of a
+ * memory-mapped file that is wrapped in a UA_ByteString without copying. Load
+ * the snapshot before UA_Server_run_startup. */
+UA_StatusCode UA_EXPORT
+UA_Server_saveSnapshot(UA_Server *server, UA_ByteString *snapshot);
+
+/* Returns UA_STATUSCODE_BADDECODINGERROR if the image is invalid. Then the
+ * address space is unchanged. */
+UA_StatusCode UA_EXPORT
+UA_Server_loadSnapshot(UA_Server *server, const UA_ByteString *snapshot);
+
 /**
  * Repeated jobs
  * ------------- */
@@ -186,6 +235,25 @@ UA_StatusCode UA_EXPORT
 UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
                          UA_UInt32 interval, UA_Guid *jobId);
 
+/* Add a job for cyclic repetition with a high-resolution interval. The
+ * executions follow a fixed schedule of now() + n * interval without drift. If
+ * the server falls behind, missed executions are skipped and the schedule is
+ * kept. When the main loop waits internally (see UA_Server_run_iterate), it
+ * sleeps until the absolute deadline of the next job if that is due sooner
+ * than the networklayer can wake up.
+ *
+ * @param server The server object.
+ * @param job The job that shall be added.
+ * @param interval The repetition interval in microseconds. The interval must
+ *        be at least 100us.
+ * @param jobId Set to the guid of the repeated job. This can be used to cancel
+ *        the job later on. If the pointer is null, the guid is not set.
+ * @return Upon success, UA_STATUSCODE_GOOD is returned.
+ *         An error code otherwise. */
+UA_StatusCode UA_EXPORT
+UA_Server_addRepeatedJobHighRes(UA_Server *server, UA_Job job,
+                                UA_UInt64 interval, UA_Guid *jobId);
+
 /* Remove repeated job.
  *
  * @param server The server object.
@@ -563,7 +631,31 @@ UA_Server_call(UA_Server *server, const UA_CallMethodRequest *request);
  * that contains the value content and additional timestamps.
  *
  * It is expected that the read callback is implemented. The write callback can
- * be set to a null-pointer. */
+ * be set to a null-pointer. Data sources that are read asynchronously or in
+ * batches implement the additional callbacks of
+ * :ref:`UA_DataSourceExtension <datasource-extension>`.
+ *
+ * .. _async-operation:
+ *
+ * Asynchronous Operations
+ * ^^^^^^^^^^^^^^^^^^^^^^^
+ * Data sources and methods can complete asynchronously. Instead of blocking
+ * the server until the device has answered, the callback receives an operation
+ * handle and returns immediately. The operation is completed later on with
+ * UA_AsyncOperation_completeRead or UA_AsyncOperation_completeCall. The
+ * response to the Read or Call request is sent when all operations of the
+ * request have completed. Meanwhile, the server continues to process other
+ * requests.
+ *
+ * Every operation that was started successfully must be completed exactly once.
+ * The completion can happen already inside the callback. Otherwise, it must be
+ * called from the thread that runs the server main loop (e.g. from a repeated
+ * job). Operations that are still pending when the server is deleted are
+ * cancelled. Completing them afterwards only releases the operation handle.
+ * Arguments of the callback (the range and the input arguments) are only valid
+ * during the callback. */
+typedef struct UA_AsyncOperation UA_AsyncOperation;
+
 typedef struct {
     void *handle; /* A custom pointer to reuse the same datasource functions for
                      multiple sources */
@@ -603,10 +695,129 @@ typedef struct {
                            const UA_Variant *data, const UA_NumericRange *range);
 } UA_DataSource;
 
+/* Completes an asynchronous read with a copy of the value. The operation handle
+ * is invalid afterwards. */
+void UA_EXPORT
+UA_AsyncOperation_completeRead(UA_AsyncOperation *op, const UA_DataValue *value);
+
 UA_StatusCode UA_EXPORT
 UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
                                      const UA_DataSource dataSource);
 
+/**
+ * .. _datasource-extension:
+ *
+ * Data Source Extensions
+ * ^^^^^^^^^^^^^^^^^^^^^^
+ * Data sources can additionally be read asynchronously or in batches. The
+ * callbacks are set after the data source and receive the same handle. Setting
+ * the data source again removes the extension. Without a read callback in the
+ * data source, the value in the VariableAttributes is used for typechecking
+ * when the node is added. */
+typedef struct {
+    /* Starts an asynchronous read. If set, it is used for Read requests from
+     * clients. Where the result is required immediately (sampling and the
+     * local UA_Server_read), read or readBatch is used if one is set.
+     * Otherwise, the result is BadWouldBlock unless the operation completes
+     * inside the callback.
+     *
+     * @param op The handle to complete the operation with
+     *        UA_AsyncOperation_completeRead. The other arguments are the same
+     *        as for the synchronous read.
+     * @return If an error is returned, the operation is not started and must
+     *         not be completed. The error is returned to the original caller. */
+    UA_StatusCode (*readAsync)(void *handle, const UA_NodeId nodeid,
+                               UA_Boolean includeSourceTimeStamp,
+                               const UA_NumericRange *range, UA_AsyncOperation *op);
+
+    /* Reads the values of several nodes of the data source in one call. If
+     * set, the items of a Read request and the sampled monitored items are
+     * grouped by the data source (same handle and callbacks) and read with
+     * one call per group. Single values are read with the read callback if it
+     * is set.
+     *
+     * @param handle An optional pointer to user-defined data for the
+     *        specific data source
+     * @param itemsSize The number of nodes to read
+     * @param nodeIds The identifiers of the nodes being read
+     * @param includeSourceTimeStamp If true, then the datasource is expected to
+     *        set the source timestamp in the returned values
+     * @param ranges For every node, the range of the value to read. Entries
+     *        are NULL if the entire value is read.
+     * @param values The (initialized) values to be filled. Errors of
+     *        individual nodes are set as the status of the value.
+     * @return Returns a status code that applies to all nodes. If it is not
+     *         good, the values are discarded. */
+    UA_StatusCode (*readBatch)(void *handle, size_t itemsSize, const UA_NodeId *nodeIds,
+                               UA_Boolean includeSourceTimeStamp,
+                               const UA_NumericRange * const *ranges,
+                               UA_DataValue *values);
+} UA_DataSourceExtension;
+
+/* Sets the extension of a variable with a data source */
+UA_StatusCode UA_EXPORT
+UA_Server_setVariableNode_dataSourceExtension(UA_Server *server, const UA_NodeId nodeId,
+                                              const UA_DataSourceExtension extension);
+
+/**
+ * .. _value-handle:
+ *
+ * Value Handles
+ * ~~~~~~~~~~~~~
+ * A value handle lets a thread outside of the server (e.g. a device
+ * acquisition thread) update the value of a variable. The handle is obtained
+ * once per variable. The data type and array length of the values are fixed
+ * and checked against the variable when the handle is added. Afterwards,
+ * updates are not type-checked again. They only copy the value into a buffer of
+ * the handle without locks or memory allocation. This is also safe in
+ * single-threaded builds. Only one thread may update a handle at a time.
+ *
+ * The variable reads the most recent value from the handle. Writing the value
+ * with the Write service is no longer possible. Optionally, the handle keeps
+ * the most recent samples. Then, monitored items of the variable (without an
+ * index range) receive every sample that arrived since the last sampling and
+ * not only the value at the time of sampling. */
+typedef struct UA_ValueHandle UA_ValueHandle;
+
+/* Adds a value handle to a variable that contains its value inline (no data
+ * source). The current value is the initial value of the handle if it has the
+ * same type and array length. Otherwise, the initial value is zeroed with the
+ * status BadWaitingForInitialData.
+ *
+ * @param server The server
+ * @param nodeId The identifier of the variable
+ * @param type The data type of the values. Must not contain pointers (e.g.
+ *        numbers, but no strings).
+ * @param arrayLength The length of array values or zero for scalar values
+ * @param samplesSize The number of recent samples kept for monitored items.
+ *        Rounded up to the next power of two. With zero, monitored items
+ *        sample the current value only.
+ * @param handle The new handle
+ * @return Returns a status code */
+UA_StatusCode UA_EXPORT
+UA_Server_addValueHandle(UA_Server *server, const UA_NodeId nodeId,
+                         const UA_DataType *type, size_t arrayLength,
+                         size_t samplesSize, UA_ValueHandle **handle);
+
+/* Removes the handle. The variable keeps the most recent value inline. The
+ * handle must no longer be updated. Handles are removed before the server is
+ * deleted. If the variable cannot be changed, the handle stays attached and
+ * valid and an error is returned. Once the variable is deleted, the handle is
+ * freed without an error. */
+UA_StatusCode UA_EXPORT
+UA_Server_removeValueHandle(UA_Server *server, UA_ValueHandle *handle);
+
+/* Updates the value of the handle. Can be called from any thread.
+ *
+ * @param handle The value handle
+ * @param data Points to the scalar value or to the first array element
+ * @param status The status of the value
+ * @param sourceTimestamp The source timestamp of the value. The current time
+ *        is used if zero. */
+void UA_EXPORT
+UA_ValueHandle_update(UA_ValueHandle *handle, const void *data,
+                      UA_StatusCode status, UA_DateTime sourceTimestamp);
+
 /**
  * .. _value-callback:
  *
@@ -673,10 +884,31 @@ typedef UA_StatusCode
                      size_t inputSize, const UA_Variant *input,
                      size_t outputSize, UA_Variant *output);
 
+/* Methods can complete asynchronously (see :ref:`async-operation`). The
+ * asynchronous callback is used for Call requests from clients. The local
+ * UA_Server_call uses the synchronous callback if it is set. The outputSize is
+ * the number of output arguments that is expected for the completion. If an
+ * error is returned, the operation is not started and must not be
+ * completed. */
+typedef UA_StatusCode
+(*UA_MethodCallbackAsync)(void *methodHandle, const UA_NodeId objectId,
+                          size_t inputSize, const UA_Variant *input,
+                          size_t outputSize, UA_AsyncOperation *op);
+
 #ifdef UA_ENABLE_METHODCALLS
 UA_StatusCode UA_EXPORT
 UA_Server_setMethodNode_callback(UA_Server *server, const UA_NodeId methodNodeId,
                                  UA_MethodCallback method, void *handle);
+
+UA_StatusCode UA_EXPORT
+UA_Server_setMethodNode_asyncCallback(UA_Server *server, const UA_NodeId methodNodeId,
+                                      UA_MethodCallbackAsync method, void *handle);
+
+/* Completes an asynchronous method call with the status code and a copy of the
+ * output arguments. The operation handle is invalid afterwards. */
+void UA_EXPORT
+UA_AsyncOperation_completeCall(UA_AsyncOperation *op, UA_StatusCode status,
+                               size_t outputSize, const UA_Variant *output);
 #endif
 
 /**
@@ -725,6 +957,23 @@ __UA_Server_addNode(UA_Server *server, const UA_NodeClass nodeClass,
                     UA_InstantiationCallback *instantiationCallback,
                     UA_NodeId *outNewNodeId);
 
+/* Adds many nodes in one pass. All nodes are checked before any is inserted.
+ * Parents and reference types can be added in the same call in any order. The
+ * references from a parent to all its new children are added in one edit of
+ * the parent node. The nodestore is rehashed at most once for the new nodes.
+ * Then the nodes are instantiated from their type definition, the members of
+ * new types first. Children given in the call take precedence over the
+ * children of the type definition. If a node fails, its children from the call
+ * are not added either. The attributes of the items are given as decoded
+ * ExtensionObjects, e.g. with UA_EXTENSIONOBJECT_DECODED_NODELETE. The results
+ * array must have itemsSize entries. Returns UA_STATUSCODE_GOOD if the results
+ * contain the individual status codes. */
+UA_StatusCode UA_EXPORT
+UA_Server_addNodes(UA_Server *server, size_t itemsSize,
+                   const UA_AddNodesItem *items,
+                   UA_InstantiationCallback *instantiationCallback,
+                   UA_AddNodesResult *results);
+
 static UA_INLINE UA_StatusCode
 UA_Server_addVariableNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                           const UA_NodeId parentNodeId,
@@ -882,6 +1131,45 @@ UA_Server_deleteReference(UA_Server *server, const UA_NodeId sourceNodeId,
                           const UA_ExpandedNodeId targetNodeId,
                           UA_Boolean deleteBidirectional);
 
+/**
+ * Read Cache Statistics
+ * ---------------------
+ * If ``maxReadCacheEntries`` is set in the server configuration, values read
+ * from data sources are cached. A Read request with a maxAge is served from the
+ * cache if the cached value is not older than maxAge. MonitoredItems are
+ * sampled from the cache if the value is not older than half the sampling
+ * interval. Writing to a data source removes the cached value. */
+typedef struct {
+    size_t entries;
+    UA_UInt64 hits;
+    UA_UInt64 misses;    /* Lookups that had to read from the data source */
+    UA_UInt64 evictions; /* Entries dropped to stay within the size limit */
+} UA_ReadCacheStatistics;
+
+void UA_EXPORT
+UA_Server_getReadCacheStatistics(UA_Server *server, UA_ReadCacheStatistics *stats);
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+/**
+ * Retransmission Statistics
+ * -------------------------
+ * Sent notification messages are kept in binary encoding until they are
+ * acknowledged by the client. If the memory budget set in
+ * ``maxRetransmissionBytes`` is exceeded, the oldest messages of all
+ * subscriptions are evicted first. */
+typedef struct {
+    size_t bytesHeld;           /* Encoded size of the held messages */
+    size_t messagesHeld;
+    UA_UInt64 evictions;        /* Messages dropped to stay within the budget */
+    UA_UInt64 republishRequests;
+    UA_UInt64 republishHits;    /* Republish requests that found the message */
+} UA_RetransmissionStatistics;
+
+void UA_EXPORT
+UA_Server_getRetransmissionStatistics(UA_Server *server,
+                                      UA_RetransmissionStatistics *stats);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
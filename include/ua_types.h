@@ -163,6 +163,9 @@ UA_String UA_EXPORT UA_String_fromChars(char const src[]) UA_FUNC_ATTR_WARN_UNUS
 
 UA_Boolean UA_EXPORT UA_String_equal(const UA_String *s1, const UA_String *s2);
 
+/* Returns a non-cryptographic hash for the String */
+UA_UInt32 UA_EXPORT UA_String_hash(const UA_String *s);
+
 UA_EXPORT extern const UA_String UA_STRING_NULL;
 
 /**
@@ -202,6 +205,10 @@ UA_DateTime UA_EXPORT UA_DateTime_now(void);
  * current time */
 UA_DateTime UA_EXPORT UA_DateTime_nowMonotonic(void);
 
+/* Block until the monotonic clock reaches the deadline. Returns immediately if
+ * the deadline has already passed. */
+void UA_EXPORT UA_DateTime_sleepUntilMonotonic(UA_DateTime deadline);
+
 typedef struct UA_DateTimeStruct {
     UA_UInt16 nanoSec;
     UA_UInt16 microSec;
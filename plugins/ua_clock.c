@@ -4,6 +4,7 @@
 #include "ua_types.h"
 
 #include <time.h>
+#include <errno.h>
 #ifdef _WIN32
 # ifdef SLIST_ENTRY
 #  undef SLIST_ENTRY /* Fix redefinition of SLIST_ENTRY on mingw winnt.h */
@@ -61,3 +62,31 @@ UA_DateTime UA_DateTime_nowMonotonic(void) {
     return (ts.tv_sec * UA_SEC_TO_DATETIME) + (ts.tv_nsec / 100);
 #endif
 }
+
+void UA_DateTime_sleepUntilMonotonic(UA_DateTime deadline) {
+    UA_DateTime remaining = deadline - UA_DateTime_nowMonotonic();
+    if(remaining <= 0)
+        return;
+#if defined(_WIN32)
+    Sleep((DWORD)((remaining + UA_MSEC_TO_DATETIME - 1) / UA_MSEC_TO_DATETIME));
+#elif defined(__APPLE__) || defined(__MACH__)
+    struct timespec ts;
+    ts.tv_sec = (time_t)(remaining / UA_SEC_TO_DATETIME);
+    ts.tv_nsec = (long)((remaining % UA_SEC_TO_DATETIME) * 100);
+    nanosleep(&ts, NULL);
+#else
+    /* Sleep until an absolute deadline, so that the wakeup does not shift by
+     * the time passed before going to sleep. clock_nanosleep does not accept
+     * CLOCK_MONOTONIC_RAW. Then the deadline is translated to CLOCK_MONOTONIC. */
+    struct timespec ts;
+# if !defined(CLOCK_MONOTONIC_RAW)
+    UA_DateTime target = deadline;
+# else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    UA_DateTime target = (ts.tv_sec * UA_SEC_TO_DATETIME) + (ts.tv_nsec / 100) + remaining;
+# endif
+    ts.tv_sec = (time_t)(target / UA_SEC_TO_DATETIME);
+    ts.tv_nsec = (long)((target % UA_SEC_TO_DATETIME) * 100);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+#endif
+}
@@ -40,6 +40,7 @@ UA_UsernamePasswordLogin usernamePasswords[2] = {
 
 const UA_EXPORT UA_ServerConfig UA_ServerConfig_standard = {
     .nThreads = 1,
+    .parallelItemsThreshold = 1000,
     .logger = UA_Log_Stdout,
 
     /* Server Description */
@@ -89,10 +90,17 @@ const UA_EXPORT UA_ServerConfig UA_ServerConfig_standard = {
     .keepAliveCountLimits = { .max = 100, .min = 1 },
     .maxNotificationsPerPublish = 1000,
     .maxRetransmissionQueueSize = 0, /* unlimited */
+    .maxRetransmissionBytes = 0, /* unlimited */
 
     /* Limits for MonitoredItems */
     .samplingIntervalLimits = { .min = 50.0, .max = 24.0 * 3600.0 * 1000.0 },
-    .queueSizeLimits = { .max = 100, .min = 1 }
+    .queueSizeLimits = { .max = 100, .min = 1 },
+
+    /* Read Cache */
+    .maxReadCacheEntries = 0, /* no caching */
+
+    /* Nodestore */
+    .nodestore = NULL /* default nodestore */
 };
 
 /***************************/
@@ -0,0 +1,142 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_nodepool.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_NODEPOOL_LOCK(pool) pthread_mutex_lock(&(pool)->mutex)
+# define UA_NODEPOOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->mutex)
+#else
+# define UA_NODEPOOL_LOCK(pool)
+# define UA_NODEPOOL_UNLOCK(pool)
+#endif
+
+/* The first slab of a NodeClass has room for few entries. The slabs double in
+ * size up to the maximum. So small servers do not allocate much memory for
+ * NodeClasses that are rare. */
+#define UA_NODEPOOL_MINSLAB 16
+#define UA_NODEPOOL_MAXSLAB 1024
+
+/* Entries are aligned to eight bytes for 64bit members on 32bit platforms */
+#define UA_NODEPOOL_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+static const size_t nodeSizes[UA_NODEPOOL_CLASSES] = {
+    sizeof(UA_ObjectNode), sizeof(UA_VariableNode), sizeof(UA_MethodNode),
+    sizeof(UA_ObjectTypeNode), sizeof(UA_VariableTypeNode),
+    sizeof(UA_ReferenceTypeNode), sizeof(UA_DataTypeNode), sizeof(UA_ViewNode)};
+
+/* The index of the single bit in the NodeClass or UA_NODEPOOL_CLASSES */
+static size_t
+classIndex(UA_NodeClass nodeClass) {
+    size_t i = 0;
+    for(; i < UA_NODEPOOL_CLASSES; ++i) {
+        if((UA_UInt32)nodeClass == ((UA_UInt32)1 << i))
+            break;
+    }
+    return i;
+}
+
+void
+UA_NodePool_init(UA_NodePool *pool, size_t headerSize) {
+    memset(pool, 0, sizeof(UA_NodePool));
+    for(size_t i = 0; i < UA_NODEPOOL_CLASSES; ++i)
+        pool->classes[i].entrySize = UA_NODEPOOL_ALIGN(headerSize + nodeSizes[i]);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&pool->mutex, NULL);
+#endif
+}
+
+void
+UA_NodePool_deleteMembers(UA_NodePool *pool) {
+    for(size_t i = 0; i < UA_NODEPOOL_CLASSES; ++i) {
+        UA_NodePoolSlab *slab = pool->classes[i].slabs;
+        while(slab) {
+            UA_NodePoolSlab *next = slab->next;
+            UA_free(slab);
+            slab = next;
+        }
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+}
+
+static UA_Byte *
+slabEntry(UA_NodePoolSlab *slab, size_t entrySize, size_t index) {
+    return (UA_Byte*)slab + UA_NODEPOOL_ALIGN(sizeof(UA_NodePoolSlab)) +
+        (index * entrySize);
+}
+
+static UA_StatusCode
+addSlab(UA_NodePoolClass *c) {
+    size_t entries = UA_NODEPOOL_MINSLAB;
+    if(c->slabs) {
+        entries = c->slabs->entries * 2;
+        if(entries > UA_NODEPOOL_MAXSLAB)
+            entries = UA_NODEPOOL_MAXSLAB;
+    }
+    size_t bytes = UA_NODEPOOL_ALIGN(sizeof(UA_NodePoolSlab)) + (entries * c->entrySize);
+    UA_NodePoolSlab *slab = UA_malloc(bytes);
+    if(!slab)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    slab->entries = entries;
+    slab->next = c->slabs;
+    c->slabs = slab;
+    c->unusedEntries = entries;
+    c->slabBytes += bytes;
+    return UA_STATUSCODE_GOOD;
+}
+
+void *
+UA_NodePool_alloc(UA_NodePool *pool, UA_NodeClass nodeClass) {
+    size_t i = classIndex(nodeClass);
+    if(i == UA_NODEPOOL_CLASSES)
+        return NULL;
+    UA_NodePoolClass *c = &pool->classes[i];
+    void *entry = NULL;
+    UA_NODEPOOL_LOCK(pool);
+    if(c->freeList) {
+        /* Reuse a freed entry */
+        entry = c->freeList;
+        memcpy(&c->freeList, entry, sizeof(void*));
+        --c->freeEntries;
+    } else if(c->unusedEntries > 0 || addSlab(c) == UA_STATUSCODE_GOOD) {
+        /* Cut the entry from the newest slab */
+        entry = slabEntry(c->slabs, c->entrySize, c->slabs->entries - c->unusedEntries);
+        --c->unusedEntries;
+    }
+    if(entry)
+        ++c->usedEntries;
+    UA_NODEPOOL_UNLOCK(pool);
+    if(entry)
+        memset(entry, 0, c->entrySize);
+    return entry;
+}
+
+void
+UA_NodePool_free(UA_NodePool *pool, UA_NodeClass nodeClass, void *entry) {
+    size_t i = classIndex(nodeClass);
+    UA_assert(i < UA_NODEPOOL_CLASSES);
+    UA_NodePoolClass *c = &pool->classes[i];
+    UA_NODEPOOL_LOCK(pool);
+    memcpy(entry, &c->freeList, sizeof(void*));
+    c->freeList = entry;
+    ++c->freeEntries;
+    --c->usedEntries;
+    UA_NODEPOOL_UNLOCK(pool);
+}
+
+void
+UA_NodePool_getStatistics(UA_NodePool *pool, UA_NodeStoreStatistics *stats) {
+    memset(stats, 0, sizeof(UA_NodeStoreStatistics));
+    UA_NODEPOOL_LOCK(pool);
+    for(size_t i = 0; i < UA_NODEPOOL_CLASSES; ++i) {
+        UA_NodePoolClass *c = &pool->classes[i];
+        size_t inUse = c->usedEntries * c->entrySize;
+        stats->nodes[i] = c->usedEntries;
+        stats->bytesInUse += inUse;
+        stats->bytesSlack += c->slabBytes - inUse;
+    }
+    UA_NODEPOOL_UNLOCK(pool);
+}
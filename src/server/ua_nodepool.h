@@ -0,0 +1,69 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#ifndef UA_NODEPOOL_H_
+#define UA_NODEPOOL_H_
+
+#include "ua_util.h"
+#include "ua_nodestore.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+/**
+ * Node Pool
+ * ---------
+ * The nodestores allocate their entries (a backend-specific header followed
+ * by the node) from a pool with one slab allocator per NodeClass. The entries
+ * of a NodeClass have the same size. They are cut from slabs that hold many
+ * entries, so there is no per-allocation overhead of malloc and nodes of a
+ * NodeClass lie close together in memory. Freed entries are kept in a free
+ * list per NodeClass and reused for the next allocation. The slabs are only
+ * returned to the system when the pool is deleted.
+ *
+ * With multithreading, allocation and deallocation are protected by a mutex,
+ * as entries are freed from the call_rcu thread. */
+
+#define UA_NODEPOOL_CLASSES 8 /* one for each NodeClass */
+
+typedef struct UA_NodePoolSlab {
+    struct UA_NodePoolSlab *next;
+    size_t entries;
+} UA_NodePoolSlab;
+
+typedef struct {
+    size_t entrySize;
+    UA_NodePoolSlab *slabs; /* the newest slab comes first */
+    size_t unusedEntries; /* entries at the end of the newest slab that were
+                           * never handed out */
+    void *freeList; /* freed entries, linked through their first bytes */
+    size_t usedEntries;
+    size_t freeEntries;
+    size_t slabBytes;
+} UA_NodePoolClass;
+
+typedef struct {
+    UA_NodePoolClass classes[UA_NODEPOOL_CLASSES];
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t mutex;
+#endif
+} UA_NodePool;
+
+/* The entries have headerSize bytes before the node */
+void UA_NodePool_init(UA_NodePool *pool, size_t headerSize);
+
+/* Frees all slabs. Entries that are still in use become invalid. */
+void UA_NodePool_deleteMembers(UA_NodePool *pool);
+
+/* Returns a zeroed entry for a node of the NodeClass. Returns NULL if the
+ * NodeClass is invalid or memory runs out. */
+void * UA_NodePool_alloc(UA_NodePool *pool, UA_NodeClass nodeClass);
+
+/* Returns the entry to the free list of the NodeClass */
+void UA_NodePool_free(UA_NodePool *pool, UA_NodeClass nodeClass, void *entry);
+
+void UA_NodePool_getStatistics(UA_NodePool *pool, UA_NodeStoreStatistics *stats);
+
+#endif /* UA_NODEPOOL_H_ */
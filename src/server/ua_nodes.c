@@ -4,24 +4,688 @@
 
 #include "ua_server_internal.h"
 #include "ua_nodes.h"
+#include "ua_stringpool.h"
+
+static void
+deleteArgumentDefinitions(UA_MethodArgumentDefinitions *defs) {
+    UA_Array_delete(defs->arguments, defs->argumentsSize, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    UA_free(defs->types);
+}
+
+void
+UA_MethodArgumentsCache_delete(UA_MethodArgumentsCache *cache) {
+    if(!cache)
+        return;
+    deleteArgumentDefinitions(&cache->input);
+    deleteArgumentDefinitions(&cache->output);
+    UA_free(cache);
+}
+
+/*******************/
+/* Reference Index */
+/*******************/
+
+/* Nodes with fewer references are searched linearly */
+#define UA_REFERENCEINDEX_MINTARGETS 8
+
+/* The versions are drawn from a global counter. So a node that was deleted and
+ * added again does not reuse the version. */
+static UA_UInt32 referencesVersion = 0;
+
+static void
+deleteReferenceIndex(UA_ReferenceIndex *index) {
+    for(size_t i = 0; i < index->kindsSize; ++i)
+        UA_NodeId_deleteMembers(&index->kinds[i].referenceTypeId);
+    UA_free(index->kinds);
+    UA_free(index->targets);
+    UA_free(index->nameHashes);
+    UA_free(index->names);
+    memset(index, 0, sizeof(UA_ReferenceIndex));
+}
+
+static void
+targetsInsert(UA_Node *node, size_t pos) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t mask = index->targetsSize - 1;
+    size_t slot = UA_NodeId_hash(&node->references[pos].targetId.nodeId) & mask;
+    while(index->targets[slot] != 0)
+        slot = (slot + 1) & mask;
+    index->targets[slot] = (UA_UInt32)pos + 1;
+}
+
+static size_t
+targetsFind(const UA_Node *node, size_t pos) {
+    const UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t mask = index->targetsSize - 1;
+    size_t slot = UA_NodeId_hash(&node->references[pos].targetId.nodeId) & mask;
+    while(index->targets[slot] != (UA_UInt32)pos + 1)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/* The reference was moved in the array */
+static void
+targetsMove(UA_Node *node, size_t oldPos, size_t newPos) {
+    if(!node->referenceIndex.targets)
+        return;
+    /* The hash is taken from the reference at the new position */
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t mask = index->targetsSize - 1;
+    size_t slot = UA_NodeId_hash(&node->references[newPos].targetId.nodeId) & mask;
+    while(index->targets[slot] != (UA_UInt32)oldPos + 1)
+        slot = (slot + 1) & mask;
+    index->targets[slot] = (UA_UInt32)newPos + 1;
+}
+
+/* Backward-shift deletion keeps the probe sequences intact */
+static void
+targetsRemove(UA_Node *node, size_t pos) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    if(!index->targets)
+        return;
+    size_t mask = index->targetsSize - 1;
+    size_t hole = targetsFind(node, pos);
+    for(size_t slot = (hole + 1) & mask; index->targets[slot] != 0; slot = (slot + 1) & mask) {
+        const UA_NodeId *target = &node->references[index->targets[slot] - 1].targetId.nodeId;
+        size_t home = UA_NodeId_hash(target) & mask;
+        /* Can the entry be moved to the hole? (cyclic distance) */
+        if(((slot - home) & mask) >= ((slot - hole) & mask)) {
+            index->targets[hole] = index->targets[slot];
+            hole = slot;
+        }
+    }
+    index->targets[hole] = 0;
+}
+
+/* Rebuild the target index with a load factor of at most 1/4. Without memory,
+ * the index is dropped and the references are searched linearly. */
+static void
+targetsRebuild(UA_Node *node) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t size = 16;
+    while(size < node->referencesSize * 4)
+        size *= 2;
+    UA_free(index->targets);
+    index->targetsSize = 0;
+    index->targets = UA_calloc(size, sizeof(UA_UInt32));
+    if(!index->targets)
+        return;
+    index->targetsSize = size;
+    for(size_t i = 0; i < node->referencesSize; ++i)
+        targetsInsert(node, i);
+}
+
+/* The browse name index uses the same probing as the target index. The hash is
+ * taken from the nameHashes array. */
+static void
+namesInsert(UA_Node *node, size_t pos) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t mask = index->namesSize - 1;
+    size_t slot = index->nameHashes[pos] & mask;
+    while(index->names[slot] != 0)
+        slot = (slot + 1) & mask;
+    index->names[slot] = (UA_UInt32)pos + 1;
+}
+
+static size_t
+namesFind(const UA_Node *node, size_t pos) {
+    const UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t mask = index->namesSize - 1;
+    size_t slot = index->nameHashes[pos] & mask;
+    while(index->names[slot] != (UA_UInt32)pos + 1)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static void
+namesRemove(UA_Node *node, size_t pos) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    if(!index->names)
+        return;
+    size_t mask = index->namesSize - 1;
+    size_t hole = namesFind(node, pos);
+    for(size_t slot = (hole + 1) & mask; index->names[slot] != 0; slot = (slot + 1) & mask) {
+        size_t home = index->nameHashes[index->names[slot] - 1] & mask;
+        if(((slot - home) & mask) >= ((slot - hole) & mask)) {
+            index->names[hole] = index->names[slot];
+            hole = slot;
+        }
+    }
+    index->names[hole] = 0;
+}
+
+static void
+namesRebuild(UA_Node *node) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    size_t size = 16;
+    while(size < index->namesCount * 4)
+        size *= 2;
+    UA_free(index->names);
+    index->namesSize = 0;
+    index->names = UA_calloc(size, sizeof(UA_UInt32));
+    if(!index->names)
+        return;
+    index->namesSize = size;
+    for(size_t i = 0; i < node->referencesSize; ++i) {
+        if(index->nameHashes[i] != 0)
+            namesInsert(node, i);
+    }
+}
+
+/* Move a reference in the array and update the indices */
+static void
+moveReference(UA_Node *node, size_t from, size_t to) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    node->references[to] = node->references[from];
+    targetsMove(node, from, to);
+    if(!index->nameHashes)
+        return;
+    index->nameHashes[to] = index->nameHashes[from];
+    if(!index->names || index->nameHashes[to] == 0)
+        return;
+    size_t mask = index->namesSize - 1;
+    size_t slot = index->nameHashes[to] & mask;
+    while(index->names[slot] != (UA_UInt32)from + 1)
+        slot = (slot + 1) & mask;
+    index->names[slot] = (UA_UInt32)to + 1;
+}
+
+static UA_StatusCode
+allocNameHashes(UA_Node *node) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    if(index->nameHashes)
+        return UA_STATUSCODE_GOOD;
+    index->nameHashes = UA_calloc(index->referencesCapacity, sizeof(UA_UInt32));
+    if(!index->nameHashes)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Replace the name hash of the reference at the position. Requires the
+ * nameHashes array. Without memory for the name index, the names are searched
+ * linearly in the nameHashes array. */
+static void
+setNameHash(UA_Node *node, UA_ReferenceKind *kind, size_t pos, UA_UInt32 nameHash) {
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    if(index->nameHashes[pos] != 0) {
+        namesRemove(node, pos);
+        --index->namesCount;
+        --kind->namedSize;
+    }
+    index->nameHashes[pos] = nameHash;
+    if(nameHash == 0)
+        return;
+    ++index->namesCount;
+    ++kind->namedSize;
+    if(!index->names && index->namesCount < UA_REFERENCEINDEX_MINTARGETS)
+        return;
+    if(index->namesCount * 2 > index->namesSize)
+        namesRebuild(node);
+    else
+        namesInsert(node, pos);
+}
+
+UA_UInt32
+UA_Node_browseNameHash(const UA_QualifiedName *browseName) {
+    UA_UInt32 hash = UA_String_hash(&browseName->name) ^
+        ((UA_UInt32)browseName->namespaceIndex * 2654435761u);
+    return hash != 0 ? hash : 1; /* zero marks references without a name */
+}
+
+static UA_ReferenceKind *
+findKind(const UA_Node *node, const UA_NodeId *referenceTypeId, UA_Boolean isInverse) {
+    for(size_t i = 0; i < node->referenceIndex.kindsSize; ++i) {
+        UA_ReferenceKind *kind = &node->referenceIndex.kinds[i];
+        if(kind->isInverse == isInverse && UA_NodeId_equal(&kind->referenceTypeId, referenceTypeId))
+            return kind;
+    }
+    return NULL;
+}
+
+const UA_ReferenceKind *
+UA_Node_findReferenceKind(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                          UA_Boolean isInverse) {
+    return findKind(node, referenceTypeId, isInverse);
+}
+
+static size_t
+findReferencePosition(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                      const UA_NodeId *targetId, UA_Boolean isInverse) {
+    const UA_ReferenceKind *kind = findKind(node, referenceTypeId, isInverse);
+    if(!kind)
+        return node->referencesSize;
+    const UA_ReferenceIndex *index = &node->referenceIndex;
+    if(index->targets) {
+        /* The position in the kind gives the reference type and direction */
+        size_t mask = index->targetsSize - 1;
+        for(size_t slot = UA_NodeId_hash(targetId) & mask; index->targets[slot] != 0;
+            slot = (slot + 1) & mask) {
+            size_t pos = index->targets[slot] - 1;
+            if(pos >= kind->referencesStart &&
+               pos < kind->referencesStart + kind->referencesSize &&
+               UA_NodeId_equal(&node->references[pos].targetId.nodeId, targetId))
+                return pos;
+        }
+        return node->referencesSize;
+    }
+    for(size_t pos = kind->referencesStart;
+        pos < kind->referencesStart + kind->referencesSize; ++pos) {
+        if(UA_NodeId_equal(&node->references[pos].targetId.nodeId, targetId))
+            return pos;
+    }
+    return node->referencesSize;
+}
+
+const UA_NodeReference *
+UA_Node_findReference(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                      const UA_NodeId *targetId, UA_Boolean isInverse) {
+    size_t pos = findReferencePosition(node, referenceTypeId, targetId, isInverse);
+    if(pos == node->referencesSize)
+        return NULL;
+    return &node->references[pos];
+}
+
+const UA_NodeReference *
+UA_Node_nextReferenceByName(const UA_Node *node, UA_UInt32 nameHash, size_t *iterator) {
+    const UA_ReferenceIndex *index = &node->referenceIndex;
+    if(!index->nameHashes)
+        return NULL;
+
+    /* Without the hash table, the iterator is the position in the array */
+    if(!index->names) {
+        for(; *iterator < node->referencesSize; ++(*iterator)) {
+            if(index->nameHashes[*iterator] == nameHash)
+                return &node->references[(*iterator)++];
+        }
+        return NULL;
+    }
+
+    /* The iterator is the number of probed slots */
+    size_t mask = index->namesSize - 1;
+    for(size_t slot = (nameHash + *iterator) & mask; index->names[slot] != 0;
+        slot = (slot + 1) & mask) {
+        ++(*iterator);
+        size_t pos = index->names[slot] - 1;
+        if(index->nameHashes[pos] == nameHash)
+            return &node->references[pos];
+    }
+    return NULL;
+}
+
+UA_StatusCode
+UA_Node_setReferenceName(UA_Node *node, const UA_NodeId *referenceTypeId,
+                         const UA_NodeId *targetId, UA_Boolean isInverse,
+                         UA_UInt32 nameHash) {
+    size_t pos = findReferencePosition(node, referenceTypeId, targetId, isInverse);
+    if(pos == node->referencesSize)
+        return UA_STATUSCODE_BADNOTFOUND;
+    if(nameHash == 0 && !node->referenceIndex.nameHashes)
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode retval = allocNameHashes(node);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    setNameHash(node, findKind(node, referenceTypeId, isInverse), pos, nameHash);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                     UA_UInt32 referenceTypeIndex, const UA_ExpandedNodeId *targetId,
+                     UA_Boolean isInverse, UA_UInt32 nameHash) {
+    /* Grow the array geometrically */
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    if(node->referencesSize == index->referencesCapacity) {
+        size_t capacity = index->referencesCapacity ? index->referencesCapacity * 2 : 4;
+        UA_NodeReference *refs =
+            UA_realloc(node->references, sizeof(UA_NodeReference) * capacity);
+        if(!refs)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        node->references = refs;
+        if(index->nameHashes) {
+            UA_UInt32 *nameHashes =
+                UA_realloc(index->nameHashes, sizeof(UA_UInt32) * capacity);
+            if(!nameHashes)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            index->nameHashes = nameHashes;
+        }
+        index->referencesCapacity = capacity;
+    }
+    UA_NodeReference *refs = node->references;
+
+    UA_NodeReference ref;
+    memset(&ref, 0, sizeof(UA_NodeReference));
+    UA_StatusCode retval = UA_ExpandedNodeId_copy(targetId, &ref.targetId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Get or create the kind. New kinds are appended at the end. */
+    UA_ReferenceKind *kind = findKind(node, referenceTypeId, isInverse);
+    if(!kind) {
+        UA_ReferenceKind *kinds =
+            UA_realloc(index->kinds, sizeof(UA_ReferenceKind) * (index->kindsSize + 1));
+        if(!kinds) {
+            UA_ExpandedNodeId_deleteMembers(&ref.targetId);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        index->kinds = kinds;
+        kind = &kinds[index->kindsSize];
+        retval = UA_NodeId_copy(referenceTypeId, &kind->referenceTypeId);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ExpandedNodeId_deleteMembers(&ref.targetId);
+            return retval;
+        }
+        kind->referenceTypeIndex = referenceTypeIndex;
+        kind->isInverse = isInverse;
+        kind->referencesStart = node->referencesSize;
+        kind->referencesSize = 0;
+        kind->namedSize = 0;
+        ++index->kindsSize;
+    }
+
+    /* Make room at the end of the kind. The first reference of every following
+     * kind is moved to the end of that kind. */
+    size_t hole = node->referencesSize;
+    for(size_t i = index->kindsSize - 1; &index->kinds[i] != kind; --i) {
+        UA_ReferenceKind *next = &index->kinds[i];
+        moveReference(node, next->referencesStart, hole);
+        hole = next->referencesStart;
+        ++next->referencesStart;
+    }
+    refs[hole] = ref;
+    ++kind->referencesSize;
+    ++node->referencesSize;
+    index->version = UA_atomic_add(&referencesVersion, 1);
+
+    /* Update the target index */
+    if(index->targets || node->referencesSize >= UA_REFERENCEINDEX_MINTARGETS) {
+        if(node->referencesSize * 2 > index->targetsSize)
+            targetsRebuild(node);
+        else
+            targetsInsert(node, hole);
+    }
+
+    /* Update the name index. If there is no memory for the hashes, the
+     * reference is only found with a linear search. */
+    if(index->nameHashes)
+        index->nameHashes[hole] = 0;
+    if(nameHash != 0 && allocNameHashes(node) == UA_STATUSCODE_GOOD)
+        setNameHash(node, kind, hole, nameHash);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Node_deleteReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                        const UA_NodeId *targetId, UA_Boolean isInverse) {
+    size_t pos = findReferencePosition(node, referenceTypeId, targetId, isInverse);
+    if(pos == node->referencesSize)
+        return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
+    UA_ReferenceIndex *index = &node->referenceIndex;
+    UA_ReferenceKind *kind = findKind(node, referenceTypeId, isInverse);
+    targetsRemove(node, pos);
+    if(index->nameHashes && index->nameHashes[pos] != 0) {
+        namesRemove(node, pos);
+        --index->namesCount;
+        --kind->namedSize;
+    }
+    UA_ExpandedNodeId_deleteMembers(&node->references[pos].targetId);
+
+    /* Fill the hole with the last reference of the kind. Then the last
+     * reference of every following kind is moved to the front of that kind. */
+    size_t hole = pos;
+    size_t last = kind->referencesStart + kind->referencesSize - 1;
+    if(last != hole) {
+        moveReference(node, last, hole);
+        hole = last;
+    }
+    --kind->referencesSize;
+    for(UA_ReferenceKind *next = kind + 1; next < &index->kinds[index->kindsSize]; ++next) {
+        last = next->referencesStart + next->referencesSize - 1;
+        moveReference(node, last, hole);
+        hole = last;
+        --next->referencesStart;
+    }
+    --node->referencesSize;
+
+    /* Remove the empty kind */
+    if(kind->referencesSize == 0) {
+        UA_NodeId_deleteMembers(&kind->referenceTypeId);
+        size_t after = (size_t)(&index->kinds[index->kindsSize] - (kind + 1));
+        memmove(kind, kind + 1, sizeof(UA_ReferenceKind) * after);
+        --index->kindsSize;
+    }
+
+    /* We removed the last reference */
+    if(node->referencesSize == 0) {
+        UA_free(node->references);
+        node->references = NULL;
+        deleteReferenceIndex(index);
+    }
+    index->version = UA_atomic_add(&referencesVersion, 1);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The cached targets are copied as well. They are checked against the
+ * nodestore version before use. */
+static UA_StatusCode
+copyReferences(const UA_Node *src, UA_Node *dst) {
+    if(src->referencesSize == 0)
+        return UA_STATUSCODE_GOOD;
+    dst->references = UA_malloc(sizeof(UA_NodeReference) * src->referencesSize);
+    if(!dst->references)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < src->referencesSize; ++i) {
+        dst->references[i] = src->references[i];
+        UA_StatusCode retval = UA_ExpandedNodeId_copy(&src->references[i].targetId,
+                                                      &dst->references[i].targetId);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        dst->referencesSize = i + 1;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+copyReferenceIndex(const UA_Node *src, UA_Node *dst) {
+    const UA_ReferenceIndex *srcIndex = &src->referenceIndex;
+    UA_ReferenceIndex *dstIndex = &dst->referenceIndex;
+    memset(dstIndex, 0, sizeof(UA_ReferenceIndex));
+    dstIndex->referencesCapacity = src->referencesSize;
+    dstIndex->version = srcIndex->version;
+    if(srcIndex->kindsSize > 0) {
+        dstIndex->kinds = UA_malloc(sizeof(UA_ReferenceKind) * srcIndex->kindsSize);
+        if(!dstIndex->kinds)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < srcIndex->kindsSize; ++i) {
+        dstIndex->kinds[i] = srcIndex->kinds[i];
+        retval |= UA_NodeId_copy(&srcIndex->kinds[i].referenceTypeId,
+                                 &dstIndex->kinds[i].referenceTypeId);
+        dstIndex->kindsSize = i + 1;
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(srcIndex->targets) {
+        dstIndex->targets = UA_malloc(sizeof(UA_UInt32) * srcIndex->targetsSize);
+        if(!dstIndex->targets)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(dstIndex->targets, srcIndex->targets, sizeof(UA_UInt32) * srcIndex->targetsSize);
+        dstIndex->targetsSize = srcIndex->targetsSize;
+    }
+    if(srcIndex->nameHashes && src->referencesSize > 0) {
+        dstIndex->nameHashes = UA_malloc(sizeof(UA_UInt32) * src->referencesSize);
+        if(!dstIndex->nameHashes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(dstIndex->nameHashes, srcIndex->nameHashes, sizeof(UA_UInt32) * src->referencesSize);
+        dstIndex->namesCount = srcIndex->namesCount;
+    }
+    if(srcIndex->names) {
+        dstIndex->names = UA_malloc(sizeof(UA_UInt32) * srcIndex->namesSize);
+        if(!dstIndex->names)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(dstIndex->names, srcIndex->names, sizeof(UA_UInt32) * srcIndex->namesSize);
+        dstIndex->namesSize = srcIndex->namesSize;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/********************/
+/* Interned Strings */
+/********************/
+
+#define UA_NODE_INTERNABLESTRINGS 6
+
+static size_t
+internableStrings(UA_Node *node, UA_String **strings) {
+    size_t n = 0;
+    strings[n++] = &node->browseName.name;
+    strings[n++] = &node->displayName.locale;
+    strings[n++] = &node->displayName.text;
+    strings[n++] = &node->description.locale;
+    strings[n++] = &node->description.text;
+    if(node->nodeId.identifierType == UA_NODEIDTYPE_STRING ||
+       node->nodeId.identifierType == UA_NODEIDTYPE_BYTESTRING)
+        strings[n++] = &node->nodeId.identifier.string;
+    return n;
+}
+
+UA_StatusCode
+UA_Node_internStrings(UA_Node *node, UA_StringPool *pool) {
+    if(node->stringPool || !pool)
+        return UA_STATUSCODE_GOOD;
+    UA_String *strings[UA_NODE_INTERNABLESTRINGS];
+    UA_String interned[UA_NODE_INTERNABLESTRINGS];
+    size_t stringsSize = internableStrings(node, strings);
+    for(size_t i = 0; i < stringsSize; ++i) {
+        UA_StatusCode retval = UA_StringPool_intern(pool, strings[i], &interned[i]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            for(size_t j = 0; j < i; ++j)
+                UA_StringPool_release(pool, &interned[j]);
+            return retval;
+        }
+    }
+    for(size_t i = 0; i < stringsSize; ++i) {
+        UA_String_deleteMembers(strings[i]);
+        *strings[i] = interned[i];
+    }
+    node->stringPool = pool;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Node_uninternStrings(UA_Node *node) {
+    if(!node->stringPool)
+        return UA_STATUSCODE_GOOD;
+    UA_String *strings[UA_NODE_INTERNABLESTRINGS];
+    UA_String copies[UA_NODE_INTERNABLESTRINGS];
+    size_t stringsSize = internableStrings(node, strings);
+    for(size_t i = 0; i < stringsSize; ++i) {
+        UA_StatusCode retval = UA_String_copy(strings[i], &copies[i]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            for(size_t j = 0; j < i; ++j)
+                UA_String_deleteMembers(&copies[j]);
+            return retval;
+        }
+    }
+    for(size_t i = 0; i < stringsSize; ++i) {
+        UA_StringPool_release(node->stringPool, strings[i]);
+        *strings[i] = copies[i];
+    }
+    node->stringPool = NULL;
+    return UA_STATUSCODE_GOOD;
+}
+
+/**************/
+/* Value Slot */
+/**************/
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+UA_StatusCode
+UA_VariableNode_addValueSlot(UA_VariableNode *node) {
+    if(node->value.data.slot)
+        return UA_STATUSCODE_GOOD;
+    UA_ValueSlot *slot = UA_malloc(sizeof(UA_ValueSlot));
+    UA_SlotValue *current = UA_malloc(sizeof(UA_SlotValue));
+    if(!slot || !current) {
+        UA_free(slot);
+        UA_free(current);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    current->value = node->value.data.value;
+    UA_DataValue_init(&node->value.data.value);
+    slot->current = current;
+    slot->refCount = 1;
+    node->value.data.slot = slot;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The last node using the slot is deleted after the RCU grace period. So no
+ * reader can see the current value anymore. */
+static void
+releaseValueSlot(UA_ValueSlot *slot) {
+    if(UA_atomic_add(&slot->refCount, (UA_UInt32)-1) > 0)
+        return;
+    UA_DataValue_deleteMembers(&slot->current->value);
+    UA_free(slot->current);
+    UA_free(slot);
+}
+
+#endif
+
+const UA_DataValue *
+UA_VariableNode_getValue(const UA_VariableNode *node) {
+#ifdef UA_ENABLE_MULTITHREADING
+    const UA_ValueSlot *slot = node->value.data.slot;
+    if(slot)
+        return &slot->current->value;
+#endif
+    return &node->value.data.value;
+}
+
+void
+UA_VariableNode_deleteValue(UA_VariableNode *node) {
+    UA_DataValue_deleteMembers(&node->value.data.value);
+#ifdef UA_ENABLE_MULTITHREADING
+    if(node->value.data.slot)
+        releaseValueSlot(node->value.data.slot);
+    node->value.data.slot = NULL;
+#endif
+}
 
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
+    /* release interned strings */
+    if(node->stringPool) {
+        UA_String *strings[UA_NODE_INTERNABLESTRINGS];
+        size_t stringsSize = internableStrings(node, strings);
+        for(size_t i = 0; i < stringsSize; ++i)
+            UA_StringPool_release(node->stringPool, strings[i]);
+        node->stringPool = NULL;
+    }
+
     /* delete standard content */
     UA_NodeId_deleteMembers(&node->nodeId);
     UA_QualifiedName_deleteMembers(&node->browseName);
     UA_LocalizedText_deleteMembers(&node->displayName);
     UA_LocalizedText_deleteMembers(&node->description);
-    UA_Array_delete(node->references, node->referencesSize,
-                    &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    for(size_t i = 0; i < node->referencesSize; ++i)
+        UA_ExpandedNodeId_deleteMembers(&node->references[i].targetId);
+    UA_free(node->references);
     node->references = NULL;
     node->referencesSize = 0;
+    deleteReferenceIndex(&node->referenceIndex);
 
     /* delete unique content of the nodeclass */
     switch(node->nodeClass) {
     case UA_NODECLASS_OBJECT:
         break;
-    case UA_NODECLASS_METHOD:
+    case UA_NODECLASS_METHOD: {
+        UA_MethodNode *p = (UA_MethodNode*)node;
+        if(p->arguments)
+            UA_MethodArgumentsCache_delete(p->arguments);
+        p->arguments = NULL;
         break;
+    }
     case UA_NODECLASS_OBJECTTYPE:
         break;
     case UA_NODECLASS_VARIABLE:
@@ -33,7 +697,7 @@ void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
         p->arrayDimensions = NULL;
         p->arrayDimensionsSize = 0;
         if(p->valueSource == UA_VALUESOURCE_DATA)
-            UA_DataValue_deleteMembers(&p->value.data.value);
+            UA_VariableNode_deleteValue(p);
         break;
     }
     case UA_NODECLASS_REFERENCETYPE: {
@@ -73,8 +737,14 @@ UA_CommonVariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
         retval |= UA_DataValue_copy(&src->value.data.value,
                                     &dst->value.data.value);
         dst->value.data.callback = src->value.data.callback;
+#ifdef UA_ENABLE_MULTITHREADING
+        /* The copy shares the slot */
+        dst->value.data.slot = src->value.data.slot;
+        if(dst->value.data.slot)
+            UA_atomic_add(&dst->value.data.slot->refCount, 1);
+#endif
     } else
-        dst->value.dataSource = src->value.dataSource;
+        dst->value.source = src->value.source;
     return retval;
 }
 
@@ -103,6 +773,8 @@ UA_MethodNode_copy(const UA_MethodNode *src, UA_MethodNode *dst) {
     dst->userExecutable = src->userExecutable;
     dst->methodHandle  = src->methodHandle;
     dst->attachedMethod = src->attachedMethod;
+    dst->attachedMethodAsync = src->attachedMethodAsync;
+    dst->arguments = NULL;
     return UA_STATUSCODE_GOOD;
 }
 
@@ -152,14 +824,16 @@ UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst) {
         UA_Node_deleteMembersAnyNodeClass(dst);
         return retval;
     }
-    retval |= UA_Array_copy(src->references, src->referencesSize,
-                            (void**)&dst->references,
-                            &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    retval = copyReferences(src, dst);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Node_deleteMembersAnyNodeClass(dst);
+        return retval;
+    }
+    retval = copyReferenceIndex(src, dst);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_Node_deleteMembersAnyNodeClass(dst);
         return retval;
     }
-    dst->referencesSize = src->referencesSize;
 
     /* copy unique content of the nodeclass */
     switch(src->nodeClass) {
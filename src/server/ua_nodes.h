@@ -47,19 +47,83 @@ extern "C" {
  *
  * Internally, open62541 uses ``UA_Node`` in places where the exact node type is
  * not known or not important. The ``nodeClass`` attribute is used to ensure the
- * correctness of casting from ``UA_Node`` to a specific node type. */
+ * correctness of casting from ``UA_Node`` to a specific node type.
+ *
+ * The references of a node are grouped by their reference type and direction.
+ * Every group (reference kind) is a contiguous slice of the ``references``
+ * array. The reference type and direction are stored only once in the kind,
+ * together with the position of the reference type in the type index of the
+ * server. So the reference type of a kind is tested against the requested
+ * type hierarchy with a bit test. Nodes with many references additionally
+ * have a hash index from the target NodeId to the position in the array. The
+ * index is maintained when references are added and removed.
+ *
+ * In single-threaded mode, the references cache the pointer to their target
+ * node. Nodes are only moved or deleted when the version of the nodestore
+ * changes. Then the cached pointer is looked up again.
+ *
+ * References can also be indexed by the browse name of their target. Then the
+ * children with a given browse name are found without looking up all targets
+ * in the nodestore. The hash of the browse name is stored for every reference.
+ * References without a hash (e.g. because the target did not exist when the
+ * reference was added) are counted per kind and have to be searched
+ * linearly.
+ *
+ * The version of the reference index is unique across all nodes and changes
+ * when references are added or removed. Browse continuation points resume at
+ * the stored position in the references array only if the version is
+ * unchanged.
+ *
+ * Nodes in the single-threaded nodestore share their browse name, display
+ * name, description and string NodeId with other nodes through the string pool
+ * of the nodestore. Then ``stringPool`` is set and the strings must not be
+ * edited in place. */
+typedef struct {
+    UA_ExpandedNodeId targetId;
+#ifndef UA_ENABLE_MULTITHREADING
+    const void *target; /* the cached target node or NULL */
+    UA_UInt32 targetVersion; /* nodestore version when the target was cached */
+#endif
+} UA_NodeReference;
+
+typedef struct {
+    UA_NodeId referenceTypeId;
+    UA_UInt32 referenceTypeIndex; /* in the type index of the server */
+    UA_Boolean isInverse;
+    size_t referencesStart; /* position in the references array */
+    size_t referencesSize;
+    size_t namedSize; /* references with the browse name hash of the target */
+} UA_ReferenceKind;
+
+typedef struct {
+    size_t referencesCapacity; /* allocated length of the references array */
+    size_t kindsSize;
+    UA_ReferenceKind *kinds; /* in the order of the references array */
+    size_t targetsSize; /* zero or a power of two */
+    UA_UInt32 *targets; /* position in the references array plus one, zero is empty */
+    UA_UInt32 *nameHashes; /* per reference, zero if the name is not indexed */
+    size_t namesCount; /* references with a name hash */
+    size_t namesSize; /* zero or a power of two */
+    UA_UInt32 *names; /* position plus one, hashed by the name */
+    UA_UInt32 version; /* changes with every added or removed reference */
+} UA_ReferenceIndex;
+
+struct UA_StringPool; /* see ua_stringpool.h */
+
 #define UA_NODE_BASEATTRIBUTES                  \
     UA_NodeId nodeId;                           \
     UA_NodeClass nodeClass;                     \
+    struct UA_StringPool *stringPool;           \
     UA_QualifiedName browseName;                \
     UA_LocalizedText displayName;               \
     UA_LocalizedText description;               \
     UA_UInt32 writeMask;                        \
     UA_UInt32 userWriteMask;                    \
     size_t referencesSize;                      \
-    UA_ReferenceNode *references;
+    UA_NodeReference *references;               \
+    UA_ReferenceIndex referenceIndex;
 
-typedef struct {
+typedef struct UA_Node {
     UA_NODE_BASEATTRIBUTES
 } UA_Node;
 
@@ -135,6 +199,15 @@ typedef enum {
     UA_VALUESOURCE_DATASOURCE
 } UA_ValueSource;
 
+/* With multithreading, the value of a written variable moves into a slot that
+ * is shared by all copies of the node (see ua_server_internal.h). */
+#ifdef UA_ENABLE_MULTITHREADING
+struct UA_ValueSlot;
+# define UA_NODE_VALUESLOT struct UA_ValueSlot *slot;
+#else
+# define UA_NODE_VALUESLOT
+#endif
+
 #define UA_NODE_VARIABLEATTRIBUTES                                      \
     /* Constraints on possible values */                                \
     UA_NodeId dataType;                                                 \
@@ -148,8 +221,12 @@ typedef enum {
         struct {                                                        \
             UA_DataValue value;                                         \
             UA_ValueCallback callback;                                  \
+            UA_NODE_VALUESLOT                                           \
         } data;                                                         \
-        UA_DataSource dataSource;                                       \
+        struct {                                                        \
+            UA_DataSource dataSource;                                   \
+            UA_DataSourceExtension extension;                           \
+        } source;                                                       \
     } value;
 
 typedef struct {
@@ -196,7 +273,26 @@ typedef struct {
  * Note that the same MethodNode may be referenced from several objects (and
  * object types). For this, the NodeId of the method *and of the object
  * providing context* is part of a Call request message.
- */
+ *
+ * The argument definitions are resolved from the properties with the first
+ * call and cached in the MethodNode. The cache is deleted when the references
+ * of the method or one of its properties change, and rebuilt with the next
+ * call. */
+typedef struct {
+    UA_StatusCode status; /* Bad if the property has no valid definition */
+    UA_Boolean defined; /* the property exists */
+    size_t argumentsSize;
+    UA_Argument *arguments;
+    const UA_DataType **types; /* the type of each argument (or NULL) */
+} UA_MethodArgumentDefinitions;
+
+typedef struct {
+    UA_MethodArgumentDefinitions input;
+    UA_MethodArgumentDefinitions output;
+} UA_MethodArgumentsCache;
+
+void UA_MethodArgumentsCache_delete(UA_MethodArgumentsCache *cache);
+
 typedef struct {
     UA_NODE_BASEATTRIBUTES
     UA_Boolean executable;
@@ -205,6 +301,8 @@ typedef struct {
     /* Members specific to open62541 */
     void *methodHandle;
     UA_MethodCallback attachedMethod;
+    UA_MethodCallbackAsync attachedMethodAsync;
+    UA_MethodArgumentsCache *arguments; /* not copied */
 } UA_MethodNode;
 
 /**
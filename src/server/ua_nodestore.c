@@ -3,6 +3,8 @@
 *  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
 
 #include "ua_nodestore.h"
+#include "ua_nodepool.h"
+#include "ua_stringpool.h"
 #include "ua_server_internal.h"
 #include "ua_util.h"
 
@@ -15,74 +17,42 @@ typedef struct UA_NodeStoreEntry {
     UA_Node node;
 } UA_NodeStoreEntry;
 
-#define UA_NODESTORE_TOMBSTONE ((UA_NodeStoreEntry*)0x01)
-
-struct UA_NodeStore {
+/* The nodestore is an open-addressing hash-map with Robin Hood hashing. The
+ * size is a power of two. Entries are displaced towards the end of the probe
+ * sequence if they are closer to their home slot than the entry that is
+ * inserted. So a lookup can stop as soon as it reaches an entry that is closer
+ * to its home slot than the searched NodeId would be. Removed entries are
+ * filled by shifting the following entries backwards. So there are no
+ * tombstones.
+ *
+ * The hashes are stored in an array next to the entry pointers. Probing only
+ * reads the hashes. The entry is dereferenced to compare the NodeId when the
+ * hash matches. Hash zero marks an empty slot. */
+typedef struct {
+    UA_UInt32 *hashes;
     UA_NodeStoreEntry **entries;
     UA_UInt32 size;
     UA_UInt32 count;
-    UA_UInt32 sizePrimeIndex;
-};
-
-/* The size of the hash-map is always a prime number. They are chosen to be
- * close to the next power of 2. So the size ca. doubles with each prime. */
-static UA_UInt32 const primes[] = {
-    7,         13,         31,         61,         127,         251,
-    509,       1021,       2039,       4093,       8191,        16381,
-    32749,     65521,      131071,     262139,     524287,      1048573,
-    2097143,   4194301,    8388593,    16777213,   33554393,    67108859,
-    134217689, 268435399,  536870909,  1073741789, 2147483647,  4294967291
-};
-
-static UA_UInt32 mod(UA_UInt32 h, UA_UInt32 size) { return h % size; }
-static UA_UInt32 mod2(UA_UInt32 h, UA_UInt32 size) { return 1 + (h % (size - 2)); }
-
-static UA_UInt16
-higher_prime_index(UA_UInt32 n) {
-    UA_UInt16 low  = 0;
-    UA_UInt16 high = (UA_UInt16)(sizeof(primes) / sizeof(UA_UInt32));
-    while(low != high) {
-        UA_UInt16 mid = (UA_UInt16)(low + ((high - low) / 2));
-        if(n > primes[mid])
-            low = (UA_UInt16)(mid + 1);
-        else
-            high = mid;
-    }
-    return low;
+    UA_UInt32 version;
+    UA_NodePool pool; /* The entries are allocated from slabs per NodeClass */
+    UA_StringPool strings; /* Shared by the nodes in the map */
+} UA_NodeMap;
+
+static UA_UInt32
+hashNodeId(const UA_NodeId *nodeid) {
+    UA_UInt32 hash = UA_NodeId_hash(nodeid);
+    return hash != 0 ? hash : 1;
+}
+
+/* Distance of the slot at index from the home slot of its entry */
+static UA_UInt32
+probeDistance(const UA_NodeMap *ns, UA_UInt32 idx) {
+    return (idx - ns->hashes[idx]) & (ns->size - 1);
 }
 
 static UA_NodeStoreEntry *
-instantiateEntry(UA_NodeClass nodeClass) {
-    size_t size = sizeof(UA_NodeStoreEntry) - sizeof(UA_Node);
-    switch(nodeClass) {
-    case UA_NODECLASS_OBJECT:
-        size += sizeof(UA_ObjectNode);
-        break;
-    case UA_NODECLASS_VARIABLE:
-        size += sizeof(UA_VariableNode);
-        break;
-    case UA_NODECLASS_METHOD:
-        size += sizeof(UA_MethodNode);
-        break;
-    case UA_NODECLASS_OBJECTTYPE:
-        size += sizeof(UA_ObjectTypeNode);
-        break;
-    case UA_NODECLASS_VARIABLETYPE:
-        size += sizeof(UA_VariableTypeNode);
-        break;
-    case UA_NODECLASS_REFERENCETYPE:
-        size += sizeof(UA_ReferenceTypeNode);
-        break;
-    case UA_NODECLASS_DATATYPE:
-        size += sizeof(UA_DataTypeNode);
-        break;
-    case UA_NODECLASS_VIEW:
-        size += sizeof(UA_ViewNode);
-        break;
-    default:
-        return NULL;
-    }
-    UA_NodeStoreEntry *entry = UA_calloc(1, size);
+instantiateEntry(UA_NodeMap *ns, UA_NodeClass nodeClass) {
+    UA_NodeStoreEntry *entry = UA_NodePool_alloc(&ns->pool, nodeClass);
     if(!entry)
         return NULL;
     entry->node.nodeClass = nodeClass;
@@ -90,243 +60,337 @@ instantiateEntry(UA_NodeClass nodeClass) {
 }
 
 static void
-deleteEntry(UA_NodeStoreEntry *entry) {
+deleteEntry(UA_NodeMap *ns, UA_NodeStoreEntry *entry) {
+    UA_NodeClass nodeClass = entry->node.nodeClass;
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    UA_NodePool_free(&ns->pool, nodeClass, entry);
 }
 
-/* returns slot of a valid node or null */
-static UA_NodeStoreEntry **
-findNode(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_UInt32 h = UA_NodeId_hash(nodeid);
-    UA_UInt32 size = ns->size;
-    UA_UInt32 idx = mod(h, size);
-    UA_UInt32 hash2 = mod2(h, size);
-
-    while(true) {
-        UA_NodeStoreEntry *e = ns->entries[idx];
-        if(!e)
-            return NULL;
-        if(e > UA_NODESTORE_TOMBSTONE &&
-           UA_NodeId_equal(&e->node.nodeId, nodeid))
-            return &ns->entries[idx];
-        idx += hash2;
-        if(idx >= size)
-            idx -= size;
+/* returns the slot index of a valid node or the size if not found */
+static UA_UInt32
+findNode(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
+    UA_UInt32 hash = hashNodeId(nodeid);
+    UA_UInt32 mask = ns->size - 1;
+    UA_UInt32 idx = hash & mask;
+    for(UA_UInt32 dist = 0; ; ++dist) {
+        if(ns->hashes[idx] == 0 || probeDistance(ns, idx) < dist)
+            return ns->size;
+        if(ns->hashes[idx] == hash &&
+           UA_NodeId_equal(&ns->entries[idx]->node.nodeId, nodeid))
+            return idx;
+        idx = (idx + 1) & mask;
     }
+}
 
-    /* NOTREACHED */
-    return NULL;
+/* Place the entry at idx (with the distance from its home slot) or later in
+ * the probe sequence. Richer entries are displaced to the back. */
+static void
+placeEntry(UA_NodeMap *ns, UA_UInt32 idx, UA_UInt32 dist,
+           UA_UInt32 hash, UA_NodeStoreEntry *entry) {
+    UA_UInt32 mask = ns->size - 1;
+    for(;; idx = (idx + 1) & mask, ++dist) {
+        if(ns->hashes[idx] == 0) {
+            ns->hashes[idx] = hash;
+            ns->entries[idx] = entry;
+            return;
+        }
+        UA_UInt32 slotDist = probeDistance(ns, idx);
+        if(slotDist < dist) {
+            UA_UInt32 tmpHash = ns->hashes[idx];
+            UA_NodeStoreEntry *tmpEntry = ns->entries[idx];
+            ns->hashes[idx] = hash;
+            ns->entries[idx] = entry;
+            hash = tmpHash;
+            entry = tmpEntry;
+            dist = slotDist;
+        }
+    }
 }
 
-/* returns an empty slot or null if the nodeid exists */
-static UA_NodeStoreEntry **
-findSlot(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_UInt32 h = UA_NodeId_hash(nodeid);
-    UA_UInt32 size = ns->size;
-    UA_UInt32 idx = mod(h, size);
-    UA_UInt32 hash2 = mod2(h, size);
+/* Returns false if the NodeId exists already */
+static UA_Boolean
+insertEntry(UA_NodeMap *ns, UA_NodeStoreEntry *entry) {
+    UA_UInt32 hash = hashNodeId(&entry->node.nodeId);
+    UA_UInt32 mask = ns->size - 1;
+    UA_UInt32 idx = hash & mask;
+    UA_UInt32 dist = 0;
+    /* The NodeId can only be found up to the point where it would be placed */
+    for(;; idx = (idx + 1) & mask, ++dist) {
+        if(ns->hashes[idx] == 0 || probeDistance(ns, idx) < dist)
+            break;
+        if(ns->hashes[idx] == hash &&
+           UA_NodeId_equal(&ns->entries[idx]->node.nodeId, &entry->node.nodeId))
+            return false;
+    }
+    placeEntry(ns, idx, dist, hash, entry);
+    return true;
+}
 
+/* Backward-shift deletion */
+static void
+removeSlot(UA_NodeMap *ns, UA_UInt32 idx) {
+    UA_UInt32 mask = ns->size - 1;
     while(true) {
-        UA_NodeStoreEntry *e = ns->entries[idx];
-        if(e > UA_NODESTORE_TOMBSTONE &&
-           UA_NodeId_equal(&e->node.nodeId, nodeid))
-            return NULL;
-        if(ns->entries[idx] <= UA_NODESTORE_TOMBSTONE)
-            return &ns->entries[idx];
-        idx += hash2;
-        if(idx >= size)
-            idx -= size;
+        UA_UInt32 next = (idx + 1) & mask;
+        if(ns->hashes[next] == 0 || probeDistance(ns, next) == 0)
+            break;
+        ns->hashes[idx] = ns->hashes[next];
+        ns->entries[idx] = ns->entries[next];
+        idx = next;
     }
+    ns->hashes[idx] = 0;
+    ns->entries[idx] = NULL;
+}
 
-    /* NOTREACHED */
-    return NULL;
+/* Allocate the arrays for a table of the given size */
+static UA_StatusCode
+allocTable(UA_NodeMap *ns, UA_UInt32 size) {
+    UA_UInt32 *hashes = UA_calloc(size, sizeof(UA_UInt32));
+    UA_NodeStoreEntry **entries = UA_calloc(size, sizeof(UA_NodeStoreEntry*));
+    if(!hashes || !entries) {
+        UA_free(hashes);
+        UA_free(entries);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    ns->hashes = hashes;
+    ns->entries = entries;
+    ns->size = size;
+    return UA_STATUSCODE_GOOD;
 }
 
-/* The occupancy of the table after the call will be about 50% */
+/* Rehash into a table with room for about twice the number of entries */
 static UA_StatusCode
-expand(UA_NodeStore *ns) {
+resize(UA_NodeMap *ns, UA_UInt32 entries) {
     UA_UInt32 osize = ns->size;
-    UA_UInt32 count = ns->count;
-    /* Resize only when table after removal of unused elements is either too
-       full or too empty */
-    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODESTORE_MINSIZE))
-        return UA_STATUSCODE_GOOD;
-
+    UA_UInt32 *ohashes = ns->hashes;
     UA_NodeStoreEntry **oentries = ns->entries;
-    UA_UInt32 nindex = higher_prime_index(count * 2);
-    UA_UInt32 nsize = primes[nindex];
-    UA_NodeStoreEntry **nentries = UA_calloc(nsize, sizeof(UA_NodeStoreEntry*));
-    if(!nentries)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-
-    ns->entries = nentries;
-    ns->size = nsize;
-    ns->sizePrimeIndex = nindex;
-
-    /* recompute the position of every entry and insert the pointer */
-    for(size_t i = 0, j = 0; i < osize && j < count; ++i) {
-        if(oentries[i] <= UA_NODESTORE_TOMBSTONE)
-            continue;
-        UA_NodeStoreEntry **e = findSlot(ns, &oentries[i]->node.nodeId);
-        UA_assert(e);
-        *e = oentries[i];
-        ++j;
+    UA_UInt32 nsize = UA_NODESTORE_MINSIZE;
+    while(nsize < entries * 2)
+        nsize *= 2;
+    UA_StatusCode retval = allocTable(ns, nsize);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The hashes are not recomputed */
+    for(UA_UInt32 i = 0; i < osize; ++i) {
+        if(ohashes[i] != 0)
+            placeEntry(ns, ohashes[i] & (nsize - 1), 0, ohashes[i], oentries[i]);
     }
 
+    UA_free(ohashes);
     UA_free(oentries);
     return UA_STATUSCODE_GOOD;
 }
 
-/**********************/
-/* Exported functions */
-/**********************/
-
-UA_NodeStore *
-UA_NodeStore_new(void) {
-    UA_NodeStore *ns = UA_malloc(sizeof(UA_NodeStore));
-    if(!ns)
-        return NULL;
-    ns->sizePrimeIndex = higher_prime_index(UA_NODESTORE_MINSIZE);
-    ns->size = primes[ns->sizePrimeIndex];
-    ns->count = 0;
-    ns->entries = UA_calloc(ns->size, sizeof(UA_NodeStoreEntry*));
-    if(!ns->entries) {
-        UA_free(ns);
-        return NULL;
-    }
-    return ns;
+/* The occupancy of the table after the call will be about 50% */
+static UA_StatusCode
+expand(UA_NodeMap *ns) {
+    /* Resize only when table after removal of unused elements is either too
+       full or too empty */
+    UA_UInt32 count = ns->count;
+    if(count * 2 < ns->size && (count * 8 > ns->size || ns->size <= UA_NODESTORE_MINSIZE))
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, count);
 }
 
-void
-UA_NodeStore_delete(UA_NodeStore *ns) {
-    UA_UInt32 size = ns->size;
-    UA_NodeStoreEntry **entries = ns->entries;
-    for(UA_UInt32 i = 0; i < size; ++i) {
-        if(entries[i] > UA_NODESTORE_TOMBSTONE)
-            deleteEntry(entries[i]);
+/*******************************/
+/* Default Nodestore Interface */
+/*******************************/
+
+static void
+NodeMap_delete(UA_NodeStore *store) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    for(UA_UInt32 i = 0; i < ns->size; ++i) {
+        if(ns->entries[i])
+            deleteEntry(ns, ns->entries[i]);
     }
+    UA_NodePool_deleteMembers(&ns->pool);
+    UA_StringPool_deleteMembers(&ns->strings);
+    UA_free(ns->hashes);
     UA_free(ns->entries);
     UA_free(ns);
+    UA_free(store);
 }
 
-UA_Node *
-UA_NodeStore_newNode(UA_NodeClass nodeClass) {
-    UA_NodeStoreEntry *entry = instantiateEntry(nodeClass);
+static UA_Node *
+NodeMap_newNode(UA_NodeStore *store, UA_NodeClass nodeClass) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_NodeStoreEntry *entry = instantiateEntry(ns, nodeClass);
     if(!entry)
         return NULL;
     return &entry->node;
 }
 
-void
-UA_NodeStore_deleteNode(UA_Node *node) {
+static void
+NodeMap_deleteNode(UA_NodeStore *store, UA_Node *node) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
     UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
     UA_assert(&entry->node == node);
-    deleteEntry(entry);
+    deleteEntry(ns, entry);
+}
+
+static UA_StatusCode
+NodeMap_reserve(UA_NodeStore *store, size_t additional) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    if(additional > (size_t)(UA_UINT32_MAX / 4 - ns->count))
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_UInt32 entries = ns->count + (UA_UInt32)additional;
+    if((UA_UInt64)ns->size * 3 > (UA_UInt64)entries * 4)
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, entries);
 }
 
-UA_StatusCode
-UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    if(ns->size * 3 <= ns->count * 4) {
+static UA_StatusCode
+NodeMap_insert(UA_NodeStore *store, UA_Node *node) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+    UA_assert(&entry->node == node);
+    if((UA_UInt64)ns->size * 3 <= (UA_UInt64)ns->count * 4) {
         if(expand(ns) != UA_STATUSCODE_GOOD)
             return UA_STATUSCODE_BADINTERNALERROR;
     }
 
+    /* Share the strings with other nodes. If this fails, the node keeps its
+     * private strings. */
+    UA_Node_internStrings(node, &ns->strings);
+
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
     tempNodeid.namespaceIndex = 0;
-    UA_NodeStoreEntry **entry;
     if(UA_NodeId_isNull(&tempNodeid)) {
-        /* create a random nodeid */
+        /* create a fresh nodeid */
         if(node->nodeId.namespaceIndex == 0)
             node->nodeId.namespaceIndex = 1;
         UA_UInt32 identifier = ns->count+1; // start value
-        UA_UInt32 size = ns->size;
-        UA_UInt32 increase = mod2(identifier, size);
-        while(true) {
-            node->nodeId.identifier.numeric = identifier;
-            entry = findSlot(ns, &node->nodeId);
-            if(entry)
-                break;
-            identifier += increase;
-            if(identifier >= size)
-                identifier -= size;
-        }
-    } else {
-        entry = findSlot(ns, &node->nodeId);
-        if(!entry) {
-            UA_NodeStore_deleteNode(node);
-            return UA_STATUSCODE_BADNODEIDEXISTS;
-        }
+        do {
+            node->nodeId.identifier.numeric = identifier++;
+        } while(!insertEntry(ns, entry));
+    } else if(!insertEntry(ns, entry)) {
+        deleteEntry(ns, entry);
+        return UA_STATUSCODE_BADNODEIDEXISTS;
     }
 
-    *entry = container_of(node, UA_NodeStoreEntry, node);
     ++ns->count;
-    UA_assert(&(*entry)->node == node);
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode
-UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
-    UA_NodeStoreEntry **entry = findNode(ns, &node->nodeId);
-    if(!entry)
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+static UA_StatusCode
+NodeMap_replace(UA_NodeStore *store, UA_Node *node) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
     UA_NodeStoreEntry *newEntry = container_of(node, UA_NodeStoreEntry, node);
-    if(*entry != newEntry->orig) {
+    UA_UInt32 idx = findNode(ns, &node->nodeId);
+    if(idx == ns->size)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(ns->entries[idx] != newEntry->orig) {
         // the node was replaced since the copy was made
-        deleteEntry(newEntry);
+        deleteEntry(ns, newEntry);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
-    deleteEntry(*entry);
-    *entry = newEntry;
+    UA_Node_internStrings(node, &ns->strings);
+    deleteEntry(ns, ns->entries[idx]);
+    ns->entries[idx] = newEntry;
+    ++ns->version;
     return UA_STATUSCODE_GOOD;
 }
 
-const UA_Node *
-UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **entry = findNode(ns, nodeid);
-    if(!entry)
+static const UA_Node *
+NodeMap_get(UA_NodeStore *store, const UA_NodeId *nodeid) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_UInt32 idx = findNode(ns, nodeid);
+    if(idx == ns->size)
         return NULL;
-    return (const UA_Node*)&(*entry)->node;
+    return (const UA_Node*)&ns->entries[idx]->node;
 }
 
-UA_Node *
-UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot = findNode(ns, nodeid);
-    if(!slot)
+static UA_Node *
+NodeMap_getCopy(UA_NodeStore *store, const UA_NodeId *nodeid) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_UInt32 idx = findNode(ns, nodeid);
+    if(idx == ns->size)
         return NULL;
-    UA_NodeStoreEntry *entry = *slot;
-    UA_NodeStoreEntry *new = instantiateEntry(entry->node.nodeClass);
+    UA_NodeStoreEntry *entry = ns->entries[idx];
+    UA_NodeStoreEntry *new = instantiateEntry(ns, entry->node.nodeClass);
     if(!new)
         return NULL;
     if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
-        deleteEntry(new);
+        deleteEntry(ns, new);
         return NULL;
     }
     new->orig = entry; // store the pointer to the original
     return &new->node;
 }
 
-UA_StatusCode
-UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot = findNode(ns, nodeid);
-    if(!slot)
+static UA_StatusCode
+NodeMap_remove(UA_NodeStore *store, const UA_NodeId *nodeid) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_UInt32 idx = findNode(ns, nodeid);
+    if(idx == ns->size)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    deleteEntry(*slot);
-    *slot = UA_NODESTORE_TOMBSTONE;
+    deleteEntry(ns, ns->entries[idx]);
+    removeSlot(ns, idx);
     --ns->count;
+    ++ns->version;
     /* Downsize the hashmap if it is very empty */
     if(ns->count * 8 < ns->size && ns->size > 32)
         expand(ns); // this can fail. we just continue with the bigger hashmap.
     return UA_STATUSCODE_GOOD;
 }
 
-void
-UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
+static void
+NodeMap_getStatistics(UA_NodeStore *store, UA_NodeStoreStatistics *stats) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
+    UA_NodePool_getStatistics(&ns->pool, stats);
+    stats->strings = UA_StringPool_size(&ns->strings);
+}
+
+static UA_UInt32
+NodeMap_getVersion(const UA_NodeStore *store) {
+    return ((const UA_NodeMap*)store->handle)->version;
+}
+
+static void
+NodeMap_iterate(UA_NodeStore *store, UA_NodeStore_nodeVisitor visitor,
+                void *visitorContext) {
+    UA_NodeMap *ns = (UA_NodeMap*)store->handle;
     for(UA_UInt32 i = 0; i < ns->size; ++i) {
-        if(ns->entries[i] > UA_NODESTORE_TOMBSTONE)
-            visitor((UA_Node*)&ns->entries[i]->node);
+        if(ns->entries[i])
+            visitor(visitorContext, (UA_Node*)&ns->entries[i]->node);
+    }
+}
+
+UA_NodeStore *
+UA_NodeStore_new(void) {
+    UA_NodeStore *store = UA_malloc(sizeof(UA_NodeStore));
+    UA_NodeMap *ns = UA_malloc(sizeof(UA_NodeMap));
+    if(!store || !ns) {
+        UA_free(store);
+        UA_free(ns);
+        return NULL;
+    }
+    ns->count = 0;
+    ns->version = 0;
+    UA_NodePool_init(&ns->pool, offsetof(UA_NodeStoreEntry, node));
+    UA_StringPool_init(&ns->strings);
+    if(allocTable(ns, UA_NODESTORE_MINSIZE) != UA_STATUSCODE_GOOD) {
+        UA_NodePool_deleteMembers(&ns->pool);
+        UA_free(store);
+        UA_free(ns);
+        return NULL;
     }
+    store->handle = ns;
+    store->deleteNodeStore = NodeMap_delete;
+    store->newNode = NodeMap_newNode;
+    store->deleteNode = NodeMap_deleteNode;
+    store->insert = NodeMap_insert;
+    store->get = NodeMap_get;
+    store->getCopy = NodeMap_getCopy;
+    store->replace = NodeMap_replace;
+    store->remove = NodeMap_remove;
+    store->reserve = NodeMap_reserve;
+    store->iterate = NodeMap_iterate;
+    store->getStatistics = NodeMap_getStatistics;
+    store->getVersion = NodeMap_getVersion;
+    return store;
 }
 
 #endif /* UA_ENABLE_MULTITHREADING */
@@ -14,20 +14,97 @@ extern "C" {
 /**
  * Nodestore
  * ---------
- * Stores nodes that can be indexed by their NodeId. Internally, it is based on
- * a hash-map implementation. */
-struct UA_NodeStore;
-typedef struct UA_NodeStore UA_NodeStore;
+ * Stores nodes that can be indexed by their NodeId. The nodestore is an
+ * interface with a pointer to the backend-specific state and the functions of
+ * the backend. The server uses the nodestore set in the configuration, or the
+ * default nodestore (a hash-map) if none is set. All backends have to pass the
+ * tests in tests/check_nodestore.c.
+ *
+ * The type ``UA_NodeStore`` is declared in ua_server.h, so that it can be set
+ * in the server configuration. */
+
+typedef void (*UA_NodeStore_nodeVisitor)(void *visitorContext, const UA_Node *node);
+
+/* Memory used for the node entries. Memory allocated by the nodes (strings,
+ * references, values, ...) is not included. */
+typedef struct {
+    size_t nodes[8]; /* Nodes per NodeClass. The index is the bit of the
+                      * NodeClass (Object 0, Variable 1, Method 2, ...). */
+    size_t bytesInUse; /* Entries of the nodes */
+    size_t bytesSlack; /* Allocated but not in use */
+    size_t strings; /* Distinct strings shared by the nodes */
+} UA_NodeStoreStatistics;
+
+struct UA_NodeStore {
+    void *handle; /* The backend-specific state */
+
+    /* Deletes the nodestore, all nodes in it and the UA_NodeStore structure
+     * itself. Do not call from a read-side critical section
+     * (multithreading). */
+    void (*deleteNodeStore)(UA_NodeStore *ns);
+
+    /* Create an editable node of the given NodeClass. The memory is managed by
+     * the nodestore. The node has to be deleted with deleteNode if it is not
+     * inserted. */
+    UA_Node * (*newNode)(UA_NodeStore *ns, UA_NodeClass nodeClass);
+    void (*deleteNode)(UA_NodeStore *ns, UA_Node *node);
+
+    /* Inserts a new node. If the nodeid is zero, then a fresh numeric nodeid
+     * from namespace 1 is assigned. If the nodeid exists already, the node is
+     * deleted. */
+    UA_StatusCode (*insert)(UA_NodeStore *ns, UA_Node *node);
+
+    /* The returned node is immutable for the users of the nodestore. In
+     * single-threaded builds, it stays valid until the node is replaced or
+     * removed. With multithreading, it stays valid in the current read-side
+     * critical section.
+     *
+     * In single-threaded builds, UA_Server_editNode edits the returned node in
+     * place, and the reference target and alias caches keep the pointer until
+     * getVersion changes. So get must return the node that is stored in the
+     * backend, not a temporary or cached copy. Backends that keep nodes
+     * elsewhere (e.g. on disk) have to hold the stored nodes in memory. */
+    const UA_Node * (*get)(UA_NodeStore *ns, const UA_NodeId *nodeid);
+
+    /* Returns an editable copy of the node */
+    UA_Node * (*getCopy)(UA_NodeStore *ns, const UA_NodeId *nodeid);
+
+    /* Replaces the node with an edited copy. Fails with
+     * UA_STATUSCODE_BADINTERNALERROR if the node was replaced since the copy
+     * was made. */
+    UA_StatusCode (*replace)(UA_NodeStore *ns, UA_Node *node);
+
+    UA_StatusCode (*remove)(UA_NodeStore *ns, const UA_NodeId *nodeid);
+
+    /* Hint that the given number of nodes will be added. Backends that do not
+     * need to prepare return UA_STATUSCODE_GOOD. */
+    UA_StatusCode (*reserve)(UA_NodeStore *ns, size_t additional);
+
+    void (*iterate)(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor,
+                    void *visitorContext);
+
+    /* Optional, can be NULL */
+    void (*getStatistics)(UA_NodeStore *ns, UA_NodeStoreStatistics *stats);
+
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Returns a version that changes whenever a node is replaced or removed.
+     * Edits in place (see get) do not change the version. */
+    UA_UInt32 (*getVersion)(const UA_NodeStore *ns);
+#endif
+};
 
 /**
  * Nodestore Lifecycle
  * ^^^^^^^^^^^^^^^^^^^ */
-/* Create a new nodestore */
+/* Create the default nodestore */
 UA_NodeStore * UA_NodeStore_new(void);
 
 /* Delete the nodestore and all nodes in it. Do not call from a read-side
    critical section (multithreading). */
-void UA_NodeStore_delete(UA_NodeStore *ns);
+static UA_INLINE void
+UA_NodeStore_delete(UA_NodeStore *ns) {
+    ns->deleteNodeStore(ns);
+}
 
 /**
  * Node Lifecycle
@@ -38,26 +115,32 @@ void UA_NodeStore_delete(UA_NodeStore *ns);
  * to be removed via a special deleteNode function. (If the new node is not
  * added to the nodestore.) */
 /* Create an editable node of the given NodeClass. */
-UA_Node * UA_NodeStore_newNode(UA_NodeClass nodeClass);
-#define UA_NodeStore_newObjectNode() \
-    (UA_ObjectNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECT)
-#define UA_NodeStore_newVariableNode() \
-    (UA_VariableNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLE)
-#define UA_NodeStore_newMethodNode() \
-    (UA_MethodNode*)UA_NodeStore_newNode(UA_NODECLASS_METHOD)
-#define UA_NodeStore_newObjectTypeNode() \
-    (UA_ObjectTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECTTYPE)
-#define UA_NodeStore_newVariableTypeNode() \
-    (UA_VariableTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLETYPE)
-#define UA_NodeStore_newReferenceTypeNode() \
-    (UA_ReferenceTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_REFERENCETYPE)
-#define UA_NodeStore_newDataTypeNode() \
-    (UA_DataTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_DATATYPE)
-#define UA_NodeStore_newViewNode() \
-    (UA_ViewNode*)UA_NodeStore_newNode(UA_NODECLASS_VIEW)
+static UA_INLINE UA_Node *
+UA_NodeStore_newNode(UA_NodeStore *ns, UA_NodeClass nodeClass) {
+    return ns->newNode(ns, nodeClass);
+}
+#define UA_NodeStore_newObjectNode(ns) \
+    (UA_ObjectNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECT)
+#define UA_NodeStore_newVariableNode(ns) \
+    (UA_VariableNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLE)
+#define UA_NodeStore_newMethodNode(ns) \
+    (UA_MethodNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_METHOD)
+#define UA_NodeStore_newObjectTypeNode(ns) \
+    (UA_ObjectTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECTTYPE)
+#define UA_NodeStore_newVariableTypeNode(ns) \
+    (UA_VariableTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLETYPE)
+#define UA_NodeStore_newReferenceTypeNode(ns) \
+    (UA_ReferenceTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_REFERENCETYPE)
+#define UA_NodeStore_newDataTypeNode(ns) \
+    (UA_DataTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_DATATYPE)
+#define UA_NodeStore_newViewNode(ns) \
+    (UA_ViewNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VIEW)
 
 /* Delete an editable node. */
-void UA_NodeStore_deleteNode(UA_Node *node);
+static UA_INLINE void
+UA_NodeStore_deleteNode(UA_NodeStore *ns, UA_Node *node) {
+    ns->deleteNode(ns, node);
+}
 
 /**
  * Insert / Get / Replace / Remove
@@ -65,32 +148,77 @@ void UA_NodeStore_deleteNode(UA_Node *node);
 /* Inserts a new node into the nodestore. If the nodeid is zero, then a fresh
  * numeric nodeid from namespace 1 is assigned. If insertion fails, the node is
  * deleted. */
-UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
+    return ns->insert(ns, node);
+}
 
 /* The returned node is immutable. */
-const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE const UA_Node *
+UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->get(ns, nodeid);
+}
 
 /* Returns an editable copy of a node (needs to be deleted with the deleteNode
    function or inserted / replaced into the nodestore). */
-UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE UA_Node *
+UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->getCopy(ns, nodeid);
+}
 
 /* To replace a node, get an editable copy of the node, edit and replace with
  * this function. If the node was already replaced since the copy was made,
  * UA_STATUSCODE_BADINTERNALERROR is returned. If the nodeid is not found,
  * UA_STATUSCODE_BADNODEIDUNKNOWN is returned. In both error cases, the editable
  * node is deleted. */
-UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
+    return ns->replace(ns, node);
+}
 
 /* Remove a node in the nodestore. */
-UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid);
+static UA_INLINE UA_StatusCode
+UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return ns->remove(ns, nodeid);
+}
+
+/* Make room for additional nodes, so that inserting them does not rehash the
+ * nodestore more than once. */
+static UA_INLINE UA_StatusCode
+UA_NodeStore_reserve(UA_NodeStore *ns, size_t additional) {
+    return ns->reserve(ns, additional);
+}
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* The version is incremented when a node is replaced or removed. Pointers to
+ * nodes stay valid as long as the version does not change. */
+static UA_INLINE UA_UInt32
+UA_NodeStore_getVersion(const UA_NodeStore *ns) {
+    return ns->getVersion(ns);
+}
+#endif
 
 /**
  * Iteration
  * ^^^^^^^^^
- * The following definitions are used to call a callback for every node in the
- * nodestore. */
-typedef void (*UA_NodeStore_nodeVisitor)(const UA_Node *node);
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor);
+ * Call a callback for every node in the nodestore. The context is passed to
+ * the callback. */
+static UA_INLINE void
+UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor,
+                     void *visitorContext) {
+    ns->iterate(ns, visitor, visitorContext);
+}
+
+/**
+ * Statistics
+ * ^^^^^^^^^^ */
+static UA_INLINE UA_StatusCode
+UA_NodeStore_getStatistics(UA_NodeStore *ns, UA_NodeStoreStatistics *stats) {
+    if(!ns->getStatistics)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    ns->getStatistics(ns, stats);
+    return UA_STATUSCODE_GOOD;
+}
 
 #ifdef __cplusplus
 } // extern "C"
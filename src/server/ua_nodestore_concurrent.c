@@ -4,6 +4,7 @@
 
 #include "ua_util.h"
 #include "ua_nodestore.h"
+#include "ua_nodepool.h"
 #include "ua_server_internal.h"
 
 #ifdef UA_ENABLE_MULTITHREADING /* conditional compilation */
@@ -13,50 +14,29 @@ struct nodeEntry {
     struct cds_lfht_node htn; ///< Contains the next-ptr for urcu-hashmap
     struct rcu_head rcu_head; ///< For call-rcu
     struct nodeEntry *orig; //< the version this is a copy from (or NULL)
+    UA_NodePool *pool; ///< The entry is returned to the pool from call_rcu
     UA_Node node; ///< Might be cast from any _bigger_ UA_Node* type. Allocate enough memory!
 };
 
-static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
-    size_t size = sizeof(struct nodeEntry) - sizeof(UA_Node);
-    switch(class) {
-    case UA_NODECLASS_OBJECT:
-        size += sizeof(UA_ObjectNode);
-        break;
-    case UA_NODECLASS_VARIABLE:
-        size += sizeof(UA_VariableNode);
-        break;
-    case UA_NODECLASS_METHOD:
-        size += sizeof(UA_MethodNode);
-        break;
-    case UA_NODECLASS_OBJECTTYPE:
-        size += sizeof(UA_ObjectTypeNode);
-        break;
-    case UA_NODECLASS_VARIABLETYPE:
-        size += sizeof(UA_VariableTypeNode);
-        break;
-    case UA_NODECLASS_REFERENCETYPE:
-        size += sizeof(UA_ReferenceTypeNode);
-        break;
-    case UA_NODECLASS_DATATYPE:
-        size += sizeof(UA_DataTypeNode);
-        break;
-    case UA_NODECLASS_VIEW:
-        size += sizeof(UA_ViewNode);
-        break;
-    default:
-        return NULL;
-    }
-    struct nodeEntry *entry = UA_calloc(1, size);
+typedef struct {
+    struct cds_lfht *ht;
+    UA_NodePool pool; ///< The entries are allocated from slabs per NodeClass
+} NodeHT;
+
+static struct nodeEntry * instantiateEntry(UA_NodePool *pool, UA_NodeClass class) {
+    struct nodeEntry *entry = UA_NodePool_alloc(pool, class);
     if(!entry)
         return NULL;
+    entry->pool = pool;
     entry->node.nodeClass = class;
     return entry;
 }
 
 static void deleteEntry(struct rcu_head *head) {
     struct nodeEntry *entry = container_of(head, struct nodeEntry, rcu_head);
+    UA_NodeClass class = entry->node.nodeClass;
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    UA_NodePool_free(entry->pool, class, entry);
 }
 
 /* We are in a rcu_read lock. So the node will not be freed under our feet. */
@@ -67,15 +47,10 @@ static int compare(struct cds_lfht_node *htn, const void *orig) {
     return UA_NodeId_equal(newid, origid);
 }
 
-UA_NodeStore * UA_NodeStore_new() {
-    /* 64 is the minimum size for the hashtable. */
-    return (UA_NodeStore*)cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
-}
-
 /* do not call with read-side critical section held!! */
-void UA_NodeStore_delete(UA_NodeStore *ns) {
+static void NodeHT_delete(UA_NodeStore *ns) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     struct cds_lfht_iter iter;
     cds_lfht_first(ht, &iter);
     while(iter.node) {
@@ -88,25 +63,30 @@ void UA_NodeStore_delete(UA_NodeStore *ns) {
     }
     UA_RCU_UNLOCK();
     cds_lfht_destroy(ht, NULL);
+    /* Wait until the entries are returned to the pool */
+    rcu_barrier();
     UA_RCU_LOCK();
+    UA_NodePool_deleteMembers(&((NodeHT*)ns->handle)->pool);
+    UA_free(ns->handle);
+    UA_free(ns);
 }
 
-UA_Node * UA_NodeStore_newNode(UA_NodeClass class) {
-    struct nodeEntry *entry = instantiateEntry(class);
+static UA_Node * NodeHT_newNode(UA_NodeStore *ns, UA_NodeClass class) {
+    struct nodeEntry *entry = instantiateEntry(&((NodeHT*)ns->handle)->pool, class);
     if(!entry)
         return NULL;
     return (UA_Node*)&entry->node;
 }
 
-void UA_NodeStore_deleteNode(UA_Node *node) {
+static void NodeHT_deleteNode(UA_NodeStore *ns, UA_Node *node) {
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
     deleteEntry(&entry->rcu_head);
 }
 
-UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
+static UA_StatusCode NodeHT_insert(UA_NodeStore *ns, UA_Node *node) {
     UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     cds_lfht_node_init(&entry->htn);
     struct cds_lfht_node *result;
     //namespace index is assumed to be valid
@@ -144,10 +124,10 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
+static UA_StatusCode NodeHT_replace(UA_NodeStore *ns, UA_Node *node) {
     UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
 
     /* Get the current version */
     UA_UInt32 h = UA_NodeId_hash(&node->nodeId);
@@ -175,9 +155,9 @@ UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
     return UA_STATUSCODE_GOOD;
 }
 
-UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static UA_StatusCode NodeHT_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, nodeid, &iter);
@@ -188,9 +168,14 @@ UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     return UA_STATUSCODE_GOOD;
 }
 
-const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+/* The hashtable is resized automatically */
+static UA_StatusCode NodeHT_reserve(UA_NodeStore *ns, size_t additional) {
+    return UA_STATUSCODE_GOOD;
+}
+
+static const UA_Node * NodeHT_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, nodeid, &iter);
@@ -200,16 +185,16 @@ const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     return &found_entry->node;
 }
 
-UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+static UA_Node * NodeHT_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     UA_UInt32 h = UA_NodeId_hash(nodeid);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, nodeid, &iter);
     struct nodeEntry *entry = (struct nodeEntry*)iter.node;
     if(!entry)
         return NULL;
-    struct nodeEntry *new = instantiateEntry(entry->node.nodeClass);
+    struct nodeEntry *new = instantiateEntry(entry->pool, entry->node.nodeClass);
     if(!new)
         return NULL;
     if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
@@ -220,16 +205,53 @@ UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     return &new->node;
 }
 
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
+static void NodeHT_getStatistics(UA_NodeStore *ns, UA_NodeStoreStatistics *stats) {
+    UA_NodePool_getStatistics(&((NodeHT*)ns->handle)->pool, stats);
+}
+
+static void NodeHT_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor,
+                           void *visitorContext) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+    struct cds_lfht *ht = ((NodeHT*)ns->handle)->ht;
     struct cds_lfht_iter iter;
     cds_lfht_first(ht, &iter);
     while(iter.node != NULL) {
         struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
-        visitor(&found_entry->node);
+        visitor(visitorContext, &found_entry->node);
         cds_lfht_next(ht, &iter);
     }
 }
 
+UA_NodeStore * UA_NodeStore_new() {
+    UA_NodeStore *ns = UA_malloc(sizeof(UA_NodeStore));
+    if(!ns)
+        return NULL;
+    NodeHT *nodeht = UA_malloc(sizeof(NodeHT));
+    if(!nodeht) {
+        UA_free(ns);
+        return NULL;
+    }
+    /* 64 is the minimum size for the hashtable. */
+    nodeht->ht = cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+    if(!nodeht->ht) {
+        UA_free(nodeht);
+        UA_free(ns);
+        return NULL;
+    }
+    UA_NodePool_init(&nodeht->pool, offsetof(struct nodeEntry, node));
+    ns->handle = nodeht;
+    ns->deleteNodeStore = NodeHT_delete;
+    ns->newNode = NodeHT_newNode;
+    ns->deleteNode = NodeHT_deleteNode;
+    ns->insert = NodeHT_insert;
+    ns->get = NodeHT_get;
+    ns->getCopy = NodeHT_getCopy;
+    ns->replace = NodeHT_replace;
+    ns->remove = NodeHT_remove;
+    ns->reserve = NodeHT_reserve;
+    ns->iterate = NodeHT_iterate;
+    ns->getStatistics = NodeHT_getStatistics;
+    return ns;
+}
+
 #endif /* UA_ENABLE_MULTITHREADING */
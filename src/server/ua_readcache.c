@@ -0,0 +1,193 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_readcache.h"
+#include "ua_types_generated_handling.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_READCACHE_LOCK(cache) pthread_mutex_lock(&(cache)->mutex)
+# define UA_READCACHE_UNLOCK(cache) pthread_mutex_unlock(&(cache)->mutex)
+#else
+# define UA_READCACHE_LOCK(cache)
+# define UA_READCACHE_UNLOCK(cache)
+#endif
+
+void
+UA_ReadCache_init(UA_ReadCache *cache) {
+    memset(cache, 0, sizeof(UA_ReadCache));
+    TAILQ_INIT(&cache->lru);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&cache->mutex, NULL);
+#endif
+}
+
+static void
+deleteEntry(UA_ReadCacheEntry *entry) {
+    UA_NodeId_deleteMembers(&entry->nodeId);
+    UA_DataValue_deleteMembers(&entry->value);
+    UA_free(entry);
+}
+
+void
+UA_ReadCache_deleteMembers(UA_ReadCache *cache) {
+    UA_ReadCacheEntry *entry, *entry_tmp;
+    TAILQ_FOREACH_SAFE(entry, &cache->lru, lruEntry, entry_tmp)
+        deleteEntry(entry);
+    UA_free(cache->buckets);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&cache->mutex);
+#endif
+}
+
+/* Returns the pointer that points to the entry (or to the NULL at the end of
+ * the bucket) */
+static UA_ReadCacheEntry **
+findEntry(UA_ReadCache *cache, const UA_NodeId *nodeId, UA_UInt32 hash) {
+    UA_ReadCacheEntry **slot = &cache->buckets[hash & (cache->bucketsSize - 1)];
+    while(*slot) {
+        if((*slot)->hash == hash && UA_NodeId_equal(&(*slot)->nodeId, nodeId))
+            break;
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static void
+unlinkEntry(UA_ReadCache *cache, UA_ReadCacheEntry **slot) {
+    UA_ReadCacheEntry *entry = *slot;
+    *slot = entry->next;
+    TAILQ_REMOVE(&cache->lru, entry, lruEntry);
+    --cache->stats.entries;
+}
+
+static UA_StatusCode
+copyCachedValue(const UA_DataValue *cached, const UA_NumericRange *range,
+                UA_DataValue *v) {
+    if(!range)
+        return UA_DataValue_copy(cached, v);
+    UA_StatusCode retval = UA_Variant_copyRange(&cached->value, &v->value, *range);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    v->hasValue = cached->hasValue;
+    v->hasStatus = cached->hasStatus;
+    v->status = cached->status;
+    v->hasSourceTimestamp = cached->hasSourceTimestamp;
+    v->sourceTimestamp = cached->sourceTimestamp;
+    v->hasSourcePicoseconds = cached->hasSourcePicoseconds;
+    v->sourcePicoseconds = cached->sourcePicoseconds;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean
+UA_ReadCache_get(UA_ReadCache *cache, const UA_NodeId *nodeId, UA_DateTime maxAge,
+                 const UA_NumericRange *range, UA_DataValue *v) {
+    UA_Boolean hit = false;
+    UA_READCACHE_LOCK(cache);
+    if(cache->buckets) {
+        UA_ReadCacheEntry *entry = *findEntry(cache, nodeId, UA_NodeId_hash(nodeId));
+        if(entry && UA_DateTime_nowMonotonic() - entry->readTime <= maxAge &&
+           copyCachedValue(&entry->value, range, v) == UA_STATUSCODE_GOOD) {
+            /* Move to the front of the lru list */
+            TAILQ_REMOVE(&cache->lru, entry, lruEntry);
+            TAILQ_INSERT_HEAD(&cache->lru, entry, lruEntry);
+            hit = true;
+        }
+    }
+    if(hit)
+        ++cache->stats.hits;
+    else
+        ++cache->stats.misses;
+    UA_READCACHE_UNLOCK(cache);
+    return hit;
+}
+
+static size_t
+bucketsForEntries(size_t maxEntries) {
+    size_t size = 16;
+    while(size < maxEntries && size < ((size_t)1 << 20))
+        size <<= 1;
+    return size;
+}
+
+void
+UA_ReadCache_put(UA_ReadCache *cache, size_t maxEntries,
+                 const UA_NodeId *nodeId, const UA_DataValue *value) {
+    if(maxEntries == 0)
+        return;
+
+    /* Prepare the new entry outside of the lock */
+    UA_ReadCacheEntry *entry = UA_malloc(sizeof(UA_ReadCacheEntry));
+    if(!entry)
+        return;
+    UA_StatusCode retval = UA_NodeId_copy(nodeId, &entry->nodeId);
+    retval |= UA_DataValue_copy(value, &entry->value);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return;
+    }
+    entry->hash = UA_NodeId_hash(nodeId);
+    entry->readTime = UA_DateTime_nowMonotonic();
+    if(!entry->value.hasSourceTimestamp) {
+        entry->value.sourceTimestamp = UA_DateTime_now();
+        entry->value.hasSourceTimestamp = true;
+    }
+
+    UA_ReadCacheEntry *old = NULL;
+    UA_ReadCacheEntry *evicted = NULL;
+    UA_READCACHE_LOCK(cache);
+
+    /* Allocate the buckets with the first entry */
+    if(!cache->buckets) {
+        size_t size = bucketsForEntries(maxEntries);
+        cache->buckets = UA_calloc(size, sizeof(UA_ReadCacheEntry*));
+        if(!cache->buckets) {
+            UA_READCACHE_UNLOCK(cache);
+            deleteEntry(entry);
+            return;
+        }
+        cache->bucketsSize = size;
+    }
+
+    /* Replace an existing entry */
+    UA_ReadCacheEntry **slot = findEntry(cache, nodeId, entry->hash);
+    if(*slot) {
+        old = *slot;
+        unlinkEntry(cache, slot);
+    }
+
+    /* Evict the least recently used entry */
+    if(cache->stats.entries >= maxEntries) {
+        evicted = TAILQ_LAST(&cache->lru, UA_ReadCacheLru);
+        unlinkEntry(cache, findEntry(cache, &evicted->nodeId, evicted->hash));
+        ++cache->stats.evictions;
+    }
+
+    /* Insert */
+    slot = &cache->buckets[entry->hash & (cache->bucketsSize - 1)];
+    entry->next = *slot;
+    *slot = entry;
+    TAILQ_INSERT_HEAD(&cache->lru, entry, lruEntry);
+    ++cache->stats.entries;
+    UA_READCACHE_UNLOCK(cache);
+
+    if(old)
+        deleteEntry(old);
+    if(evicted)
+        deleteEntry(evicted);
+}
+
+void
+UA_ReadCache_remove(UA_ReadCache *cache, const UA_NodeId *nodeId) {
+    UA_ReadCacheEntry *entry = NULL;
+    UA_READCACHE_LOCK(cache);
+    if(cache->buckets) {
+        UA_ReadCacheEntry **slot = findEntry(cache, nodeId, UA_NodeId_hash(nodeId));
+        entry = *slot;
+        if(entry)
+            unlinkEntry(cache, slot);
+    }
+    UA_READCACHE_UNLOCK(cache);
+    if(entry)
+        deleteEntry(entry);
+}
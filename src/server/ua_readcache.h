@@ -0,0 +1,60 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#ifndef UA_READCACHE_H_
+#define UA_READCACHE_H_
+
+#include "queue.h"
+#include "ua_util.h"
+#include "ua_server.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+/**
+ * Read Cache
+ * ----------
+ * Values read from data sources are kept with the (monotonic) time of the
+ * read. Reads with a maxAge and the sampling of monitored items are served from
+ * the cache if the value is fresh enough. The cache is a hash map with chaining
+ * and a fixed number of buckets. When the maximum number of entries is reached,
+ * the least recently used entry is evicted. */
+
+typedef struct UA_ReadCacheEntry {
+    TAILQ_ENTRY(UA_ReadCacheEntry) lruEntry; /* most recently used first */
+    struct UA_ReadCacheEntry *next; /* next entry in the bucket */
+    UA_UInt32 hash;
+    UA_NodeId nodeId;
+    UA_DateTime readTime; /* monotonic */
+    UA_DataValue value;
+} UA_ReadCacheEntry;
+
+typedef struct {
+    size_t bucketsSize; /* power of two, allocated with the first entry */
+    UA_ReadCacheEntry **buckets;
+    TAILQ_HEAD(UA_ReadCacheLru, UA_ReadCacheEntry) lru;
+    UA_ReadCacheStatistics stats;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t mutex;
+#endif
+} UA_ReadCache;
+
+void UA_ReadCache_init(UA_ReadCache *cache);
+void UA_ReadCache_deleteMembers(UA_ReadCache *cache);
+
+/* Copies the cached value if it is not older than maxAge (in 100ns). Only the
+ * selected range is copied if range is not NULL. Returns true on a hit. */
+UA_Boolean
+UA_ReadCache_get(UA_ReadCache *cache, const UA_NodeId *nodeId, UA_DateTime maxAge,
+                 const UA_NumericRange *range, UA_DataValue *v);
+
+/* Stores a copy of the value. Does nothing if maxEntries is zero. */
+void
+UA_ReadCache_put(UA_ReadCache *cache, size_t maxEntries,
+                 const UA_NodeId *nodeId, const UA_DataValue *value);
+
+void UA_ReadCache_remove(UA_ReadCache *cache, const UA_NodeId *nodeId);
+
+#endif /* UA_READCACHE_H_ */
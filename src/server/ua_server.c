@@ -91,16 +91,29 @@ UA_Server_forEachChildNodeCall(UA_Server *server, UA_NodeId parentNodeId,
      * delete references from within the callback. In single-threaded mode this
      * changes the same node we point at here. In multi-threaded mode, this
      * creates a new copy as nodes are truly immutable. */
-    UA_ReferenceNode *refs = NULL;
     size_t refssize = parent->referencesSize;
-    UA_StatusCode retval = UA_Array_copy(parent->references, parent->referencesSize,
-                                         (void**)&refs, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    UA_ReferenceNode *refs = UA_Array_new(refssize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    if(!refs) {
+        UA_RCU_UNLOCK();
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    const UA_ReferenceIndex *index = &parent->referenceIndex;
+    for(size_t k = 0; k < index->kindsSize; ++k) {
+        const UA_ReferenceKind *kind = &index->kinds[k];
+        for(size_t i = kind->referencesStart; i < kind->referencesStart + kind->referencesSize; ++i) {
+            retval |= UA_NodeId_copy(&kind->referenceTypeId, &refs[i].referenceTypeId);
+            retval |= UA_ExpandedNodeId_copy(&parent->references[i].targetId, &refs[i].targetId);
+            refs[i].isInverse = kind->isInverse;
+        }
+    }
     if(retval != UA_STATUSCODE_GOOD) {
         UA_RCU_UNLOCK();
+        UA_Array_delete(refs, refssize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
         return retval;
     }
 
-    for(size_t i = parent->referencesSize; i > 0; --i) {
+    for(size_t i = refssize; i > 0; --i) {
         UA_ReferenceNode *ref = &refs[i-1];
         retval |= callback(ref->targetId.nodeId, ref->isInverse,
                            ref->referenceTypeId, handle);
@@ -175,9 +188,23 @@ void UA_Server_delete(UA_Server *server) {
     // Delete all internal data
     UA_SecureChannelManager_deleteMembers(&server->secureChannelManager);
     UA_SessionManager_deleteMembers(&server->sessionManager);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_SamplingGroup_deleteAll(server);
+    UA_RetransmissionQueue_deleteAll(server);
+# ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&server->samplingMutex);
+    pthread_mutex_destroy(&server->retransmissionMutex);
+# endif
+#endif
     UA_RCU_LOCK();
     UA_NodeStore_delete(server->nodestore);
     UA_RCU_UNLOCK();
+    UA_ReadCache_deleteMembers(&server->readCache);
+    UA_TypeIndex_deleteMembers(&server->typeIndex);
+    UA_Server_deleteAsyncRequests(server);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&server->asyncMutex);
+#endif
     UA_Array_delete(server->namespaces, server->namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
     UA_Array_delete(server->endpointDescriptions, server->endpointDescriptionsSize,
                     &UA_TYPES[UA_TYPES_ENDPOINTDESCRIPTION]);
@@ -364,7 +391,7 @@ static void copyNames(UA_Node *node, char *name) {
 static void
 addDataTypeNode(UA_Server *server, char* name, UA_UInt32 datatypeid,
                 UA_Boolean isAbstract, UA_UInt32 parent) {
-    UA_DataTypeNode *datatype = UA_NodeStore_newDataTypeNode();
+    UA_DataTypeNode *datatype = UA_NodeStore_newDataTypeNode(server->nodestore);
     copyNames((UA_Node*)datatype, name);
     datatype->nodeId.identifier.numeric = datatypeid;
     datatype->isAbstract = isAbstract;
@@ -375,7 +402,7 @@ addDataTypeNode(UA_Server *server, char* name, UA_UInt32 datatypeid,
 static void
 addObjectTypeNode(UA_Server *server, char* name, UA_UInt32 objecttypeid,
                   UA_UInt32 parent, UA_UInt32 parentreference) {
-    UA_ObjectTypeNode *objecttype = UA_NodeStore_newObjectTypeNode();
+    UA_ObjectTypeNode *objecttype = UA_NodeStore_newObjectTypeNode(server->nodestore);
     copyNames((UA_Node*)objecttype, name);
     objecttype->nodeId.identifier.numeric = objecttypeid;
     addNodeInternal(server, (UA_Node*)objecttype, UA_NODEID_NUMERIC(0, parent),
@@ -385,7 +412,7 @@ addObjectTypeNode(UA_Server *server, char* name, UA_UInt32 objecttypeid,
 static UA_VariableTypeNode*
 createVariableTypeNode(UA_Server *server, char* name, UA_UInt32 variabletypeid,
                        UA_Boolean abstract) {
-    UA_VariableTypeNode *variabletype = UA_NodeStore_newVariableTypeNode();
+    UA_VariableTypeNode *variabletype = UA_NodeStore_newVariableTypeNode(server->nodestore);
     copyNames((UA_Node*)variabletype, name);
     variabletype->nodeId.identifier.numeric = variabletypeid;
     variabletype->isAbstract = abstract;
@@ -430,8 +457,27 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
         return NULL;
 
     server->config = config;
-    server->nodestore = UA_NodeStore_new();
+    server->nodestore = config.nodestore ? config.nodestore : UA_NodeStore_new();
+    UA_ReadCache_init(&server->readCache);
+    UA_TypeIndex_init(&server->typeIndex);
+    LIST_INIT(&server->asyncRequests);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&server->asyncMutex, NULL);
+#endif
     LIST_INIT(&server->repeatedJobs);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    LIST_INIT(&server->samplingGroups);
+    TAILQ_INIT(&server->retransmissionQueue);
+# ifdef UA_ENABLE_MULTITHREADING
+    /* User callbacks during a sweep may add or remove items */
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&server->samplingMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&server->retransmissionMutex, NULL);
+# endif
+#endif
 
 #ifdef UA_ENABLE_MULTITHREADING
     rcu_init();
@@ -509,14 +555,14 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /* Bootstrap reference hierarchy */
     /*********************************/
 
-    UA_ReferenceTypeNode *references = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *references = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)references, "References");
     references->nodeId.identifier.numeric = UA_NS0ID_REFERENCES;
     references->isAbstract = true;
     references->symmetric = true;
     references->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "References");
 
-    UA_ReferenceTypeNode *hassubtype = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hassubtype = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hassubtype, "HasSubtype");
     hassubtype->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "HasSupertype");
     hassubtype->nodeId.identifier.numeric = UA_NS0ID_HASSUBTYPE;
@@ -528,7 +574,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeStore_insert(server->nodestore, (UA_Node*)hassubtype);
     UA_RCU_UNLOCK();
 
-    UA_ReferenceTypeNode *hierarchicalreferences = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hierarchicalreferences = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hierarchicalreferences, "HierarchicalReferences");
     hierarchicalreferences->nodeId.identifier.numeric = UA_NS0ID_HIERARCHICALREFERENCES;
     hierarchicalreferences->isAbstract = true;
@@ -536,7 +582,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)hierarchicalreferences,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *nonhierarchicalreferences = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *nonhierarchicalreferences = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)nonhierarchicalreferences, "NonHierarchicalReferences");
     nonhierarchicalreferences->nodeId.identifier.numeric = UA_NS0ID_NONHIERARCHICALREFERENCES;
     nonhierarchicalreferences->isAbstract = true;
@@ -544,7 +590,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)nonhierarchicalreferences,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *haschild = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *haschild = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)haschild, "HasChild");
     haschild->nodeId.identifier.numeric = UA_NS0ID_HASCHILD;
     haschild->isAbstract = false;
@@ -552,7 +598,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)haschild,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *organizes = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *organizes = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)organizes, "Organizes");
     organizes->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OrganizedBy");
     organizes->nodeId.identifier.numeric = UA_NS0ID_ORGANIZES;
@@ -561,7 +607,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)organizes,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *haseventsource = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *haseventsource = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)haseventsource, "HasEventSource");
     haseventsource->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "EventSourceOf");
     haseventsource->nodeId.identifier.numeric = UA_NS0ID_HASEVENTSOURCE;
@@ -570,7 +616,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)haseventsource,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasmodellingrule = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasmodellingrule = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasmodellingrule, "HasModellingRule");
     hasmodellingrule->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ModellingRuleOf");
     hasmodellingrule->nodeId.identifier.numeric = UA_NS0ID_HASMODELLINGRULE;
@@ -578,7 +624,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasmodellingrule->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasmodellingrule, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasencoding = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasencoding = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasencoding, "HasEncoding");
     hasencoding->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "EncodingOf");
     hasencoding->nodeId.identifier.numeric = UA_NS0ID_HASENCODING;
@@ -586,7 +632,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasencoding->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasencoding, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasdescription = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasdescription = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasdescription, "HasDescription");
     hasdescription->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "DescriptionOf");
     hasdescription->nodeId.identifier.numeric = UA_NS0ID_HASDESCRIPTION;
@@ -594,7 +640,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasdescription->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasdescription, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hastypedefinition = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hastypedefinition = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hastypedefinition, "HasTypeDefinition");
     hastypedefinition->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "TypeDefinitionOf");
     hastypedefinition->nodeId.identifier.numeric = UA_NS0ID_HASTYPEDEFINITION;
@@ -602,7 +648,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hastypedefinition->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hastypedefinition, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *generatesevent = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *generatesevent = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)generatesevent, "GeneratesEvent");
     generatesevent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "GeneratedBy");
     generatesevent->nodeId.identifier.numeric = UA_NS0ID_GENERATESEVENT;
@@ -610,7 +656,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     generatesevent->symmetric  = false;
     addNodeInternal(server, (UA_Node*)generatesevent, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *aggregates = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *aggregates = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)aggregates, "Aggregates");
     aggregates->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "AggregatedBy");
     aggregates->nodeId.identifier.numeric = UA_NS0ID_AGGREGATES;
@@ -622,7 +668,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCHILD), nodeIdHasSubType,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), true);
 
-    UA_ReferenceTypeNode *hasproperty = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasproperty = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasproperty, "HasProperty");
     hasproperty->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "PropertyOf");
     hasproperty->nodeId.identifier.numeric = UA_NS0ID_HASPROPERTY;
@@ -631,7 +677,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternal(server, (UA_Node*)hasproperty,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hascomponent = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hascomponent = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hascomponent, "HasComponent");
     hascomponent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ComponentOf");
     hascomponent->nodeId.identifier.numeric = UA_NS0ID_HASCOMPONENT;
@@ -639,7 +685,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hascomponent->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hascomponent, UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasnotifier = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasnotifier = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasnotifier, "HasNotifier");
     hasnotifier->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "NotifierOf");
     hasnotifier->nodeId.identifier.numeric = UA_NS0ID_HASNOTIFIER;
@@ -647,7 +693,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasnotifier->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasnotifier, UA_NODEID_NUMERIC(0, UA_NS0ID_HASEVENTSOURCE), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasorderedcomponent = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasorderedcomponent = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasorderedcomponent, "HasOrderedComponent");
     hasorderedcomponent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OrderedComponentOf");
     hasorderedcomponent->nodeId.identifier.numeric = UA_NS0ID_HASORDEREDCOMPONENT;
@@ -655,7 +701,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasorderedcomponent->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasorderedcomponent, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hasmodelparent = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hasmodelparent = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hasmodelparent, "HasModelParent");
     hasmodelparent->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ModelParentOf");
     hasmodelparent->nodeId.identifier.numeric = UA_NS0ID_HASMODELPARENT;
@@ -663,7 +709,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hasmodelparent->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hasmodelparent, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *fromstate = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *fromstate = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)fromstate, "FromState");
     fromstate->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ToTransition");
     fromstate->nodeId.identifier.numeric = UA_NS0ID_FROMSTATE;
@@ -671,7 +717,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     fromstate->symmetric  = false;
     addNodeInternal(server, (UA_Node*)fromstate, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *tostate = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *tostate = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)tostate, "ToState");
     tostate->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "FromTransition");
     tostate->nodeId.identifier.numeric = UA_NS0ID_TOSTATE;
@@ -679,7 +725,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     tostate->symmetric  = false;
     addNodeInternal(server, (UA_Node*)tostate, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hascause = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hascause = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hascause, "HasCause");
     hascause->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "MayBeCausedBy");
     hascause->nodeId.identifier.numeric = UA_NS0ID_HASCAUSE;
@@ -687,7 +733,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     hascause->symmetric  = false;
     addNodeInternal(server, (UA_Node*)hascause, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
     
-    UA_ReferenceTypeNode *haseffect = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *haseffect = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)haseffect, "HasEffect");
     haseffect->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "MayBeEffectedBy");
     haseffect->nodeId.identifier.numeric = UA_NS0ID_HASEFFECT;
@@ -695,7 +741,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     haseffect->symmetric  = false;
     addNodeInternal(server, (UA_Node*)haseffect, nodeIdNonHierarchicalReferences, nodeIdHasSubType);
 
-    UA_ReferenceTypeNode *hashistoricalconfiguration = UA_NodeStore_newReferenceTypeNode();
+    UA_ReferenceTypeNode *hashistoricalconfiguration = UA_NodeStore_newReferenceTypeNode(server->nodestore);
     copyNames((UA_Node*)hashistoricalconfiguration, "HasHistoricalConfiguration");
     hashistoricalconfiguration->inverseName = UA_LOCALIZEDTEXT_ALLOC("en_US", "HistoricalConfigurationOf");
     hashistoricalconfiguration->nodeId.identifier.numeric = UA_NS0ID_HASHISTORICALCONFIGURATION;
@@ -707,7 +753,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /* Data Types */
     /**************/
 
-    UA_DataTypeNode *basedatatype = UA_NodeStore_newDataTypeNode();
+    UA_DataTypeNode *basedatatype = UA_NodeStore_newDataTypeNode(server->nodestore);
     copyNames((UA_Node*)basedatatype, "BaseDataType");
     basedatatype->nodeId.identifier.numeric = UA_NS0ID_BASEDATATYPE;
     basedatatype->isAbstract = true;
@@ -795,7 +841,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /* Basic Object Types */
     /**********************/
 
-    UA_ObjectTypeNode *baseobjtype = UA_NodeStore_newObjectTypeNode();
+    UA_ObjectTypeNode *baseobjtype = UA_NodeStore_newObjectTypeNode(server->nodestore);
     copyNames((UA_Node*)baseobjtype, "BaseObjectType");
     baseobjtype->nodeId.identifier.numeric = UA_NS0ID_BASEOBJECTTYPE;
     UA_RCU_LOCK();
@@ -824,7 +870,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
         .namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC,
         .identifier.numeric = UA_NS0ID_HASTYPEDEFINITION};
 
-    UA_ObjectNode *root = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *root = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)root, "Root");
     root->nodeId.identifier.numeric = UA_NS0ID_ROOTFOLDER;
     UA_RCU_LOCK();
@@ -833,19 +879,19 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER), nodeIdHasTypeDefinition,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), true);
 
-    UA_ObjectNode *objects = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *objects = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)objects, "Objects");
     objects->nodeId.identifier.numeric = UA_NS0ID_OBJECTSFOLDER;
     addNodeInternalWithType(server, (UA_Node*)objects, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
                             nodeIdOrganizes, nodeIdFolderType);
 
-    UA_ObjectNode *types = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *types = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)types, "Types");
     types->nodeId.identifier.numeric = UA_NS0ID_TYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)types, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
                             nodeIdOrganizes, nodeIdFolderType);
 
-    UA_ObjectNode *referencetypes = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *referencetypes = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)referencetypes, "ReferenceTypes");
     referencetypes->nodeId.identifier.numeric = UA_NS0ID_REFERENCETYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)referencetypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
@@ -853,7 +899,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCETYPESFOLDER), nodeIdOrganizes,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_REFERENCES), true);
 
-    UA_ObjectNode *datatypes = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *datatypes = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)datatypes, "DataTypes");
     datatypes->nodeId.identifier.numeric = UA_NS0ID_DATATYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)datatypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
@@ -861,7 +907,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_DATATYPESFOLDER), nodeIdOrganizes,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE), true);
 
-    UA_ObjectNode *variabletypes = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *variabletypes = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)variabletypes, "VariableTypes");
     variabletypes->nodeId.identifier.numeric = UA_NS0ID_VARIABLETYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)variabletypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
@@ -869,7 +915,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_VARIABLETYPESFOLDER), nodeIdOrganizes,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE), true);
 
-    UA_ObjectNode *objecttypes = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *objecttypes = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)objecttypes, "ObjectTypes");
     objecttypes->nodeId.identifier.numeric = UA_NS0ID_OBJECTTYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)objecttypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
@@ -877,13 +923,13 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTTYPESFOLDER), nodeIdOrganizes,
                            UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), true);
 
-    UA_ObjectNode *eventtypes = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *eventtypes = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)eventtypes, "EventTypes");
     eventtypes->nodeId.identifier.numeric = UA_NS0ID_EVENTTYPESFOLDER;
     addNodeInternalWithType(server, (UA_Node*)eventtypes, UA_NODEID_NUMERIC(0, UA_NS0ID_TYPESFOLDER),
                             nodeIdOrganizes, nodeIdFolderType);
 
-    UA_ObjectNode *views = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *views = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)views, "Views");
     views->nodeId.identifier.numeric = UA_NS0ID_VIEWSFOLDER;
     addNodeInternalWithType(server, (UA_Node*)views, UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
@@ -893,13 +939,13 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /* Modelling Rules */
     /*******************/
 
-    UA_ObjectNode *mandatory = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *mandatory = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)mandatory, "Mandatory");
     mandatory->nodeId.identifier.numeric = UA_NS0ID_MODELLINGRULE_MANDATORY;
     addNodeInternalWithType(server, (UA_Node*)mandatory, UA_NODEID_NULL,
                             UA_NODEID_NULL, UA_NODEID_NUMERIC(0, UA_NS0ID_MODELLINGRULETYPE));
 
-    UA_ObjectNode *optional = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *optional = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)optional, "Optional");
     optional->nodeId.identifier.numeric = UA_NS0ID_MODELLINGRULE_OPTIONAL;
     addNodeInternalWithType(server, (UA_Node*)optional, UA_NODEID_NULL,
@@ -915,7 +961,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     /*********************/
     
     /* Create our own server object */ 
-    UA_ObjectNode *servernode = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *servernode = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)servernode, "Server");
     servernode->nodeId.identifier.numeric = UA_NS0ID_SERVER;
     addNodeInternalWithType(server, (UA_Node*)servernode, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
@@ -927,19 +973,19 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId serverNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
     deleteInstanceChildren(server, &serverNodeId);
     
-    UA_VariableNode *namespaceArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *namespaceArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)namespaceArray, "NamespaceArray");
     namespaceArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_NAMESPACEARRAY;
     namespaceArray->valueSource = UA_VALUESOURCE_DATASOURCE;
-    namespaceArray->value.dataSource = (UA_DataSource) {.handle = server, .read = readNamespaces,
-                                                        .write = writeNamespaces};
+    namespaceArray->value.source.dataSource = (UA_DataSource) {.handle = server, .read = readNamespaces,
+                                                               .write = writeNamespaces};
     namespaceArray->dataType = UA_TYPES[UA_TYPES_STRING].typeId;
     namespaceArray->valueRank = 1;
     namespaceArray->minimumSamplingInterval = 1.0;
     addNodeInternalWithType(server, (UA_Node*)namespaceArray, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *serverArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverArray, "ServerArray");
     serverArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERARRAY;
     UA_Variant_setArrayCopy(&serverArray->value.data.value.value,
@@ -951,7 +997,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)serverArray, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *servercapablities = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *servercapablities = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)servercapablities, "ServerCapabilities");
     servercapablities->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES;
     addNodeInternalWithType(server, (UA_Node*)servercapablities, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
@@ -960,7 +1006,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId ServerCapabilitiesNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES);
     deleteInstanceChildren(server, &ServerCapabilitiesNodeId);
     
-    UA_VariableNode *localeIdArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *localeIdArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)localeIdArray, "LocaleIdArray");
     localeIdArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_LOCALEIDARRAY;
     UA_String enLocale = UA_STRING("en");
@@ -973,7 +1019,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxBrowseContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxBrowseContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxBrowseContinuationPoints, "MaxBrowseContinuationPoints");
     maxBrowseContinuationPoints->nodeId.identifier.numeric =
         UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXBROWSECONTINUATIONPOINTS;
@@ -1001,7 +1047,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     ADDPROFILEARRAY("http://opcfoundation.org/UA-Profile/Server/EmbeddedDataChangeSubscription");
 #endif
 
-    UA_VariableNode *serverProfileArray = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverProfileArray = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverProfileArray, "ServerProfileArray");
     serverProfileArray->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_SERVERPROFILEARRAY;
     UA_Variant_setArray(&serverProfileArray->value.data.value.value,
@@ -1016,7 +1062,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *softwareCertificates = UA_NodeStore_newVariableNode();
+    UA_VariableNode *softwareCertificates = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)softwareCertificates, "SoftwareCertificates");
     softwareCertificates->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_SOFTWARECERTIFICATES;
     softwareCertificates->dataType = UA_TYPES[UA_TYPES_SIGNEDSOFTWARECERTIFICATE].typeId;
@@ -1024,7 +1070,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxQueryContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxQueryContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxQueryContinuationPoints, "MaxQueryContinuationPoints");
     maxQueryContinuationPoints->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXQUERYCONTINUATIONPOINTS;
     UA_Variant_setScalar(&maxQueryContinuationPoints->value.data.value.value,
@@ -1034,7 +1080,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *maxHistoryContinuationPoints = UA_NodeStore_newVariableNode();
+    UA_VariableNode *maxHistoryContinuationPoints = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)maxHistoryContinuationPoints, "MaxHistoryContinuationPoints");
     maxHistoryContinuationPoints->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXHISTORYCONTINUATIONPOINTS;
     UA_Variant_setScalar(&maxHistoryContinuationPoints->value.data.value.value,
@@ -1044,7 +1090,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *minSupportedSampleRate = UA_NodeStore_newVariableNode();
+    UA_VariableNode *minSupportedSampleRate = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)minSupportedSampleRate, "MinSupportedSampleRate");
     minSupportedSampleRate->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MINSUPPORTEDSAMPLERATE;
     UA_Variant_setScalar(&minSupportedSampleRate->value.data.value.value,
@@ -1054,21 +1100,21 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *modellingRules = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *modellingRules = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)modellingRules, "ModellingRules");
     modellingRules->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_MODELLINGRULES;
     addNodeInternalWithType(server, (UA_Node*)modellingRules,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES), nodeIdHasProperty,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE));
 
-    UA_ObjectNode *aggregateFunctions = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *aggregateFunctions = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)aggregateFunctions, "AggregateFunctions");
     aggregateFunctions->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERCAPABILITIES_AGGREGATEFUNCTIONS;
     addNodeInternalWithType(server, (UA_Node*)aggregateFunctions,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE));
 
-    UA_ObjectNode *serverdiagnostics = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *serverdiagnostics = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)serverdiagnostics, "ServerDiagnostics");
     serverdiagnostics->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERDIAGNOSTICS;
     addNodeInternalWithType(server, (UA_Node*)serverdiagnostics,
@@ -1077,7 +1123,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_NodeId ServerDiagnosticsNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS);
     deleteInstanceChildren(server, &ServerDiagnosticsNodeId);
     
-    UA_VariableNode *enabledFlag = UA_NodeStore_newVariableNode();
+    UA_VariableNode *enabledFlag = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)enabledFlag, "EnabledFlag");
     enabledFlag->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERDIAGNOSTICS_ENABLEDFLAG;
     UA_Variant_setScalar(&enabledFlag->value.data.value.value, UA_Boolean_new(),
@@ -1089,16 +1135,16 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS),
                             nodeIdHasProperty, UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *serverstatus = UA_NodeStore_newVariableNode();
+    UA_VariableNode *serverstatus = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)serverstatus, "ServerStatus");
     serverstatus->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS);
     serverstatus->valueSource = UA_VALUESOURCE_DATASOURCE;
-    serverstatus->value.dataSource = (UA_DataSource) {.handle = server, .read = readStatus,
-                                                      .write = NULL};
+    serverstatus->value.source.dataSource = (UA_DataSource) {.handle = server, .read = readStatus,
+                                                             .write = NULL};
     addNodeInternalWithType(server, (UA_Node*)serverstatus, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *starttime = UA_NodeStore_newVariableNode();
+    UA_VariableNode *starttime = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)starttime, "StartTime");
     starttime->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_STARTTIME);
     UA_Variant_setScalarCopy(&starttime->value.data.value.value,
@@ -1108,17 +1154,17 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *currenttime = UA_NodeStore_newVariableNode();
+    UA_VariableNode *currenttime = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)currenttime, "CurrentTime");
     currenttime->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
     currenttime->valueSource = UA_VALUESOURCE_DATASOURCE;
-    currenttime->value.dataSource = (UA_DataSource) {.handle = NULL, .read = readCurrentTime,
-                                                     .write = NULL};
+    currenttime->value.source.dataSource = (UA_DataSource) {.handle = NULL, .read = readCurrentTime,
+                                                            .write = NULL};
     addNodeInternalWithType(server, (UA_Node*)currenttime,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *state = UA_NodeStore_newVariableNode();
+    UA_VariableNode *state = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)state, "State");
     state->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERSTATUS_STATE;
     UA_Variant_setScalar(&state->value.data.value.value, UA_ServerState_new(),
@@ -1128,7 +1174,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addNodeInternalWithType(server, (UA_Node*)state, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *buildinfo = UA_NodeStore_newVariableNode();
+    UA_VariableNode *buildinfo = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)buildinfo, "BuildInfo");
     buildinfo->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO);
     UA_Variant_setScalarCopy(&buildinfo->value.data.value.value,
@@ -1138,7 +1184,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BUILDINFOTYPE));
 
-    UA_VariableNode *producturi = UA_NodeStore_newVariableNode();
+    UA_VariableNode *producturi = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)producturi, "ProductUri");
     producturi->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_PRODUCTURI);
     UA_Variant_setScalarCopy(&producturi->value.data.value.value, &server->config.buildInfo.productUri,
@@ -1148,7 +1194,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *manufacturername = UA_NodeStore_newVariableNode();
+    UA_VariableNode *manufacturername = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)manufacturername, "ManufacturerName");
     manufacturername->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_MANUFACTURERNAME);
     UA_Variant_setScalarCopy(&manufacturername->value.data.value.value,
@@ -1159,7 +1205,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *productname = UA_NodeStore_newVariableNode();
+    UA_VariableNode *productname = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)productname, "ProductName");
     productname->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_PRODUCTNAME);
     UA_Variant_setScalarCopy(&productname->value.data.value.value, &server->config.buildInfo.productName,
@@ -1169,7 +1215,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *softwareversion = UA_NodeStore_newVariableNode();
+    UA_VariableNode *softwareversion = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)softwareversion, "SoftwareVersion");
     softwareversion->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_SOFTWAREVERSION);
     UA_Variant_setScalarCopy(&softwareversion->value.data.value.value,
@@ -1179,7 +1225,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *buildnumber = UA_NodeStore_newVariableNode();
+    UA_VariableNode *buildnumber = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)buildnumber, "BuildNumber");
     buildnumber->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_BUILDNUMBER);
     UA_Variant_setScalarCopy(&buildnumber->value.data.value.value, &server->config.buildInfo.buildNumber,
@@ -1189,7 +1235,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *builddate = UA_NodeStore_newVariableNode();
+    UA_VariableNode *builddate = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)builddate, "BuildDate");
     builddate->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO_BUILDDATE);
     UA_Variant_setScalarCopy(&builddate->value.data.value.value, &server->config.buildInfo.buildDate,
@@ -1199,7 +1245,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_BUILDINFO),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *secondstillshutdown = UA_NodeStore_newVariableNode();
+    UA_VariableNode *secondstillshutdown = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)secondstillshutdown, "SecondsTillShutdown");
     secondstillshutdown->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_SECONDSTILLSHUTDOWN);
     UA_Variant_setScalar(&secondstillshutdown->value.data.value.value, UA_UInt32_new(),
@@ -1209,7 +1255,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *shutdownreason = UA_NodeStore_newVariableNode();
+    UA_VariableNode *shutdownreason = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)shutdownreason, "ShutdownReason");
     shutdownreason->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_SHUTDOWNREASON);
     UA_Variant_setScalar(&shutdownreason->value.data.value.value, UA_LocalizedText_new(),
@@ -1219,26 +1265,26 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS),
                             nodeIdHasComponent, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE));
 
-    UA_VariableNode *servicelevel = UA_NodeStore_newVariableNode();
+    UA_VariableNode *servicelevel = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)servicelevel, "ServiceLevel");
     servicelevel->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVICELEVEL);
     servicelevel->valueSource = UA_VALUESOURCE_DATASOURCE;
-    servicelevel->value.dataSource = (UA_DataSource) {.handle = server, .read = readServiceLevel,
-                                                      .write = NULL};
+    servicelevel->value.source.dataSource = (UA_DataSource) {.handle = server, .read = readServiceLevel,
+                                                             .write = NULL};
     addNodeInternalWithType(server, (UA_Node*)servicelevel,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), nodeIdHasComponent,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_VariableNode *auditing = UA_NodeStore_newVariableNode();
+    UA_VariableNode *auditing = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)auditing, "Auditing");
     auditing->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_AUDITING);
     auditing->valueSource = UA_VALUESOURCE_DATASOURCE;
-    auditing->value.dataSource = (UA_DataSource) {.handle = server, .read = readAuditing, .write = NULL};
+    auditing->value.source.dataSource = (UA_DataSource) {.handle = server, .read = readAuditing, .write = NULL};
     addNodeInternalWithType(server, (UA_Node*)auditing,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), nodeIdHasComponent,
                             UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE));
 
-    UA_ObjectNode *vendorServerInfo = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *vendorServerInfo = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)vendorServerInfo, "VendorServerInfo");
     vendorServerInfo->nodeId.identifier.numeric = UA_NS0ID_SERVER_VENDORSERVERINFO;
     addNodeInternalWithType(server, (UA_Node*)vendorServerInfo,
@@ -1250,7 +1296,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     */
 
 
-    UA_ObjectNode *serverRedundancy = UA_NodeStore_newObjectNode();
+    UA_ObjectNode *serverRedundancy = UA_NodeStore_newObjectNode(server->nodestore);
     copyNames((UA_Node*)serverRedundancy, "ServerRedundancy");
     serverRedundancy->nodeId.identifier.numeric = UA_NS0ID_SERVER_SERVERREDUNDANCY;
     addNodeInternalWithType(server, (UA_Node*)serverRedundancy,
@@ -1261,7 +1307,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
                            nodeIdHasTypeDefinition, UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_SERVERREDUNDANCYTYPE), true);
     */
 
-    UA_VariableNode *redundancySupport = UA_NodeStore_newVariableNode();
+    UA_VariableNode *redundancySupport = UA_NodeStore_newVariableNode(server->nodestore);
     copyNames((UA_Node*)redundancySupport, "RedundancySupport");
     redundancySupport->nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERREDUNDANCY_REDUNDANCYSUPPORT);
     redundancySupport->valueRank = -1;
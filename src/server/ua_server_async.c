@@ -0,0 +1,241 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_server_internal.h"
+#include "ua_securechannel_manager.h"
+#include "ua_types_generated_handling.h"
+
+/**
+ * Asynchronous Operations
+ * -----------------------
+ * Operations of Read and Call requests can complete asynchronously. The
+ * operation is started inside the service. If the callback does not complete
+ * the operation immediately, the operation is attached to the request. After
+ * the service returns, processMSG hands over the response if operations are
+ * pending. The response is sent with the completion of the last operation.
+ *
+ * Operations without a request (e.g. from sampling or the local read) cannot
+ * wait. Their result is BadWouldBlock. They are detached and only cleaned up
+ * upon completion. The same happens to the operations of requests that are
+ * deleted with the server. */
+
+UA_THREAD_LOCAL UA_AsyncContext *asyncContext = NULL;
+
+/* Operations of a request can be started from several threads when the items
+ * are processed in parallel */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_ASYNC_LOCK(server) pthread_mutex_lock(&(server)->asyncMutex)
+# define UA_ASYNC_UNLOCK(server) pthread_mutex_unlock(&(server)->asyncMutex)
+#else
+# define UA_ASYNC_LOCK(server)
+# define UA_ASYNC_UNLOCK(server)
+#endif
+
+UA_AsyncOperation *
+UA_AsyncOperation_new(UA_Server *server, UA_AsyncOperationType type, void *result) {
+    UA_AsyncOperation *op = UA_malloc(sizeof(UA_AsyncOperation));
+    if(!op)
+        return NULL;
+    op->server = server;
+    op->type = type;
+    op->inCallback = true;
+    op->completed = false;
+    op->status = UA_STATUSCODE_GOOD;
+    op->result = result;
+    op->timestamps = UA_TIMESTAMPSTORETURN_NEITHER;
+    op->request = NULL;
+    return op;
+}
+
+/* Create the request with the first pending operation */
+static UA_AsyncRequest *
+getAsyncRequest(UA_Server *server, UA_AsyncContext *ctx) {
+    if(ctx->request)
+        return ctx->request;
+    UA_AsyncRequest *req = UA_malloc(sizeof(UA_AsyncRequest) + ctx->responseType->memSize);
+    if(!req)
+        return NULL;
+    req->channelId = ctx->channelId;
+    req->requestId = ctx->requestId;
+    req->requestHandle = ctx->requestHandle;
+    req->responseType = ctx->responseType;
+    req->responseReady = false;
+    LIST_INIT(&req->pendingOperations);
+    req->response = (void*)((uintptr_t)req + sizeof(UA_AsyncRequest));
+    LIST_INSERT_HEAD(&server->asyncRequests, req, listEntry);
+    ctx->request = req;
+    return req;
+}
+
+static void
+deleteAsyncRequest(UA_AsyncRequest *req) {
+    /* Detach the pending operations */
+    UA_AsyncOperation *op, *op_tmp;
+    LIST_FOREACH_SAFE(op, &req->pendingOperations, listEntry, op_tmp) {
+        LIST_REMOVE(op, listEntry);
+        op->request = NULL;
+        op->result = NULL;
+    }
+    LIST_REMOVE(req, listEntry);
+    if(req->responseReady)
+        UA_deleteMembers(req->response, req->responseType);
+    UA_free(req);
+}
+
+/* The request is already removed from the list */
+static void
+sendAsyncResponse(UA_Server *server, UA_AsyncRequest *req) {
+    /* The channel may have been closed in the meantime */
+    UA_SecureChannel *channel =
+        UA_SecureChannelManager_get(&server->secureChannelManager, req->channelId);
+    if(channel) {
+        UA_ResponseHeader *rh = (UA_ResponseHeader*)req->response;
+        rh->requestHandle = req->requestHandle;
+        rh->timestamp = UA_DateTime_now();
+        UA_StatusCode retval =
+            UA_SecureChannel_sendBinaryMessage(channel, req->requestId,
+                                               req->response, req->responseType);
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_INFO_CHANNEL(server->config.logger, channel,
+                                "Could not send the asynchronous response over the "
+                                "SecureChannel with StatusCode %s",
+                                UA_StatusCode_name(retval));
+    } else {
+        UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "Dropping the asynchronous response to the closed "
+                     "SecureChannel %i", req->channelId);
+    }
+    UA_deleteMembers(req->response, req->responseType);
+    UA_free(req);
+}
+
+/* The state of the operation is only changed under the lock. A completion from
+ * the main loop can happen while the callback returns on a worker thread. */
+UA_StatusCode
+UA_AsyncOperation_started(UA_AsyncOperation *op, UA_StatusCode callbackResult) {
+    UA_Server *server = op->server;
+    UA_ASYNC_LOCK(server);
+
+    /* Not started or completed inside the callback */
+    if(callbackResult != UA_STATUSCODE_GOOD || op->completed) {
+        UA_ASYNC_UNLOCK(server);
+        if(callbackResult == UA_STATUSCODE_GOOD)
+            callbackResult = op->status;
+        UA_free(op);
+        return callbackResult;
+    }
+
+    /* Pending. Attach to the request if there is one. */
+    op->inCallback = false;
+    UA_AsyncRequest *req = NULL;
+    if(asyncContext)
+        req = getAsyncRequest(server, asyncContext);
+    if(req) {
+        op->request = req;
+        LIST_INSERT_HEAD(&req->pendingOperations, op, listEntry);
+    } else {
+        /* Detach. The operation is freed with the completion. */
+        op->result = NULL;
+    }
+    UA_ASYNC_UNLOCK(server);
+    return req ? UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY : UA_STATUSCODE_BADWOULDBLOCK;
+}
+
+UA_Boolean
+UA_AsyncContext_deferResponse(UA_Server *server, UA_AsyncContext *ctx, void *response) {
+    UA_AsyncRequest *req = ctx->request;
+    if(!req)
+        return false;
+    UA_ASYNC_LOCK(server);
+    UA_Boolean pending = !LIST_EMPTY(&req->pendingOperations);
+    if(pending) {
+        memcpy(req->response, response, req->responseType->memSize);
+        req->responseReady = true;
+    } else {
+        deleteAsyncRequest(req);
+    }
+    UA_ASYNC_UNLOCK(server);
+    return pending;
+}
+
+/* Called with the lock held. Returns the request if the response can be
+ * sent. */
+static UA_AsyncRequest *
+operationCompleted(UA_AsyncOperation *op) {
+    if(op->inCallback) {
+        op->completed = true;
+        return NULL;
+    }
+    UA_AsyncRequest *req = op->request;
+    if(req) {
+        LIST_REMOVE(op, listEntry);
+        if(LIST_EMPTY(&req->pendingOperations) && req->responseReady)
+            LIST_REMOVE(req, listEntry);
+        else
+            req = NULL;
+    }
+    UA_free(op);
+    return req;
+}
+
+void
+UA_AsyncOperation_completeRead(UA_AsyncOperation *op, const UA_DataValue *value) {
+    UA_Server *server = op->server;
+    UA_ASYNC_LOCK(server);
+    UA_DataValue *v = (UA_DataValue*)op->result;
+    if(v) {
+        /* Bad statuscodes are returned without a value */
+        if(value->hasStatus && (value->status & 0x80000000))
+            op->status = value->status;
+        else
+            op->status = UA_DataValue_copy(value, v);
+
+        /* The timestamps of synchronous completions are handled in ReadWithNode */
+        if(!op->inCallback) {
+            if(op->status != UA_STATUSCODE_GOOD) {
+                v->hasStatus = true;
+                v->status = op->status;
+            } else {
+                v->hasValue = true;
+                setValueTimestamps(v, op->timestamps);
+            }
+        }
+    }
+    UA_AsyncRequest *req = operationCompleted(op);
+    UA_ASYNC_UNLOCK(server);
+    if(req)
+        sendAsyncResponse(server, req);
+}
+
+#ifdef UA_ENABLE_METHODCALLS
+void
+UA_AsyncOperation_completeCall(UA_AsyncOperation *op, UA_StatusCode status,
+                               size_t outputSize, const UA_Variant *output) {
+    UA_Server *server = op->server;
+    UA_ASYNC_LOCK(server);
+    UA_CallMethodResult *result = (UA_CallMethodResult*)op->result;
+    if(result) {
+        /* The output arguments are allocated by the service */
+        if(outputSize > result->outputArgumentsSize)
+            outputSize = result->outputArgumentsSize;
+        for(size_t i = 0; i < outputSize && status == UA_STATUSCODE_GOOD; ++i) {
+            UA_Variant_deleteMembers(&result->outputArguments[i]);
+            status = UA_Variant_copy(&output[i], &result->outputArguments[i]);
+        }
+        result->statusCode = status;
+        op->status = status;
+    }
+    UA_AsyncRequest *req = operationCompleted(op);
+    UA_ASYNC_UNLOCK(server);
+    if(req)
+        sendAsyncResponse(server, req);
+}
+#endif
+
+void
+UA_Server_deleteAsyncRequests(UA_Server *server) {
+    UA_AsyncRequest *req, *req_tmp;
+    LIST_FOREACH_SAFE(req, &server->asyncRequests, listEntry, req_tmp)
+        deleteAsyncRequest(req);
+}
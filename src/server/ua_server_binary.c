@@ -482,9 +482,27 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     }
 #endif
 
-    /* Call the service */
+    /* Call the service. Read and Call may start asynchronous operations. Then,
+     * the response is sent when the last operation completes. */
     UA_assert(service); /* For all services besides publish, the service pointer is non-NULL*/
-    service(server, session, request, response);
+    if(requestType == &UA_TYPES[UA_TYPES_READREQUEST] ||
+       requestType == &UA_TYPES[UA_TYPES_CALLREQUEST]) {
+        UA_AsyncContext ctx;
+        ctx.channelId = channel->securityToken.channelId;
+        ctx.requestId = requestId;
+        ctx.requestHandle = requestHeader->requestHandle;
+        ctx.responseType = responseType;
+        ctx.request = NULL;
+        asyncContext = &ctx;
+        service(server, session, request, response);
+        asyncContext = NULL;
+        if(UA_AsyncContext_deferResponse(server, &ctx, response)) {
+            UA_deleteMembers(request, requestType);
+            return;
+        }
+    } else {
+        service(server, session, request, response);
+    }
 
  send_response:
     /* Send the response */
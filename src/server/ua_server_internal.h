@@ -11,6 +11,9 @@
 #include "ua_session_manager.h"
 #include "ua_securechannel_manager.h"
 #include "ua_nodestore.h"
+#include "ua_stringpool.h"
+#include "ua_readcache.h"
+#include "ua_typeindex.h"
 
 #define ANONYMOUS_POLICY "open62541-anonymous-policy"
 #define USERNAME_POLICY "open62541-username-policy"
@@ -66,6 +69,73 @@ typedef struct {
 extern UA_THREAD_LOCAL UA_Session* methodCallSession;
 #endif
 
+/***************************/
+/* Asynchronous Operations */
+/***************************/
+
+/* A Read or Call request with pending asynchronous operations. The response is
+ * sent when the last operation completes. */
+typedef struct UA_AsyncRequest {
+    LIST_ENTRY(UA_AsyncRequest) listEntry;
+    UA_UInt32 channelId;
+    UA_UInt32 requestId;
+    UA_UInt32 requestHandle;
+    const UA_DataType *responseType;
+    UA_Boolean responseReady; /* The service has returned */
+    LIST_HEAD(UA_AsyncOperationsList, UA_AsyncOperation) pendingOperations;
+    void *response; /* Allocated behind the structure */
+} UA_AsyncRequest;
+
+/* Set by processMSG while a service that supports asynchronous operations is
+ * executed */
+typedef struct {
+    UA_UInt32 channelId;
+    UA_UInt32 requestId;
+    UA_UInt32 requestHandle;
+    const UA_DataType *responseType;
+    UA_AsyncRequest *request; /* Created with the first pending operation */
+} UA_AsyncContext;
+
+extern UA_THREAD_LOCAL UA_AsyncContext *asyncContext;
+
+typedef enum {
+    UA_ASYNCOPERATIONTYPE_READ,
+    UA_ASYNCOPERATIONTYPE_CALL
+} UA_AsyncOperationType;
+
+/* The fields are changed under the asyncMutex of the server */
+struct UA_AsyncOperation {
+    UA_Server *server;
+    UA_AsyncOperationType type;
+    UA_Boolean inCallback;
+    UA_Boolean completed;
+    UA_StatusCode status; /* Of a completion inside the callback */
+    void *result; /* UA_DataValue or UA_CallMethodResult. NULL if the result
+                   * cannot be used anymore. */
+    UA_TimestampsToReturn timestamps; /* For reads */
+    UA_AsyncRequest *request;
+    LIST_ENTRY(UA_AsyncOperation) listEntry; /* In the request */
+};
+
+UA_AsyncOperation *
+UA_AsyncOperation_new(UA_Server *server, UA_AsyncOperationType type, void *result);
+
+/* Call after the callback that started the operation has returned. Returns
+ * UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY if the operation is pending and the
+ * result will be set upon completion. Otherwise, the operation is cleaned up
+ * and the result is set (if the callback returned good). */
+UA_StatusCode
+UA_AsyncOperation_started(UA_AsyncOperation *op, UA_StatusCode callbackResult);
+
+/* Takes over the response of the service if operations are pending. Returns
+ * true if the response is sent later on when the last operation completes. */
+UA_Boolean
+UA_AsyncContext_deferResponse(UA_Server *server, UA_AsyncContext *ctx, void *response);
+
+/* Cancels the pending operations. Their completion only frees the operation
+ * afterwards. */
+void UA_Server_deleteAsyncRequests(UA_Server *server);
+
 struct UA_Server {
     /* Meta */
     UA_DateTime startTime;
@@ -78,6 +148,15 @@ struct UA_Server {
 
     /* Address Space */
     UA_NodeStore *nodestore;
+    UA_ReadCache readCache;
+    UA_TypeIndex typeIndex; /* hasSubtype closures */
+
+    /* Requests waiting for asynchronous operations */
+    LIST_HEAD(AsyncRequestsList, UA_AsyncRequest) asyncRequests;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t asyncMutex; /* Operations of a request can be started in
+                                 * parallel */
+#endif
 
     size_t namespacesSize;
     UA_String *namespaces;
@@ -86,6 +165,25 @@ struct UA_Server {
     /* Jobs with a repetition interval */
     LIST_HEAD(RepeatedJobsList, RepeatedJob) repeatedJobs;
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* MonitoredItems grouped by their sampling interval */
+    LIST_HEAD(SamplingGroupsList, UA_SamplingGroup) samplingGroups;
+# ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t samplingMutex; /* Recursive. Held for the sweeps and while
+                                    * items are added to or removed from the
+                                    * groups. */
+# endif
+
+    /* Retransmission entries of all subscriptions. Oldest first. */
+    TAILQ_HEAD(UA_RetransmissionQueue, UA_NotificationMessageEntry) retransmissionQueue;
+    UA_RetransmissionStatistics retransmissionStatistics;
+# ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t retransmissionMutex; /* For the server-wide queue, the
+                                          * statistics and the queues of the
+                                          * subscriptions */
+# endif
+#endif
+
 #ifndef UA_ENABLE_MULTITHREADING
     SLIST_HEAD(DelayedJobsList, UA_DelayedJob) delayedCallbacks;
 #else
@@ -112,8 +210,105 @@ struct UA_Server {
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node);
 UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst);
 
+/* Replace the browse name, display name, description and string NodeId of the
+ * node with shared copies from the string pool. The single-threaded nodestore
+ * interns the strings of inserted and replaced nodes in its own pool. Copies of
+ * a node have private strings. Without a pool or if memory runs out, the node
+ * is left unchanged. */
+UA_StatusCode UA_Node_internStrings(UA_Node *node, UA_StringPool *pool);
+
+/* Replace the interned strings with private copies before they are edited */
+UA_StatusCode UA_Node_uninternStrings(UA_Node *node);
+
+/* The value of a variable with UA_VALUESOURCE_DATA. The value is only valid
+ * within the RCU read-side critical section. */
+const UA_DataValue * UA_VariableNode_getValue(const UA_VariableNode *node);
+
+/* Deletes the value of a variable with UA_VALUESOURCE_DATA */
+void UA_VariableNode_deleteValue(UA_VariableNode *node);
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* With multithreading, nodes are edited on a copy that replaces the original
+ * node. To avoid copying the entire node for every write, the value of a
+ * variable moves into a slot when it is first written with the Write service.
+ * The slot is shared by all copies of the node and freed with the last copy.
+ * Writing the value only exchanges the pointer to the current value. The old
+ * value is freed with call_rcu. So the value can be read without locks within
+ * the RCU read-side critical section. */
+typedef struct {
+    struct rcu_head rcu_head;
+    UA_DataValue value;
+} UA_SlotValue;
+
+typedef struct UA_ValueSlot {
+    UA_SlotValue * volatile current;
+    volatile UA_UInt32 refCount; /* Number of node copies using the slot */
+} UA_ValueSlot;
+
+/* Moves the value into a new slot if there is none yet */
+UA_StatusCode UA_VariableNode_addValueSlot(UA_VariableNode *node);
+#endif
+
+/* References are only added and removed with the following functions that
+ * maintain the reference index of the node. The referenceTypeIndex is the
+ * position of the reference type in the type index of the server or
+ * UA_TYPEINDEX_NOTFOUND. The nameHash is the browse name hash of the target or
+ * zero if the reference is not indexed by name. */
+UA_StatusCode
+UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                     UA_UInt32 referenceTypeIndex, const UA_ExpandedNodeId *targetId,
+                     UA_Boolean isInverse, UA_UInt32 nameHash);
+
+/* Returns UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED if not found */
+UA_StatusCode
+UA_Node_deleteReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                        const UA_NodeId *targetId, UA_Boolean isInverse);
+
+const UA_NodeReference *
+UA_Node_findReference(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                      const UA_NodeId *targetId, UA_Boolean isInverse);
+
+/* Never returns zero */
+UA_UInt32 UA_Node_browseNameHash(const UA_QualifiedName *browseName);
+
+/* Returns UA_STATUSCODE_BADNOTFOUND if there is no such reference */
+UA_StatusCode
+UA_Node_setReferenceName(UA_Node *node, const UA_NodeId *referenceTypeId,
+                         const UA_NodeId *targetId, UA_Boolean isInverse,
+                         UA_UInt32 nameHash);
+
+/* Iterates over the references with the name hash. The iterator starts at
+ * zero. Returns NULL at the end. The browse name of the targets has to be
+ * compared, as the hashes may collide. */
+const UA_NodeReference *
+UA_Node_nextReferenceByName(const UA_Node *node, UA_UInt32 nameHash, size_t *iterator);
+
+const UA_ReferenceKind *
+UA_Node_findReferenceKind(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                          UA_Boolean isInverse);
+
+/* Updates the browse name hash of the node in the name index of the nodes
+ * that reference it. Called after the browse name was changed, outside of the
+ * edit of the node. */
+void UA_Server_updateReferenceNames(UA_Server *server, UA_Session *session,
+                                    const UA_Node *node);
+
+/* Deletes the cached argument definitions of the MethodNodes that have the
+ * node as a property. Called after the BrowseName or the value of a variable
+ * has changed and before a variable is deleted. */
+void UA_Server_invalidateMethodArguments(UA_Server *server, const UA_Node *property);
+
+/* Returns the node for a NodeId or an alias registered with the session */
+const UA_Node *
+UA_Server_getSessionNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId);
+
+/* Returns the target node of a reference. In single-threaded mode, the target
+ * is cached in the reference until the nodestore version changes. */
+const UA_Node *
+UA_Server_getReferenceTarget(UA_Server *server, const UA_NodeReference *ref);
+
 /* Calls callback on the node. In the multithreaded case, the node is copied before and replaced in
-   the nodestore. */
+   the nodestore. The NodeId can be an alias registered with the session. */
 typedef UA_StatusCode (*UA_EditNodeCallback)(UA_Server*, UA_Session*, UA_Node*, const void*);
 UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                                  UA_EditNodeCallback callback, const void *data);
@@ -129,6 +324,80 @@ UA_StatusCode UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback cal
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data);
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server);
 
+/* Processes the items [start, end) of a service request */
+typedef void (*UA_ServiceSliceCallback)(UA_Server *server, UA_Session *session,
+                                        const void *request, void *response,
+                                        size_t start, size_t end);
+
+/* Items with the same key are not processed in parallel. Aliases of
+ * registered nodes have the key of the resolved NodeId. */
+typedef UA_UInt32 (*UA_ServiceItemKey)(UA_Session *session, const void *request,
+                                       size_t index);
+
+/* With multithreading and more items than config.parallelItemsThreshold, the
+ * items are split into slices that are processed by the worker threads and the
+ * calling thread. Returns when all items are processed. If key is not NULL and
+ * two items have the same key, all items are processed by the calling thread.
+ * Otherwise, the callback is called once for all items. */
+void
+UA_Server_processServiceItems(UA_Server *server, UA_Session *session, size_t itemsSize,
+                              UA_ServiceSliceCallback callback, UA_ServiceItemKey key,
+                              const void *request, void *response);
+
+/**
+ * Static Node Tables
+ * ------------------
+ * The nodeset compiler can emit an information model as static tables instead
+ * of code that adds every node through the services. The tables are constant
+ * data, so the generated file compiles quickly and most of it stays in the
+ * read-only section of the binary. The nodes are created in bulk from the
+ * table. References are added in both directions. Duplicate references (e.g. a
+ * forward reference that is also listed as the inverse reference of the target)
+ * are added only once. References to nodes that are neither in the table nor
+ * in the nodestore are skipped. Unknown DataTypes of variables fall back to
+ * BaseDataType. There is no instantiation from the type definitions, as the
+ * nodeset contains the instances completely. Variable values are not part of
+ * the table. */
+typedef struct {
+    UA_NodeId referenceTypeId;
+    UA_NodeId targetId;
+    UA_Boolean isForward;
+} UA_StaticReference;
+
+typedef struct {
+    UA_NodeClass nodeClass;
+    UA_NodeId nodeId;
+    UA_QualifiedName browseName;
+    UA_LocalizedText displayName;
+    UA_LocalizedText description;
+    UA_UInt32 writeMask;
+    UA_UInt32 userWriteMask;
+
+    /* Attributes of the NodeClasses. Attributes that do not belong to the
+     * NodeClass are ignored. */
+    UA_Boolean isAbstract;
+    UA_Boolean symmetric;
+    UA_LocalizedText inverseName;
+    UA_Byte eventNotifier;
+    UA_Boolean containsNoLoops;
+    UA_NodeId dataType;
+    UA_Int32 valueRank;
+    UA_Byte accessLevel;
+    UA_Byte userAccessLevel;
+    UA_Double minimumSamplingInterval;
+    UA_Boolean historizing;
+    UA_Boolean executable;
+    UA_Boolean userExecutable;
+
+    size_t referencesSize;
+    const UA_StaticReference *references;
+} UA_StaticNode;
+
+/* Adds the nodes of the table. Nodes that cannot be added are skipped. Returns
+ * the first error. */
+UA_StatusCode
+UA_Server_addStaticNodes(UA_Server *server, size_t nodesSize, const UA_StaticNode *nodes);
+
 /* Add an existing node. The node is assumed to be "finished", i.e. no
  * instantiation from inheritance is necessary. Instantiationcallback and
  * addedNodeId may be NULL. */
@@ -166,12 +435,6 @@ UA_StatusCode
 getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
                  UA_NodeId **typeHierarchy, size_t *typeHierarchySize);
 
-/* Recursively searches "upwards" in the tree following specific reference types */
-UA_Boolean
-isNodeInTree(UA_NodeStore *ns, const UA_NodeId *leafNode,
-             const UA_NodeId *nodeToFind, const UA_NodeId *referenceTypeIds,
-             size_t referenceTypeIdsSize);
-
 const UA_Node *
 getNodeType(UA_Server *server, const UA_Node *node);
 
@@ -218,10 +481,60 @@ void Service_Browse_single(UA_Server *server, UA_Session *session,
                            const UA_BrowseDescription *descr,
                            UA_UInt32 maxrefs, UA_BrowseResult *result);
 
+/* maxAge is in ms. Values from data sources that are not older are taken from
+ * the read cache. */
 void Service_Read_single(UA_Server *server, UA_Session *session,
-                         UA_TimestampsToReturn timestamps,
+                         UA_TimestampsToReturn timestamps, UA_Double maxAge,
                          const UA_ReadValueId *id, UA_DataValue *v);
 
+/* Read an attribute from a node that was already looked up in the nodestore.
+ * The nodeId of the ReadValueId is not evaluated. Asynchronous reads leave the
+ * DataValue untouched until they complete. */
+void ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
+                  UA_TimestampsToReturn timestamps, UA_Double maxAge,
+                  const UA_ReadValueId *id, UA_DataValue *v);
+
+/* Set the timestamps of a value attribute that was read */
+void setValueTimestamps(UA_DataValue *v, UA_TimestampsToReturn timestamps);
+
+/* Values of data sources with a readBatch callback are collected and read with
+ * one call per data source */
+typedef struct {
+    void *handle; /* Of the data source */
+    UA_StatusCode (*readBatch)(void *handle, size_t itemsSize, const UA_NodeId *nodeIds,
+                               UA_Boolean includeSourceTimeStamp,
+                               const UA_NumericRange * const *ranges,
+                               UA_DataValue *values);
+    UA_NodeId nodeId;
+    UA_NumericRange range;
+    UA_Boolean hasRange;
+    UA_TimestampsToReturn timestamps;
+    UA_DataValue *value;
+} UA_BatchReadItem;
+
+typedef struct {
+    size_t itemsSize;
+    size_t itemsCapacity;
+    UA_BatchReadItem *items;
+} UA_BatchRead;
+
+void UA_BatchRead_init(UA_BatchRead *batch);
+
+/* Is the attribute of the node read with readBatch? */
+UA_Boolean UA_BatchRead_accepts(const UA_Node *node, UA_UInt32 attributeId);
+
+/* Adds the value attribute of an accepted node to the batch. Values from the
+ * read cache and errors of the index range are set right away. If the item
+ * could not be added, it needs to be read individually. */
+UA_StatusCode
+UA_BatchRead_add(UA_Server *server, UA_BatchRead *batch, const UA_Node *node,
+                 const UA_String *indexRange, UA_TimestampsToReturn timestamps,
+                 UA_Double maxAge, UA_DataValue *value);
+
+/* Reads the values of all items and cleans up the batch. The values are set
+ * as if they were read with ReadWithNode. */
+void UA_BatchRead_execute(UA_Server *server, UA_BatchRead *batch);
+
 void Service_Call_single(UA_Server *server, UA_Session *session,
                          const UA_CallMethodRequest *request,
                          UA_CallMethodResult *result);
@@ -0,0 +1,643 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_server_internal.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_generated_handling.h"
+
+/**
+ * Address Space Snapshots
+ * -----------------------
+ * The image starts with a header (magic number, format version, library
+ * version and the namespace array) and the number of nodes. Then the nodes
+ * follow with their attributes and references in the OPC UA binary encoding.
+ * The encoding is little-endian on all platforms, so an image can be created on
+ * the build host and be loaded on the target. Images with another format or
+ * library version are rejected.
+ *
+ * The references are written grouped by their reference kind. The browse name
+ * hashes of the targets depend on the hash function of the library and are not
+ * saved. They are computed again from the decoded nodes. Only the hasSubtype
+ * relations are registered in the type index. The values of data sources are
+ * not saved. Data sources and callbacks are taken over from the nodes of the
+ * current address space with the same NodeId and NodeClass. */
+
+#define UA_SNAPSHOT_MAGIC 0x50414e53 /* "SNAP" */
+#define UA_SNAPSHOT_VERSION 2 /* incremented with every change of the format */
+
+/**********/
+/* Saving */
+/**********/
+
+typedef struct {
+    UA_ByteString *buf; /* NULL to compute the size only */
+    size_t offset;
+    UA_UInt32 nodesSize;
+    UA_StatusCode retval;
+} SnapshotWriter;
+
+static void
+writeField(SnapshotWriter *w, const void *p, const UA_DataType *type) {
+    if(w->retval != UA_STATUSCODE_GOOD)
+        return;
+    if(!w->buf) {
+        w->offset += UA_calcSizeBinary((void*)(uintptr_t)p, type);
+        return;
+    }
+    w->retval = UA_encodeBinary(p, type, NULL, NULL, w->buf, &w->offset);
+}
+
+static void
+writeSize(SnapshotWriter *w, size_t size) {
+    if(size > UA_UINT32_MAX) {
+        w->retval = UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+        return;
+    }
+    UA_UInt32 size32 = (UA_UInt32)size;
+    writeField(w, &size32, &UA_TYPES[UA_TYPES_UINT32]);
+}
+
+static void
+writeReferences(SnapshotWriter *w, const UA_Node *node) {
+    const UA_ReferenceIndex *ri = &node->referenceIndex;
+    writeSize(w, ri->kindsSize);
+    for(size_t i = 0; i < ri->kindsSize; ++i) {
+        const UA_ReferenceKind *kind = &ri->kinds[i];
+        writeField(w, &kind->referenceTypeId, &UA_TYPES[UA_TYPES_NODEID]);
+        writeField(w, &kind->isInverse, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeSize(w, kind->referencesSize);
+        for(size_t j = kind->referencesStart;
+            j < kind->referencesStart + kind->referencesSize; ++j)
+            writeField(w, &node->references[j].targetId,
+                       &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+    }
+}
+
+/* Shared by VariableNodes and VariableTypeNodes */
+static void
+writeVariableAttributes(SnapshotWriter *w, const UA_VariableNode *node) {
+    writeField(w, &node->dataType, &UA_TYPES[UA_TYPES_NODEID]);
+    writeField(w, &node->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+    writeSize(w, node->arrayDimensionsSize);
+    for(size_t i = 0; i < node->arrayDimensionsSize; ++i)
+        writeField(w, &node->arrayDimensions[i], &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Boolean isDataSource = (node->valueSource == UA_VALUESOURCE_DATASOURCE);
+    writeField(w, &isDataSource, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    if(!isDataSource)
+        writeField(w, UA_VariableNode_getValue(node), &UA_TYPES[UA_TYPES_DATAVALUE]);
+}
+
+static void
+writeNode(void *context, const UA_Node *node) {
+    SnapshotWriter *w = (SnapshotWriter*)context;
+    ++w->nodesSize;
+    writeField(w, &node->nodeClass, &UA_TYPES[UA_TYPES_NODECLASS]);
+    writeField(w, &node->nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    writeField(w, &node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    writeField(w, &node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    writeField(w, &node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    writeField(w, &node->writeMask, &UA_TYPES[UA_TYPES_UINT32]);
+    writeField(w, &node->userWriteMask, &UA_TYPES[UA_TYPES_UINT32]);
+    writeReferences(w, node);
+
+    switch(node->nodeClass) {
+    case UA_NODECLASS_OBJECT: {
+        const UA_ObjectNode *on = (const UA_ObjectNode*)node;
+        writeField(w, &on->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLE: {
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        writeVariableAttributes(w, vn);
+        writeField(w, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        writeField(w, &vn->userAccessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        writeField(w, &vn->minimumSamplingInterval, &UA_TYPES[UA_TYPES_DOUBLE]);
+        writeField(w, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableTypeNode *vtn = (const UA_VariableTypeNode*)node;
+        writeVariableAttributes(w, (const UA_VariableNode*)node);
+        writeField(w, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        const UA_MethodNode *mn = (const UA_MethodNode*)node;
+        writeField(w, &mn->executable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeField(w, &mn->userExecutable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE: {
+        const UA_ObjectTypeNode *otn = (const UA_ObjectTypeNode*)node;
+        writeField(w, &otn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        const UA_ReferenceTypeNode *rtn = (const UA_ReferenceTypeNode*)node;
+        writeField(w, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeField(w, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeField(w, &rtn->inverseName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE: {
+        const UA_DataTypeNode *dtn = (const UA_DataTypeNode*)node;
+        writeField(w, &dtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VIEW: {
+        const UA_ViewNode *vn = (const UA_ViewNode*)node;
+        writeField(w, &vn->containsNoLoops, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeField(w, &vn->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    default:
+        w->retval = UA_STATUSCODE_BADINTERNALERROR;
+    }
+}
+
+static const UA_UInt16 libraryVersion[3] =
+    {UA_OPEN62541_VER_MAJOR, UA_OPEN62541_VER_MINOR, UA_OPEN62541_VER_PATCH};
+
+static void
+writeSnapshot(UA_Server *server, SnapshotWriter *w) {
+    UA_UInt32 magic = UA_SNAPSHOT_MAGIC;
+    UA_UInt32 version = UA_SNAPSHOT_VERSION;
+    writeField(w, &magic, &UA_TYPES[UA_TYPES_UINT32]);
+    writeField(w, &version, &UA_TYPES[UA_TYPES_UINT32]);
+    for(size_t i = 0; i < 3; ++i)
+        writeField(w, &libraryVersion[i], &UA_TYPES[UA_TYPES_UINT16]);
+    writeSize(w, server->namespacesSize);
+    for(size_t i = 0; i < server->namespacesSize; ++i)
+        writeField(w, &server->namespaces[i], &UA_TYPES[UA_TYPES_STRING]);
+
+    /* The number of nodes is known after the first pass */
+    writeField(w, &w->nodesSize, &UA_TYPES[UA_TYPES_UINT32]);
+    w->nodesSize = 0;
+    UA_NodeStore_iterate(server->nodestore, writeNode, w);
+}
+
+UA_StatusCode
+UA_Server_saveSnapshot(UA_Server *server, UA_ByteString *snapshot) {
+    UA_ByteString_init(snapshot);
+    UA_RCU_LOCK();
+
+    /* Compute the size */
+    SnapshotWriter w;
+    memset(&w, 0, sizeof(SnapshotWriter));
+    writeSnapshot(server, &w);
+    UA_StatusCode retval = w.retval;
+    if(retval != UA_STATUSCODE_GOOD)
+        goto out;
+
+    /* Encode */
+    retval = UA_ByteString_allocBuffer(snapshot, w.offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        goto out;
+    size_t expectedSize = w.offset;
+    w.buf = snapshot;
+    w.offset = 0;
+    writeSnapshot(server, &w);
+    retval = w.retval;
+    if(retval == UA_STATUSCODE_GOOD && w.offset != expectedSize)
+        retval = UA_STATUSCODE_BADINTERNALERROR; /* nodes changed in between */
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_ByteString_deleteMembers(snapshot);
+
+ out:
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
+/***********/
+/* Loading */
+/***********/
+
+typedef struct {
+    const UA_ByteString *buf;
+    size_t offset;
+    UA_StatusCode retval;
+} SnapshotReader;
+
+static void
+readField(SnapshotReader *r, void *dst, const UA_DataType *type) {
+    if(r->retval != UA_STATUSCODE_GOOD)
+        return;
+    r->retval = UA_decodeBinary(r->buf, &r->offset, dst, type);
+}
+
+static UA_UInt32
+readUInt32(SnapshotReader *r) {
+    UA_UInt32 v = 0;
+    readField(r, &v, &UA_TYPES[UA_TYPES_UINT32]);
+    return v;
+}
+
+/* Guards the allocation for array lengths from a corrupt image. Every element
+ * takes up at least one byte. */
+static UA_Boolean
+checkSize(SnapshotReader *r, UA_UInt32 size) {
+    if(r->retval != UA_STATUSCODE_GOOD)
+        return false;
+    if(size > r->buf->length - r->offset) {
+        r->retval = UA_STATUSCODE_BADDECODINGERROR;
+        return false;
+    }
+    return true;
+}
+
+static void
+readReferences(SnapshotReader *r, UA_Node *node) {
+    UA_UInt32 kindsSize = readUInt32(r);
+    for(UA_UInt32 i = 0; i < kindsSize && r->retval == UA_STATUSCODE_GOOD; ++i) {
+        UA_NodeId referenceTypeId;
+        UA_Boolean isInverse = false;
+        UA_NodeId_init(&referenceTypeId);
+        readField(r, &referenceTypeId, &UA_TYPES[UA_TYPES_NODEID]);
+        readField(r, &isInverse, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        UA_UInt32 referencesSize = readUInt32(r);
+        for(UA_UInt32 j = 0; j < referencesSize && r->retval == UA_STATUSCODE_GOOD; ++j) {
+            UA_ExpandedNodeId targetId;
+            UA_ExpandedNodeId_init(&targetId);
+            readField(r, &targetId, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+            if(r->retval == UA_STATUSCODE_GOOD)
+                r->retval = UA_Node_addReference(node, &referenceTypeId,
+                                                 UA_TYPEINDEX_NOTFOUND, &targetId,
+                                                 isInverse, 0);
+            UA_ExpandedNodeId_deleteMembers(&targetId);
+        }
+        UA_NodeId_deleteMembers(&referenceTypeId);
+    }
+}
+
+static void
+readVariableAttributes(SnapshotReader *r, UA_VariableNode *node) {
+    readField(r, &node->dataType, &UA_TYPES[UA_TYPES_NODEID]);
+    readField(r, &node->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+    UA_UInt32 dimsSize = readUInt32(r);
+    if(dimsSize > 0 && checkSize(r, dimsSize)) {
+        node->arrayDimensions = UA_Array_new(dimsSize, &UA_TYPES[UA_TYPES_UINT32]);
+        if(!node->arrayDimensions) {
+            r->retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        node->arrayDimensionsSize = dimsSize;
+        for(size_t i = 0; i < dimsSize; ++i)
+            readField(r, &node->arrayDimensions[i], &UA_TYPES[UA_TYPES_UINT32]);
+    }
+    UA_Boolean isDataSource = false;
+    readField(r, &isDataSource, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    if(isDataSource) {
+        /* The data source is taken over from the current node. Until then, the
+         * node has no value. */
+        node->valueSource = UA_VALUESOURCE_DATASOURCE;
+        return;
+    }
+    node->valueSource = UA_VALUESOURCE_DATA;
+    readField(r, &node->value.data.value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+}
+
+static UA_Node *
+readNode(SnapshotReader *r, UA_NodeStore *ns) {
+    UA_NodeClass nodeClass = UA_NODECLASS_UNSPECIFIED;
+    readField(r, &nodeClass, &UA_TYPES[UA_TYPES_NODECLASS]);
+    if(r->retval != UA_STATUSCODE_GOOD)
+        return NULL;
+    UA_Node *node = UA_NodeStore_newNode(ns, nodeClass);
+    if(!node) {
+        r->retval = UA_STATUSCODE_BADDECODINGERROR;
+        return NULL;
+    }
+
+    readField(r, &node->nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    readField(r, &node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    readField(r, &node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    readField(r, &node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    readField(r, &node->writeMask, &UA_TYPES[UA_TYPES_UINT32]);
+    readField(r, &node->userWriteMask, &UA_TYPES[UA_TYPES_UINT32]);
+    readReferences(r, node);
+
+    switch(nodeClass) {
+    case UA_NODECLASS_OBJECT: {
+        UA_ObjectNode *on = (UA_ObjectNode*)node;
+        readField(r, &on->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLE: {
+        UA_VariableNode *vn = (UA_VariableNode*)node;
+        readVariableAttributes(r, vn);
+        readField(r, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        readField(r, &vn->userAccessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        readField(r, &vn->minimumSamplingInterval, &UA_TYPES[UA_TYPES_DOUBLE]);
+        readField(r, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableTypeNode *vtn = (UA_VariableTypeNode*)node;
+        readVariableAttributes(r, (UA_VariableNode*)node);
+        readField(r, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        UA_MethodNode *mn = (UA_MethodNode*)node;
+        readField(r, &mn->executable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        readField(r, &mn->userExecutable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE: {
+        UA_ObjectTypeNode *otn = (UA_ObjectTypeNode*)node;
+        readField(r, &otn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeNode *rtn = (UA_ReferenceTypeNode*)node;
+        readField(r, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        readField(r, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        readField(r, &rtn->inverseName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE: {
+        UA_DataTypeNode *dtn = (UA_DataTypeNode*)node;
+        readField(r, &dtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VIEW: {
+        UA_ViewNode *vn = (UA_ViewNode*)node;
+        readField(r, &vn->containsNoLoops, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        readField(r, &vn->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if(r->retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(ns, node);
+        return NULL;
+    }
+    return node;
+}
+
+/* Take over the callbacks (that cannot be saved) from the current node */
+static void
+takeOverCallbacks(UA_Node *node, const UA_Node *current) {
+    switch(node->nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        ((UA_ObjectNode*)node)->instanceHandle =
+            ((const UA_ObjectNode*)current)->instanceHandle;
+        break;
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableNode *vn = (UA_VariableNode*)node;
+        const UA_VariableNode *cvn = (const UA_VariableNode*)current;
+        if(vn->valueSource == UA_VALUESOURCE_DATASOURCE) {
+            if(cvn->valueSource == UA_VALUESOURCE_DATASOURCE)
+                vn->value.source = cvn->value.source;
+        } else if(cvn->valueSource == UA_VALUESOURCE_DATA) {
+            vn->value.data.callback = cvn->value.data.callback;
+        }
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        UA_MethodNode *mn = (UA_MethodNode*)node;
+        const UA_MethodNode *cmn = (const UA_MethodNode*)current;
+        mn->methodHandle = cmn->methodHandle;
+        mn->attachedMethod = cmn->attachedMethod;
+        mn->attachedMethodAsync = cmn->attachedMethodAsync;
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE:
+        ((UA_ObjectTypeNode*)node)->lifecycleManagement =
+            ((const UA_ObjectTypeNode*)current)->lifecycleManagement;
+        break;
+    default:
+        break;
+    }
+}
+
+typedef struct {
+    size_t size;
+    size_t capacity;
+    UA_NodeId *ids;
+    UA_StatusCode retval;
+} NodeIdCollector;
+
+static void
+collectNodeId(void *context, const UA_Node *node) {
+    NodeIdCollector *c = (NodeIdCollector*)context;
+    if(c->retval != UA_STATUSCODE_GOOD)
+        return;
+    if(c->size == c->capacity) {
+        size_t capacity = c->capacity > 0 ? c->capacity * 2 : 64;
+        UA_NodeId *ids = UA_realloc(c->ids, capacity * sizeof(UA_NodeId));
+        if(!ids) {
+            c->retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        c->ids = ids;
+        c->capacity = capacity;
+    }
+    c->retval = UA_NodeId_copy(&node->nodeId, &c->ids[c->size]);
+    if(c->retval == UA_STATUSCODE_GOOD)
+        ++c->size;
+}
+
+static UA_StatusCode
+removeAllNodes(UA_Server *server) {
+    NodeIdCollector c;
+    memset(&c, 0, sizeof(NodeIdCollector));
+    UA_NodeStore_iterate(server->nodestore, collectNodeId, &c);
+    for(size_t i = 0; i < c.size; ++i) {
+        if(c.retval == UA_STATUSCODE_GOOD)
+            c.retval = UA_NodeStore_remove(server->nodestore, &c.ids[i]);
+        UA_NodeId_deleteMembers(&c.ids[i]);
+    }
+    UA_free(c.ids);
+    return c.retval;
+}
+
+/* Temporary hash-map from the NodeId to the position of the decoded node plus
+ * one. Open addressing with linear probing. The occupancy is at most 50%. */
+typedef struct {
+    size_t size; /* a power of two */
+    size_t *slots;
+    UA_Node **nodes;
+} DecodedNodeMap;
+
+static UA_StatusCode
+DecodedNodeMap_init(DecodedNodeMap *map, UA_Node **nodes, size_t nodesSize) {
+    map->size = 16;
+    while(map->size < nodesSize * 2)
+        map->size *= 2;
+    map->slots = UA_calloc(map->size, sizeof(size_t));
+    if(!map->slots)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    map->nodes = nodes;
+    size_t mask = map->size - 1;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        size_t slot = UA_NodeId_hash(&nodes[i]->nodeId) & mask;
+        while(map->slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        map->slots[slot] = i + 1;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static const UA_Node *
+DecodedNodeMap_get(const DecodedNodeMap *map, const UA_NodeId *nodeId) {
+    size_t mask = map->size - 1;
+    for(size_t slot = UA_NodeId_hash(nodeId) & mask; map->slots[slot] != 0;
+        slot = (slot + 1) & mask) {
+        const UA_Node *node = map->nodes[map->slots[slot] - 1];
+        if(UA_NodeId_equal(&node->nodeId, nodeId))
+            return node;
+    }
+    return NULL;
+}
+
+/* Forward references to local nodes are indexed by the browse name of the
+ * target. The name hashes are computed once all nodes are decoded. */
+static UA_StatusCode
+indexReferenceNames(UA_Node **nodes, size_t nodesSize) {
+    DecodedNodeMap map;
+    UA_StatusCode retval = DecodedNodeMap_init(&map, nodes, nodesSize);
+    for(size_t i = 0; i < nodesSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        UA_Node *node = nodes[i];
+        for(size_t k = 0; k < node->referenceIndex.kindsSize; ++k) {
+            const UA_ReferenceKind *kind = &node->referenceIndex.kinds[k];
+            if(kind->isInverse)
+                continue;
+            for(size_t j = kind->referencesStart;
+                j < kind->referencesStart + kind->referencesSize; ++j) {
+                const UA_ExpandedNodeId *targetId = &node->references[j].targetId;
+                if(targetId->serverIndex != 0)
+                    continue;
+                const UA_Node *target = DecodedNodeMap_get(&map, &targetId->nodeId);
+                if(!target)
+                    continue;
+                UA_UInt32 nameHash = UA_Node_browseNameHash(&target->browseName);
+                retval |= UA_Node_setReferenceName(node, &kind->referenceTypeId,
+                                                   &targetId->nodeId, false, nameHash);
+            }
+        }
+    }
+    UA_free(map.slots);
+    return retval;
+}
+
+/* Register the reference types of the kinds and the hasSubtype relations in
+ * the (empty) type index */
+static UA_StatusCode
+indexNode(UA_Server *server, UA_Node *node) {
+    UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_ReferenceIndex *ri = &node->referenceIndex;
+    for(size_t i = 0; i < ri->kindsSize && retval == UA_STATUSCODE_GOOD; ++i) {
+        UA_ReferenceKind *kind = &ri->kinds[i];
+        retval = UA_TypeIndex_addType(&server->typeIndex, &kind->referenceTypeId,
+                                      &kind->referenceTypeIndex);
+        if(!UA_NodeId_equal(&kind->referenceTypeId, &hasSubtype))
+            continue;
+        for(size_t j = kind->referencesStart;
+            j < kind->referencesStart + kind->referencesSize; ++j) {
+            const UA_NodeId *target = &node->references[j].targetId.nodeId;
+            if(kind->isInverse)
+                retval |= UA_TypeIndex_addSubtype(&server->typeIndex, target,
+                                                  &node->nodeId);
+            else
+                retval |= UA_TypeIndex_addSubtype(&server->typeIndex, &node->nodeId,
+                                                  target);
+        }
+    }
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_loadSnapshot(UA_Server *server, const UA_ByteString *snapshot) {
+    SnapshotReader r;
+    r.buf = snapshot;
+    r.offset = 0;
+    r.retval = UA_STATUSCODE_GOOD;
+
+    /* Check the header */
+    UA_UInt32 magic = readUInt32(&r);
+    UA_UInt32 version = readUInt32(&r);
+    if(r.retval != UA_STATUSCODE_GOOD || magic != UA_SNAPSHOT_MAGIC ||
+       version != UA_SNAPSHOT_VERSION)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    for(size_t i = 0; i < 3; ++i) {
+        UA_UInt16 v = 0;
+        readField(&r, &v, &UA_TYPES[UA_TYPES_UINT16]);
+        if(r.retval != UA_STATUSCODE_GOOD || v != libraryVersion[i])
+            return UA_STATUSCODE_BADDECODINGERROR;
+    }
+
+    UA_UInt32 namespacesSize = readUInt32(&r);
+    if(namespacesSize == 0 || !checkSize(&r, namespacesSize))
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_String *namespaces = UA_Array_new(namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    if(!namespaces)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < namespacesSize; ++i)
+        readField(&r, &namespaces[i], &UA_TYPES[UA_TYPES_STRING]);
+
+    /* Decode all nodes before the address space is changed */
+    UA_Node **nodes = NULL;
+    UA_UInt32 nodesSize = readUInt32(&r);
+    size_t decoded = 0;
+    if(checkSize(&r, nodesSize) && nodesSize > 0) {
+        nodes = UA_malloc(sizeof(UA_Node*) * nodesSize);
+        if(!nodes)
+            r.retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_RCU_LOCK();
+    for(; decoded < nodesSize && r.retval == UA_STATUSCODE_GOOD; ++decoded) {
+        nodes[decoded] = readNode(&r, server->nodestore);
+        if(!nodes[decoded])
+            break;
+    }
+    if(r.retval == UA_STATUSCODE_GOOD)
+        r.retval = indexReferenceNames(nodes, nodesSize);
+    if(r.retval != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < decoded; ++i)
+            UA_NodeStore_deleteNode(server->nodestore, nodes[i]);
+        UA_free(nodes);
+        UA_Array_delete(namespaces, namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+        UA_RCU_UNLOCK();
+        return r.retval;
+    }
+
+    /* Take over the callbacks and replace the address space */
+    for(size_t i = 0; i < nodesSize; ++i) {
+        const UA_Node *current = UA_NodeStore_get(server->nodestore, &nodes[i]->nodeId);
+        if(current && current->nodeClass == nodes[i]->nodeClass)
+            takeOverCallbacks(nodes[i], current);
+    }
+    UA_StatusCode retval = removeAllNodes(server);
+    UA_TypeIndex_deleteMembers(&server->typeIndex);
+    UA_TypeIndex_init(&server->typeIndex);
+    UA_ReadCache_deleteMembers(&server->readCache);
+    UA_ReadCache_init(&server->readCache);
+    UA_Array_delete(server->namespaces, server->namespacesSize,
+                    &UA_TYPES[UA_TYPES_STRING]);
+    server->namespaces = namespaces;
+    server->namespacesSize = namespacesSize;
+
+    /* Insert the nodes. Continue after errors, so that most of the address
+     * space is usable. */
+    UA_StatusCode res = UA_NodeStore_reserve(server->nodestore, nodesSize);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = res;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        res = indexNode(server, nodes[i]);
+        if(res == UA_STATUSCODE_GOOD)
+            res = UA_NodeStore_insert(server->nodestore, nodes[i]); /* deletes on failure */
+        else
+            UA_NodeStore_deleteNode(server->nodestore, nodes[i]);
+        if(res != UA_STATUSCODE_GOOD && retval == UA_STATUSCODE_GOOD)
+            retval = res;
+    }
+    UA_free(nodes);
+    UA_RCU_UNLOCK();
+    return retval;
+}
@@ -104,12 +104,11 @@ getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
     size_t last = 0; /* Index of the last element in the array */
     const UA_NodeId hasSubtypeNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     while(true) {
-        for(size_t i = 0; i < node->referencesSize; ++i) {
-            /* is the reference relevant? */
-            if(node->references[i].isInverse != inverse ||
-               !UA_NodeId_equal(&hasSubtypeNodeId, &node->references[i].referenceTypeId))
-                continue;
-
+        /* the relevant references */
+        const UA_ReferenceKind *kind = UA_Node_findReferenceKind(node, &hasSubtypeNodeId, inverse);
+        size_t begin = kind ? kind->referencesStart : 0;
+        size_t end = kind ? kind->referencesStart + kind->referencesSize : 0;
+        for(size_t i = begin; i < end; ++i) {
             /* is the target already considered? (multi-inheritance) */
             UA_Boolean duplicate = false;
             for(size_t j = 0; j <= last; ++j) {
@@ -159,32 +158,6 @@ getTypeHierarchy(UA_NodeStore *ns, const UA_Node *rootRef, UA_Boolean inverse,
     return UA_STATUSCODE_GOOD;
 }
 
-UA_Boolean
-isNodeInTree(UA_NodeStore *ns, const UA_NodeId *leafNode, const UA_NodeId *nodeToFind,
-             const UA_NodeId *referenceTypeIds, size_t referenceTypeIdsSize) {
-    if(UA_NodeId_equal(leafNode, nodeToFind))
-        return true;
-
-    const UA_Node *node = UA_NodeStore_get(ns,leafNode);
-    if(!node)
-        return false;
-
-    /* Search upwards in the tree */
-    for(size_t i = 0; i < node->referencesSize; ++i) {
-        if(!node->references[i].isInverse)
-            continue;
-
-        /* Recurse only for valid reference types */
-        for(size_t j = 0; j < referenceTypeIdsSize; ++j) {
-            if(UA_NodeId_equal(&node->references[i].referenceTypeId, &referenceTypeIds[j]) &&
-               isNodeInTree(ns, &node->references[i].targetId.nodeId, nodeToFind,
-                            referenceTypeIds, referenceTypeIdsSize))
-                return true;
-        }
-    }
-    return false;
-}
-
 const UA_Node *
 getNodeType(UA_Server *server, const UA_Node *node) {
     /* The reference to the parent is different for variable and variabletype */
@@ -205,18 +178,10 @@ getNodeType(UA_Server *server, const UA_Node *node) {
     }
 
     /* stop at the first matching candidate */
-    UA_NodeId *parentId = NULL;
-    for(size_t i = 0; i < node->referencesSize; ++i) {
-        if(node->references[i].isInverse == inverse &&
-           UA_NodeId_equal(&node->references[i].referenceTypeId, &parentRef)) {
-            parentId = &node->references[i].targetId.nodeId;
-            break;
-        }
-    }
-
-    if(!parentId)
+    const UA_ReferenceKind *kind = UA_Node_findReferenceKind(node, &parentRef, inverse);
+    if(!kind)
         return NULL;
-    return UA_NodeStore_get(server->nodestore, parentId);
+    return UA_Server_getReferenceTarget(server, &node->references[kind->referencesStart]);
 }
 
 const UA_VariableTypeNode *
@@ -230,7 +195,7 @@ getVariableNodeType(UA_Server *server, const UA_VariableNode *node) {
 const UA_ObjectTypeNode *
 getObjectNodeType(UA_Server *server, const UA_ObjectNode *node) {
     const UA_Node *type = getNodeType(server, (const UA_Node*)node);
-    if(type->nodeClass != UA_NODECLASS_OBJECTTYPE)
+    if(!type || type->nodeClass != UA_NODECLASS_OBJECTTYPE)
         return NULL;
     return (const UA_ObjectTypeNode*)type;
 }
@@ -239,15 +204,45 @@ UA_Boolean
 UA_Node_hasSubTypeOrInstances(const UA_Node *node) {
     const UA_NodeId hasSubType = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
     const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-    for(size_t i = 0; i < node->referencesSize; ++i) {
-        if(node->references[i].isInverse == false &&
-           UA_NodeId_equal(&node->references[i].referenceTypeId, &hasSubType))
-            return true;
-        if(node->references[i].isInverse == true &&
-           UA_NodeId_equal(&node->references[i].referenceTypeId, &hasTypeDefinition))
-            return true;
+    return UA_Node_findReferenceKind(node, &hasSubType, false) != NULL ||
+        UA_Node_findReferenceKind(node, &hasTypeDefinition, true) != NULL;
+}
+
+const UA_Node *
+UA_Server_getSessionNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId) {
+    if(nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE)
+        return UA_NodeStore_get(server->nodestore, nodeId);
+    UA_RegisteredNode *rn = UA_Session_getRegisteredNode(session, nodeId);
+    if(!rn)
+        return UA_NodeStore_get(server->nodestore, nodeId);
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Nodes are only moved or deleted when the nodestore version changes */
+    UA_UInt32 version = UA_NodeStore_getVersion(server->nodestore);
+    if(!rn->node || rn->nodestoreVersion != version) {
+        rn->node = UA_NodeStore_get(server->nodestore, &rn->nodeId);
+        rn->nodestoreVersion = version;
+    }
+    return rn->node;
+#else
+    return UA_NodeStore_get(server->nodestore, &rn->nodeId);
+#endif
+}
+
+const UA_Node *
+UA_Server_getReferenceTarget(UA_Server *server, const UA_NodeReference *ref) {
+#ifndef UA_ENABLE_MULTITHREADING
+    /* The cache is not part of the information model. It is updated also in
+     * nodes that are otherwise const. */
+    UA_NodeReference *cached = (UA_NodeReference*)(uintptr_t)ref;
+    UA_UInt32 version = UA_NodeStore_getVersion(server->nodestore);
+    if(!cached->target || cached->targetVersion != version) {
+        cached->target = UA_NodeStore_get(server->nodestore, &ref->targetId.nodeId);
+        cached->targetVersion = version;
     }
-    return false;
+    return (const UA_Node*)cached->target;
+#else
+    return UA_NodeStore_get(server->nodestore, &ref->targetId.nodeId);
+#endif
 }
 
 /* For mulithreading: make a copy of the node, edit and replace.
@@ -257,20 +252,26 @@ UA_Server_editNode(UA_Server *server, UA_Session *session,
                    const UA_NodeId *nodeId, UA_EditNodeCallback callback,
                    const void *data) {
 #ifndef UA_ENABLE_MULTITHREADING
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
+    const UA_Node *node = UA_Server_getSessionNode(server, session, nodeId);
     if(!node)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast
     return callback(server, session, editNode, data);
 #else
+    nodeId = UA_Session_resolveNodeId(session, nodeId);
+    if(!nodeId)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
     UA_StatusCode retval;
     do {
         UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, nodeId);
-        if(!copy)
+        if(!copy) {
+            if(!UA_NodeStore_get(server->nodestore, nodeId))
+                return UA_STATUSCODE_BADNODEIDUNKNOWN;
             return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
         retval = callback(server, session, copy, data);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_NodeStore_deleteNode(copy);
+            UA_NodeStore_deleteNode(server->nodestore, copy);
             return retval;
         }
         retval = UA_NodeStore_replace(server->nodestore, copy);
@@ -278,3 +279,32 @@ UA_Server_editNode(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 #endif
 }
+
+static UA_StatusCode
+deleteMethodArguments(UA_Server *server, UA_Session *session,
+                      UA_MethodNode *node, const void *data) {
+    /* In the multithreaded case, the copy has no cache. The cache of the
+     * replaced node is freed with the node when no reader is left. */
+    UA_MethodArgumentsCache_delete(node->arguments);
+    node->arguments = NULL;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_Server_invalidateMethodArguments(UA_Server *server, const UA_Node *property) {
+    if(property->nodeClass != UA_NODECLASS_VARIABLE)
+        return;
+    const UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+    const UA_ReferenceKind *methods = UA_Node_findReferenceKind(property, &hasProperty, true);
+    if(!methods)
+        return;
+    for(size_t i = methods->referencesStart;
+        i < methods->referencesStart + methods->referencesSize; ++i) {
+        const UA_Node *method = UA_Server_getReferenceTarget(server, &property->references[i]);
+        if(!method || method->nodeClass != UA_NODECLASS_METHOD ||
+           !((const UA_MethodNode*)method)->arguments)
+            continue;
+        UA_Server_editNode(server, &adminSession, &method->nodeId,
+                           (UA_EditNodeCallback)deleteMethodArguments, NULL);
+    }
+}
@@ -143,6 +143,167 @@ emptyDispatchQueue(UA_Server *server) {
 
 #endif
 
+/**************************/
+/* Parallel Service Items */
+/**************************/
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+static int
+compareKeys(const void *a, const void *b) {
+    UA_UInt32 ka = *(const UA_UInt32*)a;
+    UA_UInt32 kb = *(const UA_UInt32*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+/* Items with the same key must be processed in the order of the request */
+static UA_Boolean
+distinctKeys(UA_ServiceItemKey key, UA_Session *session,
+             const void *request, size_t itemsSize) {
+    UA_UInt32 *keys = UA_malloc(itemsSize * sizeof(UA_UInt32));
+    if(!keys)
+        return false;
+    for(size_t i = 0; i < itemsSize; ++i)
+        keys[i] = key(session, request, i);
+    qsort(keys, itemsSize, sizeof(UA_UInt32), compareKeys);
+    UA_Boolean distinct = true;
+    for(size_t i = 1; i < itemsSize; ++i) {
+        if(keys[i - 1] == keys[i]) {
+            distinct = false; /* Or a hash collision */
+            break;
+        }
+    }
+    UA_free(keys);
+    return distinct;
+}
+
+typedef struct {
+    UA_Server *server;
+    UA_Session *session;
+    UA_ServiceSliceCallback callback;
+    const void *request;
+    void *response;
+    UA_AsyncContext *asyncContext;
+    size_t itemsSize;
+    size_t sliceSize;
+    UA_UInt32 slicesSize;
+    volatile UA_UInt32 nextSlice;
+    volatile UA_UInt32 doneSlices;
+    volatile UA_UInt32 refCount; /* The caller and the dispatched jobs */
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+} ServiceSlices;
+
+/* Take slices until none is left */
+static void
+processSlices(ServiceSlices *ss) {
+    UA_AsyncContext *ctx = asyncContext;
+    asyncContext = ss->asyncContext;
+    while(true) {
+        UA_UInt32 slice = UA_atomic_add(&ss->nextSlice, 1) - 1;
+        if(slice >= ss->slicesSize)
+            break;
+        size_t start = slice * ss->sliceSize;
+        size_t end = start + ss->sliceSize;
+        if(end > ss->itemsSize)
+            end = ss->itemsSize;
+        ss->callback(ss->server, ss->session, ss->request, ss->response, start, end);
+        if(UA_atomic_add(&ss->doneSlices, 1) == ss->slicesSize) {
+            pthread_mutex_lock(&ss->mutex);
+            pthread_cond_broadcast(&ss->done);
+            pthread_mutex_unlock(&ss->mutex);
+        }
+    }
+    asyncContext = ctx;
+}
+
+static void
+releaseSlices(ServiceSlices *ss) {
+    if(UA_atomic_add(&ss->refCount, (UA_UInt32)-1) > 0)
+        return;
+    pthread_cond_destroy(&ss->done);
+    pthread_mutex_destroy(&ss->mutex);
+    UA_free(ss);
+}
+
+static void
+sliceJob(UA_Server *server, void *data) {
+    ServiceSlices *ss = (ServiceSlices*)data;
+    processSlices(ss);
+    releaseSlices(ss);
+}
+
+static void
+processItemsParallel(UA_Server *server, UA_Session *session, size_t itemsSize,
+                     UA_ServiceSliceCallback callback, const void *request,
+                     void *response) {
+    ServiceSlices *ss = UA_malloc(sizeof(ServiceSlices));
+    if(!ss) {
+        callback(server, session, request, response, 0, itemsSize);
+        return;
+    }
+
+    /* Several slices per thread balance the load */
+    size_t threads = (size_t)server->config.nThreads + 1;
+    size_t sliceSize = itemsSize / (threads * 4);
+    if(sliceSize < server->config.parallelItemsThreshold / 4)
+        sliceSize = server->config.parallelItemsThreshold / 4;
+    if(sliceSize == 0)
+        sliceSize = 1;
+    ss->server = server;
+    ss->session = session;
+    ss->callback = callback;
+    ss->request = request;
+    ss->response = response;
+    ss->asyncContext = asyncContext;
+    ss->itemsSize = itemsSize;
+    ss->sliceSize = sliceSize;
+    ss->slicesSize = (UA_UInt32)((itemsSize + sliceSize - 1) / sliceSize);
+    ss->nextSlice = 0;
+    ss->doneSlices = 0;
+    pthread_mutex_init(&ss->mutex, NULL);
+    pthread_cond_init(&ss->done, NULL);
+
+    /* Dispatch one job per worker (at most one per additional slice) */
+    size_t jobs = server->config.nThreads;
+    if(jobs > ss->slicesSize - 1)
+        jobs = ss->slicesSize - 1;
+    ss->refCount = (UA_UInt32)jobs + 1;
+    UA_Job job;
+    job.type = UA_JOBTYPE_METHODCALL;
+    job.job.methodCall.method = sliceJob;
+    job.job.methodCall.data = ss;
+    for(size_t i = 0; i < jobs; ++i)
+        dispatchJob(server, &job);
+    pthread_cond_broadcast(&server->dispatchQueue_condition);
+
+    /* Work on the slices and wait until all are done. Slices are never left
+     * waiting for a busy worker, since the caller takes them as well. */
+    processSlices(ss);
+    pthread_mutex_lock(&ss->mutex);
+    while(ss->doneSlices < ss->slicesSize)
+        pthread_cond_wait(&ss->done, &ss->mutex);
+    pthread_mutex_unlock(&ss->mutex);
+    releaseSlices(ss);
+}
+
+#endif
+
+void
+UA_Server_processServiceItems(UA_Server *server, UA_Session *session, size_t itemsSize,
+                              UA_ServiceSliceCallback callback, UA_ServiceItemKey key,
+                              const void *request, void *response) {
+#ifdef UA_ENABLE_MULTITHREADING
+    size_t threshold = server->config.parallelItemsThreshold;
+    if(threshold > 0 && itemsSize > threshold && server->workers &&
+       server->config.nThreads > 0 && (!key || distinctKeys(key, session, request, itemsSize))) {
+        processItemsParallel(server, session, itemsSize, callback, request, response);
+        return;
+    }
+#endif
+    callback(server, session, request, response, 0, itemsSize);
+}
+
 /*****************/
 /* Repeated Jobs */
 /*****************/
@@ -187,15 +348,9 @@ addRepeatedJob(UA_Server *server, struct RepeatedJob * UA_RESTRICT rj) {
         LIST_INSERT_HEAD(&server->repeatedJobs, rj, next);
 }
 
-UA_StatusCode
-UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
-                         UA_UInt32 interval, UA_Guid *jobId) {
-    /* the interval needs to be at least 5ms */
-    if(interval < 5)
-        return UA_STATUSCODE_BADINTERNALERROR;
-    UA_UInt64 interval_dt =
-        (UA_UInt64)interval * (UA_UInt64)UA_MSEC_TO_DATETIME; // from ms to 100ns resolution
-
+static UA_StatusCode
+addRepeatedJobWithInterval(UA_Server *server, UA_Job job,
+                           UA_UInt64 interval_dt, UA_Guid *jobId) {
     /* Create and fill the repeated job structure */
     struct RepeatedJob *rj = UA_malloc(sizeof(struct RepeatedJob));
     if(!rj)
@@ -226,6 +381,28 @@ UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
     return UA_STATUSCODE_GOOD;
 }
 
+UA_StatusCode
+UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
+                         UA_UInt32 interval, UA_Guid *jobId) {
+    /* the interval needs to be at least 5ms */
+    if(interval < 5)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt64 interval_dt =
+        (UA_UInt64)interval * (UA_UInt64)UA_MSEC_TO_DATETIME; // from ms to 100ns resolution
+    return addRepeatedJobWithInterval(server, job, interval_dt, jobId);
+}
+
+UA_StatusCode
+UA_Server_addRepeatedJobHighRes(UA_Server *server, UA_Job job,
+                                UA_UInt64 interval, UA_Guid *jobId) {
+    /* the interval needs to be at least 100us */
+    if(interval < 100)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt64 interval_dt =
+        interval * (UA_UInt64)UA_USEC_TO_DATETIME; // from us to 100ns resolution
+    return addRepeatedJobWithInterval(server, job, interval_dt, jobId);
+}
+
 /* - Dispatches all repeated jobs that have timed out
  * - Reinserts dispatched job at their new position in the sorted list
  * - Returns the next datetime when a repeated job is scheduled */
@@ -269,9 +446,12 @@ processRepeatedJobs(UA_Server *server, UA_DateTime current, UA_Boolean *dispatch
         rj->nextTime += (UA_Int64)rj->interval;
 
         /* Prevent an infinite loop when the repeated jobs took more time than
-         * rj->interval */
-        if(rj->nextTime < current)
-            rj->nextTime = current + 1;
+         * rj->interval. Skip the missed executions but stay on the schedule, so
+         * that the deadlines do not drift. */
+        if(rj->nextTime <= current) {
+            UA_UInt64 missed = (UA_UInt64)(current - rj->nextTime) / rj->interval;
+            rj->nextTime += (UA_Int64)((missed + 1) * rj->interval);
+        }
 
         /* Find new position for rj to keep the list sorted */
         struct RepeatedJob *prev_rj;
@@ -649,7 +829,17 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     processDelayedCallbacks(server);
 #endif
 
+    /* Sleep until the next repeated job if no networklayer waits or if the job
+     * is due before the networklayer can wake up again (the networklayer
+     * timeout has millisecond resolution) */
     now = UA_DateTime_nowMonotonic();
+    if(waitInternal && nextRepeated > now &&
+       (server->config.networkLayersSize == 0 ||
+        nextRepeated - now < UA_MSEC_TO_DATETIME)) {
+        UA_DateTime_sleepUntilMonotonic(nextRepeated);
+        now = UA_DateTime_nowMonotonic();
+    }
+
     timeout = 0;
     if(nextRepeated > now)
         timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
@@ -156,7 +156,9 @@ void Service_TranslateBrowsePathsToNodeIds(UA_Server *server, UA_Session *sessio
 
 /* Used by Clients to register the Nodes that they know they will access
  * repeatedly (e.g. Write, Call). It allows Servers to set up anything needed so
- * that the access operations will be more efficient. */
+ * that the access operations will be more efficient. Existing nodes are
+ * returned as numeric aliases that resolve in constant time. The aliases are
+ * valid until unregistered or the session is closed. */
 void Service_RegisterNodes(UA_Server *server, UA_Session *session,
                            const UA_RegisterNodesRequest *request,
                            UA_RegisterNodesResponse *response);
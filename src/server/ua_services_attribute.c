@@ -4,6 +4,7 @@
 
 #include "ua_server_internal.h"
 #include "ua_services.h"
+#include "ua_valuehandle.h"
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
 #include "ua_types_encoding_binary.h"
 #endif
@@ -165,8 +166,7 @@ typeCheckValue(UA_Server *server, const UA_NodeId *targetDataTypeId,
         goto check_array;
 
     /* Has the value a subtype of the required type? */
-    const UA_NodeId subtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    if(isNodeInTree(server->nodestore, &value->type->typeId, targetDataTypeId, &subtypeId, 1))
+    if(UA_TypeIndex_isSubtype(&server->typeIndex, &value->type->typeId, targetDataTypeId))
         goto check_array;
 
     /* Try to convert to a matching value if this is wanted */
@@ -371,9 +371,7 @@ writeDataTypeAttribute(UA_Server *server, UA_VariableNode *node,
         return UA_STATUSCODE_BADINTERNALERROR;
 
     /* Does the new type match the constraints of the variabletype? */
-    UA_NodeId subtypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    if(!isNodeInTree(server->nodestore, dataType,
-                     constraintDataType, &subtypeId, 1))
+    if(!UA_TypeIndex_isSubtype(&server->typeIndex, dataType, constraintDataType))
         return UA_STATUSCODE_BADTYPEMISMATCH;
 
     /* Check if the current value would match the new type */
@@ -414,42 +412,89 @@ readValueAttributeFromNode(UA_Server *server, const UA_VariableNode *vn, UA_Data
                            UA_NumericRange *rangeptr) {
     if(vn->value.data.callback.onRead) {
         UA_RCU_UNLOCK();
-        vn->value.data.callback.onRead(vn->value.data.callback.handle,
-                                       vn->nodeId, &vn->value.data.value.value, rangeptr);
+        vn->value.data.callback.onRead(vn->value.data.callback.handle, vn->nodeId,
+                                       &UA_VariableNode_getValue(vn)->value, rangeptr);
         UA_RCU_LOCK();
 #ifdef UA_ENABLE_MULTITHREADING
         /* Reopen the node to see the changes (multithreading only) */
         vn = (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &vn->nodeId);
 #endif
     }
+    const UA_DataValue *value = UA_VariableNode_getValue(vn);
     if(rangeptr)
-        return UA_Variant_copyRange(&vn->value.data.value.value, &v->value, *rangeptr);
-    *v = vn->value.data.value;
+        return UA_Variant_copyRange(&value->value, &v->value, *rangeptr);
+    *v = *value;
     v->value.storageType = UA_VARIANT_DATA_NODELETE;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-readValueAttributeFromDataSource(const UA_VariableNode *vn, UA_DataValue *v,
-                                 UA_TimestampsToReturn timestamps,
-                                 UA_NumericRange *rangeptr) {
-    if(!vn->value.dataSource.read)
-        return UA_STATUSCODE_BADINTERNALERROR;
+readValueAttributeAsync(UA_Server *server, const UA_VariableNode *vn,
+                        UA_DataValue *v, UA_TimestampsToReturn timestamps,
+                        UA_NumericRange *rangeptr) {
+    UA_AsyncOperation *op = UA_AsyncOperation_new(server, UA_ASYNCOPERATIONTYPE_READ, v);
+    if(!op)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    op->timestamps = timestamps;
     UA_Boolean sourceTimeStamp = (timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
                                   timestamps == UA_TIMESTAMPSTORETURN_BOTH);
-
     UA_RCU_UNLOCK();
     UA_StatusCode retval =
-        vn->value.dataSource.read(vn->value.dataSource.handle, vn->nodeId,
-                                  sourceTimeStamp, rangeptr, v);
+        vn->value.source.extension.readAsync(vn->value.source.dataSource.handle,
+                                             vn->nodeId, sourceTimeStamp, rangeptr, op);
     UA_RCU_LOCK();
+    return UA_AsyncOperation_started(op, retval);
+}
+
+static UA_StatusCode
+readValueAttributeFromDataSource(UA_Server *server, const UA_VariableNode *vn,
+                                 UA_DataValue *v, UA_TimestampsToReturn timestamps,
+                                 UA_NumericRange *rangeptr, UA_Double maxAge) {
+    const UA_DataSource *ds = &vn->value.source.dataSource;
+    const UA_DataSourceExtension *ext = &vn->value.source.extension;
+    if(!ds->read && !ext->readAsync && !ext->readBatch)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Take a value from the cache that is fresh enough. Values from value
+     * handles are always current and not cached. */
+    size_t maxCacheEntries = server->config.maxReadCacheEntries;
+    if(UA_ValueHandle_fromNode((const UA_Node*)vn))
+        maxCacheEntries = 0;
+    if(maxCacheEntries > 0 && maxAge > 0.0 &&
+       UA_ReadCache_get(&server->readCache, &vn->nodeId,
+                        (UA_DateTime)(maxAge * UA_MSEC_TO_DATETIME), rangeptr, v))
+        return UA_STATUSCODE_GOOD;
+
+    /* Read asynchronously if the response can wait or if there is no
+     * synchronous read. Asynchronous results are not cached. */
+    if(ext->readAsync && (asyncContext || (!ds->read && !ext->readBatch)))
+        return readValueAttributeAsync(server, vn, v, timestamps, rangeptr);
+
+    /* Values that are cached always carry the source timestamp. It is removed
+     * if not requested. */
+    UA_Boolean cache = (maxCacheEntries > 0 && !rangeptr);
+    UA_Boolean sourceTimeStamp = (cache || timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
+                                  timestamps == UA_TIMESTAMPSTORETURN_BOTH);
+
+    /* Without a read callback, read a batch of one */
+    UA_StatusCode retval;
+    const UA_NumericRange *ranges[1] = {rangeptr};
+    UA_RCU_UNLOCK();
+    if(ds->read)
+        retval = ds->read(ds->handle, vn->nodeId, sourceTimeStamp, rangeptr, v);
+    else
+        retval = ext->readBatch(ds->handle, 1, &vn->nodeId, sourceTimeStamp, ranges, v);
+    UA_RCU_LOCK();
+
+    if(cache && retval == UA_STATUSCODE_GOOD)
+        UA_ReadCache_put(&server->readCache, maxCacheEntries, &vn->nodeId, v);
     return retval;
 }
 
 static UA_StatusCode
 readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
-                           UA_TimestampsToReturn timestamps, const UA_String *indexRange,
-                           UA_DataValue *v) {
+                           UA_TimestampsToReturn timestamps, UA_Double maxAge,
+                           const UA_String *indexRange, UA_DataValue *v) {
     /* Compute the index range */
     UA_NumericRange range;
     UA_NumericRange *rangeptr = NULL;
@@ -465,7 +510,8 @@ readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
     if(vn->valueSource == UA_VALUESOURCE_DATA)
         retval = readValueAttributeFromNode(server, vn, v, rangeptr);
     else
-        retval = readValueAttributeFromDataSource(vn, v, timestamps, rangeptr);
+        retval = readValueAttributeFromDataSource(server, vn, v, timestamps,
+                                                  rangeptr, maxAge);
 
     /* Clean up */
     if(rangeptr)
@@ -475,26 +521,212 @@ readValueAttributeComplete(UA_Server *server, const UA_VariableNode *vn,
 
 UA_StatusCode
 readValueAttribute(UA_Server *server, const UA_VariableNode *vn, UA_DataValue *v) {
-    return readValueAttributeComplete(server, vn, UA_TIMESTAMPSTORETURN_NEITHER, NULL, v);
+    /* Internal reads need the value immediately */
+    UA_AsyncContext *ctx = asyncContext;
+    asyncContext = NULL;
+    UA_StatusCode retval =
+        readValueAttributeComplete(server, vn, UA_TIMESTAMPSTORETURN_NEITHER, 0.0, NULL, v);
+    asyncContext = ctx;
+    return retval;
+}
+
+/**************/
+/* Batch Read */
+/**************/
+
+void
+UA_BatchRead_init(UA_BatchRead *batch) {
+    memset(batch, 0, sizeof(UA_BatchRead));
+}
+
+UA_Boolean
+UA_BatchRead_accepts(const UA_Node *node, UA_UInt32 attributeId) {
+    if(attributeId != UA_ATTRIBUTEID_VALUE ||
+       !(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        return false;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(vn->valueSource != UA_VALUESOURCE_DATASOURCE || !vn->value.source.extension.readBatch)
+        return false;
+    /* Asynchronous reads are preferred if the response can wait */
+    return (!vn->value.source.extension.readAsync || !asyncContext);
+}
+
+/* Sets the value as in ReadWithNode */
+static void
+finishBatchReadValue(UA_DataValue *v, UA_StatusCode retval,
+                     UA_TimestampsToReturn timestamps) {
+    if(retval != UA_STATUSCODE_GOOD) {
+        v->hasStatus = true;
+        v->status = retval;
+        return;
+    }
+    v->hasValue = true;
+    setValueTimestamps(v, timestamps);
+}
+
+UA_StatusCode
+UA_BatchRead_add(UA_Server *server, UA_BatchRead *batch, const UA_Node *node,
+                 const UA_String *indexRange, UA_TimestampsToReturn timestamps,
+                 UA_Double maxAge, UA_DataValue *value) {
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+
+    /* Grow the array */
+    if(batch->itemsSize == batch->itemsCapacity) {
+        size_t newCapacity = 16;
+        if(batch->itemsCapacity > 0)
+            newCapacity = batch->itemsCapacity * 2;
+        UA_BatchReadItem *items =
+            UA_realloc(batch->items, newCapacity * sizeof(UA_BatchReadItem));
+        if(!items)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        batch->items = items;
+        batch->itemsCapacity = newCapacity;
+    }
+
+    /* Compute the index range */
+    UA_BatchReadItem *item = &batch->items[batch->itemsSize];
+    item->hasRange = false;
+    if(indexRange && indexRange->length > 0) {
+        UA_StatusCode retval = parse_numericrange(indexRange, &item->range);
+        if(retval != UA_STATUSCODE_GOOD) {
+            finishBatchReadValue(value, retval, timestamps);
+            return UA_STATUSCODE_GOOD;
+        }
+        item->hasRange = true;
+    }
+
+    /* Take a value from the cache that is fresh enough */
+    if(server->config.maxReadCacheEntries > 0 && maxAge > 0.0 &&
+       UA_ReadCache_get(&server->readCache, &vn->nodeId,
+                        (UA_DateTime)(maxAge * UA_MSEC_TO_DATETIME),
+                        item->hasRange ? &item->range : NULL, value)) {
+        if(item->hasRange)
+            UA_free(item->range.dimensions);
+        finishBatchReadValue(value, UA_STATUSCODE_GOOD, timestamps);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* The node may be replaced while the RCU lock is released for the
+     * callback. So the NodeId is copied. */
+    UA_StatusCode retval = UA_NodeId_copy(&vn->nodeId, &item->nodeId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(item->hasRange)
+            UA_free(item->range.dimensions);
+        return retval;
+    }
+    item->handle = vn->value.source.dataSource.handle;
+    item->readBatch = vn->value.source.extension.readBatch;
+    item->timestamps = timestamps;
+    item->value = value;
+    ++batch->itemsSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Items of the same data source are adjacent after sorting */
+static int
+compareBatchReadItems(const void *a, const void *b) {
+    const UA_BatchReadItem *ia = (const UA_BatchReadItem*)a;
+    const UA_BatchReadItem *ib = (const UA_BatchReadItem*)b;
+    uintptr_t ha = (uintptr_t)ia->handle, hb = (uintptr_t)ib->handle;
+    if(ha != hb)
+        return (ha > hb) - (ha < hb);
+    uintptr_t fa = (uintptr_t)ia->readBatch, fb = (uintptr_t)ib->readBatch;
+    return (fa > fb) - (fa < fb);
+}
+
+static UA_Boolean
+sameDataSource(const UA_BatchReadItem *a, const UA_BatchReadItem *b) {
+    return (a->handle == b->handle && a->readBatch == b->readBatch);
+}
+
+void
+UA_BatchRead_execute(UA_Server *server, UA_BatchRead *batch) {
+    size_t itemsSize = batch->itemsSize;
+    UA_BatchReadItem *items = batch->items;
+    if(itemsSize > 1)
+        qsort(items, itemsSize, sizeof(UA_BatchReadItem), compareBatchReadItems);
+
+    /* Arguments of the callback. Large enough for the largest group. */
+    UA_NodeId *nodeIds = UA_malloc(itemsSize * sizeof(UA_NodeId));
+    const UA_NumericRange **ranges = UA_malloc(itemsSize * sizeof(UA_NumericRange*));
+    UA_DataValue *values = UA_malloc(itemsSize * sizeof(UA_DataValue));
+
+    size_t maxCacheEntries = server->config.maxReadCacheEntries;
+    for(size_t start = 0, end; start < itemsSize; start = end) {
+        /* Find the group of the data source */
+        const UA_BatchReadItem *first = &items[start];
+        UA_Boolean sourceTimeStamp = (maxCacheEntries > 0);
+        for(end = start; end < itemsSize && sameDataSource(first, &items[end]); ++end) {
+            UA_TimestampsToReturn ts = items[end].timestamps;
+            if(ts == UA_TIMESTAMPSTORETURN_SOURCE || ts == UA_TIMESTAMPSTORETURN_BOTH)
+                sourceTimeStamp = true;
+        }
+
+        if(!nodeIds || !ranges || !values) {
+            for(size_t i = start; i < end; ++i)
+                finishBatchReadValue(items[i].value, UA_STATUSCODE_BADOUTOFMEMORY,
+                                     items[i].timestamps);
+            continue;
+        }
+
+        /* Read the group. Values that are cached always carry the source
+         * timestamp. It is removed if not requested. */
+        size_t groupSize = end - start;
+        for(size_t i = 0; i < groupSize; ++i) {
+            UA_BatchReadItem *item = &items[start + i];
+            nodeIds[i] = item->nodeId;
+            ranges[i] = item->hasRange ? &item->range : NULL;
+            UA_DataValue_init(&values[i]);
+        }
+        UA_RCU_UNLOCK();
+        UA_StatusCode retval = first->readBatch(first->handle, groupSize, nodeIds,
+                                                sourceTimeStamp, ranges, values);
+        UA_RCU_LOCK();
+
+        /* Move the values to the items */
+        for(size_t i = 0; i < groupSize; ++i) {
+            UA_BatchReadItem *item = &items[start + i];
+            if(retval != UA_STATUSCODE_GOOD) {
+                UA_DataValue_deleteMembers(&values[i]);
+            } else {
+                *item->value = values[i];
+                if(maxCacheEntries > 0 && !item->hasRange)
+                    UA_ReadCache_put(&server->readCache, maxCacheEntries,
+                                     &item->nodeId, item->value);
+            }
+            finishBatchReadValue(item->value, retval, item->timestamps);
+        }
+    }
+
+    /* Clean up */
+    for(size_t i = 0; i < itemsSize; ++i) {
+        UA_NodeId_deleteMembers(&items[i].nodeId);
+        if(items[i].hasRange)
+            UA_free(items[i].range.dimensions);
+    }
+    UA_free(nodeIds);
+    UA_free(ranges);
+    UA_free(values);
+    UA_free(items);
+    UA_BatchRead_init(batch);
 }
 
 static UA_StatusCode
-writeValueAttributeWithoutRange(UA_VariableNode *node, const UA_DataValue *value) {
-    UA_DataValue old_value = node->value.data.value; /* keep the pointers for restoring */
-    UA_StatusCode retval = UA_DataValue_copy(value, &node->value.data.value);
+writeValueAttributeWithoutRange(UA_DataValue *target, const UA_DataValue *value) {
+    UA_DataValue old_value = *target; /* keep the pointers for restoring */
+    UA_StatusCode retval = UA_DataValue_copy(value, target);
     if(retval == UA_STATUSCODE_GOOD)
         UA_DataValue_deleteMembers(&old_value);
     else
-        node->value.data.value = old_value;
+        *target = old_value;
     return retval;
 }
 
 static UA_StatusCode
-writeValueAttributeWithRange(UA_VariableNode *node, const UA_DataValue *value,
+writeValueAttributeWithRange(UA_DataValue *target, const UA_DataValue *value,
                              const UA_NumericRange *rangeptr) {
     /* Value on both sides? */
-    if(value->status != node->value.data.value.status ||
-       !value->hasValue || !node->value.data.value.hasValue)
+    if(value->status != target->status || !value->hasValue || !target->hasValue)
         return UA_STATUSCODE_BADINDEXRANGEINVALID;
 
     /* Make scalar a one-entry array for range matching */
@@ -507,21 +739,75 @@ writeValueAttributeWithRange(UA_VariableNode *node, const UA_DataValue *value,
     }
 
     /* Write the value */
-    UA_StatusCode retval = UA_Variant_setRangeCopy(&node->value.data.value.value,
-                                                   v->data, v->arrayLength, *rangeptr);
+    UA_StatusCode retval = UA_Variant_setRangeCopy(&target->value, v->data,
+                                                   v->arrayLength, *rangeptr);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
     /* Write the status and timestamps */
-    node->value.data.value.hasStatus = value->hasStatus;
-    node->value.data.value.status = value->status;
-    node->value.data.value.hasSourceTimestamp = value->hasSourceTimestamp;
-    node->value.data.value.sourceTimestamp = value->sourceTimestamp;
-    node->value.data.value.hasSourcePicoseconds = value->hasSourcePicoseconds;
-    node->value.data.value.sourcePicoseconds = value->sourcePicoseconds;
+    target->hasStatus = value->hasStatus;
+    target->status = value->status;
+    target->hasSourceTimestamp = value->hasSourceTimestamp;
+    target->sourceTimestamp = value->sourceTimestamp;
+    target->hasSourcePicoseconds = value->hasSourcePicoseconds;
+    target->sourcePicoseconds = value->sourcePicoseconds;
+    return UA_STATUSCODE_GOOD;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+static void
+deleteSlotValue(struct rcu_head *head) {
+    UA_SlotValue *sv = container_of(head, UA_SlotValue, rcu_head);
+    UA_DataValue_deleteMembers(&sv->value);
+    UA_free(sv);
+}
+
+/* The new value is prepared aside and exchanged with the current value of the
+ * slot. Writes with a range edit a copy of the current value. If the current
+ * value was replaced in the meantime, the write is repeated on the newer
+ * value. */
+static UA_StatusCode
+writeValueSlot(UA_ValueSlot *slot, const UA_DataValue *value,
+               const UA_NumericRange *rangeptr) {
+    UA_SlotValue *newValue = UA_malloc(sizeof(UA_SlotValue));
+    if(!newValue)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_DataValue_init(&newValue->value);
+
+    UA_SlotValue *oldValue;
+    UA_StatusCode retval;
+    if(!rangeptr) {
+        retval = writeValueAttributeWithoutRange(&newValue->value, value);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+        /* Make the new value visible before publishing the pointer */
+        UA_atomic_sync();
+        oldValue = UA_atomic_xchg((void * volatile *)&slot->current, newValue);
+    } else {
+        do {
+            UA_DataValue_deleteMembers(&newValue->value);
+            oldValue = slot->current;
+            retval = UA_DataValue_copy(&oldValue->value, &newValue->value);
+            if(retval != UA_STATUSCODE_GOOD)
+                goto cleanup;
+            retval = writeValueAttributeWithRange(&newValue->value, value, rangeptr);
+            if(retval != UA_STATUSCODE_GOOD)
+                goto cleanup;
+        } while(UA_atomic_cmpxchg((void * volatile *)&slot->current,
+                                  oldValue, newValue) != oldValue);
+    }
+    call_rcu(&oldValue->rcu_head, deleteSlotValue);
     return UA_STATUSCODE_GOOD;
+
+ cleanup:
+    UA_DataValue_deleteMembers(&newValue->value);
+    UA_free(newValue);
+    return retval;
 }
 
+#endif
+
 UA_StatusCode
 writeValueAttribute(UA_Server *server, UA_VariableNode *node,
                     const UA_DataValue *value, const UA_String *indexRange) {
@@ -558,10 +844,16 @@ writeValueAttribute(UA_Server *server, UA_VariableNode *node,
 
     /* Ok, do it */
     if(node->valueSource == UA_VALUESOURCE_DATA) {
+#ifdef UA_ENABLE_MULTITHREADING
+        if(node->value.data.slot)
+            retval = writeValueSlot(node->value.data.slot, &editableValue, rangeptr);
+        else
+#endif
         if(!rangeptr)
-            retval = writeValueAttributeWithoutRange(node, &editableValue);
+            retval = writeValueAttributeWithoutRange(&node->value.data.value, &editableValue);
         else
-            retval = writeValueAttributeWithRange(node, &editableValue, rangeptr);
+            retval = writeValueAttributeWithRange(&node->value.data.value,
+                                                  &editableValue, rangeptr);
 
         /* Callback after writing */
         if(retval == UA_STATUSCODE_GOOD && node->value.data.callback.onWrite) {
@@ -576,13 +868,15 @@ writeValueAttribute(UA_Server *server, UA_VariableNode *node,
             UA_RCU_UNLOCK();
             writtenNode->value.data.callback.onWrite(writtenNode->value.data.callback.handle,
                                                      writtenNode->nodeId,
-                                                     &writtenNode->value.data.value.value, rangeptr);
+                                                     &UA_VariableNode_getValue(writtenNode)->value,
+                                                     rangeptr);
             UA_RCU_LOCK();
         }
     } else {
-        if(node->value.dataSource.write) {
+        if(node->value.source.dataSource.write) {
+            UA_ReadCache_remove(&server->readCache, &node->nodeId);
             UA_RCU_UNLOCK();
-            retval = node->value.dataSource.write(node->value.dataSource.handle,
+            retval = node->value.source.dataSource.write(node->value.source.dataSource.handle,
                                                   node->nodeId, &editableValue.value, rangeptr);
             UA_RCU_LOCK();
         } else {
@@ -658,9 +952,11 @@ static const UA_String binEncoding = {sizeof("Default Binary")-1, (UA_Byte*)"Def
         break;                                                  \
     }
 
-void Service_Read_single(UA_Server *server, UA_Session *session,
-                         const UA_TimestampsToReturn timestamps,
-                         const UA_ReadValueId *id, UA_DataValue *v) {
+/* Checks the ReadValueId and looks up the node. Returns NULL and sets the
+ * status if the attribute cannot be read. */
+static const UA_Node *
+getNodeToRead(UA_Server *server, UA_Session *session,
+              const UA_ReadValueId *id, UA_DataValue *v) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session,
                          "Read the attribute %i", id->attributeId);
 
@@ -669,25 +965,40 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
        !UA_String_equal(&binEncoding, &id->dataEncoding.name)) {
            v->hasStatus = true;
            v->status = UA_STATUSCODE_BADDATAENCODINGUNSUPPORTED;
-           return;
+           return NULL;
     }
 
     /* Index range for an attribute other than value */
     if(id->indexRange.length > 0 && id->attributeId != UA_ATTRIBUTEID_VALUE) {
         v->hasStatus = true;
         v->status = UA_STATUSCODE_BADINDEXRANGENODATA;
-        return;
+        return NULL;
     }
 
     /* Get the node */
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, &id->nodeId);
+    const UA_Node *node = UA_Server_getSessionNode(server, session, &id->nodeId);
     if(!node) {
         v->hasStatus = true;
         v->status = UA_STATUSCODE_BADNODEIDUNKNOWN;
-        return;
+        return NULL;
     }
+    return node;
+}
+
+void Service_Read_single(UA_Server *server, UA_Session *session,
+                         const UA_TimestampsToReturn timestamps, UA_Double maxAge,
+                         const UA_ReadValueId *id, UA_DataValue *v) {
+    const UA_Node *node = getNodeToRead(server, session, id, v);
+    if(!node)
+        return;
 
     /* Read the attribute */
+    ReadWithNode(node, server, session, timestamps, maxAge, id, v);
+}
+
+void ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
+                  UA_TimestampsToReturn timestamps, UA_Double maxAge,
+                  const UA_ReadValueId *id, UA_DataValue *v) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     switch(id->attributeId) {
     case UA_ATTRIBUTEID_NODEID:
@@ -737,7 +1048,7 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
     case UA_ATTRIBUTEID_VALUE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
         retval = readValueAttributeComplete(server, (const UA_VariableNode*)node,
-                                            timestamps, &id->indexRange, v);
+                                            timestamps, maxAge, &id->indexRange, v);
         break;
     case UA_ATTRIBUTEID_DATATYPE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
@@ -787,6 +1098,10 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
         retval = UA_STATUSCODE_BADATTRIBUTEIDINVALID;
     }
 
+    /* The value is set when the asynchronous read completes */
+    if(retval == UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY)
+        return;
+
     /* Return error code when reading has failed */
     if(retval != UA_STATUSCODE_GOOD) {
         v->hasStatus = true;
@@ -796,6 +1111,21 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
 
     v->hasValue = true;
 
+    /* Handle source time stamp */
+    if(id->attributeId == UA_ATTRIBUTEID_VALUE) {
+        setValueTimestamps(v, timestamps);
+        return;
+    }
+
+    /* Create server timestamp */
+    if(timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
+       timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
+        v->serverTimestamp = UA_DateTime_now();
+        v->hasServerTimestamp = true;
+    }
+}
+
+void setValueTimestamps(UA_DataValue *v, UA_TimestampsToReturn timestamps) {
     /* Create server timestamp */
     if(timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
        timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
@@ -804,18 +1134,39 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
     }
 
     /* Handle source time stamp */
-    if(id->attributeId == UA_ATTRIBUTEID_VALUE) {
-        if (timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
-            timestamps == UA_TIMESTAMPSTORETURN_NEITHER) {
-            v->hasSourceTimestamp = false;
-            v->hasSourcePicoseconds = false;
-        } else if(!v->hasSourceTimestamp) {
-            v->sourceTimestamp = UA_DateTime_now();
-            v->hasSourceTimestamp = true;
-        }
+    if(timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
+       timestamps == UA_TIMESTAMPSTORETURN_NEITHER) {
+        v->hasSourceTimestamp = false;
+        v->hasSourcePicoseconds = false;
+    } else if(!v->hasSourceTimestamp) {
+        v->sourceTimestamp = UA_DateTime_now();
+        v->hasSourceTimestamp = true;
     }
 }
 
+static void
+readSlice(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
+          UA_ReadResponse *response, size_t start, size_t end) {
+    /* Values of data sources with a readBatch callback are collected and read
+     * with one call per data source in the end */
+    UA_BatchRead batch;
+    UA_BatchRead_init(&batch);
+    for(size_t i = start; i < end; ++i) {
+        const UA_ReadValueId *id = &request->nodesToRead[i];
+        const UA_Node *node = getNodeToRead(server, session, id, &response->results[i]);
+        if(!node)
+            continue;
+        if(UA_BatchRead_accepts(node, id->attributeId) &&
+           UA_BatchRead_add(server, &batch, node, &id->indexRange,
+                            request->timestampsToReturn, request->maxAge,
+                            &response->results[i]) == UA_STATUSCODE_GOOD)
+            continue;
+        ReadWithNode(node, server, session, request->timestampsToReturn,
+                     request->maxAge, id, &response->results[i]);
+    }
+    UA_BatchRead_execute(server, &batch);
+}
+
 void Service_Read(UA_Server *server, UA_Session *session,
                   const UA_ReadRequest *request, UA_ReadResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
@@ -843,10 +1194,9 @@ void Service_Read(UA_Server *server, UA_Session *session,
         return;
     }
 
-    for(size_t i = 0;i < size;++i) {
-            Service_Read_single(server, session, request->timestampsToReturn,
-                                &request->nodesToRead[i], &response->results[i]);
-    }
+    UA_Server_processServiceItems(server, session, size,
+                                  (UA_ServiceSliceCallback)readSlice, NULL,
+                                  request, response);
 
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
     /* Add an expiry header for caching */
@@ -890,6 +1240,11 @@ void Service_Read(UA_Server *server, UA_Session *session,
 #endif
 }
 
+void
+UA_Server_getReadCacheStatistics(UA_Server *server, UA_ReadCacheStatistics *stats) {
+    *stats = server->readCache.stats;
+}
+
 /* Exposes the Read service to local users */
 UA_DataValue
 UA_Server_read(UA_Server *server, const UA_ReadValueId *item,
@@ -897,7 +1252,19 @@ UA_Server_read(UA_Server *server, const UA_ReadValueId *item,
     UA_DataValue dv;
     UA_DataValue_init(&dv);
     UA_RCU_LOCK();
-    Service_Read_single(server, &adminSession, timestamps, item, &dv);
+    Service_Read_single(server, &adminSession, timestamps, 0.0, item, &dv);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The value may point into a node or a value slot that is freed after the
+     * read-side critical section. Copy it while it is valid. */
+    if(dv.hasValue && dv.value.storageType == UA_VARIANT_DATA_NODELETE) {
+        UA_Variant shallow = dv.value;
+        if(UA_Variant_copy(&shallow, &dv.value) != UA_STATUSCODE_GOOD) {
+            dv.hasValue = false;
+            dv.hasStatus = true;
+            dv.status = UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+#endif
     UA_RCU_UNLOCK();
     return dv;
 }
@@ -977,32 +1344,61 @@ __UA_Server_read(UA_Server *server, const UA_NodeId *nodeId,
         break;                                                          \
     }
 
+/* The argument definitions of methods are cached in the MethodNode */
+static UA_Boolean
+isArgumentsProperty(const UA_Node *node) {
+    static const UA_String inputArguments = {sizeof("InputArguments")-1,
+                                             (UA_Byte*)"InputArguments"};
+    static const UA_String outputArguments = {sizeof("OutputArguments")-1,
+                                              (UA_Byte*)"OutputArguments"};
+    return node->nodeClass == UA_NODECLASS_VARIABLE &&
+        node->browseName.namespaceIndex == 0 &&
+        (UA_String_equal(&node->browseName.name, &inputArguments) ||
+         UA_String_equal(&node->browseName.name, &outputArguments));
+}
+
 /* This function implements the main part of the write service and operates on a
    copy of the node (not in single-threaded mode). */
 static UA_StatusCode
 CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
                       UA_Node *node, const UA_WriteValue *wvalue) {
     const void *value = wvalue->value.value.data;
+    UA_StringPool *stringPool = node->stringPool;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     switch(wvalue->attributeId) {
     case UA_ATTRIBUTEID_NODEID:
     case UA_ATTRIBUTEID_NODECLASS:
         retval = UA_STATUSCODE_BADWRITENOTSUPPORTED;
         break;
+    /* Interned strings are shared with other nodes. They are replaced with
+     * private copies before the edit and interned again in the same pool
+     * afterwards. */
     case UA_ATTRIBUTEID_BROWSENAME:
         CHECK_DATATYPE_SCALAR(QUALIFIEDNAME);
+        retval = UA_Node_uninternStrings(node);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
         UA_QualifiedName_deleteMembers(&node->browseName);
         UA_QualifiedName_copy(value, &node->browseName);
+        UA_Node_internStrings(node, stringPool);
         break;
     case UA_ATTRIBUTEID_DISPLAYNAME:
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
+        retval = UA_Node_uninternStrings(node);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
         UA_LocalizedText_deleteMembers(&node->displayName);
         UA_LocalizedText_copy(value, &node->displayName);
+        UA_Node_internStrings(node, stringPool);
         break;
     case UA_ATTRIBUTEID_DESCRIPTION:
         CHECK_DATATYPE_SCALAR(LOCALIZEDTEXT);
+        retval = UA_Node_uninternStrings(node);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
         UA_LocalizedText_deleteMembers(&node->description);
         UA_LocalizedText_copy(value, &node->description);
+        UA_Node_internStrings(node, stringPool);
         break;
     case UA_ATTRIBUTEID_WRITEMASK:
         CHECK_DATATYPE_SCALAR(UINT32);
@@ -1039,6 +1435,14 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
         break;
     case UA_ATTRIBUTEID_VALUE:
         CHECK_NODECLASS_WRITE(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
+#ifdef UA_ENABLE_MULTITHREADING
+        /* The following writes of the value do not copy the node */
+        if(((UA_VariableNode*)node)->valueSource == UA_VALUESOURCE_DATA) {
+            retval = UA_VariableNode_addValueSlot((UA_VariableNode*)node);
+            if(retval != UA_STATUSCODE_GOOD)
+                break;
+        }
+#endif
         retval = writeValueAttribute(server, (UA_VariableNode*)node,
                                      &wvalue->value, &wvalue->indexRange);
         break;
@@ -1100,6 +1504,59 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+static UA_StatusCode
+writeNodeAttribute(UA_Server *server, UA_Session *session, const UA_WriteValue *wvalue) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Values in a slot are written in-situ. The node itself is not changed. */
+    if(wvalue->attributeId == UA_ATTRIBUTEID_VALUE) {
+        const UA_Node *node = UA_Server_getSessionNode(server, session, &wvalue->nodeId);
+        if(node && (node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE))) {
+            const UA_VariableNode *vn = (const UA_VariableNode*)node;
+            if(vn->valueSource == UA_VALUESOURCE_DATA && vn->value.data.slot)
+                return CopyAttributeIntoNode(server, session, (UA_Node*)(uintptr_t)node, wvalue);
+        }
+    }
+#endif
+    return UA_Server_editNode(server, session, &wvalue->nodeId,
+                              (UA_EditNodeCallback)CopyAttributeIntoNode, wvalue);
+}
+
+static UA_StatusCode
+writeAttribute(UA_Server *server, UA_Session *session, const UA_WriteValue *wvalue) {
+    UA_StatusCode retval = writeNodeAttribute(server, session, wvalue);
+    if(retval != UA_STATUSCODE_GOOD ||
+       (wvalue->attributeId != UA_ATTRIBUTEID_BROWSENAME &&
+        wvalue->attributeId != UA_ATTRIBUTEID_VALUE))
+        return retval;
+
+    const UA_Node *node = UA_Server_getSessionNode(server, session, &wvalue->nodeId);
+    if(!node)
+        return retval;
+
+    /* The nodes referencing the renamed node index it by the browse name */
+    if(wvalue->attributeId == UA_ATTRIBUTEID_BROWSENAME)
+        UA_Server_updateReferenceNames(server, session, node);
+
+    /* The methods resolve their arguments from properties with that name */
+    if(wvalue->attributeId == UA_ATTRIBUTEID_BROWSENAME || isArgumentsProperty(node))
+        UA_Server_invalidateMethodArguments(server, node);
+    return retval;
+}
+
+static void
+writeSlice(UA_Server *server, UA_Session *session, const UA_WriteRequest *request,
+           UA_WriteResponse *response, size_t start, size_t end) {
+    for(size_t i = start;i < end;++i)
+        response->results[i] = writeAttribute(server, session, &request->nodesToWrite[i]);
+}
+
+static UA_UInt32
+writeItemKey(UA_Session *session, const void *request, size_t index) {
+    const UA_NodeId *nodeId = &((const UA_WriteRequest*)request)->nodesToWrite[index].nodeId;
+    const UA_NodeId *resolved = UA_Session_resolveNodeId(session, nodeId);
+    return UA_NodeId_hash(resolved ? resolved : nodeId);
+}
+
 void
 Service_Write(UA_Server *server, UA_Session *session,
               const UA_WriteRequest *request, UA_WriteResponse *response) {
@@ -1116,19 +1573,16 @@ Service_Write(UA_Server *server, UA_Session *session,
     }
     response->resultsSize = request->nodesToWriteSize;
 
-    for(size_t i = 0;i < request->nodesToWriteSize;++i) {
-        response->results[i] = UA_Server_editNode(server, session, &request->nodesToWrite[i].nodeId,
-                                                  (UA_EditNodeCallback)CopyAttributeIntoNode,
-                                                  &request->nodesToWrite[i]);
-    }
+    /* Writes to the same node keep their order */
+    UA_Server_processServiceItems(server, session, request->nodesToWriteSize,
+                                  (UA_ServiceSliceCallback)writeSlice, writeItemKey,
+                                  request, response);
 }
 
 UA_StatusCode
 UA_Server_write(UA_Server *server, const UA_WriteValue *value) {
     UA_RCU_LOCK();
-    UA_StatusCode retval =
-        UA_Server_editNode(server, &adminSession, &value->nodeId,
-                           (UA_EditNodeCallback)CopyAttributeIntoNode, value);
+    UA_StatusCode retval = writeAttribute(server, &adminSession, value);
     UA_RCU_UNLOCK();
     return retval;
 }
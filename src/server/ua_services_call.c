@@ -11,44 +11,117 @@ static const UA_VariableNode *
 getArgumentsVariableNode(UA_Server *server, const UA_MethodNode *ofMethod,
                          UA_String withBrowseName) {
     UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
-    for(size_t i = 0; i < ofMethod->referencesSize; ++i) {
-        if(ofMethod->references[i].isInverse == false &&
-            UA_NodeId_equal(&hasProperty, &ofMethod->references[i].referenceTypeId)) {
-            const UA_Node *refTarget =
-                UA_NodeStore_get(server->nodestore, &ofMethod->references[i].targetId.nodeId);
-            if(!refTarget)
-                continue;
-            if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
-                refTarget->browseName.namespaceIndex == 0 &&
-                UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
-                return (const UA_VariableNode*) refTarget;
-            }
+    const UA_ReferenceKind *properties =
+        UA_Node_findReferenceKind((const UA_Node*)ofMethod, &hasProperty, false);
+    if(!properties)
+        return NULL;
+    for(size_t i = properties->referencesStart;
+        i < properties->referencesStart + properties->referencesSize; ++i) {
+        const UA_Node *refTarget =
+            UA_Server_getReferenceTarget(server, &ofMethod->references[i]);
+        if(!refTarget)
+            continue;
+        if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
+            refTarget->browseName.namespaceIndex == 0 &&
+            UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
+            return (const UA_VariableNode*) refTarget;
         }
     }
     return NULL;
 }
 
+/* Copies the argument definitions from the property and looks up the types */
 static UA_StatusCode
-argumentsConformsToDefinition(UA_Server *server, const UA_VariableNode *argRequirements,
+resolveArgumentDefinitions(UA_Server *server, const UA_MethodNode *method,
+                           UA_String withBrowseName, UA_MethodArgumentDefinitions *defs) {
+    const UA_VariableNode *argNode = getArgumentsVariableNode(server, method, withBrowseName);
+    if(!argNode)
+        return UA_STATUSCODE_GOOD;
+    defs->defined = true;
+    if(argNode->valueSource != UA_VALUESOURCE_DATA) {
+        defs->status = UA_STATUSCODE_BADINTERNALERROR;
+        return UA_STATUSCODE_GOOD;
+    }
+    const UA_Variant *value = &UA_VariableNode_getValue(argNode)->value;
+    if(value->type != &UA_TYPES[UA_TYPES_ARGUMENT]) {
+        defs->status = UA_STATUSCODE_BADINTERNALERROR;
+        return UA_STATUSCODE_GOOD;
+    }
+    size_t argsSize = value->arrayLength;
+    if(UA_Variant_isScalar(value))
+        argsSize = 1;
+    if(argsSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    UA_StatusCode retval = UA_Array_copy(value->data, argsSize, (void**)&defs->arguments,
+                                         &UA_TYPES[UA_TYPES_ARGUMENT]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    defs->argumentsSize = argsSize;
+    defs->types = UA_malloc(sizeof(UA_DataType*) * argsSize);
+    if(!defs->types)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < argsSize; ++i)
+        defs->types[i] = UA_findDataType(&defs->arguments[i].dataType);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+cacheMethodArguments(UA_Server *server, UA_Session *session,
+                     UA_MethodNode *method, const UA_MethodArgumentsCache **result) {
+    if(!method->arguments) {
+        UA_MethodArgumentsCache *cache = UA_calloc(1, sizeof(UA_MethodArgumentsCache));
+        if(!cache)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_StatusCode retval =
+            resolveArgumentDefinitions(server, method, UA_STRING("InputArguments"), &cache->input);
+        retval |= resolveArgumentDefinitions(server, method, UA_STRING("OutputArguments"),
+                                             &cache->output);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_MethodArgumentsCache_delete(cache);
+            return retval;
+        }
+        method->arguments = cache;
+    }
+    *result = method->arguments;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the cached argument definitions of the method. They are resolved
+ * with the first call. Returns NULL if out of memory. */
+static const UA_MethodArgumentsCache *
+getMethodArguments(UA_Server *server, UA_Session *session, const UA_MethodNode *method) {
+    if(method->arguments)
+        return method->arguments;
+    const UA_MethodArgumentsCache *cache = NULL;
+    if(UA_Server_editNode(server, session, &method->nodeId,
+                          (UA_EditNodeCallback)cacheMethodArguments, &cache) != UA_STATUSCODE_GOOD)
+        return NULL;
+    return cache;
+}
+
+static UA_StatusCode
+argumentsConformsToDefinition(UA_Server *server, const UA_MethodArgumentDefinitions *defs,
                               size_t argsSize, UA_Variant *args) {
-    if(argRequirements->value.data.value.value.type != &UA_TYPES[UA_TYPES_ARGUMENT])
-        return UA_STATUSCODE_BADINTERNALERROR;
-    UA_Argument *argReqs = (UA_Argument*)argRequirements->value.data.value.value.data;
-    size_t argReqsSize = argRequirements->value.data.value.value.arrayLength;
-    if(argRequirements->valueSource != UA_VALUESOURCE_DATA)
-        return UA_STATUSCODE_BADINTERNALERROR;
-    if(UA_Variant_isScalar(&argRequirements->value.data.value.value))
-        argReqsSize = 1;
-    if(argReqsSize > argsSize)
+    if(defs->status != UA_STATUSCODE_GOOD)
+        return defs->status;
+    if(defs->argumentsSize > argsSize)
         return UA_STATUSCODE_BADARGUMENTSMISSING;
-    if(argReqsSize != argsSize)
+    if(defs->argumentsSize != argsSize)
         return UA_STATUSCODE_BADINVALIDARGUMENT;
 
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(size_t i = 0; i < argReqsSize; ++i)
-        retval |= typeCheckValue(server, &argReqs[i].dataType, argReqs[i].valueRank,
-                                 argReqs[i].arrayDimensionsSize, argReqs[i].arrayDimensions,
+    for(size_t i = 0; i < argsSize; ++i) {
+        const UA_Argument *argReq = &defs->arguments[i];
+        /* Shortcut for scalars of the exact type */
+        if(defs->types[i] && args[i].type == defs->types[i] &&
+           UA_Variant_isScalar(&args[i]) && argReq->arrayDimensionsSize == 0 &&
+           (argReq->valueRank == -1 || argReq->valueRank == -2 || argReq->valueRank == -3))
+            continue;
+        retval |= typeCheckValue(server, &argReq->dataType, argReq->valueRank,
+                                 argReq->arrayDimensionsSize, argReq->arrayDimensions,
                                  &args[i], NULL, &args[i]);
+    }
     return retval;
 }
 
@@ -58,7 +131,7 @@ Service_Call_single(UA_Server *server, UA_Session *session,
                     UA_CallMethodResult *result) {
     /* Get/verify the method node */
     const UA_MethodNode *methodCalled =
-        (const UA_MethodNode*)UA_NodeStore_get(server->nodestore, &request->methodId);
+        (const UA_MethodNode*)UA_Server_getSessionNode(server, session, &request->methodId);
     if(!methodCalled) {
         result->statusCode = UA_STATUSCODE_BADMETHODINVALID;
         return;
@@ -67,14 +140,15 @@ Service_Call_single(UA_Server *server, UA_Session *session,
         result->statusCode = UA_STATUSCODE_BADNODECLASSINVALID;
         return;
     }
-    if(!methodCalled->executable || !methodCalled->userExecutable || !methodCalled->attachedMethod) {
+    if(!methodCalled->executable || !methodCalled->userExecutable ||
+       (!methodCalled->attachedMethod && !methodCalled->attachedMethodAsync)) {
         result->statusCode = UA_STATUSCODE_BADNOTWRITABLE; // There is no NOTEXECUTABLE?
         return;
     }
 
     /* Get/verify the object node */
     const UA_ObjectNode *withObject =
-        (const UA_ObjectNode*)UA_NodeStore_get(server->nodestore, &request->objectId);
+        (const UA_ObjectNode*)UA_Server_getSessionNode(server, session, &request->objectId);
     if(!withObject) {
         result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
         return;
@@ -90,32 +164,36 @@ Service_Call_single(UA_Server *server, UA_Session *session,
      * a hasComponent (or subtype) reference */
     UA_Boolean found = false;
     UA_NodeId hasComponentNodeId = UA_NODEID_NUMERIC(0,UA_NS0ID_HASCOMPONENT);
-    UA_NodeId hasSubTypeNodeId = UA_NODEID_NUMERIC(0,UA_NS0ID_HASSUBTYPE);
-    for(size_t i = 0; i < methodCalled->referencesSize; ++i) {
-        if(methodCalled->references[i].isInverse &&
-           UA_NodeId_equal(&methodCalled->references[i].targetId.nodeId, &withObject->nodeId)) {
-            found = isNodeInTree(server->nodestore, &methodCalled->references[i].referenceTypeId,
-                                 &hasComponentNodeId, &hasSubTypeNodeId, 1);
-            if(found)
-                break;
-        }
+    const UA_ReferenceIndex *refIndex = &methodCalled->referenceIndex;
+    for(size_t i = 0; i < refIndex->kindsSize && !found; ++i) {
+        const UA_ReferenceKind *kind = &refIndex->kinds[i];
+        if(!kind->isInverse ||
+           !UA_TypeIndex_isSubtype(&server->typeIndex, &kind->referenceTypeId,
+                                   &hasComponentNodeId))
+            continue;
+        found = (UA_Node_findReference((const UA_Node*)methodCalled, &kind->referenceTypeId,
+                                       &withObject->nodeId, true) != NULL);
     }
     if(!found) {
         result->statusCode = UA_STATUSCODE_BADMETHODINVALID;
         return;
     }
 
-    /* Verify Input Argument count, types and sizes */
-    const UA_VariableNode *inputArguments =
-        getArgumentsVariableNode(server, methodCalled, UA_STRING("InputArguments"));
+    /* Get the (cached) argument definitions */
+    const UA_MethodArgumentsCache *arguments = getMethodArguments(server, session, methodCalled);
+    if(!arguments) {
+        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
 
-    if(!inputArguments) {
+    /* Verify Input Argument count, types and sizes */
+    if(!arguments->input.defined) {
         if(request->inputArgumentsSize > 0) {
             result->statusCode = UA_STATUSCODE_BADINVALIDARGUMENT;
             return;
         }
     } else {
-        result->statusCode = argumentsConformsToDefinition(server, inputArguments,
+        result->statusCode = argumentsConformsToDefinition(server, &arguments->input,
                                                            request->inputArgumentsSize,
                                                            request->inputArguments);
         if(result->statusCode != UA_STATUSCODE_GOOD)
@@ -124,25 +202,45 @@ Service_Call_single(UA_Server *server, UA_Session *session,
 
     /* Allocate the output arguments */
     result->outputArgumentsSize = 0; /* the default */
-    const UA_VariableNode *outputArguments =
-        getArgumentsVariableNode(server, methodCalled, UA_STRING("OutputArguments"));
-    if(outputArguments) {
-        result->outputArguments = UA_Array_new(outputArguments->value.data.value.value.arrayLength,
+    if(arguments->output.argumentsSize > 0) {
+        result->outputArguments = UA_Array_new(arguments->output.argumentsSize,
                                                &UA_TYPES[UA_TYPES_VARIANT]);
         if(!result->outputArguments) {
             result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
             return;
         }
-        result->outputArgumentsSize = outputArguments->value.data.value.value.arrayLength;
+        result->outputArgumentsSize = arguments->output.argumentsSize;
     }
 
-    /* Call the method */
+    /* Call the method. Asynchronously if the response can wait or if there is
+     * no synchronous callback. */
+    UA_Boolean async = (methodCalled->attachedMethodAsync &&
+                        (asyncContext || !methodCalled->attachedMethod));
+    UA_AsyncOperation *op = NULL;
+    if(async) {
+        op = UA_AsyncOperation_new(server, UA_ASYNCOPERATIONTYPE_CALL, result);
+        if(!op) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+    }
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
     methodCallSession = session;
 #endif
-    result->statusCode = methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
-                                                      request->inputArgumentsSize, request->inputArguments,
-                                                      result->outputArgumentsSize, result->outputArguments);
+    if(async) {
+        UA_StatusCode retval =
+            methodCalled->attachedMethodAsync(methodCalled->methodHandle, withObject->nodeId,
+                                              request->inputArgumentsSize, request->inputArguments,
+                                              result->outputArgumentsSize, op);
+        retval = UA_AsyncOperation_started(op, retval);
+        /* The status code is set when the operation completes */
+        if(retval != UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY)
+            result->statusCode = retval;
+    } else {
+        result->statusCode = methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
+                                                          request->inputArgumentsSize, request->inputArguments,
+                                                          result->outputArgumentsSize, result->outputArguments);
+    }
 #if defined(UA_ENABLE_METHODCALLS) && defined(UA_ENABLE_SUBSCRIPTIONS)
     methodCallSession = NULL;
 #endif
@@ -150,6 +248,27 @@ Service_Call_single(UA_Server *server, UA_Session *session,
     /* TODO: Verify Output matches the argument definition */
 }
 
+static void
+callSlice(UA_Server *server, UA_Session *session, const UA_CallRequest *request,
+          UA_CallResponse *response, size_t start, size_t end) {
+    for(size_t i = start; i < end;++i){
+            Service_Call_single(server, session, &request->methodsToCall[i], &response->results[i]);
+    }
+}
+
+static UA_UInt32
+resolvedHash(UA_Session *session, const UA_NodeId *nodeId) {
+    const UA_NodeId *resolved = UA_Session_resolveNodeId(session, nodeId);
+    return UA_NodeId_hash(resolved ? resolved : nodeId);
+}
+
+static UA_UInt32
+callItemKey(UA_Session *session, const void *request, size_t index) {
+    const UA_CallMethodRequest *call = &((const UA_CallRequest*)request)->methodsToCall[index];
+    return resolvedHash(session, &call->methodId) ^
+        (resolvedHash(session, &call->objectId) * 31);
+}
+
 void Service_Call(UA_Server *server, UA_Session *session,
                   const UA_CallRequest *request,
                   UA_CallResponse *response) {
@@ -166,10 +285,21 @@ void Service_Call(UA_Server *server, UA_Session *session,
     }
     response->resultsSize = request->methodsToCallSize;
 
-    
-    for(size_t i = 0; i < request->methodsToCallSize;++i){
-            Service_Call_single(server, session, &request->methodsToCall[i], &response->results[i]);
-    }
+
+    /* Calls of the same method on the same object keep their order */
+    UA_Server_processServiceItems(server, session, request->methodsToCallSize,
+                                  (UA_ServiceSliceCallback)callSlice, callItemKey,
+                                  request, response);
+}
+
+UA_CallMethodResult
+UA_Server_call(UA_Server *server, const UA_CallMethodRequest *request) {
+    UA_CallMethodResult result;
+    UA_CallMethodResult_init(&result);
+    UA_RCU_LOCK();
+    Service_Call_single(server, &adminSession, request, &result);
+    UA_RCU_UNLOCK();
+    return result;
 }
 
 #endif /* UA_ENABLE_METHODCALLS */
@@ -13,6 +13,10 @@ static UA_StatusCode
 addReference(UA_Server *server, UA_Session *session,
              const UA_AddReferencesItem *item);
 
+static UA_StatusCode
+addOneWayReference(UA_Server *server, UA_Session *session,
+                   UA_Node *node, const UA_AddReferencesItem *item);
+
 static UA_StatusCode
 deleteReference(UA_Server *server, UA_Session *session,
                 const UA_DeleteReferencesItem *item);
@@ -25,19 +29,95 @@ deleteNode(UA_Server *server, UA_Session *session,
 /* Consistency Checks */
 /**********************/
 
+/* Nodes added with UA_Server_addNodes are checked before any of them is
+ * inserted. The checks look up nodes in the nodestore and in the batch. */
+typedef struct {
+    UA_UInt32 hash;
+    size_t item;
+} HashedItem;
+
+typedef struct {
+    size_t itemsSize;
+    const UA_AddNodesItem *items;
+    UA_AddNodesResult *results;
+    UA_Node **nodes; /* created from the items, not yet inserted */
+    size_t sortedSize;
+    HashedItem *sorted; /* the items with a requested NodeId */
+} AddNodesBatch;
+
+/* Returns the first item that requests the NodeId or itemsSize */
+static size_t
+findBatchItem(const AddNodesBatch *batch, const UA_NodeId *nodeId) {
+    UA_UInt32 hash = UA_NodeId_hash(nodeId);
+    size_t lo = 0, hi = batch->sortedSize;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(batch->sorted[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for(; lo < batch->sortedSize && batch->sorted[lo].hash == hash; ++lo) {
+        size_t item = batch->sorted[lo].item;
+        if(UA_NodeId_equal(&batch->items[item].requestedNewNodeId.nodeId, nodeId))
+            return item;
+    }
+    return batch->itemsSize;
+}
+
+static const UA_Node *
+getNewOrExistingNode(UA_Server *server, const AddNodesBatch *batch,
+                     const UA_NodeId *nodeId) {
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
+    if(node || !batch)
+        return node;
+    size_t item = findBatchItem(batch, nodeId);
+    if(item == batch->itemsSize ||
+       batch->results[item].statusCode != UA_STATUSCODE_GOOD)
+        return NULL;
+    return batch->nodes[item];
+}
+
+/* Reference types from the batch are not yet in the type index. Their
+ * supertypes are followed until a type in the index is found. */
+static UA_Boolean
+isHierarchicalReferenceType(UA_Server *server, const AddNodesBatch *batch,
+                            const UA_NodeId *referenceTypeId) {
+    const UA_NodeId hierarchicalReference =
+        UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    if(UA_TypeIndex_isSubtype(&server->typeIndex, referenceTypeId, &hierarchicalReference))
+        return true;
+    if(!batch)
+        return false;
+    for(size_t steps = 0; steps < batch->itemsSize; ++steps) {
+        size_t item = findBatchItem(batch, referenceTypeId);
+        if(item == batch->itemsSize ||
+           batch->results[item].statusCode != UA_STATUSCODE_GOOD ||
+           batch->items[item].nodeClass != UA_NODECLASS_REFERENCETYPE)
+            return false;
+        referenceTypeId = &batch->items[item].parentNodeId.nodeId;
+        if(UA_TypeIndex_isSubtype(&server->typeIndex, referenceTypeId,
+                                  &hierarchicalReference))
+            return true;
+    }
+    return false;
+}
+
 /* Check if the requested parent node exists, has the right node class and is
  * referenced with an allowed (hierarchical) reference type. For "type" nodes,
- * only hasSubType references are allowed. */
+ * only hasSubType references are allowed. The batch is NULL for single
+ * nodes. */
 static UA_StatusCode
-checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeClass,
-                     const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId) {
+checkParentReference(UA_Server *server, UA_Session *session, const AddNodesBatch *batch,
+                     UA_NodeClass nodeClass, const UA_NodeId *parentNodeId,
+                     const UA_NodeId *referenceTypeId) {
     /* Objects do not need a parent (e.g. mandatory/optional modellingrules) */
     if(nodeClass == UA_NODECLASS_OBJECT && UA_NodeId_isNull(parentNodeId) &&
        UA_NodeId_isNull(referenceTypeId))
         return UA_STATUSCODE_GOOD;
 
     /* See if the parent exists */
-    const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
+    const UA_Node *parent = getNewOrExistingNode(server, batch, parentNodeId);
     if(!parent) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Parent node not found");
@@ -46,7 +126,7 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
 
     /* Check the referencetype exists */
     const UA_ReferenceTypeNode *referenceType =
-        (const UA_ReferenceTypeNode*)UA_NodeStore_get(server->nodestore, referenceTypeId);
+        (const UA_ReferenceTypeNode*)getNewOrExistingNode(server, batch, referenceTypeId);
     if(!referenceType) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Reference type to the parent not found");
@@ -91,10 +171,7 @@ checkParentReference(UA_Server *server, UA_Session *session, UA_NodeClass nodeCl
     }
 
     /* Test if the referencetype is hierarchical */
-    const UA_NodeId hierarchicalReference =
-        UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
-    if(!isNodeInTree(server->nodestore, referenceTypeId,
-                     &hierarchicalReference, &subtypeId, 1)) {
+    if(!isHierarchicalReferenceType(server, batch, referenceTypeId)) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Reference type is not hierarchical");
         return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
@@ -359,17 +436,7 @@ mandatoryChild(UA_Server *server, UA_Session *session, const UA_NodeId *childNod
         return false;
 
     /* Look for the reference making the child mandatory */
-    for(size_t i = 0; i < child->referencesSize; ++i) {
-        UA_ReferenceNode *ref = &child->references[i];
-        if(!UA_NodeId_equal(&hasModellingRuleId, &ref->referenceTypeId))
-            continue;
-        if(!UA_NodeId_equal(&mandatoryId, &ref->targetId.nodeId))
-            continue;
-        if(ref->isInverse)
-            continue;
-        return true;
-    }
-    return false;
+    return UA_Node_findReference(child, &hasModellingRuleId, &mandatoryId, false) != NULL;
 }
 
 /* Copy any children of Node sourceNodeId to another node destinationNodeId
@@ -463,6 +530,42 @@ copyChildNodesToNode(UA_Server* server, UA_Session* session,
     return retval;
 }
 
+/* Instantiate variables and objects from the type definition and call the
+ * custom callback */
+static UA_StatusCode
+instantiateNewNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
+                   UA_NodeClass nodeClass, const UA_NodeId *typeDefinition,
+                   UA_InstantiationCallback *instantiationCallback) {
+    /* Fall back to a default typedefinition for variables and objects */
+    const UA_NodeId basedatavariabletype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+    const UA_NodeId baseobjecttype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
+    if(nodeClass == UA_NODECLASS_VARIABLE ||
+       nodeClass == UA_NODECLASS_OBJECT) {
+        if(!typeDefinition || UA_NodeId_isNull(typeDefinition)) {
+            if(nodeClass == UA_NODECLASS_VARIABLE)
+                typeDefinition = &basedatavariabletype;
+            else
+                typeDefinition = &baseobjecttype;
+        }
+
+        /* Instantiate variables and objects */
+        UA_StatusCode retval = instantiateNode(server, session, nodeId, nodeClass,
+                                               typeDefinition, instantiationCallback);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_INFO_SESSION(server->config.logger, session,
+                                "AddNodes: Could not instantiate the node with"
+                                "error code %s", UA_StatusCode_name(retval));
+            return retval;
+        }
+    }
+
+    /* Custom callback */
+    if(instantiationCallback)
+        instantiationCallback->method(*nodeId, *typeDefinition,
+                                      instantiationCallback->handle);
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_StatusCode
 Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
                           const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
@@ -474,18 +577,18 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
     /* Check the namespaceindex */
     if(node->nodeId.namespaceIndex >= server->namespacesSize) {
         UA_LOG_INFO_SESSION(server->config.logger, session, "AddNodes: Namespace invalid");
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return UA_STATUSCODE_BADNODEIDINVALID;
     }
 
     /* Check the reference to the parent */
-    UA_StatusCode retval = checkParentReference(server, session, node->nodeClass,
+    UA_StatusCode retval = checkParentReference(server, session, NULL, node->nodeClass,
                                                 parentNodeId, referenceTypeId);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_INFO_SESSION(server->config.logger, session,
                             "AddNodes: Checking the reference to the parent returned "
                             "error code %s", UA_StatusCode_name(retval));
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return retval;
     }
 
@@ -525,33 +628,10 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
         }
     }
 
-    /* Fall back to a default typedefinition for variables and objects */
-    const UA_NodeId basedatavariabletype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
-    const UA_NodeId baseobjecttype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
-    if(node->nodeClass == UA_NODECLASS_VARIABLE ||
-       node->nodeClass == UA_NODECLASS_OBJECT) {
-        if(!typeDefinition || UA_NodeId_isNull(typeDefinition)) {
-            if(node->nodeClass == UA_NODECLASS_VARIABLE)
-                typeDefinition = &basedatavariabletype;
-            else
-                typeDefinition = &baseobjecttype;
-        }
-
-        /* Instantiate variables and objects */
-        retval = instantiateNode(server, session, &node->nodeId, node->nodeClass,
-                                 typeDefinition, instantiationCallback);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_INFO_SESSION(server->config.logger, session,
-                                "AddNodes: Could not instantiate the node with"
-                                "error code %s", UA_StatusCode_name(retval));
-            goto remove_node;
-        }
-    }
-
-    /* Custom callback */
-    if(instantiationCallback)
-        instantiationCallback->method(node->nodeId, *typeDefinition,
-                                      instantiationCallback->handle);
+    retval = instantiateNewNode(server, session, &node->nodeId, node->nodeClass,
+                                typeDefinition, instantiationCallback);
+    if(retval != UA_STATUSCODE_GOOD)
+        goto remove_node;
     return UA_STATUSCODE_GOOD;
 
  remove_node:
@@ -736,7 +816,7 @@ createNodeFromAttributes(UA_Server *server, const UA_AddNodesItem *item, UA_Node
 
     /* Create the node */
     // todo: error case where the nodeclass is faulty
-    void *node = UA_NodeStore_newNode(item->nodeClass);
+    void *node = UA_NodeStore_newNode(server->nodestore, item->nodeClass);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -781,7 +861,7 @@ createNodeFromAttributes(UA_Server *server, const UA_AddNodesItem *item, UA_Node
     if(retval == UA_STATUSCODE_GOOD)
         *newNode = node;
     else
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
     return retval;
 }
 
@@ -811,6 +891,327 @@ Service_AddNodes_single(UA_Server *server, UA_Session *session,
     }
 }
 
+/****************************/
+/* Add Many Nodes (in Bulk) */
+/****************************/
+
+/* Many nodes are added in phases. First, all nodes are created and checked.
+ * The parents and reference types are looked up in the nodestore and in the
+ * batch. So they can be added in the same batch in any order. Then the valid
+ * nodes are inserted with a single rehash of the nodestore. The references of
+ * all children of a parent are added with a single edit of the parent node.
+ * Finally, the nodes are instantiated from their type definition. Nodes that
+ * fail in a later phase are removed again, together with their children from
+ * the batch. */
+
+static int
+compareHashedItems(const void *a, const void *b) {
+    const HashedItem *ha = (const HashedItem*)a;
+    const HashedItem *hb = (const HashedItem*)b;
+    if(ha->hash != hb->hash)
+        return (ha->hash < hb->hash) ? -1 : 1;
+    /* Keep the order of the items for the same hash */
+    if(ha->item != hb->item)
+        return (ha->item < hb->item) ? -1 : 1;
+    return 0;
+}
+
+/* A fresh NodeId is assigned for null identifiers during the insertion */
+static UA_Boolean
+hasRequestedNodeId(const UA_NodeId *nodeId) {
+    UA_NodeId id = *nodeId;
+    id.namespaceIndex = 0;
+    return !UA_NodeId_isNull(&id);
+}
+
+/* The parents from the batch must lead to a node in the address space */
+static UA_Boolean
+reachesAddressSpace(UA_Server *server, const AddNodesBatch *batch, size_t item) {
+    for(size_t steps = 0; steps < batch->itemsSize; ++steps) {
+        const UA_NodeId *parentId = &batch->items[item].parentNodeId.nodeId;
+        if(UA_NodeId_isNull(parentId) || UA_NodeStore_get(server->nodestore, parentId))
+            return true;
+        item = findBatchItem(batch, parentId);
+        if(item == batch->itemsSize)
+            return false;
+    }
+    return false; /* cycle */
+}
+
+static void
+checkBatch(UA_Server *server, UA_Session *session, AddNodesBatch *batch) {
+    const UA_AddNodesItem *items = batch->items;
+    UA_AddNodesResult *results = batch->results;
+
+    /* Requested NodeIds must be new */
+    for(size_t i = 0; i < batch->itemsSize; ++i) {
+        if(results[i].statusCode != UA_STATUSCODE_GOOD ||
+           !hasRequestedNodeId(&batch->nodes[i]->nodeId))
+            continue;
+        if(UA_NodeStore_get(server->nodestore, &batch->nodes[i]->nodeId) ||
+           findBatchItem(batch, &batch->nodes[i]->nodeId) != i)
+            results[i].statusCode = UA_STATUSCODE_BADNODEIDEXISTS;
+    }
+
+    /* Repeat until no more items fail. Then all parents and reference types
+     * from the batch are valid. */
+    UA_Boolean changed;
+    do {
+        changed = false;
+        for(size_t i = 0; i < batch->itemsSize; ++i) {
+            if(results[i].statusCode != UA_STATUSCODE_GOOD)
+                continue;
+            UA_StatusCode retval =
+                checkParentReference(server, session, batch, items[i].nodeClass,
+                                     &items[i].parentNodeId.nodeId, &items[i].referenceTypeId);
+            if(retval == UA_STATUSCODE_GOOD && !reachesAddressSpace(server, batch, i))
+                retval = UA_STATUSCODE_BADPARENTNODEIDINVALID;
+            if(retval != UA_STATUSCODE_GOOD) {
+                results[i].statusCode = retval;
+                changed = true;
+            }
+        }
+    } while(changed);
+}
+
+typedef struct {
+    const UA_AddNodesItem *items;
+    UA_AddNodesResult *results;
+    const size_t *children;
+    size_t childrenSize;
+} ParentReferences;
+
+static UA_StatusCode
+addParentReferences(UA_Server *server, UA_Session *session, UA_Node *parent,
+                    const ParentReferences *refs) {
+    UA_AddReferencesItem item;
+    UA_AddReferencesItem_init(&item);
+    item.sourceNodeId = parent->nodeId;
+    item.isForward = true;
+    for(size_t i = 0; i < refs->childrenSize; ++i) {
+        size_t c = refs->children[i];
+        item.referenceTypeId = refs->items[c].referenceTypeId;
+        item.targetNodeId.nodeId = refs->results[c].addedNodeId;
+        refs->results[c].statusCode = addOneWayReference(server, session, parent, &item);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+removeAddedNode(UA_Server *server, UA_AddNodesResult *result) {
+    deleteNode(server, &adminSession, &result->addedNodeId, true);
+    UA_NodeId_deleteMembers(&result->addedNodeId);
+}
+
+/* Removes the nodes whose parent from the batch was removed again */
+static void
+removeOrphans(UA_Server *server, const AddNodesBatch *batch) {
+    UA_Boolean changed;
+    do {
+        changed = false;
+        for(size_t i = 0; i < batch->itemsSize; ++i) {
+            const UA_NodeId *parentId = &batch->items[i].parentNodeId.nodeId;
+            if(batch->results[i].statusCode != UA_STATUSCODE_GOOD ||
+               UA_NodeId_isNull(parentId) || UA_NodeStore_get(server->nodestore, parentId))
+                continue;
+            batch->results[i].statusCode = UA_STATUSCODE_BADPARENTNODEIDINVALID;
+            removeAddedNode(server, &batch->results[i]);
+            changed = true;
+        }
+    } while(changed);
+}
+
+static void
+addNodesReferences(UA_Server *server, UA_Session *session, size_t itemsSize,
+                   const UA_AddNodesItem *items, UA_AddNodesResult *results,
+                   HashedItem *parents, size_t *children) {
+    /* The references of the children to the parent. The children are new and
+     * have no other references yet. */
+    size_t parentsSize = 0;
+    for(size_t i = 0; i < itemsSize; ++i) {
+        if(results[i].statusCode != UA_STATUSCODE_GOOD ||
+           UA_NodeId_isNull(&items[i].parentNodeId.nodeId))
+            continue;
+        UA_AddReferencesItem item;
+        UA_AddReferencesItem_init(&item);
+        item.sourceNodeId = results[i].addedNodeId;
+        item.referenceTypeId = items[i].referenceTypeId;
+        item.isForward = false;
+        item.targetNodeId.nodeId = items[i].parentNodeId.nodeId;
+        results[i].statusCode = UA_Server_editNode(server, session, &item.sourceNodeId,
+                                                   (UA_EditNodeCallback)addOneWayReference,
+                                                   &item);
+        if(results[i].statusCode != UA_STATUSCODE_GOOD) {
+            removeAddedNode(server, &results[i]);
+            continue;
+        }
+        parents[parentsSize].hash = UA_NodeId_hash(&items[i].parentNodeId.nodeId);
+        parents[parentsSize].item = i;
+        ++parentsSize;
+    }
+
+    /* Group the children by the parent */
+    qsort(parents, parentsSize, sizeof(HashedItem), compareHashedItems);
+    for(size_t i = 0; i < parentsSize; ++i) {
+        if(parents[i].item == itemsSize)
+            continue; /* already done */
+        const UA_NodeId *parentId = &items[parents[i].item].parentNodeId.nodeId;
+        ParentReferences refs = {items, results, children, 0};
+        for(size_t j = i; j < parentsSize && parents[j].hash == parents[i].hash; ++j) {
+            if(parents[j].item == itemsSize ||
+               !UA_NodeId_equal(&items[parents[j].item].parentNodeId.nodeId, parentId))
+                continue;
+            children[refs.childrenSize++] = parents[j].item;
+            if(j > i)
+                parents[j].item = itemsSize;
+        }
+        UA_StatusCode retval = UA_Server_editNode(server, session, parentId,
+                                                  (UA_EditNodeCallback)addParentReferences,
+                                                  &refs);
+        for(size_t j = 0; j < refs.childrenSize; ++j) {
+            UA_AddNodesResult *result = &results[children[j]];
+            if(retval != UA_STATUSCODE_GOOD)
+                result->statusCode = retval;
+            if(result->statusCode != UA_STATUSCODE_GOOD)
+                removeAddedNode(server, result);
+        }
+    }
+}
+
+/* Is the item a member of a type that is added in the same batch? */
+static UA_Boolean
+isBatchTypeMember(const AddNodesBatch *batch, size_t item) {
+    for(size_t steps = 0; steps < batch->itemsSize; ++steps) {
+        item = findBatchItem(batch, &batch->items[item].parentNodeId.nodeId);
+        if(item == batch->itemsSize)
+            return false;
+        if(batch->items[item].nodeClass == UA_NODECLASS_OBJECTTYPE ||
+           batch->items[item].nodeClass == UA_NODECLASS_VARIABLETYPE)
+            return true;
+    }
+    return false;
+}
+
+/* Instances copy the members of their type definition. So the members of types
+ * from the batch are instantiated first. Then the other nodes follow in the
+ * order of the items. */
+static void
+instantiateBatch(UA_Server *server, UA_Session *session, const AddNodesBatch *batch,
+                 UA_InstantiationCallback *instantiationCallback) {
+    for(size_t round = 0; round < 2; ++round) {
+        for(size_t i = 0; i < batch->itemsSize; ++i) {
+            UA_AddNodesResult *result = &batch->results[i];
+            if(result->statusCode != UA_STATUSCODE_GOOD ||
+               isBatchTypeMember(batch, i) != (round == 0))
+                continue;
+            result->statusCode =
+                instantiateNewNode(server, session, &result->addedNodeId,
+                                   batch->items[i].nodeClass,
+                                   &batch->items[i].typeDefinition.nodeId,
+                                   instantiationCallback);
+            if(result->statusCode != UA_STATUSCODE_GOOD) {
+                removeAddedNode(server, result);
+                removeOrphans(server, batch);
+            }
+        }
+    }
+}
+
+static void
+addNodesBulk(UA_Server *server, UA_Session *session, AddNodesBatch *batch,
+             HashedItem *parents, size_t *children,
+             UA_InstantiationCallback *instantiationCallback) {
+    const UA_AddNodesItem *items = batch->items;
+    UA_AddNodesResult *results = batch->results;
+
+    /* Create the nodes */
+    for(size_t i = 0; i < batch->itemsSize; ++i) {
+        results[i].statusCode = createNodeFromAttributes(server, &items[i], &batch->nodes[i]);
+        if(results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        if(batch->nodes[i]->nodeId.namespaceIndex >= server->namespacesSize) {
+            results[i].statusCode = UA_STATUSCODE_BADNODEIDINVALID;
+            continue;
+        }
+        if(!hasRequestedNodeId(&batch->nodes[i]->nodeId))
+            continue;
+        batch->sorted[batch->sortedSize].hash = UA_NodeId_hash(&batch->nodes[i]->nodeId);
+        batch->sorted[batch->sortedSize].item = i;
+        ++batch->sortedSize;
+    }
+    qsort(batch->sorted, batch->sortedSize, sizeof(HashedItem), compareHashedItems);
+
+    /* Check the nodes before any is inserted */
+    checkBatch(server, session, batch);
+
+    /* Insert the valid nodes. Reserving space can fail. Then the nodestore
+     * grows during the insertion. */
+    size_t valid = 0;
+    for(size_t i = 0; i < batch->itemsSize; ++i) {
+        if(results[i].statusCode == UA_STATUSCODE_GOOD)
+            ++valid;
+    }
+    UA_NodeStore_reserve(server->nodestore, valid);
+    for(size_t i = 0; i < batch->itemsSize; ++i) {
+        UA_Node *node = batch->nodes[i];
+        if(!node)
+            continue;
+        batch->nodes[i] = NULL;
+        if(results[i].statusCode != UA_STATUSCODE_GOOD) {
+            UA_NodeStore_deleteNode(server->nodestore, node);
+            continue;
+        }
+        results[i].statusCode = UA_NodeStore_insert(server->nodestore, node); /* deletes on failure */
+        if(results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        results[i].statusCode = UA_NodeId_copy(&node->nodeId, &results[i].addedNodeId);
+        if(results[i].statusCode != UA_STATUSCODE_GOOD)
+            UA_NodeStore_remove(server->nodestore, &node->nodeId);
+    }
+    removeOrphans(server, batch);
+
+    /* Add the references and instantiate */
+    addNodesReferences(server, session, batch->itemsSize, items, results, parents, children);
+    removeOrphans(server, batch);
+    instantiateBatch(server, session, batch, instantiationCallback);
+}
+
+UA_StatusCode
+UA_Server_addNodes(UA_Server *server, size_t itemsSize, const UA_AddNodesItem *items,
+                   UA_InstantiationCallback *instantiationCallback,
+                   UA_AddNodesResult *results) {
+    if(itemsSize == 0)
+        return UA_STATUSCODE_BADNOTHINGTODO;
+    for(size_t i = 0; i < itemsSize; ++i)
+        UA_AddNodesResult_init(&results[i]);
+
+    AddNodesBatch batch;
+    batch.itemsSize = itemsSize;
+    batch.items = items;
+    batch.results = results;
+    batch.nodes = UA_calloc(itemsSize, sizeof(UA_Node*));
+    batch.sortedSize = 0;
+    batch.sorted = UA_malloc(sizeof(HashedItem) * itemsSize);
+    HashedItem *parents = UA_malloc(sizeof(HashedItem) * itemsSize);
+    size_t *children = UA_malloc(sizeof(size_t) * itemsSize);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(!batch.nodes || !batch.sorted || !parents || !children) {
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto cleanup;
+    }
+
+    UA_RCU_LOCK();
+    addNodesBulk(server, &adminSession, &batch, parents, children, instantiationCallback);
+    UA_RCU_UNLOCK();
+
+ cleanup:
+    UA_free(batch.nodes);
+    UA_free(batch.sorted);
+    UA_free(parents);
+    UA_free(children);
+    return retval;
+}
+
 void Service_AddNodes(UA_Server *server, UA_Session *session,
                       const UA_AddNodesRequest *request,
                       UA_AddNodesResponse *response) {
@@ -881,24 +1282,25 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
                                     const UA_VariableAttributes attr, const UA_DataSource dataSource,
                                     UA_NodeId *outNewNodeId) {
     /* Create the new node */
-    UA_VariableNode *node = UA_NodeStore_newVariableNode();
+    UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
-    /* Read the current value (to do typechecking) */
+    /* Read the current value (to do typechecking). Data sources without a
+     * read callback (their extension is set later on) are typechecked with the
+     * value from the attributes. */
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_VariableAttributes editAttr = attr;
     UA_DataValue value;
     UA_DataValue_init(&value);
-    if(dataSource.read)
+    if(dataSource.read) {
         retval = dataSource.read(dataSource.handle, requestedNewNodeId,
                                  false, NULL, &value);
-    else
-        retval = UA_STATUSCODE_BADTYPEMISMATCH;
-    editAttr.value = value.value;
+        editAttr.value = value.value;
+    }
 
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)node);
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)node);
         return retval;
     }
 
@@ -914,10 +1316,11 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
     retval |= copyVariableNodeAttributes(server, node, &item, &editAttr);
     UA_DataValue_deleteMembers(&node->value.data.value);
     node->valueSource = UA_VALUESOURCE_DATASOURCE;
-    node->value.dataSource = dataSource;
+    memset(&node->value.source, 0, sizeof(node->value.source));
+    node->value.source.dataSource = dataSource;
     UA_DataValue_deleteMembers(&value);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)node);
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)node);
         UA_RCU_UNLOCK();
         return retval;
     }
@@ -941,7 +1344,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                         size_t inputArgumentsSize, const UA_Argument* inputArguments,
                         size_t outputArgumentsSize, const UA_Argument* outputArguments,
                         UA_NodeId *outNewNodeId) {
-    UA_MethodNode *node = UA_NodeStore_newMethodNode();
+    UA_MethodNode *node = UA_NodeStore_newMethodNode(server->nodestore);
     if(!node)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
@@ -969,7 +1372,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
     const UA_NodeId propertytype = UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE);
 
     if(inputArgumentsSize > 0) {
-        UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode();
+        UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode(server->nodestore);
         inputArgumentsVariableNode->nodeId.namespaceIndex = newMethodId.namespaceIndex;
         inputArgumentsVariableNode->browseName = UA_QUALIFIEDNAME_ALLOC(0, "InputArguments");
         inputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "InputArguments");
@@ -1001,7 +1404,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
 
     if(outputArgumentsSize > 0) {
         /* create OutputArguments */
-        UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode();
+        UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode(server->nodestore);
         outputArgumentsVariableNode->nodeId.namespaceIndex = newMethodId.namespaceIndex;
         outputArgumentsVariableNode->browseName  = UA_QUALIFIEDNAME_ALLOC(0, "OutputArguments");
         outputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OutputArguments");
@@ -1042,25 +1445,63 @@ static UA_StatusCode
 deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
                       const UA_DeleteReferencesItem *item);
 
+static UA_Boolean
+isHasSubtype(const UA_NodeId *referenceTypeId) {
+    return referenceTypeId->namespaceIndex == 0 &&
+        referenceTypeId->identifierType == UA_NODEIDTYPE_NUMERIC &&
+        referenceTypeId->identifier.numeric == UA_NS0ID_HASSUBTYPE;
+}
+
+/* Adds a reference to the node without checking for duplicates. The nameHash
+ * is the hash of the target's browse name for forward references. */
+static UA_StatusCode
+addReferenceWithName(UA_Server *server, UA_Node *node, const UA_NodeId *referenceTypeId,
+                     const UA_ExpandedNodeId *targetId, UA_Boolean isForward,
+                     UA_UInt32 nameHash) {
+    /* The kind stores the position of the reference type in the type index. If
+     * the type cannot be added, the kind falls back to the NodeId. */
+    UA_UInt32 referenceTypeIndex;
+    if(UA_TypeIndex_addType(&server->typeIndex, referenceTypeId,
+                            &referenceTypeIndex) != UA_STATUSCODE_GOOD)
+        referenceTypeIndex = UA_TYPEINDEX_NOTFOUND;
+    UA_StatusCode retval = UA_Node_addReference(node, referenceTypeId, referenceTypeIndex,
+                                                targetId, !isForward, nameHash);
+    if(retval != UA_STATUSCODE_GOOD || !isHasSubtype(referenceTypeId))
+        return retval;
+    if(isForward)
+        retval = UA_TypeIndex_addSubtype(&server->typeIndex, &node->nodeId,
+                                         &targetId->nodeId);
+    else
+        retval = UA_TypeIndex_addSubtype(&server->typeIndex, &targetId->nodeId,
+                                         &node->nodeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_Node_deleteReference(node, referenceTypeId, &targetId->nodeId, !isForward);
+    return retval;
+}
+
 /* Adds a one-way reference to the local nodestore */
 static UA_StatusCode
 addOneWayReference(UA_Server *server, UA_Session *session,
                    UA_Node *node, const UA_AddReferencesItem *item) {
-    size_t i = node->referencesSize;
-    size_t refssize = (i+1) | 3; // so the realloc is not necessary every time
-    UA_ReferenceNode *new_refs = UA_realloc(node->references, sizeof(UA_ReferenceNode) * refssize);
-    if(!new_refs)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    node->references = new_refs;
-    UA_ReferenceNode_init(&new_refs[i]);
-    UA_StatusCode retval = UA_NodeId_copy(&item->referenceTypeId, &new_refs[i].referenceTypeId);
-    retval |= UA_ExpandedNodeId_copy(&item->targetNodeId, &new_refs[i].targetId);
-    new_refs[i].isInverse = !item->isForward;
-    if(retval == UA_STATUSCODE_GOOD)
-        node->referencesSize = i+1;
-    else
-        UA_ReferenceNode_deleteMembers(&new_refs[i]);
-    return retval;
+    if(UA_Node_findReference(node, &item->referenceTypeId,
+                             &item->targetNodeId.nodeId, !item->isForward))
+        return UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED;
+    if(node->nodeClass == UA_NODECLASS_METHOD) {
+        /* The arguments are resolved again with the next call */
+        UA_MethodArgumentsCache_delete(((UA_MethodNode*)node)->arguments);
+        ((UA_MethodNode*)node)->arguments = NULL;
+    }
+
+    /* Forward references to local nodes are indexed by the browse name of the
+     * target for TranslateBrowsePathsToNodeIds */
+    UA_UInt32 nameHash = 0;
+    if(item->isForward && item->targetNodeId.serverIndex == 0) {
+        const UA_Node *target = UA_NodeStore_get(server->nodestore, &item->targetNodeId.nodeId);
+        if(target)
+            nameHash = UA_Node_browseNameHash(&target->browseName);
+    }
+    return addReferenceWithName(server, node, &item->referenceTypeId, &item->targetNodeId,
+                                item->isForward, nameHash);
 }
 
 static UA_StatusCode
@@ -1144,6 +1585,303 @@ UA_Server_addReference(UA_Server *server, const UA_NodeId sourceId,
     return retval;
 }
 
+typedef struct {
+    const UA_NodeId *referenceTypeId;
+    const UA_NodeId *targetId;
+    UA_UInt32 nameHash;
+} ReferenceName;
+
+static UA_StatusCode
+setReferenceName(UA_Server *server, UA_Session *session, UA_Node *node,
+                 const ReferenceName *name) {
+    return UA_Node_setReferenceName(node, name->referenceTypeId, name->targetId,
+                                    false, name->nameHash);
+}
+
+/* Sets the name hash in the forward references to the node */
+static void
+setIncomingReferenceNames(UA_Server *server, UA_Session *session,
+                          const UA_Node *node, UA_UInt32 nameHash) {
+    ReferenceName name;
+    name.targetId = &node->nodeId;
+    name.nameHash = nameHash;
+    for(size_t k = 0; k < node->referenceIndex.kindsSize; ++k) {
+        const UA_ReferenceKind *kind = &node->referenceIndex.kinds[k];
+        if(!kind->isInverse)
+            continue;
+        name.referenceTypeId = &kind->referenceTypeId;
+        for(size_t i = kind->referencesStart; i < kind->referencesStart + kind->referencesSize; ++i) {
+            const UA_NodeReference *ref = &node->references[i];
+            if(ref->targetId.serverIndex != 0)
+                continue;
+            UA_Server_editNode(server, session, &ref->targetId.nodeId,
+                               (UA_EditNodeCallback)setReferenceName, &name);
+        }
+    }
+}
+
+void
+UA_Server_updateReferenceNames(UA_Server *server, UA_Session *session, const UA_Node *node) {
+    setIncomingReferenceNames(server, session, node, UA_Node_browseNameHash(&node->browseName));
+}
+
+/**********************/
+/* Static Node Tables */
+/**********************/
+
+/* Open addressing with linear probing from the NodeId to the position in the
+ * table. The occupancy is at most 50%. */
+#define UA_STATICNODES_EMPTY (~(size_t)0)
+
+typedef struct {
+    size_t size; /* power of two */
+    size_t *slots;
+    const UA_StaticNode *nodes;
+} StaticNodeMap;
+
+static size_t
+staticNodeMapFind(const StaticNodeMap *map, const UA_NodeId *nodeId) {
+    size_t mask = map->size - 1;
+    for(size_t idx = UA_NodeId_hash(nodeId) & mask;
+        map->slots[idx] != UA_STATICNODES_EMPTY; idx = (idx + 1) & mask) {
+        if(UA_NodeId_equal(&map->nodes[map->slots[idx]].nodeId, nodeId))
+            return map->slots[idx];
+    }
+    return UA_STATICNODES_EMPTY;
+}
+
+static void
+staticNodeMapAdd(StaticNodeMap *map, size_t pos) {
+    size_t mask = map->size - 1;
+    size_t idx = UA_NodeId_hash(&map->nodes[pos].nodeId) & mask;
+    while(map->slots[idx] != UA_STATICNODES_EMPTY)
+        idx = (idx + 1) & mask;
+    map->slots[idx] = pos;
+}
+
+/* Creates the node from the table entry. The nodestore interns the strings
+ * when the node is inserted. */
+static UA_StatusCode
+newStaticNode(UA_Server *server, const UA_StaticNode *sn, UA_Node **out) {
+    UA_Node *node = UA_NodeStore_newNode(server->nodestore, sn->nodeClass);
+    if(!node)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = UA_NodeId_copy(&sn->nodeId, &node->nodeId);
+    retval |= UA_QualifiedName_copy(&sn->browseName, &node->browseName);
+    retval |= UA_LocalizedText_copy(&sn->displayName, &node->displayName);
+    retval |= UA_LocalizedText_copy(&sn->description, &node->description);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, node);
+        return retval;
+    }
+    node->writeMask = sn->writeMask;
+    node->userWriteMask = sn->userWriteMask;
+
+    switch(sn->nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        ((UA_ObjectNode*)node)->eventNotifier = sn->eventNotifier;
+        break;
+    case UA_NODECLASS_VARIABLE: {
+        UA_VariableNode *vnode = (UA_VariableNode*)node;
+        vnode->valueRank = sn->valueRank;
+        vnode->accessLevel = sn->accessLevel;
+        vnode->userAccessLevel = sn->userAccessLevel;
+        vnode->minimumSamplingInterval = sn->minimumSamplingInterval;
+        vnode->historizing = sn->historizing;
+        break;
+    }
+    case UA_NODECLASS_METHOD:
+        ((UA_MethodNode*)node)->executable = sn->executable;
+        ((UA_MethodNode*)node)->userExecutable = sn->userExecutable;
+        break;
+    case UA_NODECLASS_OBJECTTYPE:
+        ((UA_ObjectTypeNode*)node)->isAbstract = sn->isAbstract;
+        break;
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableTypeNode *vtnode = (UA_VariableTypeNode*)node;
+        vtnode->valueRank = sn->valueRank;
+        vtnode->isAbstract = sn->isAbstract;
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeNode *rtnode = (UA_ReferenceTypeNode*)node;
+        rtnode->isAbstract = sn->isAbstract;
+        rtnode->symmetric = sn->symmetric;
+        retval = UA_LocalizedText_copy(&sn->inverseName, &rtnode->inverseName);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE:
+        ((UA_DataTypeNode*)node)->isAbstract = sn->isAbstract;
+        break;
+    case UA_NODECLASS_VIEW:
+        ((UA_ViewNode*)node)->eventNotifier = sn->eventNotifier;
+        ((UA_ViewNode*)node)->containsNoLoops = sn->containsNoLoops;
+        break;
+    default:
+        retval = UA_STATUSCODE_BADNODECLASSINVALID;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, node);
+        return retval;
+    }
+    *out = node;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The DataType is set when all nodes of the table are created. Unknown
+ * DataTypes fall back to BaseDataType as if the DataType were not defined. */
+static UA_StatusCode
+setStaticDataType(UA_Server *server, const StaticNodeMap *map, UA_Node *node,
+                  const UA_StaticNode *sn) {
+    UA_NodeId *dataType;
+    if(node->nodeClass == UA_NODECLASS_VARIABLE)
+        dataType = &((UA_VariableNode*)node)->dataType;
+    else if(node->nodeClass == UA_NODECLASS_VARIABLETYPE)
+        dataType = &((UA_VariableTypeNode*)node)->dataType;
+    else
+        return UA_STATUSCODE_GOOD;
+    if(UA_NodeId_isNull(&sn->dataType) ||
+       (staticNodeMapFind(map, &sn->dataType) == UA_STATICNODES_EMPTY &&
+        !UA_NodeStore_get(server->nodestore, &sn->dataType))) {
+        *dataType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATATYPE);
+        return UA_STATUSCODE_GOOD;
+    }
+    return UA_NodeId_copy(&sn->dataType, dataType);
+}
+
+/* Adds the reference to the source node and, if the target is in the table,
+ * the inverse reference to the target node. References to nodes outside the
+ * table are completed after the nodes are inserted. */
+static UA_StatusCode
+addStaticReference(UA_Server *server, const StaticNodeMap *map, UA_Node **nodes,
+                   UA_Node *node, const UA_StaticReference *sr) {
+    UA_Node *target = NULL;
+    const UA_QualifiedName *targetName;
+    size_t pos = staticNodeMapFind(map, &sr->targetId);
+    if(pos != UA_STATICNODES_EMPTY) {
+        target = nodes[pos];
+        targetName = &target->browseName;
+    } else {
+        const UA_Node *external = UA_NodeStore_get(server->nodestore, &sr->targetId);
+        if(!external)
+            return UA_STATUSCODE_GOOD; /* skip */
+        targetName = &external->browseName;
+    }
+
+    UA_ExpandedNodeId targetId;
+    UA_ExpandedNodeId_init(&targetId);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(!UA_Node_findReference(node, &sr->referenceTypeId, &sr->targetId, !sr->isForward)) {
+        targetId.nodeId = sr->targetId;
+        retval = addReferenceWithName(server, node, &sr->referenceTypeId, &targetId,
+                                      sr->isForward, sr->isForward ?
+                                      UA_Node_browseNameHash(targetName) : 0);
+    }
+    if(retval != UA_STATUSCODE_GOOD || !target ||
+       UA_Node_findReference(target, &sr->referenceTypeId, &node->nodeId, sr->isForward))
+        return retval;
+    targetId.nodeId = node->nodeId;
+    return addReferenceWithName(server, target, &sr->referenceTypeId, &targetId,
+                                !sr->isForward, !sr->isForward ?
+                                UA_Node_browseNameHash(&node->browseName) : 0);
+}
+
+UA_StatusCode
+UA_Server_addStaticNodes(UA_Server *server, size_t nodesSize, const UA_StaticNode *nodes) {
+    if(nodesSize == 0)
+        return UA_STATUSCODE_BADNOTHINGTODO;
+
+    StaticNodeMap map;
+    map.nodes = nodes;
+    map.size = 1;
+    while(map.size < nodesSize * 2)
+        map.size <<= 1;
+    map.slots = UA_malloc(sizeof(size_t) * map.size);
+    UA_Node **created = UA_calloc(nodesSize, sizeof(UA_Node*));
+    if(!map.slots || !created) {
+        UA_free(map.slots);
+        UA_free(created);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    memset(map.slots, 0xff, sizeof(size_t) * map.size); /* UA_STATICNODES_EMPTY */
+
+    UA_RCU_LOCK();
+    UA_StatusCode result = UA_NodeStore_reserve(server->nodestore, nodesSize);
+
+    /* Create the nodes */
+    UA_StatusCode retval;
+    for(size_t i = 0; i < nodesSize; ++i) {
+        const UA_StaticNode *sn = &nodes[i];
+        if(sn->nodeId.namespaceIndex >= server->namespacesSize)
+            retval = UA_STATUSCODE_BADNODEIDINVALID;
+        else if(staticNodeMapFind(&map, &sn->nodeId) != UA_STATICNODES_EMPTY ||
+                UA_NodeStore_get(server->nodestore, &sn->nodeId))
+            retval = UA_STATUSCODE_BADNODEIDEXISTS;
+        else
+            retval = newStaticNode(server, sn, &created[i]);
+        if(retval == UA_STATUSCODE_GOOD)
+            staticNodeMapAdd(&map, i);
+        else if(result == UA_STATUSCODE_GOOD)
+            result = retval;
+    }
+
+    /* Add the references between the nodes before they are inserted. So the
+     * references within the table need no edits in the nodestore. */
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(!created[i])
+            continue;
+        retval = setStaticDataType(server, &map, created[i], &nodes[i]);
+        if(retval != UA_STATUSCODE_GOOD && result == UA_STATUSCODE_GOOD)
+            result = retval;
+        for(size_t j = 0; j < nodes[i].referencesSize; ++j) {
+            retval = addStaticReference(server, &map, created, created[i],
+                                        &nodes[i].references[j]);
+            if(retval != UA_STATUSCODE_GOOD && result == UA_STATUSCODE_GOOD)
+                result = retval;
+        }
+    }
+
+    /* Insert the nodes. The nodestore deletes the node if insertion fails. */
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(!created[i])
+            continue;
+        retval = UA_NodeStore_insert(server->nodestore, created[i]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            created[i] = NULL;
+            if(result == UA_STATUSCODE_GOOD)
+                result = retval;
+        }
+    }
+
+    /* Add the inverse references to nodes outside the table */
+    UA_AddReferencesItem item;
+    UA_AddReferencesItem_init(&item);
+    for(size_t i = 0; i < nodesSize; ++i) {
+        if(!created[i])
+            continue;
+        item.targetNodeId.nodeId = nodes[i].nodeId;
+        for(size_t j = 0; j < nodes[i].referencesSize; ++j) {
+            const UA_StaticReference *sr = &nodes[i].references[j];
+            if(staticNodeMapFind(&map, &sr->targetId) != UA_STATICNODES_EMPTY)
+                continue;
+            item.sourceNodeId = sr->targetId;
+            item.referenceTypeId = sr->referenceTypeId;
+            item.isForward = !sr->isForward;
+            retval = UA_Server_editNode(server, &adminSession, &item.sourceNodeId,
+                                        (UA_EditNodeCallback)addOneWayReference, &item);
+            if(retval != UA_STATUSCODE_GOOD && retval != UA_STATUSCODE_BADNODEIDUNKNOWN &&
+               retval != UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED &&
+               result == UA_STATUSCODE_GOOD)
+                result = retval;
+        }
+    }
+    UA_RCU_UNLOCK();
+
+    UA_free(map.slots);
+    UA_free(created);
+    return result;
+}
+
 /****************/
 /* Delete Nodes */
 /****************/
@@ -1153,11 +1891,14 @@ removeReferences(UA_Server *server, UA_Session *session, const UA_Node *node) {
     UA_DeleteReferencesItem item;
     UA_DeleteReferencesItem_init(&item);
     item.targetNodeId.nodeId = node->nodeId;
-    for(size_t i = 0; i < node->referencesSize; ++i) {
-        item.isForward = node->references[i].isInverse;
-        item.sourceNodeId = node->references[i].targetId.nodeId;
-        item.referenceTypeId = node->references[i].referenceTypeId;
-        deleteReference(server, session, &item);
+    for(size_t k = 0; k < node->referenceIndex.kindsSize; ++k) {
+        const UA_ReferenceKind *kind = &node->referenceIndex.kinds[k];
+        item.isForward = kind->isInverse;
+        item.referenceTypeId = kind->referenceTypeId;
+        for(size_t i = kind->referencesStart; i < kind->referencesStart + kind->referencesSize; ++i) {
+            item.sourceNodeId = node->references[i].targetId.nodeId;
+            deleteReference(server, session, &item);
+        }
     }
 }
 
@@ -1183,7 +1924,16 @@ deleteNode(UA_Server *server, UA_Session *session,
      * be deleted anyway) */
     if(deleteReferences)
         removeReferences(server, session, node);
+    else
+        /* The remaining references may point to a node with another name that
+         * is added with the same NodeId later on */
+        setIncomingReferenceNames(server, session, node, 0);
 
+    /* The node may be a property of a method */
+    UA_Server_invalidateMethodArguments(server, node);
+
+    UA_ReadCache_remove(&server->readCache, nodeId);
+    UA_TypeIndex_removeType(&server->typeIndex, nodeId);
     return UA_NodeStore_remove(server->nodestore, nodeId);
 }
 
@@ -1229,30 +1979,23 @@ UA_Server_deleteNode(UA_Server *server, const UA_NodeId nodeId,
 static UA_StatusCode
 deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
                       const UA_DeleteReferencesItem *item) {
-    UA_Boolean edited = false;
-    for(size_t i = node->referencesSize; i > 0; --i) {
-        UA_ReferenceNode *ref = &node->references[i-1];
-        if(!UA_NodeId_equal(&item->targetNodeId.nodeId, &ref->targetId.nodeId))
-            continue;
-        if(!UA_NodeId_equal(&item->referenceTypeId, &ref->referenceTypeId))
-            continue;
-        if(item->isForward == ref->isInverse)
-            continue;
-        UA_ReferenceNode_deleteMembers(ref);
-        /* move the last entry to override the current position */
-        node->references[i-1] = node->references[node->referencesSize-1];
-        --node->referencesSize;
-        edited = true;
-        break;
+    UA_StatusCode retval = UA_Node_deleteReference(node, &item->referenceTypeId,
+                                                   &item->targetNodeId.nodeId, !item->isForward);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(isHasSubtype(&item->referenceTypeId)) {
+        if(item->isForward)
+            UA_TypeIndex_removeSubtype(&server->typeIndex, &node->nodeId,
+                                       &item->targetNodeId.nodeId);
+        else
+            UA_TypeIndex_removeSubtype(&server->typeIndex, &item->targetNodeId.nodeId,
+                                       &node->nodeId);
     }
-    if(!edited)
-        return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
-    /* we removed the last reference */
-    if(node->referencesSize == 0 && node->references) {
-        UA_free(node->references);
-        node->references = NULL;
+    if(node->nodeClass == UA_NODECLASS_METHOD) {
+        UA_MethodArgumentsCache_delete(((UA_MethodNode*)node)->arguments);
+        ((UA_MethodNode*)node)->arguments = NULL;
     }
-    return UA_STATUSCODE_GOOD;;
+    return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
@@ -1347,9 +2090,11 @@ setDataSource(UA_Server *server, UA_Session *session,
     if(node->nodeClass != UA_NODECLASS_VARIABLE)
         return UA_STATUSCODE_BADNODECLASSINVALID;
     if(node->valueSource == UA_VALUESOURCE_DATA)
-        UA_DataValue_deleteMembers(&node->value.data.value);
-    node->value.dataSource = *dataSource;
+        UA_VariableNode_deleteValue(node);
+    memset(&node->value.source, 0, sizeof(node->value.source));
+    node->value.source.dataSource = *dataSource;
     node->valueSource = UA_VALUESOURCE_DATASOURCE;
+    UA_ReadCache_remove(&server->readCache, &node->nodeId);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -1359,6 +2104,35 @@ UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
     UA_RCU_LOCK();
     UA_StatusCode retval = UA_Server_editNode(server, &adminSession, &nodeId,
                                               (UA_EditNodeCallback)setDataSource, &dataSource);
+    /* Method arguments are not resolved from a data source */
+    if(retval == UA_STATUSCODE_GOOD) {
+        const UA_Node *node = UA_NodeStore_get(server->nodestore, &nodeId);
+        if(node)
+            UA_Server_invalidateMethodArguments(server, node);
+    }
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
+static UA_StatusCode
+setDataSourceExtension(UA_Server *server, UA_Session *session, UA_VariableNode* node,
+                       const UA_DataSourceExtension *extension) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    if(node->valueSource != UA_VALUESOURCE_DATASOURCE)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    node->value.source.extension = *extension;
+    UA_ReadCache_remove(&server->readCache, &node->nodeId);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setVariableNode_dataSourceExtension(UA_Server *server, const UA_NodeId nodeId,
+                                              const UA_DataSourceExtension extension) {
+    UA_RCU_LOCK();
+    UA_StatusCode retval =
+        UA_Server_editNode(server, &adminSession, &nodeId,
+                           (UA_EditNodeCallback)setDataSourceExtension, &extension);
     UA_RCU_UNLOCK();
     return retval;
 }
@@ -1420,4 +2194,32 @@ UA_Server_setMethodNode_callback(UA_Server *server, const UA_NodeId methodNodeId
     return retval;
 }
 
+struct addMethodCallbackAsync {
+    UA_MethodCallbackAsync callback;
+    void *handle;
+};
+
+static UA_StatusCode
+editMethodCallbackAsync(UA_Server *server, UA_Session* session,
+                        UA_Node* node, const void* handle) {
+    if(node->nodeClass != UA_NODECLASS_METHOD)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    const struct addMethodCallbackAsync *newCallback = handle;
+    UA_MethodNode *mnode = (UA_MethodNode*) node;
+    mnode->attachedMethodAsync = newCallback->callback;
+    mnode->methodHandle        = newCallback->handle;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setMethodNode_asyncCallback(UA_Server *server, const UA_NodeId methodNodeId,
+                                      UA_MethodCallbackAsync method, void *handle) {
+    struct addMethodCallbackAsync cb = { method, handle };
+    UA_RCU_LOCK();
+    UA_StatusCode retval = UA_Server_editNode(server, &adminSession,
+                                              &methodNodeId, editMethodCallbackAsync, &cb);
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
 #endif
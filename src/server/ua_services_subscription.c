@@ -44,6 +44,12 @@ setSubscriptionSettings(UA_Server *server, UA_Subscription *subscription,
     if(maxNotificationsPerPublish == 0 ||
        maxNotificationsPerPublish > server->config.maxNotificationsPerPublish)
         subscription->notificationsPerPublish = server->config.maxNotificationsPerPublish;
+    if(subscription->isReady && subscription->priority != priority) {
+        /* Move to the new position in the ready queue */
+        subscription->priority = priority;
+        UA_Session_unsetSubscriptionReady(subscription->session, subscription);
+        UA_Session_setSubscriptionReady(subscription->session, subscription);
+    }
     subscription->priority = priority;
 
     retval = Subscription_registerPublishJob(server, subscription);
@@ -205,7 +211,8 @@ Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session,
      * be repaired inside the data source. */
     UA_DataValue v;
     UA_DataValue_init(&v);
-    Service_Read_single(server, session, timestampsToReturn, &request->itemToMonitor, &v);
+    Service_Read_single(server, session, timestampsToReturn, 0.0,
+                        &request->itemToMonitor, &v);
     if(v.hasStatus && (v.status >> 30) > 1 &&
        v.status != UA_STATUSCODE_BADRESOURCEUNAVAILABLE &&
        v.status != UA_STATUSCODE_BADCOMMUNICATIONERROR &&
@@ -237,8 +244,12 @@ Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session,
         result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
         return;
     }
-    UA_StatusCode retval = UA_NodeId_copy(&request->itemToMonitor.nodeId,
-                                          &newMon->monitoredNodeId);
+    /* Monitored items outlive the aliases of registered nodes */
+    const UA_NodeId *monitoredNodeId =
+        UA_Session_resolveNodeId(session, &request->itemToMonitor.nodeId);
+    if(!monitoredNodeId)
+        monitoredNodeId = &request->itemToMonitor.nodeId;
+    UA_StatusCode retval = UA_NodeId_copy(monitoredNodeId, &newMon->monitoredNodeId);
     if(retval != UA_STATUSCODE_GOOD) {
         result->statusCode = retval;
         MonitoredItem_delete(server, newMon);
@@ -443,7 +454,8 @@ Service_Publish(UA_Server *server, UA_Session *session,
             continue;
         }
         /* Remove the acked transmission from the retransmission queue */
-        response->results[i] = UA_Subscription_removeRetransmissionMessage(sub, ack->sequenceNumber);
+        response->results[i] =
+            UA_Subscription_removeRetransmissionMessage(server, sub, ack->sequenceNumber);
     }
 
     /* Queue the publish response */
@@ -451,16 +463,15 @@ Service_Publish(UA_Server *server, UA_Session *session,
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Queued a publication message",
                          session->authenticationToken.identifier.numeric);
 
-    /* Answer immediately to a late subscription */
+    /* Answer immediately to the late subscriptions in the order of their
+     * priority. A subscription that has nothing to send (no notifications and
+     * no keepalive due) does not consume the PublishRequest. */
     UA_Subscription *immediate;
-    LIST_FOREACH(immediate, &session->serverSubscriptions, listEntry) {
-        if(immediate->state == UA_SUBSCRIPTIONSTATE_LATE) {
-            UA_LOG_DEBUG_SESSION(server->config.logger, session, "Subscription %u | "
-                                 "Response on a late subscription", immediate->subscriptionID,
-                                 session->authenticationToken.identifier.numeric);
-            UA_Subscription_publishCallback(server, immediate);
-            break;
-        }
+    while(SIMPLEQ_FIRST(&session->responseQueue) &&
+          (immediate = UA_Session_popReadySubscription(session))) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, session, "Subscription %u | "
+                             "Response on a late subscription", immediate->subscriptionID);
+        UA_Subscription_publishCallback(server, immediate);
     }
     return;
 
@@ -563,16 +574,9 @@ void Service_Republish(UA_Server *server, UA_Session *session, const UA_Republis
     sub->currentLifetimeCount = 0;
 
     /* Find the notification in the retransmission queue  */
-    UA_NotificationMessageEntry *entry;
-    TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
-        if(entry->message.sequenceNumber == request->retransmitSequenceNumber)
-            break;
-    }
-    if(entry)
-        response->responseHeader.serviceResult =
-            UA_NotificationMessage_copy(&entry->message, &response->notificationMessage);
-    else
-      response->responseHeader.serviceResult = UA_STATUSCODE_BADMESSAGENOTAVAILABLE;
+    response->responseHeader.serviceResult =
+        UA_Subscription_getRetransmissionMessage(server, sub, request->retransmitSequenceNumber,
+                                                 &response->notificationMessage);
 }
 
 #endif /* UA_ENABLE_SUBSCRIPTIONS */
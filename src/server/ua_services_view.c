@@ -6,14 +6,14 @@
 #include "ua_services.h"
 
 static UA_StatusCode
-fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode *ref,
+fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, const UA_ReferenceKind *kind,
                          UA_UInt32 mask, UA_ReferenceDescription *descr) {
     UA_ReferenceDescription_init(descr);
     UA_StatusCode retval = UA_NodeId_copy(&curr->nodeId, &descr->nodeId.nodeId);
     if(mask & UA_BROWSERESULTMASK_REFERENCETYPEID)
-        retval |= UA_NodeId_copy(&ref->referenceTypeId, &descr->referenceTypeId);
+        retval |= UA_NodeId_copy(&kind->referenceTypeId, &descr->referenceTypeId);
     if(mask & UA_BROWSERESULTMASK_ISFORWARD)
-        descr->isForward = !ref->isInverse;
+        descr->isForward = !kind->isInverse;
     if(mask & UA_BROWSERESULTMASK_NODECLASS)
         retval |= UA_NodeClass_copy(&curr->nodeClass, &descr->nodeClass);
     if(mask & UA_BROWSERESULTMASK_BROWSENAME)
@@ -22,47 +22,55 @@ fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode
         retval |= UA_LocalizedText_copy(&curr->displayName, &descr->displayName);
     if(mask & UA_BROWSERESULTMASK_TYPEDEFINITION){
         if(curr->nodeClass == UA_NODECLASS_OBJECT || curr->nodeClass == UA_NODECLASS_VARIABLE) {
-            for(size_t i = 0; i < curr->referencesSize; ++i) {
-                UA_ReferenceNode *refnode = &curr->references[i];
-                if(refnode->referenceTypeId.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION) {
-                    retval |= UA_ExpandedNodeId_copy(&refnode->targetId, &descr->typeDefinition);
-                    break;
-                }
-            }
+            const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+            const UA_ReferenceKind *typeKind =
+                UA_Node_findReferenceKind(curr, &hasTypeDefinition, false);
+            if(typeKind)
+                retval |= UA_ExpandedNodeId_copy(&curr->references[typeKind->referencesStart].targetId,
+                                                 &descr->typeDefinition);
         }
     }
     return retval;
 }
 
 
-/* Tests if the node is relevant to the browse request and shall be returned. If
-   so, it is retrieved from the Nodestore. If not, null is returned. */
-static const UA_Node *
-returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Boolean return_all,
-                   const UA_ReferenceNode *reference, const UA_NodeId *relevant, size_t relevant_count,
-                   UA_Boolean *isExternal) {
+/* Does the reference type of the kind match the requested type (or one of its
+ * subtypes)? The position of the requested type in the type index is looked up
+ * once per request. */
+static UA_Boolean
+isRelevantReferenceType(UA_Server *server, const UA_ReferenceKind *kind,
+                        const UA_NodeId *requested, UA_UInt32 requestedIndex,
+                        UA_Boolean includeSubtypes) {
+    if(!includeSubtypes)
+        return UA_NodeId_equal(&kind->referenceTypeId, requested);
+    if(kind->referenceTypeIndex == UA_TYPEINDEX_NOTFOUND)
+        return UA_TypeIndex_isSubtype(&server->typeIndex, &kind->referenceTypeId, requested);
+    return UA_TypeIndex_isSubtypeAt(&server->typeIndex, kind->referenceTypeIndex, requestedIndex);
+}
+
+/* Tests if the references of a kind (reference type and direction) are
+   relevant to the browse request */
+static UA_Boolean
+isRelevantKind(UA_Server *server, const UA_BrowseDescription *descr, UA_Boolean return_all,
+               UA_UInt32 requestedIndex, const UA_ReferenceKind *kind) {
     /* reference in the right direction? */
-    if(reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD)
-        return NULL;
-    if(!reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_INVERSE)
-        return NULL;
+    if(kind->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD)
+        return false;
+    if(!kind->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_INVERSE)
+        return false;
 
     /* is the reference part of the hierarchy of references we look for? */
-    if(!return_all) {
-        UA_Boolean is_relevant = false;
-        for(size_t i = 0; i < relevant_count; ++i) {
-            if(UA_NodeId_equal(&reference->referenceTypeId, &relevant[i])) {
-                is_relevant = true;
-                break;
-            }
-        }
-        if(!is_relevant)
-            return NULL;
-    }
-
+    return return_all || isRelevantReferenceType(server, kind, &descr->referenceTypeId,
+                                                 requestedIndex, descr->includeSubtypes);
+}
 
+/* Tests if the node is relevant to the browse request and shall be returned. If
+   so, it is retrieved from the Nodestore. If not, null is returned. */
+static const UA_Node *
+returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr,
+                   const UA_NodeReference *reference, UA_Boolean *isExternal) {
     /* return from the internal nodestore */
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, &reference->targetId.nodeId);
+    const UA_Node *node = UA_Server_getReferenceTarget(server, reference);
     if(node && descr->nodeClassMask != 0 && (node->nodeClass & descr->nodeClassMask) == 0)
         return NULL;
     *isExternal = false;
@@ -110,41 +118,28 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         return;
     }
     
-    /* get the references that match the browsedescription */
-    size_t relevant_refs_size = 0;
-    UA_NodeId *relevant_refs = NULL;
+    /* is the reference type valid? the subtypes are taken from the type index */
     UA_Boolean all_refs = UA_NodeId_isNull(&descr->referenceTypeId);
+    UA_UInt32 requestedIndex = UA_TYPEINDEX_NOTFOUND;
     if(!all_refs) {
         const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &descr->referenceTypeId);
         if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE) {
             result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
             return;
         }
-        if(descr->includeSubtypes) {
-            result->statusCode = getTypeHierarchy(server->nodestore, rootRef, false,
-                                                  &relevant_refs, &relevant_refs_size);
-            if(result->statusCode != UA_STATUSCODE_GOOD)
-                return;
-        } else {
-            relevant_refs = (UA_NodeId*)(uintptr_t)&descr->referenceTypeId;
-            relevant_refs_size = 1;
-        }
+        requestedIndex = UA_TypeIndex_findType(&server->typeIndex, &descr->referenceTypeId);
     }
 
     /* get the node */
-    const UA_Node *node = UA_NodeStore_get(server->nodestore, &descr->nodeId);
+    const UA_Node *node = UA_Server_getSessionNode(server, session, &descr->nodeId);
     if(!node) {
         result->statusCode = UA_STATUSCODE_BADNODEIDUNKNOWN;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
     /* if the node has no references, just return */
     if(node->referencesSize == 0) {
         result->referencesSize = 0;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
@@ -160,26 +155,48 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         goto cleanup;
     }
 
-    /* loop over the node's references */
+    /* Resume at the position of the continuation point if the references of
+     * the node are unchanged. Otherwise, skip over the references that were
+     * already returned. */
+    size_t resumeIndex = 0;
+    if(cp && cp->referencesVersion == node->referenceIndex.version) {
+        resumeIndex = cp->referencesIndex;
+        continuationIndex = 0;
+    }
+    referencesIndex = resumeIndex;
+
+    /* loop over the node's references. the reference type and direction are
+     * tested once for every kind of references. */
     size_t skipped = 0;
     UA_Boolean isExternal = false;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(; referencesIndex < node->referencesSize && referencesCount < real_maxrefs; ++referencesIndex) {
-        isExternal = false;
-        const UA_Node *current =
-            returnRelevantNode(server, descr, all_refs, &node->references[referencesIndex],
-                               relevant_refs, relevant_refs_size, &isExternal);
-        if(!current)
+    for(size_t k = 0; k < node->referenceIndex.kindsSize && referencesCount < real_maxrefs; ++k) {
+        const UA_ReferenceKind *kind = &node->referenceIndex.kinds[k];
+        size_t kindEnd = kind->referencesStart + kind->referencesSize;
+        if(kindEnd <= resumeIndex)
             continue;
-
-        if(skipped < continuationIndex) {
-            ++skipped;
-        } else {
-            retval |= fillReferenceDescription(server->nodestore, current,
-                                               &node->references[referencesIndex],
-                                               descr->resultMask,
-                                               &result->references[referencesCount]);
-            ++referencesCount;
+        if(!isRelevantKind(server, descr, all_refs, requestedIndex, kind)) {
+            referencesIndex = kindEnd;
+            continue;
+        }
+        referencesIndex = kind->referencesStart;
+        if(referencesIndex < resumeIndex)
+            referencesIndex = resumeIndex;
+        for(; referencesIndex < kindEnd && referencesCount < real_maxrefs; ++referencesIndex) {
+            isExternal = false;
+            const UA_Node *current =
+                returnRelevantNode(server, descr, &node->references[referencesIndex], &isExternal);
+            if(!current)
+                continue;
+
+            if(skipped < continuationIndex) {
+                ++skipped;
+            } else {
+                retval |= fillReferenceDescription(server->nodestore, current, kind,
+                                                   descr->resultMask,
+                                                   &result->references[referencesCount]);
+                ++referencesCount;
+            }
         }
     }
     result->referencesSize = referencesCount;
@@ -199,8 +216,6 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
     }
 
  cleanup:
-    if(!all_refs && descr->includeSubtypes)
-        UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
     if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
 
@@ -212,6 +227,8 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         } else {
             /* update the cp and return the cp identifier */
             cp->continuationIndex += (UA_UInt32)referencesCount;
+            cp->referencesIndex = referencesIndex;
+            cp->referencesVersion = node->referenceIndex.version;
             UA_ByteString_copy(&cp->identifier, &result->continuationPoint);
         }
     } else if(maxrefs != 0 && referencesCount >= maxrefs) {
@@ -224,6 +241,8 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
         UA_BrowseDescription_copy(descr, &cp->browseDescription);
         cp->maxReferences = maxrefs;
         cp->continuationIndex = (UA_UInt32)referencesCount;
+        cp->referencesIndex = referencesIndex;
+        cp->referencesVersion = node->referenceIndex.version;
         UA_Guid *ident = UA_Guid_new();
         *ident = UA_Guid_random();
         cp->identifier.data = (UA_Byte*)ident;
@@ -236,6 +255,15 @@ Service_Browse_single(UA_Server *server, UA_Session *session,
     }
 }
 
+static void
+browseSlice(UA_Server *server, UA_Session *session, const UA_BrowseRequest *request,
+            UA_BrowseResponse *response, size_t start, size_t end) {
+    for(size_t i = start; i < end; ++i) {
+            Service_Browse_single(server, session, NULL, &request->nodesToBrowse[i],
+                                  request->requestedMaxReferencesPerNode, &response->results[i]);
+    }
+}
+
 void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseRequest *request,
                     UA_BrowseResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing BrowseRequest");
@@ -257,11 +285,16 @@ void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseReque
     }
     response->resultsSize = size;
 
-
-    for(size_t i = 0; i < size; ++i) {
-            Service_Browse_single(server, session, NULL, &request->nodesToBrowse[i],
-                                  request->requestedMaxReferencesPerNode, &response->results[i]);
+    /* Continuation points are created in the order of the request. So only
+     * requests without a limit of references per node are processed in
+     * parallel. */
+    if(request->requestedMaxReferencesPerNode == 0) {
+        UA_Server_processServiceItems(server, session, size,
+                                      (UA_ServiceSliceCallback)browseSlice, NULL,
+                                      request, response);
+        return;
     }
+    browseSlice(server, session, request, response, 0, size);
 }
 
 UA_BrowseResult
@@ -330,25 +363,7 @@ UA_Server_browseNext(UA_Server *server, UA_Boolean releaseContinuationPoint,
 static void
 walkBrowsePathElementNodeReference(UA_BrowsePathResult *result, size_t *targetsSize,
                                    UA_NodeId **next, size_t *nextSize, size_t *nextCount,
-                                   UA_UInt32 elemDepth, UA_Boolean inverse, UA_Boolean all_refs,
-                                   const UA_NodeId *reftypes, size_t reftypes_count,
-                                   const UA_ReferenceNode *reference) {
-    /* Does the direction of the reference match? */
-    if(reference->isInverse != inverse)
-        return;
-
-    /* Is the node relevant? */
-    if(!all_refs) {
-        UA_Boolean match = false;
-        for(size_t j = 0; j < reftypes_count; ++j) {
-            if(UA_NodeId_equal(&reference->referenceTypeId, &reftypes[j])) {
-                match = true;
-                break;
-            }
-        }
-        if(!match)
-            return;
-    }
+                                   UA_UInt32 elemDepth, const UA_NodeReference *reference) {
 
     /* Does the reference point to an external server? Then add to the
      * targets with the right path "depth" */
@@ -382,6 +397,25 @@ walkBrowsePathElementNodeReference(UA_BrowsePathResult *result, size_t *targetsS
     ++(*nextCount);
 }
 
+/* The kinds are in the order of the references array */
+static const UA_ReferenceKind *
+kindOfReference(const UA_Node *node, size_t pos) {
+    const UA_ReferenceKind *kind = node->referenceIndex.kinds;
+    while(pos >= kind->referencesStart + kind->referencesSize)
+        ++kind;
+    return kind;
+}
+
+static UA_Boolean
+isRelevantPathKind(UA_Server *server, const UA_RelativePathElement *elem,
+                   UA_Boolean all_refs, UA_UInt32 requestedIndex,
+                   const UA_ReferenceKind *kind) {
+    if(kind->isInverse != elem->isInverse)
+        return false;
+    return all_refs || isRelevantReferenceType(server, kind, &elem->referenceTypeId,
+                                               requestedIndex, elem->includeSubtypes);
+}
+
 static void
 walkBrowsePathElement(UA_Server *server, UA_Session *session,
                       UA_BrowsePathResult *result, size_t *targetsSize,
@@ -389,24 +423,17 @@ walkBrowsePathElement(UA_Server *server, UA_Session *session,
                       const UA_QualifiedName *targetName,
                       const UA_NodeId *current, const size_t currentCount,
                       UA_NodeId **next, size_t *nextSize, size_t *nextCount) {
-    /* Get the full list of relevant referencetypes for this path element */
-    UA_NodeId *reftypes = NULL;
-    size_t reftypes_count = 1; // all_refs or no subtypes => 1
-    UA_Boolean all_refs = false;
-    if(UA_NodeId_isNull(&elem->referenceTypeId)) {
-        all_refs = true;
-    } else if(!elem->includeSubtypes) {
-        reftypes = (UA_NodeId*)(uintptr_t)&elem->referenceTypeId; // ptr magic due to const cast
-    } else {
+    /* Is the reference type valid? The subtypes are taken from the type index. */
+    UA_Boolean all_refs = UA_NodeId_isNull(&elem->referenceTypeId);
+    if(!all_refs && elem->includeSubtypes) {
         const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &elem->referenceTypeId);
         if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE)
             return;
-        UA_StatusCode retval =
-            getTypeHierarchy(server->nodestore, rootRef, false, &reftypes, &reftypes_count);
-        if(retval != UA_STATUSCODE_GOOD)
-            return;
     }
 
+    UA_UInt32 requestedIndex = UA_TypeIndex_findType(&server->typeIndex, &elem->referenceTypeId);
+    UA_UInt32 nameHash = UA_Node_browseNameHash(&elem->targetName);
+
     /* Iterate over all nodes at the current depth-level */
     for(size_t i = 0; i < currentCount; ++i) {
         /* Get the node */
@@ -424,19 +451,36 @@ walkBrowsePathElement(UA_Server *server, UA_Session *session,
                           !UA_String_equal(&targetName->name, &node->browseName.name)))
             continue;
 
-        /* Walk over the references in the node */
-        /* Loop over the nodes references */
-        for(size_t r = 0; r < node->referencesSize &&
-                result->statusCode == UA_STATUSCODE_GOOD; ++r) {
-            UA_ReferenceNode *reference = &node->references[r];
-            walkBrowsePathElementNodeReference(result, targetsSize, next, nextSize, nextCount,
-                                               elemDepth, elem->isInverse, all_refs,
-                                               reftypes, reftypes_count, reference);
+        /* Look up the references by the browse name of the target. Only the
+         * candidates are fetched from the nodestore for the next path element,
+         * where the browse name is compared. */
+        const UA_ReferenceIndex *index = &node->referenceIndex;
+        size_t iterator = 0;
+        const UA_NodeReference *ref;
+        while(result->statusCode == UA_STATUSCODE_GOOD &&
+              (ref = UA_Node_nextReferenceByName(node, nameHash, &iterator))) {
+            const UA_ReferenceKind *kind = kindOfReference(node, (size_t)(ref - node->references));
+            if(isRelevantPathKind(server, elem, all_refs, requestedIndex, kind))
+                walkBrowsePathElementNodeReference(result, targetsSize, next, nextSize,
+                                                   nextCount, elemDepth, ref);
         }
-    }
 
-    if(!all_refs && elem->includeSubtypes)
-        UA_Array_delete(reftypes, reftypes_count, &UA_TYPES[UA_TYPES_NODEID]);
+        /* Walk over the references without a name hash in the relevant kinds
+         * (reference type and direction) */
+        for(size_t k = 0; k < index->kindsSize; ++k) {
+            const UA_ReferenceKind *kind = &index->kinds[k];
+            if(kind->namedSize == kind->referencesSize ||
+               !isRelevantPathKind(server, elem, all_refs, requestedIndex, kind))
+                continue;
+            for(size_t r = kind->referencesStart; r < kind->referencesStart + kind->referencesSize &&
+                    result->statusCode == UA_STATUSCODE_GOOD; ++r) {
+                if(index->nameHashes && index->nameHashes[r] != 0)
+                    continue;
+                walkBrowsePathElementNodeReference(result, targetsSize, next, nextSize,
+                                                   nextCount, elemDepth, &node->references[r]);
+            }
+        }
+    }
 }
 
 /* This assumes that result->targets has enough room for all currentCount elements */
@@ -650,24 +694,44 @@ void Service_TranslateBrowsePathsToNodeIds(UA_Server *server, UA_Session *sessio
 void Service_RegisterNodes(UA_Server *server, UA_Session *session, const UA_RegisterNodesRequest *request,
                            UA_RegisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing RegisterNodesRequest");
-    //TODO: hang the nodeids to the session if really needed
     response->responseHeader.timestamp = UA_DateTime_now();
-    if(request->nodesToRegisterSize <= 0)
+    if(request->nodesToRegisterSize == 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
-    else {
+        return;
+    }
+
+    response->registeredNodeIds = UA_Array_new(request->nodesToRegisterSize,
+                                               &UA_TYPES[UA_TYPES_NODEID]);
+    if(!response->registeredNodeIds) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    response->registeredNodeIdsSize = request->nodesToRegisterSize;
+
+    /* Existing nodes get an alias that is resolved from the table of the
+     * session. Otherwise, the NodeId is returned as it is. */
+    for(size_t i = 0; i < request->nodesToRegisterSize; ++i) {
+        const UA_NodeId *nodeId = &request->nodesToRegister[i];
+        const UA_NodeId *registered = UA_Session_resolveNodeId(session, nodeId);
+        if(registered && UA_NodeStore_get(server->nodestore, registered) &&
+           UA_Session_registerNode(session, registered,
+                                   &response->registeredNodeIds[i]) == UA_STATUSCODE_GOOD)
+            continue;
         response->responseHeader.serviceResult =
-            UA_Array_copy(request->nodesToRegister, request->nodesToRegisterSize,
-                          (void**)&response->registeredNodeIds, &UA_TYPES[UA_TYPES_NODEID]);
-        if(response->responseHeader.serviceResult == UA_STATUSCODE_GOOD)
-            response->registeredNodeIdsSize = request->nodesToRegisterSize;
+            UA_NodeId_copy(nodeId, &response->registeredNodeIds[i]);
+        if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+            return;
     }
 }
 
 void Service_UnregisterNodes(UA_Server *server, UA_Session *session, const UA_UnregisterNodesRequest *request,
                              UA_UnregisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing UnRegisterNodesRequest");
-    //TODO: remove the nodeids from the session if really needed
     response->responseHeader.timestamp = UA_DateTime_now();
-    if(request->nodesToUnregisterSize==0)
+    if(request->nodesToUnregisterSize == 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
+        return;
+    }
+    for(size_t i = 0; i < request->nodesToUnregisterSize; ++i)
+        UA_Session_unregisterNode(session, &request->nodesToUnregister[i]);
 }
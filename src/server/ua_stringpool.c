@@ -0,0 +1,156 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_stringpool.h"
+#include "ua_types_generated_handling.h"
+
+#define UA_STRINGPOOL_MINSIZE 64
+
+/* The characters follow the header in the same allocation */
+typedef struct UA_InternedString {
+    UA_UInt32 hash;
+    UA_UInt32 refCount;
+    size_t length;
+} UA_InternedString;
+
+static UA_Byte *
+internedData(UA_InternedString *entry) {
+    return (UA_Byte*)(entry + 1);
+}
+
+static UA_InternedString *
+internedEntry(UA_Byte *data) {
+    return (UA_InternedString*)(uintptr_t)data - 1;
+}
+
+void
+UA_StringPool_init(UA_StringPool *pool) {
+    pool->size = 0;
+    pool->count = 0;
+    pool->entries = NULL;
+}
+
+void
+UA_StringPool_deleteMembers(UA_StringPool *pool) {
+    UA_assert(pool->count == 0);
+    UA_free(pool->entries);
+    UA_StringPool_init(pool);
+}
+
+/* The occupancy is at most 50% */
+static UA_StatusCode
+resize(UA_StringPool *pool, size_t size) {
+    UA_InternedString **entries = UA_calloc(size, sizeof(UA_InternedString*));
+    if(!entries)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < pool->size; ++i) {
+        UA_InternedString *entry = pool->entries[i];
+        if(!entry)
+            continue;
+        size_t idx = entry->hash & (size - 1);
+        while(entries[idx])
+            idx = (idx + 1) & (size - 1);
+        entries[idx] = entry;
+    }
+    UA_free(pool->entries);
+    pool->entries = entries;
+    pool->size = size;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Backward-shift deletion of the entry at idx */
+static void
+removeSlot(UA_StringPool *pool, size_t idx) {
+    size_t mask = pool->size - 1;
+    size_t next = idx;
+    while(true) {
+        next = (next + 1) & mask;
+        UA_InternedString *entry = pool->entries[next];
+        if(!entry)
+            break;
+        /* Move the entry into the gap if the gap lies between its home slot
+         * and the current position */
+        size_t home = entry->hash & mask;
+        if(((next - home) & mask) >= ((next - idx) & mask)) {
+            pool->entries[idx] = entry;
+            idx = next;
+        }
+    }
+    pool->entries[idx] = NULL;
+}
+
+UA_StatusCode
+UA_StringPool_intern(UA_StringPool *pool, const UA_String *s, UA_String *interned) {
+    if(s->length == 0) {
+        /* Keep the difference between empty and null strings */
+        interned->length = 0;
+        interned->data = s->data ? UA_EMPTY_ARRAY_SENTINEL : NULL;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_UInt32 hash = UA_String_hash(s);
+    if(pool->count * 2 >= pool->size) {
+        UA_StatusCode retval =
+            resize(pool, pool->size > 0 ? pool->size * 2 : UA_STRINGPOOL_MINSIZE);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+
+    /* Find the string or the empty slot at the end of the probe sequence */
+    size_t mask = pool->size - 1;
+    size_t idx = hash & mask;
+    UA_InternedString *entry;
+    for(; (entry = pool->entries[idx]); idx = (idx + 1) & mask) {
+        if(entry->hash == hash && entry->length == s->length &&
+           memcmp(internedData(entry), s->data, s->length) == 0)
+            break;
+    }
+
+    if(!entry) {
+        entry = UA_malloc(sizeof(UA_InternedString) + s->length);
+        if(!entry)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        entry->hash = hash;
+        entry->refCount = 0;
+        entry->length = s->length;
+        memcpy(internedData(entry), s->data, s->length);
+        pool->entries[idx] = entry;
+        ++pool->count;
+    }
+
+    ++entry->refCount;
+    interned->length = entry->length;
+    interned->data = internedData(entry);
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_StringPool_release(UA_StringPool *pool, UA_String *interned) {
+    if(interned->length == 0) {
+        UA_String_deleteMembers(interned);
+        return;
+    }
+
+    UA_InternedString *entry = internedEntry(interned->data);
+    UA_String_init(interned);
+    if(--entry->refCount > 0)
+        return;
+
+    size_t mask = pool->size - 1;
+    size_t idx = entry->hash & mask;
+    while(pool->entries[idx] != entry)
+        idx = (idx + 1) & mask;
+    removeSlot(pool, idx);
+    UA_free(entry);
+    --pool->count;
+
+    /* Free the hash-set with the last string. Shrink if it is very empty. */
+    if(pool->count == 0) {
+        UA_free(pool->entries);
+        pool->entries = NULL;
+        pool->size = 0;
+    } else if(pool->count * 8 < pool->size && pool->size > UA_STRINGPOOL_MINSIZE) {
+        resize(pool, pool->size / 2); /* can fail, we continue with the larger set */
+    }
+}
@@ -0,0 +1,51 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#ifndef UA_STRINGPOOL_H_
+#define UA_STRINGPOOL_H_
+
+#include "ua_util.h"
+#include "ua_types.h"
+
+/**
+ * String Pool
+ * -----------
+ * Nodes in the nodestore share immutable copies of equal strings (browse
+ * names, display names, descriptions and string NodeIds). The shared copies
+ * are reference-counted and kept in a hash-set. Equal interned strings have the
+ * same data pointer, so comparing them does not touch the content.
+ *
+ * Every nodestore that interns strings has its own pool. The pool has no lock.
+ * It is only used by the single-threaded nodestore. The memory of the hash-set
+ * is freed when the last string is released. */
+
+struct UA_InternedString;
+
+typedef struct UA_StringPool {
+    size_t size; /* zero or a power of two */
+    size_t count;
+    struct UA_InternedString **entries; /* open addressing with linear probing */
+} UA_StringPool;
+
+void UA_StringPool_init(UA_StringPool *pool);
+
+/* All strings have to be released before */
+void UA_StringPool_deleteMembers(UA_StringPool *pool);
+
+/* Sets interned to the shared copy of the string and increases its reference
+ * count. Empty strings are not interned. */
+UA_StatusCode
+UA_StringPool_intern(UA_StringPool *pool, const UA_String *s, UA_String *interned);
+
+/* Decreases the reference count of an interned string and frees it when it is
+ * no longer used. The string is set to the empty string. */
+void UA_StringPool_release(UA_StringPool *pool, UA_String *interned);
+
+/* Number of distinct interned strings */
+static UA_INLINE size_t
+UA_StringPool_size(const UA_StringPool *pool) {
+    return pool->count;
+}
+
+#endif /* UA_STRINGPOOL_H_ */
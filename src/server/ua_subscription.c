@@ -7,6 +7,7 @@
 #include "ua_types_encoding_binary.h"
 #include "ua_services.h"
 #include "ua_nodestore.h"
+#include "ua_valuehandle.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
@@ -29,8 +30,10 @@ UA_MonitoredItem * UA_MonitoredItem_new() {
     TAILQ_INIT(&new->queue);
     UA_NodeId_init(&new->monitoredNodeId);
     new->lastSampledValue = UA_BYTESTRING_NULL;
-    memset(&new->sampleJobGuid, 0, sizeof(UA_Guid));
-    new->sampleJobIsRegistered = false;
+    new->samplingGroup = NULL;
+    new->samplingGroupIndex = 0;
+    new->feedStarted = false;
+    new->nextFeedSample = 0;
     new->itemId = 0;
     return new;
 }
@@ -114,7 +117,8 @@ detectValueChange(UA_MonitoredItem *mon, UA_DataValue *value,
 
     /* The value has changed */
     encoding->length = encodingOffset;
-    if(!mon->lastSampledValue.data || !UA_String_equal(encoding, &mon->lastSampledValue))
+    if(!mon->lastSampledValue.data ||
+       !UA_String_equal(encoding, &mon->lastSampledValue))
         *changed = true;
 
  cleanup:
@@ -127,7 +131,16 @@ detectValueChange(UA_MonitoredItem *mon, UA_DataValue *value,
     return retval;
 }
 
-void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
+static UA_Boolean
+feedMonitoredItem(UA_Server *server, UA_MonitoredItem *mon,
+                  const UA_Node *node);
+
+/* Sample the (already looked up) node. The node may be NULL if it does not
+ * exist. If the value was already read in a batch, it is moved from
+ * prefetched. */
+static void
+sampleMonitoredItem(UA_Server *server, UA_MonitoredItem *monitoredItem,
+                    const UA_Node *node, UA_DataValue *prefetched) {
     UA_Subscription *sub = monitoredItem->subscription;
     if(monitoredItem->monitoredItemType != UA_MONITOREDITEMTYPE_CHANGENOTIFY) {
         UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
@@ -137,6 +150,10 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
         return;
     }
 
+    /* Take the samples of a value handle */
+    if(!prefetched && feedMonitoredItem(server, monitoredItem, node))
+        return;
+
     /* Read the value */
     UA_ReadValueId rvid;
     UA_ReadValueId_init(&rvid);
@@ -145,8 +162,18 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
     rvid.indexRange = monitoredItem->indexRange;
     UA_DataValue value;
     UA_DataValue_init(&value);
-    Service_Read_single(server, sub->session, monitoredItem->timestampsToReturn,
-                        &rvid, &value);
+    if(prefetched) {
+        value = *prefetched;
+        UA_DataValue_init(prefetched);
+    } else if(node) {
+        /* A cached value from within the last half sampling interval is
+         * considered fresh */
+        ReadWithNode(node, server, sub->session, monitoredItem->timestampsToReturn,
+                     monitoredItem->samplingInterval / 2.0, &rvid, &value);
+    } else {
+        value.hasStatus = true;
+        value.status = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
 
     /* Stack-allocate some memory for the value encoding */
     UA_Byte *stackValueEncoding = UA_alloca(UA_VALUENCODING_MAXSTACK);
@@ -156,8 +183,8 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
 
     /* Has the value changed? */
     UA_Boolean changed = false;
-    UA_StatusCode retval = detectValueChange(monitoredItem, &value,
-                                             &valueEncoding, &changed);
+    UA_StatusCode retval = detectValueChange(monitoredItem, &value, &valueEncoding,
+                                             &changed);
     if(!changed || retval != UA_STATUSCODE_GOOD)
         goto cleanup;
 
@@ -222,31 +249,361 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
     UA_DataValue_deleteMembers(&value);
 }
 
-UA_StatusCode
-MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
+/* Feeds the samples that arrived in a value handle since the last sampling.
+ * The first time, only the most recent sample is taken. Returns false if the
+ * value of the item does not come from a value handle. */
+static UA_Boolean
+feedMonitoredItem(UA_Server *server, UA_MonitoredItem *mon,
+                  const UA_Node *node) {
+    const UA_ValueHandle *handle = UA_ValueHandle_fromNode(node);
+    if(!handle || mon->attributeID != UA_ATTRIBUTEID_VALUE ||
+       mon->indexRange.length > 0)
+        return false;
+
+    UA_UInt32 count = handle->samplesCount;
+    UA_atomic_barrier();
+    UA_UInt32 next = count - 1;
+    if(mon->feedStarted && count - mon->nextFeedSample <= handle->samplesSize)
+        next = mon->nextFeedSample;
+    else if(mon->feedStarted)
+        next = count - (UA_UInt32)handle->samplesSize; /* Samples were lost */
+    mon->feedStarted = true;
+    mon->nextFeedSample = count;
+
+    UA_Boolean sourceTimestamp =
+        (mon->timestampsToReturn == UA_TIMESTAMPSTORETURN_SOURCE ||
+         mon->timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH);
+    UA_Boolean serverTimestamp =
+        (mon->timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER ||
+         mon->timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH);
+    UA_DateTime now = UA_DateTime_now();
+    for(; next != count; ++next) {
+        UA_DataValue value;
+        UA_DataValue_init(&value);
+        /* Overwritten samples are skipped */
+        if(UA_ValueHandle_readSample(handle, next, sourceTimestamp,
+                                     &value) != UA_STATUSCODE_GOOD)
+            continue;
+        if(serverTimestamp) {
+            value.hasServerTimestamp = true;
+            value.serverTimestamp = now;
+        }
+        sampleMonitoredItem(server, mon, node, &value);
+        UA_DataValue_deleteMembers(&value);
+    }
+    return true;
+}
+
+void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
+    const UA_Node *node =
+        UA_NodeStore_get(server->nodestore, &monitoredItem->monitoredNodeId);
+    sampleMonitoredItem(server, monitoredItem, node, NULL);
+}
+
+/******************/
+/* Sampling Group */
+/******************/
+
+/* The sweeps run in worker threads with multithreading. Items are also added
+ * and removed from the worker threads. */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_SAMPLING_LOCK(server) pthread_mutex_lock(&(server)->samplingMutex)
+# define UA_SAMPLING_UNLOCK(server) pthread_mutex_unlock(&(server)->samplingMutex)
+#else
+# define UA_SAMPLING_LOCK(server)
+# define UA_SAMPLING_UNLOCK(server)
+#endif
+
+/* The nodes of a block of items are looked up before the items are sampled.
+ * Values of data sources with a readBatch callback are read for the entire
+ * block. */
+#define UA_SAMPLINGGROUP_BLOCKSIZE 32
+
+/* Does reading the node call into user code? The callback might modify the
+ * nodestore and invalidate the nodes that were looked up ahead. */
+static UA_Boolean
+readCallsUserCode(const UA_MonitoredItem *mon, const UA_Node *node) {
+    if(!node || mon->attributeID != UA_ATTRIBUTEID_VALUE ||
+       !(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        return false;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    return (vn->valueSource == UA_VALUESOURCE_DATASOURCE ||
+            vn->value.data.callback.onRead != NULL);
+}
+
+/* Read the values of the block that are read in a batch. The nodes need to be
+ * looked up again afterwards, as the callbacks are user code. */
+static UA_Boolean
+batchReadBlock(UA_Server *server, UA_MonitoredItem **items, size_t blockSize,
+               const UA_Node **nodes, UA_Boolean lookedUp,
+               UA_MonitoredItem **batched, UA_DataValue *values) {
+    UA_BatchRead batch;
+    UA_BatchRead_init(&batch);
+    for(size_t i = 0; i < blockSize; ++i) {
+        UA_MonitoredItem *mon = items[i];
+        batched[i] = NULL;
+        if(mon->monitoredItemType != UA_MONITOREDITEMTYPE_CHANGENOTIFY)
+            continue;
+        const UA_Node *node = lookedUp ? nodes[i] :
+            UA_NodeStore_get(server->nodestore, &mon->monitoredNodeId);
+        if(!node || !UA_BatchRead_accepts(node, mon->attributeID))
+            continue;
+        UA_DataValue_init(&values[i]);
+        if(UA_BatchRead_add(server, &batch, node, &mon->indexRange,
+                            mon->timestampsToReturn, mon->samplingInterval / 2.0,
+                            &values[i]) == UA_STATUSCODE_GOOD)
+            batched[i] = mon;
+    }
+    UA_Boolean callsUserCode = (batch.itemsSize > 0);
+    UA_BatchRead_execute(server, &batch);
+    return callsUserCode;
+}
+
+static void
+sweepItems(UA_Server *server, UA_SamplingGroup *group) {
+    const UA_Node *nodes[UA_SAMPLINGGROUP_BLOCKSIZE];
+    UA_MonitoredItem *batched[UA_SAMPLINGGROUP_BLOCKSIZE];
+    UA_DataValue values[UA_SAMPLINGGROUP_BLOCKSIZE];
+    for(size_t start = 0; start < group->itemsSize; start += UA_SAMPLINGGROUP_BLOCKSIZE) {
+        size_t blockSize = group->itemsSize - start;
+        if(blockSize > UA_SAMPLINGGROUP_BLOCKSIZE)
+            blockSize = UA_SAMPLINGGROUP_BLOCKSIZE;
+
+        /* Look up the nodes of the block. With multithreading, the RCU lock is
+         * released during user callbacks. So the nodes are not kept from one
+         * item to the next. */
+        UA_Boolean lookedUp = false;
+#ifndef UA_ENABLE_MULTITHREADING
+        UA_MonitoredItem **items = &group->items[start];
+        for(size_t i = 0; i < blockSize; ++i)
+            nodes[i] = UA_NodeStore_get(server->nodestore, &items[i]->monitoredNodeId);
+        lookedUp = true;
+#endif
+        if(batchReadBlock(server, &group->items[start], blockSize,
+                          nodes, lookedUp, batched, values))
+            lookedUp = false;
+
+        /* Sample the block. User callbacks may add or remove items from the
+         * group. So the table is accessed via the group every time. */
+        for(size_t i = 0; i < blockSize && start + i < group->itemsSize; ++i) {
+            UA_MonitoredItem *mon = group->items[start + i];
+            const UA_Node *node = lookedUp ? nodes[i] :
+                UA_NodeStore_get(server->nodestore, &mon->monitoredNodeId);
+            UA_DataValue *prefetched = NULL;
+            if(batched[i] == mon)
+                prefetched = &values[i];
+            else if(readCallsUserCode(mon, node))
+                lookedUp = false;
+            sampleMonitoredItem(server, mon, node, prefetched);
+            batched[i] = NULL;
+        }
+
+        /* Values of items that were removed in the meantime */
+        for(size_t j = 0; j < blockSize; ++j) {
+            if(batched[j])
+                UA_DataValue_deleteMembers(&values[j]);
+        }
+    }
+}
+
+static UA_StatusCode
+UA_SamplingGroup_delete(UA_Server *server, UA_SamplingGroup *group);
+
+/* The lock is held for the entire sweep. So the sweeps of different groups
+ * do not run in parallel. */
+static void
+UA_SamplingGroup_sweep(UA_Server *server, UA_SamplingGroup *group) {
+    UA_SAMPLING_LOCK(server);
+    /* The repeated job is removed asynchronously with multithreading */
+    if(group->removed) {
+        UA_SAMPLING_UNLOCK(server);
+        return;
+    }
+    group->sweeping = true;
+    sweepItems(server, group);
+    group->sweeping = false;
+
+    /* The last item was removed during the sweep */
+    if(group->itemsSize == 0)
+        UA_SamplingGroup_delete(server, group);
+    UA_SAMPLING_UNLOCK(server);
+}
+
+static UA_StatusCode
+UA_SamplingGroup_grow(UA_SamplingGroup *group) {
+    size_t newCapacity = 8;
+    if(group->itemsCapacity > 0)
+        newCapacity = group->itemsCapacity * 2;
+    UA_MonitoredItem **items =
+        UA_realloc(group->items, newCapacity * sizeof(UA_MonitoredItem*));
+    if(!items)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    group->items = items;
+    group->itemsCapacity = newCapacity;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+UA_SamplingGroup_free(UA_Server *server, UA_SamplingGroup *group) {
+    UA_free(group->items);
+    UA_free(group);
+}
+
+static UA_StatusCode
+UA_SamplingGroup_delete(UA_Server *server, UA_SamplingGroup *group) {
+    LIST_REMOVE(group, listEntry);
+    group->removed = true;
+    UA_StatusCode retval = UA_Server_removeRepeatedJob(server, group->sweepJobGuid);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Sweeps that were already dispatched may still run */
+    if(server->workers) {
+        UA_Server_delayedCallback(server, (UA_ServerCallback)UA_SamplingGroup_free, group);
+        return retval;
+    }
+#endif
+    UA_SamplingGroup_free(server, group);
+    return retval;
+}
+
+static UA_SamplingGroup *
+UA_SamplingGroup_get(UA_Server *server, UA_UInt64 samplingInterval) {
+    /* Find an existing group */
+    UA_SamplingGroup *group;
+    LIST_FOREACH(group, &server->samplingGroups, listEntry) {
+        if(group->samplingInterval == samplingInterval)
+            return group;
+    }
+
+    /* Create a new group with its sweep job */
+    group = UA_calloc(1, sizeof(UA_SamplingGroup));
+    if(!group)
+        return NULL;
+    group->samplingInterval = samplingInterval;
     UA_Job job;
     job.type = UA_JOBTYPE_METHODCALL;
-    job.job.methodCall.method = (UA_ServerCallback)UA_MoniteredItem_SampleCallback;
-    job.job.methodCall.data = mon;
-    UA_StatusCode retval = UA_Server_addRepeatedJob(server, job,
-                                                    (UA_UInt32)mon->samplingInterval,
-                                                    &mon->sampleJobGuid);
-    if(retval == UA_STATUSCODE_GOOD)
-        mon->sampleJobIsRegistered = true;
+    job.job.methodCall.method = (UA_ServerCallback)UA_SamplingGroup_sweep;
+    job.job.methodCall.data = group;
+    UA_StatusCode retval = UA_Server_addRepeatedJobHighRes(server, job, samplingInterval,
+                                                           &group->sweepJobGuid);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(group);
+        return NULL;
+    }
+    LIST_INSERT_HEAD(&server->samplingGroups, group, listEntry);
+    return group;
+}
+
+static UA_StatusCode
+registerSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
+    if(mon->samplingGroup)
+        return UA_STATUSCODE_GOOD;
+
+    /* Sampling intervals below 5ms are possible if permitted by the
+     * samplingIntervalLimits of the server configuration */
+    UA_SamplingGroup *group =
+        UA_SamplingGroup_get(server, (UA_UInt64)(mon->samplingInterval * 1000.0));
+    if(!group)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Make space in the table */
+    if(group->itemsSize >= group->itemsCapacity) {
+        UA_StatusCode retval = UA_SamplingGroup_grow(group);
+        if(retval != UA_STATUSCODE_GOOD) {
+            if(group->itemsSize == 0 && !group->sweeping)
+                UA_SamplingGroup_delete(server, group);
+            return retval;
+        }
+    }
+
+    /* Append the item */
+    size_t index = group->itemsSize;
+    group->items[index] = mon;
+    ++group->itemsSize;
+    mon->samplingGroup = group;
+    mon->samplingGroupIndex = index;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_SAMPLING_LOCK(server);
+    UA_StatusCode retval = registerSampleJob(server, mon);
+    UA_SAMPLING_UNLOCK(server);
     return retval;
 }
 
-UA_StatusCode MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
-    if(!mon->sampleJobIsRegistered)
+static UA_StatusCode
+unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_SamplingGroup *group = mon->samplingGroup;
+    if(!group)
         return UA_STATUSCODE_GOOD;
-    mon->sampleJobIsRegistered = false;
-    return UA_Server_removeRepeatedJob(server, mon->sampleJobGuid);
+    mon->samplingGroup = NULL;
+
+    /* Move the last item of the table into the free slot */
+    size_t index = mon->samplingGroupIndex;
+    size_t last = group->itemsSize - 1;
+    if(index != last) {
+        UA_MonitoredItem *moved = group->items[last];
+        group->items[index] = moved;
+        moved->samplingGroupIndex = index;
+    }
+    --group->itemsSize;
+
+    /* Remove empty groups. Not during the sweep of the group. */
+    if(group->itemsSize > 0 || group->sweeping)
+        return UA_STATUSCODE_GOOD;
+    return UA_SamplingGroup_delete(server, group);
+}
+
+UA_StatusCode
+MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_SAMPLING_LOCK(server);
+    UA_StatusCode retval = unregisterSampleJob(server, mon);
+    UA_SAMPLING_UNLOCK(server);
+    return retval;
+}
+
+/* The repeated jobs are already removed when the server is deleted. Remaining
+ * items belong to subscriptions of the local admin session, which outlives the
+ * server. They are detached and can be registered with another server. */
+void
+UA_SamplingGroup_deleteAll(UA_Server *server) {
+    UA_SamplingGroup *group, *group_tmp;
+    LIST_FOREACH_SAFE(group, &server->samplingGroups, listEntry, group_tmp) {
+        for(size_t i = 0; i < group->itemsSize; ++i)
+            group->items[i]->samplingGroup = NULL;
+        LIST_REMOVE(group, listEntry);
+        UA_SamplingGroup_free(server, group);
+    }
 }
 
 /****************/
 /* Subscription */
 /****************/
 
+/* The retransmission entries of a subscription can be evicted by the publish
+ * job of another session. So the queues of all subscriptions are protected
+ * together with the server-wide queue. */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_RETRANSMISSION_LOCK(server) pthread_mutex_lock(&(server)->retransmissionMutex)
+# define UA_RETRANSMISSION_UNLOCK(server) pthread_mutex_unlock(&(server)->retransmissionMutex)
+#else
+# define UA_RETRANSMISSION_LOCK(server)
+# define UA_RETRANSMISSION_UNLOCK(server)
+#endif
+
+/* Called with the retransmission lock held */
+static void
+removeRetransmissionEntry(UA_Server *server, UA_Subscription *sub,
+                          UA_NotificationMessageEntry *entry) {
+    TAILQ_REMOVE(&sub->retransmissionQueue, entry, listEntry);
+    TAILQ_REMOVE(&server->retransmissionQueue, entry, serverEntry);
+    --sub->retransmissionQueueSize;
+    server->retransmissionStatistics.bytesHeld -= entry->encoded.length;
+    --server->retransmissionStatistics.messagesHeld;
+    UA_free(entry); /* The encoded message is in the same memory block */
+}
+
 UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptionID) {
     UA_Subscription *new = UA_malloc(sizeof(UA_Subscription));
     if(!new)
@@ -261,6 +618,8 @@ UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptio
     new->currentKeepAliveCount = 0;
     new->currentLifetimeCount = 0;
     new->lastMonitoredItemId = 0;
+    new->priority = 0;
+    new->isReady = false;
     new->state = UA_SUBSCRIPTIONSTATE_NORMAL; /* The first publish response is sent immediately */
     LIST_INIT(&new->monitoredItems);
     TAILQ_INIT(&new->retransmissionQueue);
@@ -270,6 +629,7 @@ UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptio
 
 void UA_Subscription_deleteMembers(UA_Subscription *subscription, UA_Server *server) {
     Subscription_unregisterPublishJob(server, subscription);
+    UA_Session_unsetSubscriptionReady(subscription->session, subscription);
 
     /* Delete monitored Items */
     UA_MonitoredItem *mon, *tmp_mon;
@@ -280,12 +640,10 @@ void UA_Subscription_deleteMembers(UA_Subscription *subscription, UA_Server *ser
 
     /* Delete Retransmission Queue */
     UA_NotificationMessageEntry *nme, *nme_tmp;
-    TAILQ_FOREACH_SAFE(nme, &subscription->retransmissionQueue, listEntry, nme_tmp) {
-        TAILQ_REMOVE(&subscription->retransmissionQueue, nme, listEntry);
-        UA_NotificationMessage_deleteMembers(&nme->message);
-        UA_free(nme);
-    }
-    subscription->retransmissionQueueSize = 0;
+    UA_RETRANSMISSION_LOCK(server);
+    TAILQ_FOREACH_SAFE(nme, &subscription->retransmissionQueue, listEntry, nme_tmp)
+        removeRetransmissionEntry(server, subscription, nme);
+    UA_RETRANSMISSION_UNLOCK(server);
 }
 
 UA_MonitoredItem *
@@ -331,38 +689,115 @@ countQueuedNotifications(UA_Subscription *sub, UA_Boolean *moreNotifications) {
     return notifications;
 }
 
-static void
+UA_StatusCode
 UA_Subscription_addRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
-                                         UA_NotificationMessageEntry *entry) {
+                                         const UA_NotificationMessage *message) {
+    /* Encode the message into the memory block behind the entry */
+    size_t length = UA_calcSizeBinary((void*)(uintptr_t)message,
+                                      &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE]);
+    UA_NotificationMessageEntry *entry =
+        UA_malloc(sizeof(UA_NotificationMessageEntry) + length);
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    entry->subscription = sub;
+    entry->sequenceNumber = message->sequenceNumber;
+    entry->encoded.length = length;
+    entry->encoded.data = (UA_Byte*)entry + sizeof(UA_NotificationMessageEntry);
+    size_t offset = 0;
+    UA_StatusCode retval = UA_encodeBinary(message, &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE],
+                                           NULL, NULL, &entry->encoded, &offset);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(entry);
+        return retval;
+    }
+
     /* Release the oldest entry if there is not enough space */
+    UA_RETRANSMISSION_LOCK(server);
     if(server->config.maxRetransmissionQueueSize > 0 &&
        sub->retransmissionQueueSize >= server->config.maxRetransmissionQueueSize) {
         UA_NotificationMessageEntry *lastentry =
             TAILQ_LAST(&sub->retransmissionQueue, UA_ListOfNotificationMessages);
-        TAILQ_REMOVE(&sub->retransmissionQueue, lastentry, listEntry);
-        --sub->retransmissionQueueSize;
-        UA_NotificationMessage_deleteMembers(&lastentry->message);
-        UA_free(lastentry);
+        removeRetransmissionEntry(server, sub, lastentry);
     }
 
     /* Add entry */
     TAILQ_INSERT_HEAD(&sub->retransmissionQueue, entry, listEntry);
+    TAILQ_INSERT_TAIL(&server->retransmissionQueue, entry, serverEntry);
     ++sub->retransmissionQueueSize;
+    server->retransmissionStatistics.bytesHeld += length;
+    ++server->retransmissionStatistics.messagesHeld;
+
+    /* Evict the oldest entries of all subscriptions until the budget is met.
+     * The new entry is always kept. */
+    if(server->config.maxRetransmissionBytes > 0) {
+        UA_NotificationMessageEntry *oldest;
+        while(server->retransmissionStatistics.bytesHeld > server->config.maxRetransmissionBytes &&
+              (oldest = TAILQ_FIRST(&server->retransmissionQueue)) != entry) {
+            removeRetransmissionEntry(server, oldest->subscription, oldest);
+            ++server->retransmissionStatistics.evictions;
+        }
+    }
+    UA_RETRANSMISSION_UNLOCK(server);
+    return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
-UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequenceNumber) {
-    UA_NotificationMessageEntry *entry, *entry_tmp;
-    TAILQ_FOREACH_SAFE(entry, &sub->retransmissionQueue, listEntry, entry_tmp) {
-        if(entry->message.sequenceNumber != sequenceNumber)
+UA_Subscription_removeRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
+                                            UA_UInt32 sequenceNumber) {
+    UA_StatusCode retval = UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN;
+    UA_NotificationMessageEntry *entry;
+    UA_RETRANSMISSION_LOCK(server);
+    TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
+        if(entry->sequenceNumber != sequenceNumber)
             continue;
-        TAILQ_REMOVE(&sub->retransmissionQueue, entry, listEntry);
-        --sub->retransmissionQueueSize;
-        UA_NotificationMessage_deleteMembers(&entry->message);
-        UA_free(entry);
-        return UA_STATUSCODE_GOOD;
+        removeRetransmissionEntry(server, sub, entry);
+        retval = UA_STATUSCODE_GOOD;
+        break;
     }
-    return UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN;
+    UA_RETRANSMISSION_UNLOCK(server);
+    return retval;
+}
+
+UA_StatusCode
+UA_Subscription_getRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
+                                         UA_UInt32 sequenceNumber,
+                                         UA_NotificationMessage *message) {
+    UA_RETRANSMISSION_LOCK(server);
+    ++server->retransmissionStatistics.republishRequests;
+    UA_NotificationMessageEntry *entry;
+    TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
+        if(entry->sequenceNumber == sequenceNumber)
+            break;
+    }
+    UA_StatusCode retval = UA_STATUSCODE_BADMESSAGENOTAVAILABLE;
+    if(entry) {
+        /* Decode before the entry can be evicted */
+        ++server->retransmissionStatistics.republishHits;
+        size_t offset = 0;
+        retval = UA_decodeBinary(&entry->encoded, &offset, message,
+                                 &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE]);
+    }
+    UA_RETRANSMISSION_UNLOCK(server);
+    return retval;
+}
+
+/* Messages of the local admin session's subscriptions are still held when the
+ * server is deleted */
+void
+UA_RetransmissionQueue_deleteAll(UA_Server *server) {
+    UA_NotificationMessageEntry *entry;
+    UA_RETRANSMISSION_LOCK(server);
+    while((entry = TAILQ_FIRST(&server->retransmissionQueue)))
+        removeRetransmissionEntry(server, entry->subscription, entry);
+    UA_RETRANSMISSION_UNLOCK(server);
+}
+
+void
+UA_Server_getRetransmissionStatistics(UA_Server *server,
+                                      UA_RetransmissionStatistics *stats) {
+    UA_RETRANSMISSION_LOCK(server);
+    *stats = server->retransmissionStatistics;
+    UA_RETRANSMISSION_UNLOCK(server);
 }
 
 static UA_StatusCode
@@ -446,6 +881,9 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
         UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
                              "Subscription %u | Cannot send a publish response "
                              "since the publish queue is empty", sub->subscriptionID)
+        /* Wait for the next PublishRequest. Late subscriptions are served in
+         * the order of their priority. */
+        UA_Session_setSubscriptionReady(sub->session, sub);
         if(sub->state != UA_SUBSCRIPTIONSTATE_LATE) {
             sub->state = UA_SUBSCRIPTIONSTATE_LATE;
         } else {
@@ -461,16 +899,7 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
 
     UA_PublishResponse *response = &pre->response;
     UA_NotificationMessage *message = &response->notificationMessage;
-    UA_NotificationMessageEntry *retransmission = NULL;
     if(notifications > 0) {
-        /* Allocate the retransmission entry */
-        retransmission = UA_malloc(sizeof(UA_NotificationMessageEntry));
-        if(!retransmission) {
-            UA_LOG_WARNING_SESSION(server->config.logger, sub->session,
-                                   "Subscription %u | Could not allocate memory "
-                                   "for retransmission", sub->subscriptionID);
-            return;
-        }
         /* Prepare the response */
         UA_StatusCode retval =
             prepareNotificationMessage(sub, message, notifications);
@@ -478,7 +907,6 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
             UA_LOG_WARNING_SESSION(server->config.logger, sub->session,
                                    "Subscription %u | Could not prepare the "
                                    "notification message", sub->subscriptionID);
-            UA_free(retransmission);
             return;
         }
     }
@@ -500,14 +928,19 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
         /* Increase the sequence number */
         message->sequenceNumber = ++sub->sequenceNumber;
 
-        /* Put the notification message into the retransmission queue. This needs to
-         * be done here, so that the message itself is included in the available
-         * sequence numbers for acknowledgement. */
-        retransmission->message = response->notificationMessage;
-        UA_Subscription_addRetransmissionMessage(server, sub, retransmission);
+        /* Put the encoded notification message into the retransmission queue.
+         * This needs to be done here, so that the message itself is included
+         * in the available sequence numbers for acknowledgement. */
+        UA_StatusCode retval = UA_Subscription_addRetransmissionMessage(server, sub, message);
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_WARNING_SESSION(server->config.logger, sub->session,
+                                   "Subscription %u | Could not store the notification "
+                                   "message for retransmission", sub->subscriptionID);
     }
 
-    /* Get the available sequence numbers from the retransmission queue */
+    /* Get the available sequence numbers from the retransmission queue.
+     * Entries can be evicted by other sessions in the meantime. */
+    UA_RETRANSMISSION_LOCK(server);
     size_t available = sub->retransmissionQueueSize;
     if(available > 0) {
         response->availableSequenceNumbers = UA_alloca(available * sizeof(UA_UInt32));
@@ -515,10 +948,11 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
         size_t i = 0;
         UA_NotificationMessageEntry *nme;
         TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
-            response->availableSequenceNumbers[i] = nme->message.sequenceNumber;
+            response->availableSequenceNumbers[i] = nme->sequenceNumber;
             ++i;
         }
     }
+    UA_RETRANSMISSION_UNLOCK(server);
 
     /* Send the response */
     UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
@@ -528,14 +962,16 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
                                        &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
 
     /* Reset subscription state to normal. */
+    UA_Session_unsetSubscriptionReady(sub->session, sub);
     sub->state = UA_SUBSCRIPTIONSTATE_NORMAL;
     sub->currentKeepAliveCount = 0;
     sub->currentLifetimeCount = 0;
 
-    /* Free the response */
-    UA_Array_delete(response->results, response->resultsSize,
-                    &UA_TYPES[UA_TYPES_UINT32]);
-    UA_free(pre); /* no need for UA_PublishResponse_deleteMembers */
+    /* Free the response. The available sequence numbers are on the stack. */
+    response->availableSequenceNumbers = NULL;
+    response->availableSequenceNumbersSize = 0;
+    UA_PublishResponse_deleteMembers(response);
+    UA_free(pre);
 
     /* Repeat if there are more notifications to send */
     if(moreNotifications)
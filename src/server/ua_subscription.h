@@ -47,9 +47,11 @@ typedef struct UA_MonitoredItem {
     // TODO: dataEncoding is hardcoded to UA binary
     UA_DataChangeTrigger trigger;
 
-    /* Sample Job */
-    UA_Guid sampleJobGuid;
-    UA_Boolean sampleJobIsRegistered;
+    /* Sampling */
+    struct UA_SamplingGroup *samplingGroup; /* NULL if not sampled */
+    size_t samplingGroupIndex; /* Position in the group table */
+    UA_Boolean feedStarted; /* Samples were taken from a value handle */
+    UA_UInt32 nextFeedSample; /* Number of the next sample of the handle */
 
     /* Sample Queue */
     UA_ByteString lastSampledValue;
@@ -62,13 +64,42 @@ void UA_MoniteredItem_SampleCallback(UA_Server *server, UA_MonitoredItem *monito
 UA_StatusCode MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon);
 UA_StatusCode MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon);
 
+/******************/
+/* Sampling Group */
+/******************/
+
+/* MonitoredItems with the same sampling interval are sampled together in a
+ * single repeated job. The items of a group are kept in a compact table. They
+ * are not ordered inside the table. Empty groups are removed. With
+ * multithreading, they are freed once the sweeps that were already dispatched
+ * have finished. */
+typedef struct UA_SamplingGroup {
+    LIST_ENTRY(UA_SamplingGroup) listEntry;
+    UA_UInt64 samplingInterval; /* in us */
+    UA_Guid sweepJobGuid;
+    UA_Boolean sweeping; /* Removed after the sweep if it became empty */
+    UA_Boolean removed; /* Not yet freed, but no longer sampled */
+
+    size_t itemsSize;
+    size_t itemsCapacity;
+    UA_MonitoredItem **items;
+} UA_SamplingGroup;
+
+void UA_SamplingGroup_deleteAll(UA_Server *server);
+
 /****************/
 /* Subscription */
 /****************/
 
+/* Sent notification messages are kept in binary encoding until they are
+ * acknowledged. The encoded message is allocated in the same memory block
+ * behind the entry. */
 typedef struct UA_NotificationMessageEntry {
-    TAILQ_ENTRY(UA_NotificationMessageEntry) listEntry;
-    UA_NotificationMessage message;
+    TAILQ_ENTRY(UA_NotificationMessageEntry) listEntry; /* newest first */
+    TAILQ_ENTRY(UA_NotificationMessageEntry) serverEntry; /* oldest first */
+    UA_Subscription *subscription;
+    UA_UInt32 sequenceNumber;
+    UA_ByteString encoded;
 } UA_NotificationMessageEntry;
 
 /* We use only a subset of the states defined in the standard */
@@ -100,6 +131,10 @@ struct UA_Subscription {
     UA_UInt32 currentLifetimeCount;
     UA_UInt32 lastMonitoredItemId;
 
+    /* Waiting for a PublishRequest in the session's ready queue */
+    TAILQ_ENTRY(UA_Subscription) readyEntry;
+    UA_Boolean isReady;
+
     /* Publish Job */
     UA_Guid publishJobGuid;
     UA_Boolean publishJobIsRegistered;
@@ -126,8 +161,23 @@ UA_Subscription_getMonitoredItem(UA_Subscription *sub, UA_UInt32 monitoredItemID
 
 void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub);
 
+/* Stores the message in binary encoding. Evicts the oldest messages of all
+ * subscriptions if the server-wide memory budget is exceeded. */
 UA_StatusCode
-UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequenceNumber);
+UA_Subscription_addRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
+                                         const UA_NotificationMessage *message);
+
+UA_StatusCode
+UA_Subscription_removeRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
+                                            UA_UInt32 sequenceNumber);
+
+/* Decodes the message from the retransmission queue */
+UA_StatusCode
+UA_Subscription_getRetransmissionMessage(UA_Server *server, UA_Subscription *sub,
+                                         UA_UInt32 sequenceNumber,
+                                         UA_NotificationMessage *message);
+
+void UA_RetransmissionQueue_deleteAll(UA_Server *server);
 
 void
 UA_Subscription_answerPublishRequestsNoSubscription(UA_Server *server,
@@ -0,0 +1,503 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_typeindex.h"
+#include "ua_types_generated_handling.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <urcu.h>
+# define UA_TYPEINDEX_LOCK(index) pthread_mutex_lock(&(index)->mutex)
+# define UA_TYPEINDEX_UNLOCK(index) pthread_mutex_unlock(&(index)->mutex)
+#else
+# define UA_TYPEINDEX_LOCK(index)
+# define UA_TYPEINDEX_UNLOCK(index)
+#endif
+
+/* The part of the index that is used by the queries */
+typedef struct UA_TypeIndexView {
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+    size_t typesSize;
+    const UA_TypeIndexEntry *types; /* only the NodeId and the hash are used */
+    size_t mapSize;
+    const UA_UInt32 *map;
+    size_t words; /* per bitset */
+    const UA_UInt64 *subtypeSets;
+} UA_TypeIndexView;
+
+void
+UA_TypeIndex_init(UA_TypeIndex *index) {
+    memset(index, 0, sizeof(UA_TypeIndex));
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&index->mutex, NULL);
+#endif
+}
+
+void
+UA_TypeIndex_deleteMembers(UA_TypeIndex *index) {
+    for(size_t i = 0; i < index->typesSize; ++i) {
+        UA_NodeId_deleteMembers(&index->types[i].nodeId);
+        UA_free(index->types[i].subtypes);
+    }
+    UA_free(index->types);
+    UA_free(index->map);
+    UA_free(index->subtypeSets);
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_free(index->view);
+    pthread_mutex_destroy(&index->mutex);
+#endif
+}
+
+/***********/
+/* Bitsets */
+/***********/
+
+static UA_UInt64 *
+subtypeSet(const UA_TypeIndex *index, UA_UInt32 type) {
+    return &index->subtypeSets[(size_t)type * (index->typesCapacity / 64)];
+}
+
+static UA_Boolean
+testBit(const UA_UInt64 *set, UA_UInt32 bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void
+setBit(UA_UInt64 *set, UA_UInt32 bit) {
+    set[bit / 64] |= (UA_UInt64)1 << (bit % 64);
+}
+
+/* Compute the bitset of a type from the direct subtypes with a depth-first
+ * search. Every type is pushed at most once, so the stack has room for
+ * typesSize entries. */
+static void
+computeSubtypeSet(UA_TypeIndex *index, UA_UInt32 root, UA_UInt32 *stack) {
+    UA_UInt64 *set = subtypeSet(index, root);
+    memset(set, 0, sizeof(UA_UInt64) * (index->typesCapacity / 64));
+    setBit(set, root);
+    size_t stackSize = 0;
+    stack[stackSize++] = root;
+    while(stackSize > 0) {
+        const UA_TypeIndexEntry *type = &index->types[stack[--stackSize]];
+        for(size_t j = 0; j < type->subtypesSize; ++j) {
+            UA_UInt32 sub = type->subtypes[j];
+            if(testBit(set, sub))
+                continue;
+            setBit(set, sub);
+            stack[stackSize++] = sub;
+        }
+    }
+}
+
+/* Recompute all bitsets */
+static void
+recomputeSubtypeSets(UA_TypeIndex *index) {
+    UA_UInt32 *stack = UA_malloc(sizeof(UA_UInt32) * index->typesSize);
+    if(!stack)
+        return; /* stays outdated */
+    for(UA_UInt32 i = 0; i < index->typesSize; ++i)
+        computeSubtypeSet(index, i, stack);
+    UA_free(stack);
+    index->outdated = false;
+}
+
+/* A hasSubtype relation below the type was removed. Only the bitsets of the
+ * type and its supertypes can change. They are found by the (not yet updated)
+ * bit of the type in their sets. */
+static void
+recomputeSupertypeSets(UA_TypeIndex *index, UA_UInt32 type) {
+    if(index->outdated)
+        return;
+    UA_UInt32 *stack = UA_malloc(sizeof(UA_UInt32) * index->typesSize);
+    UA_UInt32 *affected = UA_malloc(sizeof(UA_UInt32) * index->typesSize);
+    if(!stack || !affected) {
+        index->outdated = true;
+        goto cleanup;
+    }
+    size_t affectedSize = 0;
+    for(UA_UInt32 i = 0; i < index->typesSize; ++i) {
+        if(testBit(subtypeSet(index, i), type))
+            affected[affectedSize++] = i;
+    }
+    for(size_t i = 0; i < affectedSize; ++i)
+        computeSubtypeSet(index, affected[i], stack);
+ cleanup:
+    UA_free(stack);
+    UA_free(affected);
+}
+
+/*******************/
+/* NodeId to index */
+/*******************/
+
+static UA_UInt32
+findType(const UA_TypeIndexView *view, const UA_NodeId *nodeId, UA_UInt32 hash) {
+    if(view->mapSize == 0)
+        return UA_TYPEINDEX_NOTFOUND;
+    size_t mask = view->mapSize - 1;
+    for(size_t pos = hash & mask; view->map[pos] != 0; pos = (pos + 1) & mask) {
+        const UA_TypeIndexEntry *type = &view->types[view->map[pos] - 1];
+        if(type->hash == hash && UA_NodeId_equal(&type->nodeId, nodeId))
+            return view->map[pos] - 1;
+    }
+    return UA_TYPEINDEX_NOTFOUND;
+}
+
+/* Points the view to the current state of the index */
+static void
+setLiveView(const UA_TypeIndex *index, UA_TypeIndexView *view) {
+    view->typesSize = index->typesSize;
+    view->types = index->types;
+    view->mapSize = index->mapSize;
+    view->map = index->map;
+    view->words = index->typesCapacity / 64;
+    view->subtypeSets = index->subtypeSets;
+}
+
+static UA_UInt32
+findLiveType(const UA_TypeIndex *index, const UA_NodeId *nodeId) {
+    UA_TypeIndexView view;
+    setLiveView(index, &view);
+    return findType(&view, nodeId, UA_NodeId_hash(nodeId));
+}
+
+static void
+mapInsert(UA_TypeIndex *index, UA_UInt32 type) {
+    size_t mask = index->mapSize - 1;
+    size_t pos = index->types[type].hash & mask;
+    while(index->map[pos] != 0)
+        pos = (pos + 1) & mask;
+    index->map[pos] = type + 1;
+}
+
+/* Double the capacity of the types, the map and the bitsets */
+static UA_StatusCode
+grow(UA_TypeIndex *index) {
+    size_t oldCapacity = index->typesCapacity;
+    size_t capacity = oldCapacity ? oldCapacity * 2 : 64;
+    UA_TypeIndexEntry *types = UA_realloc(index->types, sizeof(UA_TypeIndexEntry) * capacity);
+    if(!types)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    index->types = types;
+
+    size_t words = capacity / 64;
+    size_t oldWords = oldCapacity / 64;
+    UA_UInt64 *sets = UA_calloc(capacity * words, sizeof(UA_UInt64));
+    UA_UInt32 *map = UA_calloc(capacity * 2, sizeof(UA_UInt32));
+    if(!sets || !map) {
+        UA_free(sets);
+        UA_free(map);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < index->typesSize; ++i)
+        memcpy(&sets[i * words], &index->subtypeSets[i * oldWords], sizeof(UA_UInt64) * oldWords);
+    UA_free(index->subtypeSets);
+    index->subtypeSets = sets;
+    index->typesCapacity = capacity;
+
+    UA_free(index->map);
+    index->map = map;
+    index->mapSize = capacity * 2;
+    for(UA_UInt32 i = 0; i < index->typesSize; ++i)
+        mapInsert(index, i);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+getOrAddType(UA_TypeIndex *index, const UA_NodeId *nodeId, UA_UInt32 *type) {
+    UA_UInt32 hash = UA_NodeId_hash(nodeId);
+    UA_TypeIndexView view;
+    setLiveView(index, &view);
+    *type = findType(&view, nodeId, hash);
+    if(*type != UA_TYPEINDEX_NOTFOUND)
+        return UA_STATUSCODE_GOOD;
+    if(index->typesSize == index->typesCapacity) {
+        UA_StatusCode retval = grow(index);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    UA_TypeIndexEntry *entry = &index->types[index->typesSize];
+    UA_StatusCode retval = UA_NodeId_copy(nodeId, &entry->nodeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    entry->hash = hash;
+    entry->subtypesSize = 0;
+    entry->subtypes = NULL;
+    *type = (UA_UInt32)index->typesSize;
+    ++index->typesSize;
+    mapInsert(index, *type);
+    setBit(subtypeSet(index, *type), *type);
+    return UA_STATUSCODE_GOOD;
+}
+
+/*********/
+/* Views */
+/*********/
+
+#ifndef UA_ENABLE_MULTITHREADING
+
+/* Queries and updates alternate. So queries use the index directly. */
+static const UA_TypeIndexView *
+beginQuery(UA_TypeIndex *index, UA_TypeIndexView *live) {
+    if(index->outdated)
+        recomputeSubtypeSets(index);
+    if(index->outdated)
+        return NULL;
+    setLiveView(index, live);
+    return live;
+}
+
+static void
+endQuery(UA_TypeIndex *index, const UA_TypeIndexView *view,
+         const UA_TypeIndexView *live) {}
+
+static void
+withdrawView(UA_TypeIndex *index) {}
+
+#else
+
+static void
+deleteView(struct rcu_head *head) {
+    UA_free(container_of(head, UA_TypeIndexView, rcu_head));
+}
+
+/* Copies the lookup table and the bitsets into a single allocation. The
+ * NodeIds are not copied. They are freed only with the index. */
+static UA_TypeIndexView *
+copyView(const UA_TypeIndex *index) {
+    size_t words = index->typesCapacity / 64;
+    size_t setsSize = sizeof(UA_UInt64) * words * index->typesSize;
+    size_t typesSize = sizeof(UA_TypeIndexEntry) * index->typesSize;
+    size_t mapSize = sizeof(UA_UInt32) * index->mapSize;
+    UA_TypeIndexView *view = UA_malloc(sizeof(UA_TypeIndexView) + setsSize + typesSize + mapSize);
+    if(!view)
+        return NULL;
+    UA_Byte *pos = (UA_Byte*)view + sizeof(UA_TypeIndexView);
+    memcpy(pos, index->subtypeSets, setsSize);
+    view->subtypeSets = (UA_UInt64*)pos;
+    pos += setsSize;
+    memcpy(pos, index->types, typesSize);
+    view->types = (UA_TypeIndexEntry*)pos;
+    pos += typesSize;
+    memcpy(pos, index->map, mapSize);
+    view->map = (UA_UInt32*)pos;
+    view->typesSize = index->typesSize;
+    view->mapSize = index->mapSize;
+    view->words = words;
+    return view;
+}
+
+/* Returns the published view. Without a published view, the lock is taken
+ * and the query uses the index directly until endQuery. Making a view copies
+ * all bitsets. So a new view is only made after more queries than types
+ * without an update in between. Updates interleaved with queries (e.g. while
+ * a nodeset is added) do not copy the index every time. */
+static const UA_TypeIndexView *
+beginQuery(UA_TypeIndex *index, UA_TypeIndexView *live) {
+    UA_TypeIndexView *view = index->view;
+    if(view)
+        return view;
+    UA_TYPEINDEX_LOCK(index);
+    if(index->outdated)
+        recomputeSubtypeSets(index);
+    view = index->view; /* Published in the meantime */
+    if(!view && !index->outdated && ++index->lockedQueries > index->typesSize) {
+        view = copyView(index);
+        if(view) {
+            /* Make the copy visible before publishing the pointer */
+            UA_atomic_sync();
+            index->view = view;
+        }
+    }
+    if(view || index->outdated) {
+        UA_TYPEINDEX_UNLOCK(index);
+        return view;
+    }
+    setLiveView(index, live);
+    return live;
+}
+
+static void
+endQuery(UA_TypeIndex *index, const UA_TypeIndexView *view,
+         const UA_TypeIndexView *live) {
+    if(view == live)
+        UA_TYPEINDEX_UNLOCK(index);
+}
+
+/* Called with the lock held after the index has changed. Queries that still
+ * use the old view are done when it is freed. */
+static void
+withdrawView(UA_TypeIndex *index) {
+    index->lockedQueries = 0;
+    UA_TypeIndexView *view = UA_atomic_xchg((void * volatile *)&index->view, NULL);
+    if(view)
+        call_rcu(&view->rcu_head, deleteView);
+}
+
+#endif
+
+static const UA_UInt64 *
+viewSubtypeSet(const UA_TypeIndexView *view, UA_UInt32 type) {
+    return &view->subtypeSets[(size_t)type * view->words];
+}
+
+/**********************/
+/* Exported functions */
+/**********************/
+
+static UA_StatusCode
+addSubtype(UA_TypeIndex *index, const UA_NodeId *supertype, const UA_NodeId *subtype,
+           UA_Boolean *added) {
+    UA_UInt32 super, sub;
+    UA_StatusCode retval = getOrAddType(index, supertype, &super);
+    retval |= getOrAddType(index, subtype, &sub);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Store the direct subtype */
+    UA_TypeIndexEntry *entry = &index->types[super];
+    for(size_t i = 0; i < entry->subtypesSize; ++i) {
+        if(entry->subtypes[i] == sub)
+            return UA_STATUSCODE_GOOD;
+    }
+    UA_UInt32 *subtypes = UA_realloc(entry->subtypes, sizeof(UA_UInt32) * (entry->subtypesSize + 1));
+    if(!subtypes) {
+        index->outdated = true;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    subtypes[entry->subtypesSize] = sub;
+    entry->subtypes = subtypes;
+    ++entry->subtypesSize;
+    *added = true;
+
+    /* All types with the supertype in their set get the subtypes of the new
+     * subtype */
+    if(index->outdated)
+        return UA_STATUSCODE_GOOD;
+    size_t words = index->typesCapacity / 64;
+    const UA_UInt64 *subSet = subtypeSet(index, sub);
+    for(UA_UInt32 i = 0; i < index->typesSize; ++i) {
+        UA_UInt64 *set = subtypeSet(index, i);
+        if(!testBit(set, super) || i == sub)
+            continue;
+        for(size_t j = 0; j < words; ++j)
+            set[j] |= subSet[j];
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_TypeIndex_addSubtype(UA_TypeIndex *index, const UA_NodeId *supertype,
+                        const UA_NodeId *subtype) {
+    UA_TYPEINDEX_LOCK(index);
+    size_t typesSize = index->typesSize;
+    UA_Boolean added = false;
+    UA_StatusCode retval = addSubtype(index, supertype, subtype, &added);
+    if(added || index->typesSize != typesSize || index->outdated)
+        withdrawView(index);
+    UA_TYPEINDEX_UNLOCK(index);
+    return retval;
+}
+
+static UA_Boolean
+removeDirectSubtype(UA_TypeIndexEntry *entry, UA_UInt32 sub) {
+    for(size_t i = 0; i < entry->subtypesSize; ++i) {
+        if(entry->subtypes[i] != sub)
+            continue;
+        entry->subtypes[i] = entry->subtypes[entry->subtypesSize - 1];
+        --entry->subtypesSize;
+        return true;
+    }
+    return false;
+}
+
+void
+UA_TypeIndex_removeSubtype(UA_TypeIndex *index, const UA_NodeId *supertype,
+                           const UA_NodeId *subtype) {
+    UA_TYPEINDEX_LOCK(index);
+    UA_UInt32 super = findLiveType(index, supertype);
+    UA_UInt32 sub = findLiveType(index, subtype);
+    if(super != UA_TYPEINDEX_NOTFOUND && sub != UA_TYPEINDEX_NOTFOUND &&
+       removeDirectSubtype(&index->types[super], sub)) {
+        recomputeSupertypeSets(index, super);
+        withdrawView(index);
+    }
+    UA_TYPEINDEX_UNLOCK(index);
+}
+
+void
+UA_TypeIndex_removeType(UA_TypeIndex *index, const UA_NodeId *nodeId) {
+    UA_TYPEINDEX_LOCK(index);
+    UA_UInt32 type = findLiveType(index, nodeId);
+    if(type != UA_TYPEINDEX_NOTFOUND) {
+        /* The entry remains with the NodeId but without relations */
+        UA_free(index->types[type].subtypes);
+        index->types[type].subtypes = NULL;
+        index->types[type].subtypesSize = 0;
+        for(size_t i = 0; i < index->typesSize; ++i)
+            removeDirectSubtype(&index->types[i], type);
+        recomputeSupertypeSets(index, type);
+        withdrawView(index);
+    }
+    UA_TYPEINDEX_UNLOCK(index);
+}
+
+UA_Boolean
+UA_TypeIndex_isSubtype(UA_TypeIndex *index, const UA_NodeId *type,
+                       const UA_NodeId *supertype) {
+    if(UA_NodeId_equal(type, supertype))
+        return true;
+    UA_TypeIndexView live;
+    const UA_TypeIndexView *view = beginQuery(index, &live);
+    if(!view)
+        return false;
+    UA_Boolean found = false;
+    UA_UInt32 super = findType(view, supertype, UA_NodeId_hash(supertype));
+    UA_UInt32 sub = findType(view, type, UA_NodeId_hash(type));
+    if(super != UA_TYPEINDEX_NOTFOUND && sub != UA_TYPEINDEX_NOTFOUND)
+        found = testBit(viewSubtypeSet(view, super), sub);
+    endQuery(index, view, &live);
+    return found;
+}
+
+UA_StatusCode
+UA_TypeIndex_addType(UA_TypeIndex *index, const UA_NodeId *type, UA_UInt32 *position) {
+    UA_TYPEINDEX_LOCK(index);
+    size_t typesSize = index->typesSize;
+    UA_StatusCode retval = getOrAddType(index, type, position);
+    if(index->typesSize != typesSize)
+        withdrawView(index);
+    UA_TYPEINDEX_UNLOCK(index);
+    return retval;
+}
+
+UA_UInt32
+UA_TypeIndex_findType(UA_TypeIndex *index, const UA_NodeId *type) {
+    UA_TypeIndexView live;
+    const UA_TypeIndexView *view = beginQuery(index, &live);
+    if(!view)
+        return UA_TYPEINDEX_NOTFOUND;
+    UA_UInt32 found = findType(view, type, UA_NodeId_hash(type));
+    endQuery(index, view, &live);
+    return found;
+}
+
+UA_Boolean
+UA_TypeIndex_isSubtypeAt(UA_TypeIndex *index, UA_UInt32 type, UA_UInt32 supertype) {
+    if(type == UA_TYPEINDEX_NOTFOUND || supertype == UA_TYPEINDEX_NOTFOUND)
+        return false;
+    if(type == supertype)
+        return true;
+    UA_TypeIndexView live;
+    const UA_TypeIndexView *view = beginQuery(index, &live);
+    if(!view)
+        return false;
+    /* The types may have been added after the view was made */
+    UA_Boolean found = false;
+    if(type < view->typesSize && supertype < view->typesSize)
+        found = testBit(viewSubtypeSet(view, supertype), type);
+    endQuery(index, view, &live);
+    return found;
+}
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#ifndef UA_TYPEINDEX_H_
+#define UA_TYPEINDEX_H_
+
+#include "ua_util.h"
+#include "ua_server.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+/**
+ * Type Index
+ * ----------
+ * The server keeps the hasSubtype relations between types (reference types,
+ * data types, object types and variable types) in an index. Every type that
+ * takes part in a hasSubtype reference gets a dense index. For every type, a
+ * bitset over the dense indices holds the type and all its (transitive)
+ * subtypes. So subtype tests are a lookup of the two types and a bit test.
+ *
+ * The index replaces the recursive search for supertypes in the nodestore. It
+ * is updated incrementally. Added hasSubtype references extend the bitsets of
+ * all supertypes. Removed references and types recompute only the bitsets of
+ * the supertypes from the direct subtypes. If memory runs out during an
+ * update, the index is marked outdated and fully recomputed with the next
+ * query.
+ *
+ * With multithreading, the updates are serialized with a mutex. Queries use a
+ * read-only copy of the lookup table and the bitsets that is published with a
+ * pointer swap. They take no lock. An update withdraws the copy and frees it
+ * with call_rcu. Until a new copy is made, queries take the mutex and use the
+ * index directly. The copy is only made after more queries than types without
+ * an update in between. So queries must be made within the RCU read-side
+ * critical section. */
+
+/* The position of types that are not in the index */
+#define UA_TYPEINDEX_NOTFOUND UA_UINT32_MAX
+
+typedef struct {
+    UA_NodeId nodeId;
+    UA_UInt32 hash;
+    size_t subtypesSize;
+    UA_UInt32 *subtypes; /* direct subtypes */
+} UA_TypeIndexEntry;
+
+struct UA_TypeIndexView;
+
+typedef struct {
+    size_t typesSize;
+    size_t typesCapacity; /* multiple of 64 */
+    UA_TypeIndexEntry *types;
+
+    /* Maps NodeIds to the dense index (plus one, zero is empty) */
+    size_t mapSize; /* power of two */
+    UA_UInt32 *map;
+
+    /* One row of typesCapacity bits per type */
+    UA_UInt64 *subtypeSets;
+    UA_Boolean outdated;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t mutex; /* serializes the updates */
+    struct UA_TypeIndexView * volatile view; /* for the queries, or NULL */
+    size_t lockedQueries; /* since the view was withdrawn */
+#endif
+} UA_TypeIndex;
+
+void UA_TypeIndex_init(UA_TypeIndex *index);
+void UA_TypeIndex_deleteMembers(UA_TypeIndex *index);
+
+UA_StatusCode
+UA_TypeIndex_addSubtype(UA_TypeIndex *index, const UA_NodeId *supertype,
+                        const UA_NodeId *subtype);
+
+void
+UA_TypeIndex_removeSubtype(UA_TypeIndex *index, const UA_NodeId *supertype,
+                           const UA_NodeId *subtype);
+
+/* Removes all hasSubtype relations of the type */
+void UA_TypeIndex_removeType(UA_TypeIndex *index, const UA_NodeId *type);
+
+/* Is the type equal to the supertype or a (transitive) subtype? */
+UA_Boolean
+UA_TypeIndex_isSubtype(UA_TypeIndex *index, const UA_NodeId *type,
+                       const UA_NodeId *supertype);
+
+/* Types keep their position in the index until the index is deleted. So the
+ * position can be stored instead of the NodeId. Adds the type if it is not yet
+ * in the index. */
+UA_StatusCode
+UA_TypeIndex_addType(UA_TypeIndex *index, const UA_NodeId *type, UA_UInt32 *position);
+
+/* Returns UA_TYPEINDEX_NOTFOUND if the type is not in the index */
+UA_UInt32 UA_TypeIndex_findType(UA_TypeIndex *index, const UA_NodeId *type);
+
+/* UA_TypeIndex_isSubtype for the positions of the types */
+UA_Boolean
+UA_TypeIndex_isSubtypeAt(UA_TypeIndex *index, UA_UInt32 type, UA_UInt32 supertype);
+
+#endif /* UA_TYPEINDEX_H_ */
@@ -0,0 +1,295 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#include "ua_valuehandle.h"
+#include "ua_types_generated_handling.h"
+
+/* Samples are aligned to eight bytes for 64bit members on 32bit platforms */
+#define UA_VALUEHANDLE_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+/* Numbers of samples wrap around. So the ring can be at most half as large. */
+#define UA_VALUEHANDLE_MAXSAMPLES ((size_t)1 << 24)
+
+static UA_ValueHandleSample *
+getSample(const UA_ValueHandle *handle, UA_UInt32 number) {
+    size_t index = number & (handle->samplesSize - 1);
+    return (UA_ValueHandleSample*)(uintptr_t)(handle->samples + (index * handle->sampleSize));
+}
+
+static UA_Byte *
+sampleData(UA_ValueHandleSample *sample) {
+    return (UA_Byte*)sample + sizeof(UA_ValueHandleSample);
+}
+
+/* Only one thread writes at a time. So the number of the next sample can be
+ * taken from the counter. The counter is increased after the sample is
+ * complete. Zeroes the data if it is NULL. */
+static void
+writeSample(UA_ValueHandle *handle, const void *data,
+            UA_StatusCode status, UA_DateTime sourceTimestamp) {
+    UA_UInt32 number = handle->samplesCount;
+    UA_ValueHandleSample *sample = getSample(handle, number);
+    sample->sequence = sample->sequence + 1;
+    UA_atomic_barrier();
+    sample->number = number;
+    sample->status = status;
+    sample->sourceTimestamp = sourceTimestamp;
+    if(data)
+        memcpy(sampleData(sample), data, handle->dataSize);
+    else
+        memset(sampleData(sample), 0, handle->dataSize);
+    UA_atomic_barrier();
+    sample->sequence = sample->sequence + 1;
+    UA_atomic_barrier();
+    handle->samplesCount = number + 1;
+}
+
+void
+UA_ValueHandle_update(UA_ValueHandle *handle, const void *data,
+                      UA_StatusCode status, UA_DateTime sourceTimestamp) {
+    if(sourceTimestamp == 0)
+        sourceTimestamp = UA_DateTime_now();
+    writeSample(handle, data, status, sourceTimestamp);
+}
+
+UA_StatusCode
+UA_ValueHandle_readSample(const UA_ValueHandle *handle, UA_UInt32 number,
+                          UA_Boolean sourceTimestamp, UA_DataValue *value) {
+    /* Allocate before the sample is copied */
+    void *data;
+    if(handle->arrayLength == 0)
+        data = UA_new(handle->type);
+    else
+        data = UA_Array_new(handle->arrayLength, handle->type);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Copy until the sample was not written in the meantime */
+    UA_ValueHandleSample *sample = getSample(handle, number);
+    UA_Boolean found;
+    UA_StatusCode status;
+    UA_DateTime timestamp;
+    UA_UInt32 sequence;
+    do {
+        sequence = sample->sequence;
+        UA_atomic_barrier();
+        found = (sample->number == number);
+        status = sample->status;
+        timestamp = sample->sourceTimestamp;
+        memcpy(data, sampleData(sample), handle->dataSize);
+        UA_atomic_barrier();
+    } while((sequence & 1) != 0 || sample->sequence != sequence);
+
+    if(!found) {
+        UA_free(data);
+        return UA_STATUSCODE_BADNODATA;
+    }
+
+    if(handle->arrayLength == 0)
+        UA_Variant_setScalar(&value->value, data, handle->type);
+    else
+        UA_Variant_setArray(&value->value, data, handle->arrayLength, handle->type);
+    value->hasValue = true;
+    if(status != UA_STATUSCODE_GOOD) {
+        value->hasStatus = true;
+        value->status = status;
+    }
+    if(sourceTimestamp) {
+        value->hasSourceTimestamp = true;
+        value->sourceTimestamp = timestamp;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The data source of variables with a value handle */
+static UA_StatusCode
+readValueHandle(void *h, const UA_NodeId nodeId, UA_Boolean sourceTimestamp,
+                const UA_NumericRange *range, UA_DataValue *value) {
+    const UA_ValueHandle *handle = (const UA_ValueHandle*)h;
+
+    /* Retry if the most recent sample was overwritten while it was read */
+    UA_StatusCode retval;
+    do {
+        UA_UInt32 count = handle->samplesCount;
+        UA_atomic_barrier();
+        retval = UA_ValueHandle_readSample(handle, count - 1, sourceTimestamp, value);
+    } while(retval == UA_STATUSCODE_BADNODATA);
+    if(retval != UA_STATUSCODE_GOOD || !range)
+        return retval;
+
+    /* Select the range */
+    UA_Variant full = value->value;
+    UA_Variant_init(&value->value);
+    retval = UA_Variant_copyRange(&full, &value->value, *range);
+    UA_Variant_deleteMembers(&full);
+    if(retval != UA_STATUSCODE_GOOD) {
+        value->hasValue = false;
+        value->hasStatus = true;
+        value->status = retval;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_ValueHandle *
+UA_ValueHandle_fromNode(const UA_Node *node) {
+    if(!node || node->nodeClass != UA_NODECLASS_VARIABLE)
+        return NULL;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(vn->valueSource != UA_VALUESOURCE_DATASOURCE ||
+       vn->value.source.dataSource.read != readValueHandle)
+        return NULL;
+    return (UA_ValueHandle*)vn->value.source.dataSource.handle;
+}
+
+/* Does the value have the type and array length of the handle? */
+static UA_Boolean
+matchesHandle(const UA_ValueHandle *handle, const UA_DataValue *value) {
+    if(!value->hasValue || value->value.type != handle->type)
+        return false;
+    if(handle->arrayLength == 0)
+        return UA_Variant_isScalar(&value->value);
+    return (!UA_Variant_isScalar(&value->value) &&
+            value->value.arrayLength == handle->arrayLength);
+}
+
+static UA_StatusCode
+addValueHandle(UA_Server *server, UA_Session *session,
+               UA_VariableNode *node, UA_ValueHandle *handle) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    if(node->valueSource != UA_VALUESOURCE_DATA)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    /* Check the type of the handle once. Values where the type would need to
+     * be adjusted are not accepted. */
+    UA_Variant sample;
+    UA_Variant_init(&sample);
+    sample.type = handle->type;
+    sample.data = sampleData(getSample(handle, 0));
+    sample.arrayLength = handle->arrayLength;
+    UA_Variant editable = sample;
+    UA_StatusCode retval = typeCheckValue(server, &node->dataType, node->valueRank,
+                                          node->arrayDimensionsSize, node->arrayDimensions,
+                                          &sample, NULL, &editable);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(editable.type != handle->type)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+
+    /* Take the current value as the initial sample if it matches */
+    const UA_DataValue *current = UA_VariableNode_getValue(node);
+    handle->samplesCount = 0;
+    if(matchesHandle(handle, current))
+        writeSample(handle, current->value.data,
+                    current->hasStatus ? current->status : UA_STATUSCODE_GOOD,
+                    current->hasSourceTimestamp ? current->sourceTimestamp : UA_DateTime_now());
+    else
+        writeSample(handle, NULL, UA_STATUSCODE_BADWAITINGFORINITIALDATA, UA_DateTime_now());
+
+    /* Read the value from the handle */
+    UA_VariableNode_deleteValue(node);
+    node->valueSource = UA_VALUESOURCE_DATASOURCE;
+    memset(&node->value.source, 0, sizeof(node->value.source));
+    node->value.source.dataSource.handle = handle;
+    node->value.source.dataSource.read = readValueHandle;
+    UA_ReadCache_remove(&server->readCache, &node->nodeId);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_addValueHandle(UA_Server *server, const UA_NodeId nodeId,
+                         const UA_DataType *type, size_t arrayLength,
+                         size_t samplesSize, UA_ValueHandle **handle) {
+    /* The values are copied with memcpy */
+    if(!type || !type->fixedSize)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    if(arrayLength > UA_INT32_MAX || samplesSize > UA_VALUEHANDLE_MAXSAMPLES)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Allocate the handle with the samples */
+    size_t size = 1;
+    while(size < samplesSize)
+        size *= 2;
+    size_t dataSize = type->memSize * (arrayLength > 0 ? arrayLength : 1);
+    size_t sampleSize = UA_VALUEHANDLE_ALIGN(sizeof(UA_ValueHandleSample) + dataSize);
+    size_t headerSize = UA_VALUEHANDLE_ALIGN(sizeof(UA_ValueHandle));
+    UA_ValueHandle *h = UA_calloc(1, headerSize + (size * sampleSize));
+    if(!h)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    h->type = type;
+    h->arrayLength = arrayLength;
+    h->dataSize = dataSize;
+    h->sampleSize = sampleSize;
+    h->samplesSize = size;
+    h->samples = (UA_Byte*)h + headerSize;
+    UA_StatusCode retval = UA_NodeId_copy(&nodeId, &h->nodeId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(h);
+        return retval;
+    }
+
+    UA_RCU_LOCK();
+    retval = UA_Server_editNode(server, &adminSession, &nodeId,
+                                (UA_EditNodeCallback)addValueHandle, h);
+    UA_RCU_UNLOCK();
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeId_deleteMembers(&h->nodeId);
+        UA_free(h);
+        return retval;
+    }
+    *handle = h;
+    return UA_STATUSCODE_GOOD;
+}
+
+typedef struct {
+    const UA_ValueHandle *handle;
+    UA_DataValue value;
+} UA_RemoveValueHandle;
+
+static UA_StatusCode
+removeValueHandle(UA_Server *server, UA_Session *session,
+                  UA_VariableNode *node, const UA_RemoveValueHandle *data) {
+    /* The node was changed in the meantime */
+    if(UA_ValueHandle_fromNode((const UA_Node*)node) != data->handle)
+        return UA_STATUSCODE_BADNOTFOUND;
+    UA_DataValue value;
+    UA_StatusCode retval = UA_DataValue_copy(&data->value, &value);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    node->valueSource = UA_VALUESOURCE_DATA;
+    memset(&node->value, 0, sizeof(node->value));
+    node->value.data.value = value;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_removeValueHandle(UA_Server *server, UA_ValueHandle *handle) {
+    /* Keep the most recent value in the variable */
+    UA_RemoveValueHandle data;
+    data.handle = handle;
+    UA_DataValue_init(&data.value);
+    readValueHandle(handle, handle->nodeId, true, NULL, &data.value);
+    UA_RCU_LOCK();
+    UA_StatusCode retval =
+        UA_Server_editNode(server, &adminSession, &handle->nodeId,
+                           (UA_EditNodeCallback)removeValueHandle, &data);
+    UA_RCU_UNLOCK();
+    UA_DataValue_deleteMembers(&data.value);
+
+    /* The variable still reads from the handle */
+    if(retval != UA_STATUSCODE_GOOD && retval != UA_STATUSCODE_BADNOTFOUND &&
+       retval != UA_STATUSCODE_BADNODEIDUNKNOWN)
+        return retval;
+
+    /* The handle is no longer attached to the variable or the variable was
+     * deleted */
+    UA_NodeId_deleteMembers(&handle->nodeId);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Other threads may still read from the replaced node */
+    UA_Server_delayedFree(server, handle);
+#else
+    UA_free(handle);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
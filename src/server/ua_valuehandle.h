@@ -0,0 +1,53 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+*  License, v. 2.0. If a copy of the MPL was not distributed with this
+*  file, You can obtain one at http://mozilla.org/MPL/2.0/.*/
+
+#ifndef UA_VALUEHANDLE_H_
+#define UA_VALUEHANDLE_H_
+
+#include "ua_server_internal.h"
+
+/**
+ * Value Handles
+ * -------------
+ * The samples of a value handle are kept in a ring buffer. The most recent
+ * sample is the current value of the variable. Every sample is protected by a
+ * sequence lock. The producer increases the sequence number to an odd value
+ * before it writes the sample and to an even value afterwards. Readers copy the
+ * sample and retry if the sequence number was odd or has changed in the
+ * meantime. So the producer never waits for the server.
+ *
+ * The handle is the data source of the variable. Monitored items remember the
+ * number of the next sample they have not seen yet. Samples that were
+ * overwritten before they were sampled are lost. */
+
+typedef struct {
+    volatile UA_UInt32 sequence; /* Odd while the sample is written */
+    UA_UInt32 number; /* Position in the sequence of all samples */
+    UA_StatusCode status;
+    UA_DateTime sourceTimestamp;
+    /* The data follows */
+} UA_ValueHandleSample;
+
+struct UA_ValueHandle {
+    UA_NodeId nodeId;
+    const UA_DataType *type;
+    size_t arrayLength; /* Zero for scalars */
+    size_t dataSize;
+    size_t sampleSize; /* Including the header */
+    size_t samplesSize; /* Power of two */
+    volatile UA_UInt32 samplesCount; /* Number of samples written so far */
+    UA_Byte *samples;
+    /* The samples follow in the same allocation */
+};
+
+/* Returns the handle if the value of the node comes from a value handle */
+UA_ValueHandle * UA_ValueHandle_fromNode(const UA_Node *node);
+
+/* Copies the sample with the given number. Returns UA_STATUSCODE_BADNODATA if
+ * the sample was already overwritten. */
+UA_StatusCode
+UA_ValueHandle_readSample(const UA_ValueHandle *handle, UA_UInt32 number,
+                          UA_Boolean sourceTimestamp, UA_DataValue *value);
+
+#endif /* UA_VALUEHANDLE_H_ */
@@ -21,7 +21,11 @@ UA_Session adminSession = {
     .sessionId = {.namespaceIndex = 0, .identifierType = UA_NODEIDTYPE_NUMERIC, .identifier.numeric = 1},
     .maxRequestMessageSize = UA_UINT32_MAX, .maxResponseMessageSize = UA_UINT32_MAX,
     .timeout = (UA_Double)UA_INT64_MAX, .validTill = UA_INT64_MAX, .channel = NULL,
-    .continuationPoints = {NULL}};
+    .continuationPoints = {NULL},
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    .readySubscriptions = TAILQ_HEAD_INITIALIZER(adminSession.readySubscriptions),
+#endif
+};
 
 void UA_Session_init(UA_Session *session) {
     UA_ApplicationDescription_init(&session->clientDescription);
@@ -36,10 +40,14 @@ void UA_Session_init(UA_Session *session) {
     session->channel = NULL;
     session->availableContinuationPoints = UA_MAXCONTINUATIONPOINTS;
     LIST_INIT(&session->continuationPoints);
+    session->registeredNodesSize = 0;
+    session->registeredNodes = NULL;
+    session->registeredNodesFree = 0;
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     LIST_INIT(&session->serverSubscriptions);
     session->lastSubscriptionID = 0;
     SIMPLEQ_INIT(&session->responseQueue);
+    TAILQ_INIT(&session->readySubscriptions);
 #endif
 }
 
@@ -55,6 +63,12 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
         UA_BrowseDescription_deleteMembers(&cp->browseDescription);
         UA_free(cp);
     }
+    for(size_t i = 0; i < session->registeredNodesSize; ++i)
+        UA_NodeId_deleteMembers(&session->registeredNodes[i].nodeId);
+    UA_free(session->registeredNodes);
+    session->registeredNodes = NULL;
+    session->registeredNodesSize = 0;
+    session->registeredNodesFree = 0;
     if(session->channel)
         UA_SecureChannel_detachSession(session->channel, session);
 #ifdef UA_ENABLE_SUBSCRIPTIONS
@@ -64,6 +78,7 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
         UA_Subscription_deleteMembers(currents, server);
         UA_free(currents);
     }
+    TAILQ_INIT(&session->readySubscriptions);
     UA_PublishResponseEntry *entry;
     while((entry = SIMPLEQ_FIRST(&session->responseQueue))) {
         SIMPLEQ_REMOVE_HEAD(&session->responseQueue, listEntry);
@@ -78,6 +93,86 @@ void UA_Session_updateLifetime(UA_Session *session) {
         (UA_DateTime)(session->timeout * UA_MSEC_TO_DATETIME);
 }
 
+UA_StatusCode
+UA_Session_registerNode(UA_Session *session, const UA_NodeId *nodeId,
+                        UA_NodeId *alias) {
+    /* Grow the table if all entries are used */
+    if(session->registeredNodesFree == session->registeredNodesSize) {
+        if(session->registeredNodesSize >= UA_MAXREGISTEREDNODES)
+            return UA_STATUSCODE_BADTOOMANYOPERATIONS;
+        size_t newSize = session->registeredNodesSize * 2;
+        if(newSize < 16)
+            newSize = 16;
+        if(newSize > UA_MAXREGISTEREDNODES)
+            newSize = UA_MAXREGISTEREDNODES;
+        UA_RegisteredNode *nodes =
+            UA_realloc(session->registeredNodes, newSize * sizeof(UA_RegisteredNode));
+        if(!nodes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memset(&nodes[session->registeredNodesSize], 0,
+               (newSize - session->registeredNodesSize) * sizeof(UA_RegisteredNode));
+        for(size_t i = session->registeredNodesSize; i < newSize; ++i)
+            nodes[i].nextFree = (UA_UInt32)(i + 1);
+        session->registeredNodes = nodes;
+        session->registeredNodesSize = newSize;
+    }
+
+    UA_UInt32 index = session->registeredNodesFree;
+    UA_RegisteredNode *rn = &session->registeredNodes[index];
+    UA_StatusCode retval = UA_NodeId_copy(nodeId, &rn->nodeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    rn->used = true;
+#ifndef UA_ENABLE_MULTITHREADING
+    rn->node = NULL;
+#endif
+    session->registeredNodesFree = rn->nextFree;
+    *alias = UA_NODEID_NUMERIC(UA_REGISTEREDNODES_NAMESPACE,
+                               ((UA_UInt32)rn->generation << 16) | index);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_RegisteredNode *
+UA_Session_getRegisteredNode(UA_Session *session, const UA_NodeId *alias) {
+    if(alias->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE ||
+       alias->identifierType != UA_NODEIDTYPE_NUMERIC)
+        return NULL;
+    UA_UInt32 index = alias->identifier.numeric & 0xffff;
+    if(index >= session->registeredNodesSize)
+        return NULL;
+    UA_RegisteredNode *rn = &session->registeredNodes[index];
+    if(!rn->used || rn->generation != (UA_UInt16)(alias->identifier.numeric >> 16))
+        return NULL;
+    return rn;
+}
+
+void
+UA_Session_unregisterNode(UA_Session *session, const UA_NodeId *alias) {
+    UA_RegisteredNode *rn = UA_Session_getRegisteredNode(session, alias);
+    if(!rn)
+        return;
+    UA_NodeId_deleteMembers(&rn->nodeId);
+    rn->used = false;
+    ++rn->generation; /* old aliases of the entry become invalid */
+    /* Retire the entry when the generation wraps around. Otherwise the aliases
+     * of the first generation would become valid again. */
+    if(rn->generation == 0)
+        return;
+    rn->nextFree = session->registeredNodesFree;
+    session->registeredNodesFree = (UA_UInt32)(rn - session->registeredNodes);
+}
+
+const UA_NodeId *
+UA_Session_resolveNodeId(UA_Session *session, const UA_NodeId *nodeId) {
+    if(nodeId->namespaceIndex != UA_REGISTEREDNODES_NAMESPACE ||
+       nodeId->identifierType != UA_NODEIDTYPE_NUMERIC)
+        return nodeId;
+    UA_RegisteredNode *rn = UA_Session_getRegisteredNode(session, nodeId);
+    if(!rn)
+        return NULL;
+    return &rn->nodeId;
+}
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS
 
 void UA_Session_addSubscription(UA_Session *session, UA_Subscription *newSubscription) {
@@ -110,4 +205,40 @@ UA_UInt32 UA_Session_getUniqueSubscriptionID(UA_Session *session) {
     return ++(session->lastSubscriptionID);
 }
 
+void
+UA_Session_setSubscriptionReady(UA_Session *session, UA_Subscription *sub) {
+    if(sub->isReady)
+        return;
+    /* Insert behind the last subscription with the same or a higher priority.
+     * Sessions have few subscriptions, so a linear search from the tail is
+     * cheap. */
+    UA_Subscription *prev;
+    TAILQ_FOREACH_REVERSE(prev, &session->readySubscriptions,
+                          UA_ListOfReadySubscriptions, readyEntry) {
+        if(prev->priority >= sub->priority)
+            break;
+    }
+    if(prev)
+        TAILQ_INSERT_AFTER(&session->readySubscriptions, prev, sub, readyEntry);
+    else
+        TAILQ_INSERT_HEAD(&session->readySubscriptions, sub, readyEntry);
+    sub->isReady = true;
+}
+
+void
+UA_Session_unsetSubscriptionReady(UA_Session *session, UA_Subscription *sub) {
+    if(!sub->isReady)
+        return;
+    TAILQ_REMOVE(&session->readySubscriptions, sub, readyEntry);
+    sub->isReady = false;
+}
+
+UA_Subscription *
+UA_Session_popReadySubscription(UA_Session *session) {
+    UA_Subscription *sub = TAILQ_FIRST(&session->readySubscriptions);
+    if(sub)
+        UA_Session_unsetSubscriptionReady(session, sub);
+    return sub;
+}
+
 #endif
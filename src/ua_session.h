@@ -12,12 +12,37 @@
 
 #define UA_MAXCONTINUATIONPOINTS 5
 
+/* Aliases returned by the RegisterNodes service are numeric NodeIds in this
+ * namespace. The lower 16 bit of the identifier are the index in the table of
+ * registered nodes, the upper 16 bit are the generation of the table entry.
+ * An entry is not reused once its generation has wrapped around. */
+#define UA_REGISTEREDNODES_NAMESPACE 0xffff
+#define UA_MAXREGISTEREDNODES 0x10000
+
+struct UA_Node;
+
+typedef struct {
+    UA_NodeId nodeId; /* the registered NodeId */
+    UA_Boolean used;
+    UA_UInt16 generation; /* incremented when the entry is unregistered */
+    UA_UInt32 nextFree; /* next unused entry if unused */
+#ifndef UA_ENABLE_MULTITHREADING
+    /* The node is cached until the nodestore changes its version */
+    const struct UA_Node *node;
+    UA_UInt32 nodestoreVersion;
+#endif
+} UA_RegisteredNode;
+
 struct ContinuationPointEntry {
     LIST_ENTRY(ContinuationPointEntry) pointers;
     UA_ByteString        identifier;
     UA_BrowseDescription browseDescription;
     UA_UInt32            continuationIndex;
     UA_UInt32            maxReferences;
+    /* Browsing resumes at the position in the references array if the
+     * references of the node were not changed in between */
+    size_t               referencesIndex;
+    UA_UInt32            referencesVersion;
 };
 
 struct UA_Subscription;
@@ -44,10 +69,16 @@ struct UA_Session {
     UA_SecureChannel *channel;
     UA_UInt16 availableContinuationPoints;
     LIST_HEAD(ContinuationPointList, ContinuationPointEntry) continuationPoints;
+    size_t registeredNodesSize;
+    UA_RegisteredNode *registeredNodes;
+    UA_UInt32 registeredNodesFree; /* first unused entry or registeredNodesSize */
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     UA_UInt32 lastSubscriptionID;
     LIST_HEAD(UA_ListOfUASubscriptions, UA_Subscription) serverSubscriptions;
     SIMPLEQ_HEAD(UA_ListOfQueuedPublishResponses, UA_PublishResponseEntry) responseQueue;
+    /* Late subscriptions waiting for a PublishRequest. Ordered by descending
+     * priority and FIFO within the same priority. */
+    TAILQ_HEAD(UA_ListOfReadySubscriptions, UA_Subscription) readySubscriptions;
 #endif
 };
 
@@ -61,6 +92,29 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server *server);
 /* If any activity on a session happens, the timeout is extended */
 void UA_Session_updateLifetime(UA_Session *session);
 
+/**
+ * Registered Nodes
+ * ^^^^^^^^^^^^^^^^
+ * RegisterNodes binds compact aliases to NodeIds for the lifetime of the
+ * session. The aliases resolve in constant time to the table entry. */
+
+/* Returns the alias in *alias. Fails with BadTooManyOperations if the table is
+ * full. */
+UA_StatusCode
+UA_Session_registerNode(UA_Session *session, const UA_NodeId *nodeId,
+                        UA_NodeId *alias);
+
+void UA_Session_unregisterNode(UA_Session *session, const UA_NodeId *alias);
+
+/* Returns NULL if the NodeId is not a registered alias of the session */
+UA_RegisteredNode *
+UA_Session_getRegisteredNode(UA_Session *session, const UA_NodeId *alias);
+
+/* Returns the registered NodeId for an alias, NULL for an unknown alias and
+ * the NodeId itself otherwise */
+const UA_NodeId *
+UA_Session_resolveNodeId(UA_Session *session, const UA_NodeId *nodeId);
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS
 void UA_Session_addSubscription(UA_Session *session, UA_Subscription *newSubscription);
 
@@ -73,6 +127,18 @@ UA_Session_deleteSubscription(UA_Server *server, UA_Session *session,
 
 UA_UInt32
 UA_Session_getUniqueSubscriptionID(UA_Session *session);
+
+/* Queue a subscription that could not publish for lack of a PublishRequest.
+ * Does nothing if the subscription is already queued. */
+void
+UA_Session_setSubscriptionReady(UA_Session *session, UA_Subscription *sub);
+
+void
+UA_Session_unsetSubscriptionReady(UA_Session *session, UA_Subscription *sub);
+
+/* Dequeue the waiting subscription with the highest priority */
+UA_Subscription *
+UA_Session_popReadySubscription(UA_Session *session);
 #endif
 
 /**
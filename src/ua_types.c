@@ -79,6 +79,8 @@ UA_Boolean
 UA_String_equal(const UA_String *s1, const UA_String *s2) {
     if(s1->length != s2->length)
         return false;
+    if(s1->data == s2->data) /* e.g. interned strings */
+        return true;
     UA_Int32 is = memcmp((char const*)s1->data,
                          (char const*)s2->data, s1->length);
     return (is == 0) ? true : false;
@@ -276,16 +278,37 @@ UA_NodeId_equal(const UA_NodeId *n1, const UA_NodeId *n2) {
     return false;
 }
 
-/* FNV non-cryptographic hash function. See
- * https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function */
-#define FNV_PRIME_32 16777619
+/* Non-cryptographic hash that consumes 64bit words at a time. The words are
+ * mixed in with a multiplication and a rotation. The final avalanche step is
+ * the finalizer of MurmurHash3. So the lower bits are well distributed for
+ * power-of-two hash tables. */
+#define HASH_MULT_64 0x9E3779B97F4A7C15ull
+
+static UA_UInt64
+mix64(UA_UInt64 h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
 static UA_UInt32
-fnv32(UA_UInt32 fnv, const UA_Byte *buf, size_t size) {
-    for(size_t i = 0; i < size; ++i) {
-        fnv = fnv ^ (buf[i]);
-        fnv = fnv * FNV_PRIME_32;
+hashBytes(UA_UInt64 seed, const UA_Byte *buf, size_t size) {
+    UA_UInt64 h = seed ^ ((UA_UInt64)size * HASH_MULT_64);
+    UA_UInt64 word;
+    for(; size >= 8; buf += 8, size -= 8) {
+        memcpy(&word, buf, 8);
+        h = (h ^ word) * HASH_MULT_64;
+        h = (h << 31) | (h >> 33);
     }
-    return fnv;
+    if(size > 0) {
+        word = 0;
+        memcpy(&word, buf, size);
+        h = (h ^ word) * HASH_MULT_64;
+    }
+    return (UA_UInt32)mix64(h);
 }
 
 UA_UInt32
@@ -293,15 +316,20 @@ UA_NodeId_hash(const UA_NodeId *n) {
     switch(n->identifierType) {
     case UA_NODEIDTYPE_NUMERIC:
     default:
-        return (UA_UInt32)(n->namespaceIndex + (n->identifier.numeric * 2654435761)); /*  Knuth's multiplicative hashing */
+        return (UA_UInt32)mix64(((UA_UInt64)n->namespaceIndex << 32) | n->identifier.numeric);
     case UA_NODEIDTYPE_STRING:
     case UA_NODEIDTYPE_BYTESTRING:
-        return fnv32(n->namespaceIndex, n->identifier.string.data, n->identifier.string.length);
+        return hashBytes(n->namespaceIndex, n->identifier.string.data, n->identifier.string.length);
     case UA_NODEIDTYPE_GUID:
-        return fnv32(n->namespaceIndex, (const UA_Byte*)&n->identifier.guid, sizeof(UA_Guid));
+        return hashBytes(n->namespaceIndex, (const UA_Byte*)&n->identifier.guid, sizeof(UA_Guid));
     }
 }
 
+UA_UInt32
+UA_String_hash(const UA_String *s) {
+    return hashBytes(0, s->data, s->length);
+}
+
 /* ExpandedNodeId */
 static void
 ExpandedNodeId_deleteMembers(UA_ExpandedNodeId *p, const UA_DataType *_) {
@@ -11,6 +11,15 @@
 #include <assert.h>
 #define UA_assert(ignore) assert(ignore)
 
+/* MemoryBarrier. Included before the BSD queue macros that redefine
+ * SLIST_ENTRY. */
+#ifdef _MSC_VER
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN /* No winsock.h, conflicts with winsock2.h */
+# endif
+# include <windows.h>
+#endif
+
 /* BSD Queue Macros */
 #include "queue.h"
 
@@ -46,6 +55,15 @@
 # endif
 #endif
 
+/* Memory barrier that is also used without multithreading. For data that is
+ * shared with threads outside of the server. A hardware fence on all
+ * compilers, _ReadWriteBarrier only constrains the MSVC optimizer. */
+#ifdef _MSC_VER /* Visual Studio */
+# define UA_atomic_barrier() MemoryBarrier()
+#else /* GCC/Clang */
+# define UA_atomic_barrier() __sync_synchronize()
+#endif
+
 static UA_INLINE void *
 UA_atomic_xchg(void * volatile * addr, void *newptr) {
 #ifndef UA_ENABLE_MULTITHREADING
@@ -4,12 +4,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "ua_types.h"
 #include "server/ua_nodestore.h"
 #include "server/ua_server_internal.h"
 #include "ua_util.h"
+#include "ua_config_standard.h"
 #include "check.h"
 
 #ifdef UA_ENABLE_MULTITHREADING
@@ -17,10 +19,22 @@
 #include <urcu.h>
 #endif
 
+/* The nodestore backends under test. All backends run the same test cases. */
+typedef struct {
+    const char *name;
+    UA_NodeStore * (*create)(void);
+} NodeStoreBackend;
+
+static const NodeStoreBackend backends[] = {
+    {"default", UA_NodeStore_new}
+};
+
+static const NodeStoreBackend *backend;
+
 UA_NodeStore *ns;
 
 static void setup(void) {
-    ns = UA_NodeStore_new();
+    ns = backend->create();
     UA_RCU_LOCK();
 }
 
@@ -29,19 +43,28 @@ static void teardown(void) {
     UA_RCU_UNLOCK();
 }
 
+/* With multithreading, removed nodes are freed after the readers are done */
+static void waitForRemovedNodes(void) {
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_RCU_UNLOCK();
+    rcu_barrier();
+    UA_RCU_LOCK();
+#endif
+}
+
 int zeroCnt = 0;
 int visitCnt = 0;
-static void checkZeroVisitor(const UA_Node* node) {
+static void checkZeroVisitor(void *context, const UA_Node* node) {
     visitCnt++;
     if (node == NULL) zeroCnt++;
 }
 
-static void printVisitor(const UA_Node* node) {
+static void printVisitor(void *context, const UA_Node* node) {
     printf("%d\n", node->nodeId.identifier.numeric);
 }
 
 static UA_Node* createNode(UA_Int16 nsid, UA_Int32 id) {
-    UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode();
+    UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode(ns);
     p->nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
     p->nodeId.namespaceIndex = nsid;
     p->nodeId.identifier.numeric = id;
@@ -130,7 +153,7 @@ START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
 
     zeroCnt = 0;
     visitCnt = 0;
-    UA_NodeStore_iterate(ns,checkZeroVisitor);
+    UA_NodeStore_iterate(ns, checkZeroVisitor, NULL);
     ck_assert_int_eq(zeroCnt, 0);
     ck_assert_int_eq(visitCnt, 6);
 }
@@ -145,7 +168,7 @@ START_TEST(findNodeInExpandedNamespace) {
     UA_Node *n2 = createNode(0,25);
     const UA_Node* nr = UA_NodeStore_get(ns,&n2->nodeId);
     ck_assert_int_eq(nr->nodeId.identifier.numeric,n2->nodeId.identifier.numeric);
-    UA_NodeStore_deleteNode(n2);
+    UA_NodeStore_deleteNode(ns, n2);
 }
 END_TEST
 
@@ -157,7 +180,7 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
     // when
     zeroCnt = 0;
     visitCnt = 0;
-    UA_NodeStore_iterate(ns,checkZeroVisitor);
+    UA_NodeStore_iterate(ns, checkZeroVisitor, NULL);
     // then
     ck_assert_int_eq(zeroCnt, 0);
     ck_assert_int_eq(visitCnt, 200);
@@ -182,6 +205,135 @@ START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+START_TEST(insertAndRemoveManyNodes) {
+    /* The table grows and shrinks. Removed nodes leave no gaps in the probe
+     * sequences of the remaining nodes. (Identifier zero is a null NodeId.) */
+    for(UA_Int32 i = 1; i <= 10000; i++)
+        ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(1, i)), UA_STATUSCODE_GOOD);
+    UA_Node *dup = createNode(1, 5000);
+    ck_assert_int_eq(UA_NodeStore_insert(ns, dup), UA_STATUSCODE_BADNODEIDEXISTS);
+    for(UA_Int32 i = 2; i <= 10000; i += 2) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+    }
+    for(UA_Int32 i = 1; i <= 10000; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        const UA_Node *n = UA_NodeStore_get(ns, &id);
+        if(i % 2 == 0) {
+            ck_assert_ptr_eq(n, NULL);
+        } else {
+            ck_assert_ptr_ne(n, NULL);
+            ck_assert_int_eq(n->nodeId.identifier.numeric, i);
+        }
+    }
+    for(UA_Int32 i = 1; i <= 10000; i += 2) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+    }
+    zeroCnt = 0;
+    visitCnt = 0;
+    UA_NodeStore_iterate(ns, checkZeroVisitor, NULL);
+    ck_assert_int_eq(visitCnt, 0);
+
+    /* Fresh NodeIds are assigned for null NodeIds */
+    UA_Node *n1 = createNode(1, 0);
+    UA_Node *n2 = createNode(1, 0);
+    ck_assert_int_eq(UA_NodeStore_insert(ns, n1), UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(UA_NodeStore_insert(ns, n2), UA_STATUSCODE_GOOD);
+    ck_assert(!UA_NodeId_equal(&n1->nodeId, &n2->nodeId));
+    ck_assert_ptr_eq(UA_NodeStore_get(ns, &n2->nodeId), n2);
+}
+END_TEST
+
+START_TEST(memoryStatistics) {
+    UA_NodeStoreStatistics stats;
+    if(UA_NodeStore_getStatistics(ns, &stats) != UA_STATUSCODE_GOOD)
+        return; /* the statistics are optional */
+    ck_assert_uint_eq(stats.nodes[1], 0);
+    for(UA_Int32 i = 1; i <= 100; i++)
+        UA_NodeStore_insert(ns, createNode(1, i));
+    UA_Node *object = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+    object->nodeId = UA_NODEID_NUMERIC(1, 5000);
+    UA_NodeStore_insert(ns, object);
+    UA_NodeStore_getStatistics(ns, &stats);
+    ck_assert_uint_eq(stats.nodes[0], 1); /* Object */
+    ck_assert_uint_eq(stats.nodes[1], 100); /* Variable */
+    size_t inUse = stats.bytesInUse;
+    size_t allocated = stats.bytesInUse + stats.bytesSlack;
+    ck_assert_uint_ge(inUse, 100 * sizeof(UA_VariableNode) + sizeof(UA_ObjectNode));
+
+    /* Removed nodes become slack */
+    for(UA_UInt32 i = 1; i <= 50; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+        UA_NodeStore_remove(ns, &id);
+    }
+    waitForRemovedNodes();
+    UA_NodeStore_getStatistics(ns, &stats);
+    ck_assert_uint_eq(stats.nodes[1], 50);
+    ck_assert_uint_lt(stats.bytesInUse, inUse);
+    ck_assert_uint_eq(stats.bytesInUse + stats.bytesSlack, allocated);
+
+    /* The memory of removed nodes is reused */
+    for(UA_Int32 i = 101; i <= 150; i++)
+        UA_NodeStore_insert(ns, createNode(1, i));
+    UA_NodeStore_getStatistics(ns, &stats);
+    ck_assert_uint_eq(stats.nodes[1], 100);
+    ck_assert_uint_eq(stats.bytesInUse, inUse);
+    ck_assert_uint_eq(stats.bytesInUse + stats.bytesSlack, allocated);
+}
+END_TEST
+
+#ifndef UA_ENABLE_MULTITHREADING
+static size_t
+internedStringsCount(void) {
+    UA_NodeStoreStatistics stats;
+    UA_NodeStore_getStatistics(ns, &stats);
+    return stats.strings;
+}
+
+START_TEST(internedStrings) {
+    ck_assert_uint_eq(internedStringsCount(), 0);
+    UA_Node *n1 = createNode(1, 1);
+    UA_Node *n2 = createNode(1, 2);
+    n1->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+    n2->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+    n1->displayName = UA_LOCALIZEDTEXT_ALLOC("en", "");
+    ck_assert_ptr_ne(n1->browseName.name.data, n2->browseName.name.data);
+    UA_NodeStore_insert(ns, n1);
+    UA_NodeStore_insert(ns, n2);
+
+    /* Equal strings share the memory. Empty strings are not interned. */
+    ck_assert_ptr_eq(n1->browseName.name.data, n2->browseName.name.data);
+    ck_assert_uint_eq(internedStringsCount(), 2);
+    ck_assert_ptr_eq(n1->displayName.text.data, UA_EMPTY_ARRAY_SENTINEL);
+    ck_assert_ptr_eq(n2->displayName.text.data, NULL);
+
+    /* Every nodestore has its own pool */
+    UA_NodeStore *other = backend->create();
+    UA_Node *n3 = UA_NodeStore_newNode(other, UA_NODECLASS_OBJECT);
+    n3->nodeId = UA_NODEID_NUMERIC(1, 3);
+    n3->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+    UA_NodeStore_insert(other, n3);
+    ck_assert_ptr_ne(n3->browseName.name.data, n1->browseName.name.data);
+    ck_assert_uint_eq(internedStringsCount(), 2);
+    UA_NodeStore_delete(other);
+
+    /* Copies have their own strings */
+    UA_Node *copy = UA_NodeStore_getCopy(ns, &n1->nodeId);
+    ck_assert_ptr_ne(copy->browseName.name.data, n1->browseName.name.data);
+    ck_assert(UA_String_equal(&copy->browseName.name, &n1->browseName.name));
+    UA_NodeStore_deleteNode(ns, copy);
+
+    /* The strings are freed with the last node that uses them */
+    UA_NodeStore_remove(ns, &n1->nodeId);
+    ck_assert_uint_eq(internedStringsCount(), 1);
+    UA_NodeId id2 = UA_NODEID_NUMERIC(1, 2);
+    UA_NodeStore_remove(ns, &id2);
+    ck_assert_uint_eq(internedStringsCount(), 0);
+}
+END_TEST
+#endif
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -231,7 +383,8 @@ START_TEST(profileGetDelete) {
     for (int i = 0; i < THREADS; i++)
         pthread_join(t[i], NULL);
     end = clock();
-    printf("Time for %d create/get/delete on %d threads in a namespace: %fs.\n", N, THREADS, (double)(end - begin) / CLOCKS_PER_SEC);
+    printf("Time for %d create/get/delete on %d threads in a namespace (%s nodestore): %fs.\n",
+           N, THREADS, backend->name, (double)(end - begin) / CLOCKS_PER_SEC);
 #else
     UA_NodeId id;
     UA_NodeId_init(&id);
@@ -242,12 +395,44 @@ START_TEST(profileGetDelete) {
         }
     }
     end = clock();
-    printf("Time for single-threaded %d create/get/delete in a namespace: %fs.\n", N, (double)(end - begin) / CLOCKS_PER_SEC);
+    printf("Time for single-threaded %d create/get/delete in a namespace (%s nodestore): %fs.\n",
+           N, backend->name, (double)(end - begin) / CLOCKS_PER_SEC);
 #endif
 }
 END_TEST
 
-static Suite * namespace_suite (void) {
+START_TEST(serverUsesConfiguredNodeStore) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nodestore = backend->create();
+    UA_Server *server = UA_Server_new(config);
+    ck_assert_ptr_eq(server->nodestore, config.nodestore);
+    UA_NodeId root = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    UA_RCU_LOCK();
+    ck_assert_ptr_ne(UA_NodeStore_get(server->nodestore, &root), NULL);
+    UA_RCU_UNLOCK();
+    UA_Server_delete(server); /* deletes the nodestore */
+}
+END_TEST
+
+START_TEST(serverWritesInternedBrowseName) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nodestore = backend->create();
+    UA_Server *server = UA_Server_new(config);
+    UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_QualifiedName name = UA_QUALIFIEDNAME(1, "Plant");
+    UA_StatusCode retval = UA_Server_writeBrowseName(server, objects, name);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_QualifiedName readName;
+    retval = UA_Server_readBrowseName(server, objects, &readName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(readName.namespaceIndex, 1);
+    ck_assert(UA_String_equal(&readName.name, &name.name));
+    UA_QualifiedName_deleteMembers(&readName);
+    UA_Server_delete(server);
+}
+END_TEST
+
+static Suite * namespace_suite (UA_Boolean profile) {
     Suite *s = suite_create ("UA_NodeStore");
 
     TCase* tc_find = tcase_create ("Find");
@@ -257,8 +442,17 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_find, findNodeInExpandedNamespace);
     tcase_add_test (tc_find, failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries);
     tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
+    tcase_add_test (tc_find, insertAndRemoveManyNodes);
     suite_add_tcase (s, tc_find);
 
+    TCase* tc_memory = tcase_create ("Memory");
+    tcase_add_checked_fixture(tc_memory, setup, teardown);
+    tcase_add_test (tc_memory, memoryStatistics);
+#ifndef UA_ENABLE_MULTITHREADING
+    tcase_add_test (tc_memory, internedStrings);
+#endif
+    suite_add_tcase (s, tc_memory);
+
     TCase *tc_replace = tcase_create("Replace");
     tcase_add_checked_fixture(tc_replace, setup, teardown);
     tcase_add_test (tc_replace, replaceExistingNode);
@@ -271,27 +465,40 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_iterate, iterateOverExpandedNamespaceShallNotVisitEmptyNodes);
     suite_add_tcase (s, tc_iterate);
     
-    /* TCase* tc_profile = tcase_create ("Profile"); */
-    /* tcase_add_checked_fixture(tc_profile, setup, teardown); */
-    /* tcase_add_test (tc_profile, profileGetDelete); */
-    /* suite_add_tcase (s, tc_profile); */
+    TCase* tc_server = tcase_create ("Server");
+    tcase_add_test (tc_server, serverUsesConfiguredNodeStore);
+    tcase_add_test (tc_server, serverWritesInternedBrowseName);
+    suite_add_tcase (s, tc_server);
+
+    /* Compare the backends with "check_nodestore profile" */
+    if(profile) {
+        TCase* tc_profile = tcase_create ("Profile");
+        tcase_add_checked_fixture(tc_profile, setup, teardown);
+        tcase_add_test (tc_profile, profileGetDelete);
+        suite_add_tcase (s, tc_profile);
+    }
 
     return s;
 }
 
 
-int main (void) {
+int main (int argc, char **argv) {
 #ifdef UA_ENABLE_MULTITHREADING
     rcu_init();
     rcu_register_thread();
 #endif
+    UA_Boolean profile = (argc > 1 && strcmp(argv[1], "profile") == 0);
     int number_failed = 0;
-    Suite *s = namespace_suite();
-    SRunner *sr = srunner_create(s);
-    srunner_set_fork_status(sr,CK_NOFORK);
-    srunner_run_all(sr, CK_NORMAL);
-    number_failed += srunner_ntests_failed (sr);
-    srunner_free(sr);
+    for(size_t i = 0; i < sizeof(backends) / sizeof(NodeStoreBackend); i++) {
+        backend = &backends[i];
+        printf("Testing the %s nodestore\n", backend->name);
+        Suite *s = namespace_suite(profile);
+        SRunner *sr = srunner_create(s);
+        srunner_set_fork_status(sr,CK_NOFORK);
+        srunner_run_all(sr, CK_NORMAL);
+        number_failed += srunner_ntests_failed (sr);
+        srunner_free(sr);
+    }
 #ifdef UA_ENABLE_MULTITHREADING
     rcu_barrier();
     rcu_unregister_thread();
@@ -0,0 +1,152 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* Measures insert, get and remove in the nodestore for 10k up to 10M nodes
+   (or the number of nodes given as argument). Numeric and string NodeIds are
+   measured separately. The nodes are allocated before the time is taken. The
+   growth of the address space for the nodes and the nodestore is printed
+   (Linux only) together with the memory statistics of the nodestore. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ua_types.h"
+#include "server/ua_nodestore.h"
+#include "server/ua_server_internal.h"
+#include "ua_util.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <urcu.h>
+#endif
+
+/* Visit the nodes in a scattered order */
+#define STRIDE 7919
+
+static double
+nsPerOp(clock_t begin, clock_t end, size_t ops) {
+    return (double)(end - begin) * 1e9 / CLOCKS_PER_SEC / (double)ops;
+}
+
+/* The size of the address space of the process */
+static size_t
+addressSpace(void) {
+    size_t pages = 0;
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/statm", "r");
+    if(!f)
+        return 0;
+    unsigned long vmPages;
+    if(fscanf(f, "%lu", &vmPages) == 1)
+        pages = vmPages;
+    fclose(f);
+#endif
+    return pages * 4096;
+}
+
+static double
+megabytes(size_t bytes) {
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+static void
+makeNodeId(UA_NodeId *id, UA_UInt16 nsIndex, size_t i, enum UA_NodeIdType type) {
+    if(type == UA_NODEIDTYPE_NUMERIC) {
+        *id = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i + 1); /* zero is a null NodeId */
+        return;
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "Plant.Line%u.Cell%u.Node%lu", (unsigned)(i % 10),
+             (unsigned)(i % 100), (unsigned long)i);
+    *id = UA_NODEID_STRING_ALLOC(nsIndex, buf);
+}
+
+static UA_StatusCode
+benchmark(size_t n, enum UA_NodeIdType type) {
+    UA_NodeId *ids = UA_Array_new(n, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_NodeId *missing = UA_Array_new(n, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Node **nodes = UA_malloc(sizeof(UA_Node*) * n);
+    UA_NodeStore *ns = UA_NodeStore_new();
+    if(!ids || !missing || !nodes || !ns) {
+        UA_Array_delete(ids, n, &UA_TYPES[UA_TYPES_NODEID]);
+        UA_Array_delete(missing, n, &UA_TYPES[UA_TYPES_NODEID]);
+        UA_free(nodes);
+        if(ns)
+            UA_NodeStore_delete(ns);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < n; ++i) {
+        makeNodeId(&ids[i], 1, i, type);
+        makeNodeId(&missing[i], 2, i, type);
+    }
+
+    size_t memBefore = addressSpace();
+    for(size_t i = 0; i < n; ++i) {
+        nodes[i] = UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECT);
+        if(!nodes[i]) {
+            printf("out of memory after %lu nodes\n", (unsigned long)i);
+            exit(EXIT_FAILURE);
+        }
+        retval |= UA_NodeId_copy(&ids[i], &nodes[i]->nodeId);
+    }
+
+    UA_RCU_LOCK();
+    clock_t t0 = clock();
+    for(size_t i = 0; i < n; ++i)
+        retval |= UA_NodeStore_insert(ns, nodes[i]);
+    clock_t t1 = clock();
+    size_t memAfter = addressSpace();
+    UA_NodeStoreStatistics stats;
+    memset(&stats, 0, sizeof(UA_NodeStoreStatistics));
+    UA_NodeStore_getStatistics(ns, &stats);
+    size_t found = 0;
+    for(size_t i = 0, j = 0; i < n; ++i, j = (j + STRIDE) % n)
+        found += (UA_NodeStore_get(ns, &ids[j]) != NULL);
+    clock_t t2 = clock();
+    for(size_t i = 0, j = 0; i < n; ++i, j = (j + STRIDE) % n)
+        found += (UA_NodeStore_get(ns, &missing[j]) != NULL);
+    clock_t t3 = clock();
+    for(size_t i = 0, j = 0; i < n; ++i, j = (j + STRIDE) % n)
+        retval |= UA_NodeStore_remove(ns, &ids[j]);
+    clock_t t4 = clock();
+
+    printf("%9lu %s nodes: insert %7.1f ns, get %7.1f ns, miss %7.1f ns, remove %7.1f ns\n",
+           (unsigned long)n, type == UA_NODEIDTYPE_NUMERIC ? "numeric" : "string ",
+           nsPerOp(t0, t1, n), nsPerOp(t1, t2, n), nsPerOp(t2, t3, n), nsPerOp(t3, t4, n));
+    printf("%9s address space %+8.1f MB, node entries %8.1f MB, slack %6.1f MB\n", "",
+           megabytes(memAfter - memBefore), megabytes(stats.bytesInUse),
+           megabytes(stats.bytesSlack));
+    if(found != n)
+        retval |= UA_STATUSCODE_BADINTERNALERROR;
+
+    UA_NodeStore_delete(ns);
+    UA_RCU_UNLOCK();
+    UA_free(nodes);
+    UA_Array_delete(ids, n, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Array_delete(missing, n, &UA_TYPES[UA_TYPES_NODEID]);
+    return retval;
+}
+
+int main(int argc, char **argv) {
+    size_t maxNodes = 10000000;
+    if(argc > 1)
+        maxNodes = strtoul(argv[1], NULL, 10);
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_init();
+    rcu_register_thread();
+#endif
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t n = 10000; n <= maxNodes; n *= 10) {
+        retval |= benchmark(n, UA_NODEIDTYPE_NUMERIC);
+        retval |= benchmark(n, UA_NODEIDTYPE_STRING);
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_barrier();
+    rcu_unregister_thread();
+#endif
+    printf("retval is %i\n", retval);
+    return (retval == UA_STATUSCODE_GOOD) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This benchmark measures how late high-resolution repeated jobs are executed
+   by the main loop. The server does not open a TCP port. Unlike the other
+   tests, it runs on the system clock. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_config_standard.h"
+
+#define SAMPLES 4000
+
+typedef struct {
+    UA_DateTime start;
+    UA_DateTime interval; /* in 100ns */
+    size_t count;
+    UA_DateTime lateness[SAMPLES];
+} JitterMeasurement;
+
+static void
+measureJob(UA_Server *server, void *data) {
+    JitterMeasurement *m = (JitterMeasurement*)data;
+    if(m->count >= SAMPLES)
+        return;
+    /* The k-th execution is scheduled at start + k * interval. Executions that
+     * are skipped because the main loop was too late show up as lateness of
+     * all following executions. */
+    m->count++;
+    UA_DateTime deadline = m->start + ((UA_DateTime)m->count * m->interval);
+    m->lateness[m->count - 1] = UA_DateTime_nowMonotonic() - deadline;
+}
+
+static int
+compareDateTime(const void *a, const void *b) {
+    UA_DateTime da = *(const UA_DateTime*)a;
+    UA_DateTime db = *(const UA_DateTime*)b;
+    return (da > db) - (da < db);
+}
+
+static double
+percentileUs(const UA_DateTime *sorted, size_t size, double p) {
+    size_t i = (size_t)(p * (double)(size - 1));
+    return (double)sorted[i] / (double)UA_USEC_TO_DATETIME;
+}
+
+static UA_StatusCode
+runBenchmark(UA_UInt64 intervalUs) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.networkLayersSize = 0;
+    UA_Server *server = UA_Server_new(config);
+
+    JitterMeasurement *m = (JitterMeasurement*)calloc(1, sizeof(JitterMeasurement));
+    m->interval = (UA_DateTime)intervalUs * UA_USEC_TO_DATETIME;
+
+    UA_Job job;
+    job.type = UA_JOBTYPE_METHODCALL;
+    job.job.methodCall.method = measureJob;
+    job.job.methodCall.data = m;
+    UA_StatusCode retval = UA_Server_run_startup(server);
+    m->start = UA_DateTime_nowMonotonic();
+    retval |= UA_Server_addRepeatedJobHighRes(server, job, intervalUs, NULL);
+    while(retval == UA_STATUSCODE_GOOD && m->count < SAMPLES)
+        UA_Server_run_iterate(server, true);
+    retval |= UA_Server_run_shutdown(server);
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        qsort(m->lateness, m->count, sizeof(UA_DateTime), compareDateTime);
+        printf("interval %5lu us | lateness p50 %8.1f us | p99 %8.1f us | p999 %8.1f us\n",
+               (unsigned long)intervalUs, percentileUs(m->lateness, m->count, 0.5),
+               percentileUs(m->lateness, m->count, 0.99),
+               percentileUs(m->lateness, m->count, 0.999));
+    }
+
+    free(m);
+    UA_Server_delete(server);
+    return retval;
+}
+
+int main(int argc, char** argv) {
+    UA_StatusCode retval = runBenchmark(1000);
+    retval |= runBenchmark(500);
+    printf("retval is %i\n", retval);
+    return (int)retval;
+}
@@ -22,6 +22,7 @@
 #endif
 
 #include "server/ua_services.h"
+#include "server/ua_server_internal.h"
 #include "ua_types_encoding_binary.h"
 
 int main(int argc, char** argv) {
@@ -73,7 +74,9 @@ int main(int argc, char** argv) {
         retval |= UA_decodeBinary(&request_msg, &offset, &rq, &UA_TYPES[UA_TYPES_READREQUEST]);
 
         UA_ReadResponse_init(&rr);
+        UA_RCU_LOCK();
         Service_Read(server, &adminSession, &rq, &rr);
+        UA_RCU_UNLOCK();
 
         offset = 0;
         retval |= UA_encodeBinary(&rr, &UA_TYPES[UA_TYPES_READRESPONSE], NULL, NULL, &response_msg, &offset);
@@ -14,16 +14,82 @@
 #include "ua_types.h"
 #include "ua_config_standard.h"
 #include "server/ua_server_internal.h"
+#include "testing_clock.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#include <urcu.h>
+#endif
+
+static size_t readCPUTemperatureCount = 0;
 
 static UA_StatusCode
 readCPUTemperature(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
                    const UA_NumericRange *range, UA_DataValue *dataValue) {
+    ++readCPUTemperatureCount;
     UA_Float temp = 20.5f;
     UA_Variant_setScalarCopy(&dataValue->value, &temp, &UA_TYPES[UA_TYPES_FLOAT]);
     dataValue->hasValue = true;
     return UA_STATUSCODE_GOOD;
 }
 
+/* Asynchronous reads are completed by the test */
+static UA_AsyncOperation *pendingReads[2];
+static size_t pendingReadsSize = 0;
+static UA_Boolean completeReadImmediately = true;
+
+static UA_StatusCode
+readCPUTemperatureAsync(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                        const UA_NumericRange *range, UA_AsyncOperation *op) {
+    if(!completeReadImmediately) {
+        ck_assert_uint_lt(pendingReadsSize, 2);
+        pendingReads[pendingReadsSize++] = op;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    readCPUTemperature(handle, nodeid, sourceTimeStamp, range, &value);
+    UA_AsyncOperation_completeRead(op, &value);
+    UA_DataValue_deleteMembers(&value);
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+countPendingOperations(const UA_AsyncRequest *req) {
+    size_t count = 0;
+    const UA_AsyncOperation *op;
+    LIST_FOREACH(op, &req->pendingOperations, listEntry)
+        ++count;
+    return count;
+}
+
+static void
+completePendingRead(size_t i) {
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    readCPUTemperature(NULL, UA_NODEID_NULL, false, NULL, &value);
+    UA_AsyncOperation_completeRead(pendingReads[i], &value);
+    UA_DataValue_deleteMembers(&value);
+}
+
+/* The values of the batch nodes are their numeric identifiers */
+static size_t readBatchCalls = 0;
+static size_t readBatchItems = 0;
+
+static UA_StatusCode
+readBatchValues(void *handle, size_t itemsSize, const UA_NodeId *nodeIds,
+                UA_Boolean sourceTimeStamp, const UA_NumericRange * const *ranges,
+                UA_DataValue *values) {
+    ++readBatchCalls;
+    readBatchItems += itemsSize;
+    for(size_t i = 0; i < itemsSize; ++i) {
+        UA_UInt32 v = nodeIds[i].identifier.numeric;
+        UA_Variant_setScalarCopy(&values[i].value, &v, &UA_TYPES[UA_TYPES_UINT32]);
+        values[i].hasValue = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 static UA_Server *
 makeTestSequence(void) {
     UA_Server * server = UA_Server_new(UA_ServerConfig_standard);
@@ -59,6 +125,41 @@ makeTestSequence(void) {
                                                  UA_NODEID_NULL, vattr, temperatureDataSource, NULL);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
 
+    /* Asynchronous DataSource VariableNode */
+    UA_VariableAttributes_init(&vattr);
+    UA_DataSource asyncDataSource = (UA_DataSource) {.handle = NULL, .read = NULL, .write = NULL};
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US","async temperature");
+    retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(1, "cpu.temperature.async"),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                 UA_QUALIFIEDNAME(1, "async cpu temperature"),
+                                                 UA_NODEID_NULL, vattr, asyncDataSource, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_DataSourceExtension asyncExtension =
+        (UA_DataSourceExtension) {.readAsync = readCPUTemperatureAsync, .readBatch = NULL};
+    retval = UA_Server_setVariableNode_dataSourceExtension(server,
+                                                           UA_NODEID_STRING(1, "cpu.temperature.async"),
+                                                           asyncExtension);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* DataSource VariableNodes with batch reads */
+    UA_DataSource batchDataSource = (UA_DataSource) {.handle = NULL, .read = NULL, .write = NULL};
+    UA_DataSourceExtension batchExtension =
+        (UA_DataSourceExtension) {.readAsync = NULL, .readBatch = readBatchValues};
+    for(UA_UInt32 i = 0; i < 3; ++i) {
+        UA_VariableAttributes_init(&vattr);
+        vattr.displayName = UA_LOCALIZEDTEXT("en_US","batch");
+        retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 50000 + i),
+                                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                     UA_QUALIFIEDNAME(1, "batch"),
+                                                     UA_NODEID_NULL, vattr, batchDataSource, NULL);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Server_setVariableNode_dataSourceExtension(server, UA_NODEID_NUMERIC(1, 50000 + i),
+                                                               batchExtension);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
     /* VariableNode with array */
     UA_VariableAttributes_init(&vattr);
     UA_Int32 myIntegerArray[9] = {1,2,3,4,5,6,7,8,9};
@@ -118,8 +219,8 @@ makeTestSequence(void) {
     return server;
 }
 
-static UA_VariableNode* makeCompareSequence(void) {
-    UA_VariableNode *node = UA_NodeStore_newVariableNode();
+static UA_VariableNode* makeCompareSequence(UA_Server *server) {
+    UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
 
     UA_Int32 myInteger = 42;
     UA_Variant_setScalarCopy(&node->value.data.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
@@ -242,14 +343,14 @@ START_TEST(ReadSingleAttributeDisplayNameWithoutTimestamp) {
 
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
     const UA_LocalizedText comp = UA_LOCALIZEDTEXT("locale", "the answer");
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&comp.text, &respval->text));
     ck_assert(UA_String_equal(&compNode->displayName.locale, &respval->locale));
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
     UA_Server_delete(server);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
 } END_TEST
 
 START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
@@ -263,13 +364,13 @@ START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
     UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
     
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&compNode->description.locale, &respval->locale));
     ck_assert(UA_String_equal(&compNode->description.text, &respval->text));
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
     UA_Server_delete(server);
 } END_TEST
 
@@ -502,13 +603,13 @@ START_TEST(ReadSingleAttributeMinimumSamplingIntervalWithoutTimestamp) {
     UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
     
     UA_Double* respval = (UA_Double*) resp.value.data;
-    UA_VariableNode *compNode = makeCompareSequence();
+    UA_VariableNode *compNode = makeCompareSequence(server);
     UA_Double comp = (UA_Double) compNode->minimumSamplingInterval;
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_DOUBLE], resp.value.type);
     ck_assert(*respval == comp);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
     UA_Server_delete(server);
 } END_TEST
 
@@ -584,6 +685,207 @@ START_TEST(ReadSingleDataSourceAttributeValueWithoutTimestamp) {
     UA_DataValue_deleteMembers(&resp);
 } END_TEST
 
+START_TEST(ReadAsyncDataSourceValue) {
+    UA_Server *server = makeTestSequence();
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "cpu.temperature.async");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+
+    /* Completed inside the callback */
+    UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_SOURCE);
+    ck_assert(resp.hasValue);
+    ck_assert(resp.hasSourceTimestamp);
+    ck_assert_int_eq(*(UA_Float*)resp.value.data * 10, 205);
+    UA_DataValue_deleteMembers(&resp);
+
+    /* The local read cannot wait for the completion */
+    completeReadImmediately = false;
+    pendingReadsSize = 0;
+    resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
+    ck_assert(!resp.hasValue);
+    ck_assert_int_eq(resp.status, UA_STATUSCODE_BADWOULDBLOCK);
+    ck_assert_uint_eq(pendingReadsSize, 1);
+    completePendingRead(0);
+
+    /* The response to a request is deferred until both reads have completed.
+     * The request has no SecureChannel and is dropped in the end. */
+    UA_ReadValueId rvis[2] = {rvi, rvi};
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = rvis;
+    request.nodesToReadSize = 2;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SERVER;
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    UA_AsyncContext ctx;
+    memset(&ctx, 0, sizeof(UA_AsyncContext));
+    ctx.responseType = &UA_TYPES[UA_TYPES_READRESPONSE];
+    pendingReadsSize = 0;
+    asyncContext = &ctx;
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    asyncContext = NULL;
+    ck_assert_uint_eq(pendingReadsSize, 2);
+    ck_assert_ptr_ne(ctx.request, NULL);
+    ck_assert_uint_eq(countPendingOperations(ctx.request), 2);
+    ck_assert(UA_AsyncContext_deferResponse(server, &ctx, &response));
+
+    completePendingRead(1);
+    UA_ReadResponse *deferred = (UA_ReadResponse*)ctx.request->response;
+    ck_assert_uint_eq(countPendingOperations(ctx.request), 1);
+    ck_assert(!deferred->results[0].hasValue);
+    ck_assert(deferred->results[1].hasValue);
+    ck_assert(deferred->results[1].hasServerTimestamp);
+    ck_assert(!deferred->results[1].hasSourceTimestamp);
+
+    completePendingRead(0);
+    ck_assert_ptr_eq(LIST_FIRST(&server->asyncRequests), NULL);
+
+    /* Pending operations are cancelled when the server is deleted. The late
+     * completion only frees the operation. */
+    UA_ReadResponse_init(&response);
+    memset(&ctx, 0, sizeof(UA_AsyncContext));
+    ctx.responseType = &UA_TYPES[UA_TYPES_READRESPONSE];
+    pendingReadsSize = 0;
+    asyncContext = &ctx;
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    asyncContext = NULL;
+    ck_assert(UA_AsyncContext_deferResponse(server, &ctx, &response));
+    UA_Server_delete(server);
+    completePendingRead(0);
+    completePendingRead(1);
+    completeReadImmediately = true;
+} END_TEST
+
+START_TEST(ReadBatchDataSourceValues) {
+    UA_Server *server = makeTestSequence();
+
+    /* Three nodes of the batch data source, a regular variable and the
+     * batch node with an invalid index range */
+    UA_ReadValueId rvi[5];
+    for(size_t i = 0; i < 5; ++i) {
+        UA_ReadValueId_init(&rvi[i]);
+        rvi[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    rvi[0].nodeId = UA_NODEID_NUMERIC(1, 50002);
+    rvi[1].nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi[2].nodeId = UA_NODEID_NUMERIC(1, 50000);
+    rvi[3].nodeId = UA_NODEID_NUMERIC(1, 50001);
+    rvi[4].nodeId = UA_NODEID_NUMERIC(1, 50001);
+    rvi[4].indexRange = UA_STRING("x");
+
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = rvi;
+    request.nodesToReadSize = 5;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    readBatchCalls = 0;
+    readBatchItems = 0;
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+
+    /* One call for the batch nodes */
+    ck_assert_uint_eq(readBatchCalls, 1);
+    ck_assert_uint_eq(readBatchItems, 3);
+    ck_assert_uint_eq(response.resultsSize, 5);
+    UA_UInt32 expected[4] = {50002, 0, 50000, 50001};
+    for(size_t i = 0; i < 4; ++i) {
+        ck_assert(response.results[i].hasValue);
+        ck_assert(response.results[i].hasServerTimestamp);
+        ck_assert(response.results[i].hasSourceTimestamp);
+        if(i != 1)
+            ck_assert_uint_eq(*(UA_UInt32*)response.results[i].value.data, expected[i]);
+    }
+    ck_assert_int_eq(*(UA_Int32*)response.results[1].value.data, 42);
+    ck_assert(!response.results[4].hasValue);
+    ck_assert(response.results[4].hasStatus);
+    UA_ReadResponse_deleteMembers(&response);
+
+    /* A single value is read as a batch of one */
+    UA_DataValue resp = UA_Server_read(server, &rvi[2], UA_TIMESTAMPSTORETURN_NEITHER);
+    ck_assert(resp.hasValue);
+    ck_assert(!resp.hasSourceTimestamp);
+    ck_assert_uint_eq(*(UA_UInt32*)resp.value.data, 50000);
+    ck_assert_uint_eq(readBatchCalls, 2);
+    UA_DataValue_deleteMembers(&resp);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(ReadDataSourceValueFromCache) {
+    UA_Server *server = makeTestSequence();
+    server->config.maxReadCacheEntries = 10;
+
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "cpu.temperature");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &rvi;
+    request.nodesToReadSize = 1;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.maxAge = 100.0; /* ms */
+
+    /* The first read populates the cache */
+    size_t count = readCPUTemperatureCount;
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert(response.results[0].hasValue);
+    ck_assert(response.results[0].hasSourceTimestamp);
+    UA_DateTime sourceTimestamp = response.results[0].sourceTimestamp;
+    UA_ReadResponse_deleteMembers(&response);
+    ck_assert_uint_eq(readCPUTemperatureCount, count + 1);
+
+    /* Served from the cache with the original source timestamp */
+    UA_sleep(50);
+    UA_ReadResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert(response.results[0].hasValue);
+    ck_assert_int_eq(*(UA_Float*)response.results[0].value.data * 10, 205);
+    ck_assert(response.results[0].sourceTimestamp == sourceTimestamp);
+    UA_ReadResponse_deleteMembers(&response);
+    ck_assert_uint_eq(readCPUTemperatureCount, count + 1);
+
+    /* Too old for the maxAge */
+    UA_sleep(60);
+    UA_ReadResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    UA_ReadResponse_deleteMembers(&response);
+    ck_assert_uint_eq(readCPUTemperatureCount, count + 2);
+
+    /* maxAge 0 always reads from the data source */
+    request.maxAge = 0.0;
+    UA_ReadResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    UA_ReadResponse_deleteMembers(&response);
+    ck_assert_uint_eq(readCPUTemperatureCount, count + 3);
+
+    UA_ReadCacheStatistics stats;
+    UA_Server_getReadCacheStatistics(server, &stats);
+    ck_assert_uint_eq(stats.entries, 1);
+    ck_assert_uint_eq(stats.hits, 1);
+    ck_assert_uint_eq(stats.misses, 2);
+
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
 
@@ -845,6 +1147,339 @@ START_TEST(WriteSingleAttributeValueRangeFromArray) {
     UA_Server_delete(server);
 } END_TEST
 
+/* The value is written repeatedly and kept when other attributes of the node
+ * are written in between */
+START_TEST(WriteValueAndOtherAttributes) {
+    UA_Server *server = makeTestSequence();
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 myInteger = 50;
+    UA_Variant_setScalar(&wValue.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = UA_NODEID_STRING(1, "myarray");
+    wValue.indexRange = UA_STRING("1,1");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_StatusCode retval = UA_Server_write(server, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_LocalizedText displayName = UA_LOCALIZEDTEXT("locale", "written array");
+    retval = UA_Server_writeDisplayName(server, UA_NODEID_STRING(1, "myarray"), displayName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    myInteger = 60;
+    wValue.indexRange = UA_STRING("2,2");
+    retval = UA_Server_write(server, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Variant value;
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "myarray"), &value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(value.arrayLength, 9);
+    UA_Int32 *data = (UA_Int32*)value.data;
+    ck_assert_int_eq(data[0], 1);
+    ck_assert_int_eq(data[4], 50);
+    ck_assert_int_eq(data[8], 60);
+    UA_Variant_deleteMembers(&value);
+
+    UA_LocalizedText readName;
+    retval = UA_Server_readDisplayName(server, UA_NODEID_STRING(1, "myarray"), &readName);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_String_equal(&readName.text, &displayName.text));
+    UA_LocalizedText_deleteMembers(&readName);
+    UA_Server_delete(server);
+} END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+#define CONCURRENT_ROUNDS 2000
+
+/* All elements of the array are written with the same value. Readers must
+ * never see a mix of two writes. */
+typedef struct {
+    UA_Server *server;
+    UA_Int32 base;
+    const char *indexRange;
+    UA_Boolean running;
+    size_t failures;
+} ConcurrentClient;
+
+static void *
+concurrentWriteValue(void *data) {
+    ConcurrentClient *c = (ConcurrentClient*)data;
+    rcu_register_thread();
+    UA_Int32 values[9];
+    UA_WriteValue wv;
+    UA_WriteValue_init(&wv);
+    wv.nodeId = UA_NODEID_STRING(1, "myarray");
+    wv.attributeId = UA_ATTRIBUTEID_VALUE;
+    wv.value.hasValue = true;
+    if(c->indexRange)
+        wv.indexRange = UA_STRING((char*)(uintptr_t)c->indexRange);
+    for(UA_Int32 i = 0; i < CONCURRENT_ROUNDS; ++i) {
+        for(size_t j = 0; j < 9; ++j)
+            values[j] = c->base + i;
+        UA_Variant_setArray(&wv.value.value, values, 9, &UA_TYPES[UA_TYPES_INT32]);
+        if(UA_Server_write(c->server, &wv) != UA_STATUSCODE_GOOD)
+            ++c->failures;
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void *
+concurrentReadValue(void *data) {
+    ConcurrentClient *c = (ConcurrentClient*)data;
+    rcu_register_thread();
+    while(c->running) {
+        UA_Variant value;
+        if(UA_Server_readValue(c->server, UA_NODEID_STRING(1, "myarray"),
+                               &value) != UA_STATUSCODE_GOOD) {
+            ++c->failures;
+            continue;
+        }
+        UA_Int32 *v = (UA_Int32*)value.data;
+        if(value.arrayLength != 9)
+            ++c->failures;
+        else
+            for(size_t j = 1; j < 9; ++j)
+                if(v[j] != v[0])
+                    ++c->failures;
+        UA_Variant_deleteMembers(&value);
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void *
+concurrentWriteDisplayName(void *data) {
+    ConcurrentClient *c = (ConcurrentClient*)data;
+    rcu_register_thread();
+    char name[16];
+    for(UA_Int32 i = 0; i < CONCURRENT_ROUNDS; ++i) {
+        snprintf(name, sizeof(name), "name%d", i);
+        if(UA_Server_writeDisplayName(c->server, UA_NODEID_STRING(1, "myarray"),
+                                      UA_LOCALIZEDTEXT("locale", name)) != UA_STATUSCODE_GOOD)
+            ++c->failures;
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* Requests above the threshold are processed in slices by the worker threads.
+ * Writes to the same node keep the order of the request. */
+START_TEST(ReadWriteInParallelSlices) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nThreads = 3;
+    config.parallelItemsThreshold = 8;
+    UA_Server *server = UA_Server_new(config);
+    UA_VariableAttributes vattr;
+    for(UA_Int32 i = 0; i < 100; ++i) {
+        UA_VariableAttributes_init(&vattr);
+        UA_Variant_setScalar(&vattr.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        UA_StatusCode retval =
+            UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 60000 + (UA_UInt32)i),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                      UA_QUALIFIEDNAME(1, "sliced"), UA_NODEID_NULL,
+                                      vattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    UA_Server_run_startup(server);
+
+    /* 1000 writes to 100 nodes. The last write of every node wins. */
+    UA_Int32 values[1000];
+    UA_WriteValue wv[1000];
+    for(UA_Int32 k = 0; k < 1000; ++k) {
+        values[k] = k;
+        UA_WriteValue_init(&wv[k]);
+        wv[k].nodeId = UA_NODEID_NUMERIC(1, 60000 + (UA_UInt32)(k % 100));
+        wv[k].attributeId = UA_ATTRIBUTEID_VALUE;
+        wv[k].value.hasValue = true;
+        UA_Variant_setScalar(&wv[k].value.value, &values[k], &UA_TYPES[UA_TYPES_INT32]);
+    }
+    UA_WriteRequest wreq;
+    UA_WriteRequest_init(&wreq);
+    wreq.nodesToWrite = wv;
+    wreq.nodesToWriteSize = 1000;
+    UA_WriteResponse wresp;
+    UA_WriteResponse_init(&wresp);
+    UA_RCU_LOCK();
+    Service_Write(server, &adminSession, &wreq, &wresp);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(wresp.resultsSize, 1000);
+    for(size_t k = 0; k < 1000; ++k)
+        ck_assert_uint_eq(wresp.results[k], UA_STATUSCODE_GOOD);
+    UA_WriteResponse_deleteMembers(&wresp);
+
+    UA_ReadValueId rvi[1000];
+    for(UA_UInt32 k = 0; k < 1000; ++k) {
+        UA_ReadValueId_init(&rvi[k]);
+        rvi[k].nodeId = UA_NODEID_NUMERIC(1, 60000 + k % 100);
+        rvi[k].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    UA_ReadRequest rreq;
+    UA_ReadRequest_init(&rreq);
+    rreq.nodesToRead = rvi;
+    rreq.nodesToReadSize = 1000;
+    UA_ReadResponse rresp;
+    UA_ReadResponse_init(&rresp);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &rreq, &rresp);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(rresp.resultsSize, 1000);
+    for(UA_Int32 k = 0; k < 1000; ++k) {
+        ck_assert(rresp.results[k].hasValue);
+        ck_assert_int_eq(*(UA_Int32*)rresp.results[k].value.data, 900 + k % 100);
+    }
+    UA_ReadResponse_deleteMembers(&rresp);
+
+    /* Aliases of registered nodes and the NodeIds of the same nodes alternate.
+     * They are written in the order of the request as well. */
+    UA_NodeId aliases[100];
+    for(UA_UInt32 i = 0; i < 100; ++i) {
+        UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 60000 + i);
+        ck_assert_uint_eq(UA_Session_registerNode(&adminSession, &nodeId, &aliases[i]),
+                          UA_STATUSCODE_GOOD);
+    }
+    for(UA_Int32 k = 0; k < 1000; ++k) {
+        values[k] = -k;
+        if((k / 100) % 2 == 1)
+            wv[k].nodeId = aliases[k % 100];
+    }
+    UA_WriteResponse_init(&wresp);
+    UA_RCU_LOCK();
+    Service_Write(server, &adminSession, &wreq, &wresp);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(wresp.resultsSize, 1000);
+    for(size_t k = 0; k < 1000; ++k)
+        ck_assert_uint_eq(wresp.results[k], UA_STATUSCODE_GOOD);
+    UA_WriteResponse_deleteMembers(&wresp);
+    UA_ReadResponse_init(&rresp);
+    UA_RCU_LOCK();
+    Service_Read(server, &adminSession, &rreq, &rresp);
+    UA_RCU_UNLOCK();
+    for(UA_Int32 k = 0; k < 1000; ++k)
+        ck_assert_int_eq(*(UA_Int32*)rresp.results[k].value.data, -(900 + k % 100));
+    UA_ReadResponse_deleteMembers(&rresp);
+    for(size_t i = 0; i < 100; ++i)
+        UA_Session_unregisterNode(&adminSession, &aliases[i]);
+
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+} END_TEST
+
+/* Value writes (with and without index range), reads and an edit of another
+ * attribute of the same node run concurrently. No write may be lost. */
+START_TEST(WriteValueConcurrently) {
+    UA_Server *server = makeTestSequence();
+    ConcurrentClient writers[2] = {{server, 0, NULL, true, 0},
+                                   {server, 1000000, "0:8", true, 0}};
+    ConcurrentClient readers[2] = {{server, 0, NULL, true, 0}, {server, 0, NULL, true, 0}};
+    ConcurrentClient editor = {server, 0, NULL, true, 0};
+    pthread_t writerThreads[2], readerThreads[2], editorThread;
+    UA_Int32 initial[9] = {0};
+    UA_Variant value;
+    UA_Variant_setArray(&value, initial, 9, &UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval = UA_Server_writeValue(server, UA_NODEID_STRING(1, "myarray"), value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < 2; ++i)
+        pthread_create(&readerThreads[i], NULL, concurrentReadValue, &readers[i]);
+    for(size_t i = 0; i < 2; ++i)
+        pthread_create(&writerThreads[i], NULL, concurrentWriteValue, &writers[i]);
+    pthread_create(&editorThread, NULL, concurrentWriteDisplayName, &editor);
+    for(size_t i = 0; i < 2; ++i)
+        pthread_join(writerThreads[i], NULL);
+    pthread_join(editorThread, NULL);
+    for(size_t i = 0; i < 2; ++i) {
+        readers[i].running = false;
+        pthread_join(readerThreads[i], NULL);
+    }
+    for(size_t i = 0; i < 2; ++i) {
+        ck_assert_uint_eq(writers[i].failures, 0);
+        ck_assert_uint_eq(readers[i].failures, 0);
+    }
+    ck_assert_uint_eq(editor.failures, 0);
+
+    /* The last value of one of the writers and the last DisplayName remain */
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "myarray"), &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Int32 last = *(UA_Int32*)value.data;
+    ck_assert(last == CONCURRENT_ROUNDS - 1 || last == 1000000 + CONCURRENT_ROUNDS - 1);
+    UA_Variant_deleteMembers(&value);
+    UA_LocalizedText readName;
+    retval = UA_Server_readDisplayName(server, UA_NODEID_STRING(1, "myarray"), &readName);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    char name[16];
+    snprintf(name, sizeof(name), "name%d", CONCURRENT_ROUNDS - 1);
+    UA_String expected = UA_STRING(name);
+    ck_assert(UA_String_equal(&readName.text, &expected));
+    UA_LocalizedText_deleteMembers(&readName);
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
+START_TEST(WriteValueHandle) {
+    UA_Server *server = makeTestSequence();
+    UA_ValueHandle *handle = NULL;
+    UA_StatusCode retval =
+        UA_Server_addValueHandle(server, UA_NODEID_STRING(1, "the.answer"),
+                                 &UA_TYPES[UA_TYPES_INT32], 0, 4, &handle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Values with dynamic members cannot be copied into the samples */
+    UA_ValueHandle *stringHandle = NULL;
+    retval = UA_Server_addValueHandle(server, UA_NODEID_STRING(1, "myarray"),
+                                      &UA_TYPES[UA_TYPES_STRING], 9, 4, &stringHandle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADTYPEMISMATCH);
+
+    /* The variable already has a handle */
+    UA_ValueHandle *secondHandle = NULL;
+    retval = UA_Server_addValueHandle(server, UA_NODEID_STRING(1, "the.answer"),
+                                      &UA_TYPES[UA_TYPES_INT32], 0, 4, &secondHandle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADNOTSUPPORTED);
+
+    /* The current value is the initial sample */
+    UA_Variant value;
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "the.answer"), &value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)value.data, 42);
+    UA_Variant_deleteMembers(&value);
+
+    /* More updates than samples in the ring */
+    for(UA_Int32 i = 0; i < 10; ++i)
+        UA_ValueHandle_update(handle, &i, UA_STATUSCODE_GOOD, 0);
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "the.answer"), &value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)value.data, 9);
+    UA_Variant_deleteMembers(&value);
+
+    /* The value is only written through the handle */
+    UA_Int32 myInteger = 20;
+    UA_Variant_setScalar(&value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, UA_NODEID_STRING(1, "the.answer"), value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADWRITENOTSUPPORTED);
+
+    /* The variable keeps the last value when the handle is removed */
+    retval = UA_Server_removeValueHandle(server, handle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "the.answer"), &value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)value.data, 9);
+    UA_Variant_deleteMembers(&value);
+    UA_Variant_setScalar(&value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, UA_NODEID_STRING(1, "the.answer"), value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The handle of a deleted variable is freed */
+    retval = UA_Server_addValueHandle(server, UA_NODEID_STRING(1, "myarray"),
+                                      &UA_TYPES[UA_TYPES_INT32], 9, 4, &handle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_deleteNode(server, UA_NODEID_STRING(1, "myarray"), true);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_removeValueHandle(server, handle);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(WriteSingleAttributeDataType) {
     UA_Server *server = makeTestSequence();
     UA_WriteValue wValue;
@@ -1016,6 +1651,9 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeExecutableWithoutTimestamp);
     tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeUserExecutableWithoutTimestamp);
     tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeValueWithoutTimestamp);
+    tcase_add_test(tc_readSingleAttributes, ReadDataSourceValueFromCache);
+    tcase_add_test(tc_readSingleAttributes, ReadAsyncDataSourceValue);
+    tcase_add_test(tc_readSingleAttributes, ReadBatchDataSourceValues);
     tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeDataTypeWithoutTimestamp);
     tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp);
 
@@ -1038,6 +1676,12 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataType);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeFromScalar);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeFromArray);
+    tcase_add_test(tc_writeSingleAttributes, WriteValueAndOtherAttributes);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test(tc_writeSingleAttributes, WriteValueConcurrently);
+    tcase_add_test(tc_writeSingleAttributes, ReadWriteInParallelSlices);
+#endif
+    tcase_add_test(tc_writeSingleAttributes, WriteValueHandle);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRank);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeArrayDimensions);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeAccessLevel);
@@ -176,6 +176,39 @@ START_TEST(DeleteObjectWithDestructor) {
     UA_Server_delete(server);
 } END_TEST
 
+START_TEST(DeleteObjectWithDeletedType) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    /* Add an object type and an object of the type */
+    UA_NodeId objecttypeid = UA_NODEID_NUMERIC(0, 13371337);
+    UA_ObjectTypeAttributes attr;
+    UA_ObjectTypeAttributes_init(&attr);
+    attr.displayName = UA_LOCALIZEDTEXT("en_US","my objecttype");
+    UA_StatusCode res = UA_Server_addObjectTypeNode(server, objecttypeid,
+                                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                                    UA_QUALIFIEDNAME(0, "myobjecttype"), attr, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_NodeId objectid = UA_NODEID_NUMERIC(0, 23372337);
+    UA_ObjectAttributes attr2;
+    UA_ObjectAttributes_init(&attr2);
+    attr2.displayName = UA_LOCALIZEDTEXT("en_US","my object");
+    res = UA_Server_addObjectNode(server, objectid, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), UA_QUALIFIEDNAME(0, ""),
+                                  objecttypeid, attr2, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    /* Delete the type but keep the reference from the object */
+    res = UA_Server_deleteNode(server, objecttypeid, false);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    /* The object has no type to take the destructor from */
+    res = UA_Server_deleteNode(server, objectid, true);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(DeleteObjectAndReferences) {
     UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
 
@@ -244,6 +277,814 @@ START_TEST(DeleteObjectAndReferences) {
     UA_Server_delete(server);
 } END_TEST
 
+#ifdef UA_ENABLE_METHODCALLS
+static UA_StatusCode
+echoMethod(void *methodHandle, const UA_NodeId objectId,
+           size_t inputSize, const UA_Variant *input,
+           size_t outputSize, UA_Variant *output) {
+    return UA_Variant_copy(&input[0], &output[0]);
+}
+
+static UA_StatusCode
+callEcho(UA_Server *server, const UA_NodeId *methodId, UA_Variant *input) {
+    UA_CallMethodRequest req;
+    UA_CallMethodRequest_init(&req);
+    req.objectId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    req.methodId = *methodId;
+    req.inputArguments = input;
+    req.inputArgumentsSize = 1;
+    UA_CallMethodResult res = UA_Server_call(server, &req);
+    UA_StatusCode retval = res.statusCode;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_uint_eq(res.outputArgumentsSize, 1);
+        ck_assert_ptr_eq(res.outputArguments[0].type, input->type);
+    }
+    UA_CallMethodResult_deleteMembers(&res);
+    return retval;
+}
+
+START_TEST(CallMethodWithChangedArguments) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    UA_Argument arg;
+    UA_Argument_init(&arg);
+    arg.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    arg.valueRank = -1;
+    arg.name = UA_STRING("value");
+    UA_MethodAttributes attr;
+    UA_MethodAttributes_init(&attr);
+    attr.executable = true;
+    attr.userExecutable = true;
+    UA_NodeId methodId = UA_NODEID_STRING(1, "echo");
+    UA_StatusCode retval =
+        UA_Server_addMethodNode(server, methodId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                UA_QUALIFIEDNAME(1, "echo"), attr, echoMethod, NULL,
+                                1, &arg, 1, &arg, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_NodeId otherMethodId = UA_NODEID_STRING(1, "echo2");
+    retval = UA_Server_addMethodNode(server, otherMethodId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                     UA_QUALIFIEDNAME(1, "echo2"), attr, echoMethod, NULL,
+                                     1, &arg, 1, &arg, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Int32 i = 42;
+    UA_Variant input;
+    UA_Variant_setScalar(&input, &i, &UA_TYPES[UA_TYPES_INT32]);
+    UA_String str = UA_STRING("42");
+    UA_Variant strInput;
+    UA_Variant_setScalar(&strInput, &str, &UA_TYPES[UA_TYPES_STRING]);
+
+    /* The second call uses the cached argument definitions */
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &strInput), UA_STATUSCODE_BADTYPEMISMATCH);
+    ck_assert_uint_eq(callEcho(server, &otherMethodId, &input), UA_STATUSCODE_GOOD);
+    UA_RCU_LOCK();
+    const UA_MethodNode *otherMethod =
+        (const UA_MethodNode*)UA_NodeStore_get(server->nodestore, &otherMethodId);
+    const UA_MethodArgumentsCache *otherArguments = otherMethod->arguments;
+    ck_assert_ptr_ne(otherArguments, NULL);
+    UA_RCU_UNLOCK();
+
+    /* Find the InputArguments property */
+    UA_NodeId inputArgumentsId = UA_NODEID_NULL;
+    UA_RCU_LOCK();
+    const UA_Node *method = UA_NodeStore_get(server->nodestore, &methodId);
+    UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+    UA_String inputArguments = UA_STRING("InputArguments");
+    const UA_ReferenceKind *properties = UA_Node_findReferenceKind(method, &hasProperty, false);
+    ck_assert_ptr_ne(properties, NULL);
+    for(size_t j = properties->referencesStart;
+        j < properties->referencesStart + properties->referencesSize; ++j) {
+        const UA_Node *prop =
+            UA_NodeStore_get(server->nodestore, &method->references[j].targetId.nodeId);
+        if(UA_String_equal(&prop->browseName.name, &inputArguments))
+            UA_NodeId_copy(&prop->nodeId, &inputArgumentsId);
+    }
+    UA_RCU_UNLOCK();
+    ck_assert(!UA_NodeId_isNull(&inputArgumentsId));
+
+    /* Without the property, no input arguments are accepted */
+    retval = UA_Server_deleteNode(server, inputArgumentsId, true);
+    UA_NodeId_deleteMembers(&inputArgumentsId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_BADINVALIDARGUMENT);
+
+    /* A new property changes the signature. Added like in addMethodNode, as
+     * the Argument DataType is not in the standard namespace zero. */
+    arg.dataType = UA_TYPES[UA_TYPES_STRING].typeId;
+    UA_VariableNode *prop = UA_NodeStore_newVariableNode(server->nodestore);
+    prop->nodeId = UA_NODEID_NUMERIC(1, 4711);
+    prop->browseName = UA_QUALIFIEDNAME_ALLOC(0, "InputArguments");
+    prop->valueRank = 1;
+    prop->dataType = UA_TYPES[UA_TYPES_ARGUMENT].typeId;
+    UA_Variant_setArrayCopy(&prop->value.data.value.value, &arg, 1,
+                            &UA_TYPES[UA_TYPES_ARGUMENT]);
+    prop->value.data.value.hasValue = true;
+    UA_NodeId propertyType = UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE);
+    UA_RCU_LOCK();
+    retval = Service_AddNodes_existing(server, &adminSession, (UA_Node*)prop, &methodId,
+                                       &hasProperty, &propertyType, NULL, NULL);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_BADTYPEMISMATCH);
+    ck_assert_uint_eq(callEcho(server, &methodId, &strInput), UA_STATUSCODE_GOOD);
+
+    /* Writing the value of the property changes the signature again */
+    arg.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    UA_Variant newArguments;
+    UA_Variant_setArray(&newArguments, &arg, 1, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    retval = UA_Server_writeValue(server, UA_NODEID_NUMERIC(1, 4711), newArguments);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &strInput), UA_STATUSCODE_BADTYPEMISMATCH);
+
+    /* After a rename, the property no longer defines the input arguments */
+    retval = UA_Server_writeBrowseName(server, UA_NODEID_NUMERIC(1, 4711),
+                                       UA_QUALIFIEDNAME(0, "Renamed"));
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(callEcho(server, &methodId, &input), UA_STATUSCODE_BADINVALIDARGUMENT);
+
+    /* The cache of the other method was not touched */
+    UA_RCU_LOCK();
+    otherMethod = (const UA_MethodNode*)UA_NodeStore_get(server->nodestore, &otherMethodId);
+    ck_assert_ptr_eq(otherMethod->arguments, otherArguments);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(callEcho(server, &otherMethodId, &input), UA_STATUSCODE_GOOD);
+
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
+static UA_StatusCode
+addVariableWithReference(UA_Server *server, const char *name, const UA_NodeId referenceTypeId) {
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 myInteger = 42;
+    UA_Variant_setScalar(&attr.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    return UA_Server_addVariableNode(server, UA_NODEID_STRING(1, (char*)(uintptr_t)name),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     referenceTypeId, UA_QUALIFIEDNAME(1, (char*)(uintptr_t)name),
+                                     UA_NODEID_NULL, attr, NULL, NULL);
+}
+
+START_TEST(AddNodeWithChangedReferenceTypeHierarchy) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    /* HierarchicalReferences <- mid <- leaf */
+    UA_NodeId midType = UA_NODEID_STRING(1, "test.hierarchical");
+    UA_NodeId leafType = UA_NODEID_STRING(1, "test.hierarchical.leaf");
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    UA_StatusCode retval =
+        UA_Server_addReferenceTypeNode(server, midType,
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                       UA_QUALIFIEDNAME(1, "Mid"), rattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReferenceTypeNode(server, leafType, midType,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                            UA_QUALIFIEDNAME(1, "Leaf"), rattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(addVariableWithReference(server, "var1", leafType), UA_STATUSCODE_GOOD);
+
+    /* Without the intermediate type, the leaf is no longer hierarchical */
+    retval = UA_Server_deleteNode(server, midType, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(addVariableWithReference(server, "var2", leafType),
+                      UA_STATUSCODE_BADREFERENCETYPEIDINVALID);
+
+    /* Attach the leaf directly below Organizes */
+    retval = UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                    UA_EXPANDEDNODEID_STRING(1, "test.hierarchical.leaf"), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(addVariableWithReference(server, "var2", leafType), UA_STATUSCODE_GOOD);
+
+    UA_Server_delete(server);
+} END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+typedef struct {
+    UA_Server *server;
+    UA_Boolean running;
+    size_t failures;
+} TypeIndexReader;
+
+static void *
+queryTypeIndex(void *data) {
+    TypeIndexReader *r = (TypeIndexReader*)data;
+    const UA_NodeId hasComponent = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    const UA_NodeId hierarchical = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    const UA_NodeId nonHierarchical = UA_NODEID_NUMERIC(0, UA_NS0ID_NONHIERARCHICALREFERENCES);
+    const UA_NodeId leafType = UA_NODEID_STRING(1, "test.concurrent");
+    rcu_register_thread();
+    while(r->running) {
+        UA_RCU_LOCK();
+        UA_TypeIndex *index = &r->server->typeIndex;
+        if(!UA_TypeIndex_isSubtype(index, &hasComponent, &hierarchical) ||
+           UA_TypeIndex_isSubtype(index, &organizes, &nonHierarchical) ||
+           UA_TypeIndex_isSubtype(index, &leafType, &nonHierarchical))
+            r->failures++;
+        UA_UInt32 leaf = UA_TypeIndex_findType(index, &leafType);
+        UA_UInt32 super = UA_TypeIndex_findType(index, &hierarchical);
+        if(leaf != UA_TYPEINDEX_NOTFOUND && super == UA_TYPEINDEX_NOTFOUND)
+            r->failures++;
+        UA_TypeIndex_isSubtypeAt(index, leaf, super);
+        UA_RCU_UNLOCK();
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* Queries of the type index take no lock while reference types are added and
+ * deleted */
+START_TEST(QueryTypeIndexWhileUpdating) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    TypeIndexReader readers[2] = {{server, true, 0}, {server, true, 0}};
+    pthread_t threads[2];
+    for(size_t i = 0; i < 2; ++i)
+        pthread_create(&threads[i], NULL, queryTypeIndex, &readers[i]);
+
+    const UA_NodeId leafType = UA_NODEID_STRING(1, "test.concurrent");
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    for(size_t i = 0; i < 200; ++i) {
+        UA_StatusCode retval =
+            UA_Server_addReferenceTypeNode(server, leafType, organizes,
+                                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                           UA_QUALIFIEDNAME(1, "Leaf"), rattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_RCU_LOCK();
+        ck_assert(UA_TypeIndex_isSubtype(&server->typeIndex, &leafType, &organizes));
+        UA_RCU_UNLOCK();
+        retval = UA_Server_deleteNode(server, leafType, true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_RCU_LOCK();
+        ck_assert(!UA_TypeIndex_isSubtype(&server->typeIndex, &leafType, &organizes));
+        UA_RCU_UNLOCK();
+    }
+
+    for(size_t i = 0; i < 2; ++i) {
+        readers[i].running = false;
+        pthread_join(threads[i], NULL);
+        ck_assert_uint_eq(readers[i].failures, 0);
+    }
+    UA_Server_delete(server);
+} END_TEST
+
+/* Queries between updates use the index under the lock. The view for the
+ * queries without a lock is only copied once there are no more updates. */
+START_TEST(TypeIndexViewAfterQueries) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    const UA_NodeId leafType = UA_NODEID_STRING(1, "test.view");
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    UA_StatusCode retval =
+        UA_Server_addReferenceTypeNode(server, leafType, organizes,
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                       UA_QUALIFIEDNAME(1, "Leaf"), rattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_TypeIndex *index = &server->typeIndex;
+    UA_RCU_LOCK();
+    ck_assert(UA_TypeIndex_isSubtype(index, &leafType, &organizes));
+    ck_assert_ptr_eq(index->view, NULL);
+    for(size_t i = 0; i < index->typesSize; ++i)
+        ck_assert(UA_TypeIndex_isSubtype(index, &leafType, &organizes));
+    ck_assert_ptr_ne(index->view, NULL);
+    UA_RCU_UNLOCK();
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
+static void
+checkReferenceIndex(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_RCU_LOCK();
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
+    ck_assert_ptr_ne(node, NULL);
+    /* The kinds are contiguous and cover all references */
+    size_t pos = 0;
+    for(size_t k = 0; k < node->referenceIndex.kindsSize; ++k) {
+        const UA_ReferenceKind *kind = &node->referenceIndex.kinds[k];
+        ck_assert_uint_eq(kind->referencesStart, pos);
+        ck_assert_uint_gt(kind->referencesSize, 0);
+        for(size_t i = 0; i < kind->referencesSize; ++i, ++pos) {
+            const UA_NodeReference *ref = &node->references[pos];
+            ck_assert_ptr_eq(UA_Node_findReference(node, &kind->referenceTypeId,
+                                                   &ref->targetId.nodeId, kind->isInverse), ref);
+        }
+    }
+    ck_assert_uint_eq(pos, node->referencesSize);
+    UA_RCU_UNLOCK();
+}
+
+static size_t
+countBrowsedReferences(UA_Server *server, const UA_NodeId *nodeId, UA_UInt32 referenceType) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = *nodeId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    size_t count = br.referencesSize;
+    UA_BrowseResult_deleteMembers(&br);
+    return count;
+}
+
+START_TEST(AddAndDeleteManyReferences) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_NodeId folder = UA_NODEID_NUMERIC(1, 1000);
+    UA_ObjectAttributes attr;
+    UA_ObjectAttributes_init(&attr);
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Children with organizes references. Every second child also gets a
+     * hasComponent reference to the same target. */
+    const UA_UInt32 children = 100;
+    for(UA_UInt32 i = 0; i < children; ++i) {
+        retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + i), folder,
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                         UA_QUALIFIEDNAME(1, "Child"),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                         attr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        if(i % 2 != 0)
+            continue;
+        retval = UA_Server_addReference(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                        UA_EXPANDEDNODEID_NUMERIC(1, 2000 + i), true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    checkReferenceIndex(server, &folder);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_ORGANIZES), children);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_HASCOMPONENT), children / 2);
+
+    /* Duplicates are rejected */
+    retval = UA_Server_addReference(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_EXPANDEDNODEID_NUMERIC(1, 2000), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED);
+
+    /* Delete every third organizes reference. The kinds are moved together. */
+    for(UA_UInt32 i = 0; i < children; i += 3) {
+        retval = UA_Server_deleteReference(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                           true, UA_EXPANDEDNODEID_NUMERIC(1, 2000 + i), true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    checkReferenceIndex(server, &folder);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_ORGANIZES), children - 34);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_HASCOMPONENT), children / 2);
+
+    /* Remove all hasComponent references. The kind disappears. */
+    for(UA_UInt32 i = 0; i < children; i += 2) {
+        retval = UA_Server_deleteReference(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                           true, UA_EXPANDEDNODEID_NUMERIC(1, 2000 + i), true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    checkReferenceIndex(server, &folder);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_HASCOMPONENT), 0);
+    retval = UA_Server_deleteReference(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                       true, UA_EXPANDEDNODEID_NUMERIC(1, 2000), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED);
+
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(AddNodesInBulk) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    /* A folder with many variables. The folder comes last, so the variables
+     * are checked against the folder item of the batch. The last variable has
+     * an unknown parent. */
+    const size_t childrenSize = 1000;
+    const size_t itemsSize = childrenSize + 2;
+    UA_AddNodesItem *items = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_ADDNODESITEM]);
+    UA_AddNodesResult *results = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_ADDNODESRESULT]);
+    UA_NodeId folder = UA_NODEID_STRING(1, "bulk.folder");
+    UA_Int32 value = 42;
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Variant_setScalar(&vattr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t i = 0; i <= childrenSize; ++i) {
+        items[i].requestedNewNodeId.nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)(5000 + i));
+        items[i].parentNodeId.nodeId = folder;
+        items[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+        items[i].browseName = UA_QUALIFIEDNAME(1, "Variable");
+        items[i].nodeClass = UA_NODECLASS_VARIABLE;
+        items[i].nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+        items[i].nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+        items[i].nodeAttributes.content.decoded.data = &vattr;
+    }
+    items[childrenSize].parentNodeId.nodeId = UA_NODEID_STRING(1, "bulk.unknown");
+
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_AddNodesItem *folderItem = &items[childrenSize + 1];
+    folderItem->requestedNewNodeId.nodeId = folder;
+    folderItem->parentNodeId.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    folderItem->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    folderItem->browseName = UA_QUALIFIEDNAME(1, "BulkFolder");
+    folderItem->typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE);
+    folderItem->nodeClass = UA_NODECLASS_OBJECT;
+    folderItem->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    folderItem->nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+    folderItem->nodeAttributes.content.decoded.data = &oattr;
+
+    UA_StatusCode retval = UA_Server_addNodes(server, itemsSize, items, NULL, results);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < childrenSize; ++i) {
+        ck_assert_uint_eq(results[i].statusCode, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&results[i].addedNodeId, &items[i].requestedNewNodeId.nodeId));
+    }
+    ck_assert_uint_eq(results[childrenSize].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert(UA_NodeId_isNull(&results[childrenSize].addedNodeId));
+    ck_assert_uint_eq(results[childrenSize + 1].statusCode, UA_STATUSCODE_GOOD);
+
+    /* The node with the invalid parent was removed */
+    UA_RCU_LOCK();
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore,
+                                      &items[childrenSize].requestedNewNodeId.nodeId), NULL);
+    UA_RCU_UNLOCK();
+
+    /* All children are referenced from the folder and the variables are
+     * instantiated with a type definition */
+    checkReferenceIndex(server, &folder);
+    ck_assert_uint_eq(countBrowsedReferences(server, &folder, UA_NS0ID_HASCOMPONENT), childrenSize);
+    UA_Variant out;
+    retval = UA_Server_readValue(server, items[0].requestedNewNodeId.nodeId, &out);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)out.data, 42);
+    UA_Variant_deleteMembers(&out);
+    ck_assert_uint_eq(countBrowsedReferences(server, &items[0].requestedNewNodeId.nodeId,
+                                             UA_NS0ID_HASTYPEDEFINITION), 1);
+
+    /* The items only point to stack memory */
+    for(size_t i = 0; i < itemsSize; ++i)
+        UA_AddNodesItem_init(&items[i]);
+    UA_Array_delete(items, itemsSize, &UA_TYPES[UA_TYPES_ADDNODESITEM]);
+    UA_Array_delete(results, itemsSize, &UA_TYPES[UA_TYPES_ADDNODESRESULT]);
+    UA_Server_delete(server);
+} END_TEST
+
+static void
+setBulkItem(UA_AddNodesItem *item, UA_NodeClass nodeClass, const char *id,
+            UA_NodeId parent, UA_NodeId referenceType, void *attributes,
+            const UA_DataType *attributesType) {
+    UA_AddNodesItem_init(item);
+    item->requestedNewNodeId.nodeId = UA_NODEID_STRING(1, (char*)(uintptr_t)id);
+    item->parentNodeId.nodeId = parent;
+    item->referenceTypeId = referenceType;
+    item->browseName = UA_QUALIFIEDNAME(1, (char*)(uintptr_t)id);
+    item->nodeClass = nodeClass;
+    item->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    item->nodeAttributes.content.decoded.type = attributesType;
+    item->nodeAttributes.content.decoded.data = attributes;
+}
+
+START_TEST(AddNodesInBulkChecksFirst) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    const UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    const UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_DataType *otype = &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+
+    UA_AddNodesItem items[9];
+    UA_AddNodesResult results[9];
+    /* A hierarchical reference type from the batch is used before and after
+     * its definition */
+    setBulkItem(&items[0], UA_NODECLASS_OBJECT, "bulk.first", UA_NODEID_STRING(1, "bulk.parent"),
+                UA_NODEID_STRING(1, "bulk.reftype"), &oattr, otype);
+    setBulkItem(&items[1], UA_NODECLASS_REFERENCETYPE, "bulk.reftype", organizes, hasSubtype,
+                &rattr, &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES]);
+    setBulkItem(&items[2], UA_NODECLASS_OBJECT, "bulk.parent", objects,
+                UA_NODEID_STRING(1, "bulk.reftype"), &oattr, otype);
+    /* The child of a failed item fails as well */
+    setBulkItem(&items[3], UA_NODECLASS_OBJECT, "bulk.child", UA_NODEID_STRING(1, "bulk.orphan"),
+                organizes, &oattr, otype);
+    setBulkItem(&items[4], UA_NODECLASS_OBJECT, "bulk.orphan", UA_NODEID_STRING(1, "bulk.unknown"),
+                organizes, &oattr, otype);
+    /* Parents in a cycle never reach the address space */
+    setBulkItem(&items[5], UA_NODECLASS_OBJECT, "bulk.cycle1", UA_NODEID_STRING(1, "bulk.cycle2"),
+                organizes, &oattr, otype);
+    setBulkItem(&items[6], UA_NODECLASS_OBJECT, "bulk.cycle2", UA_NODEID_STRING(1, "bulk.cycle1"),
+                organizes, &oattr, otype);
+    /* Duplicate NodeIds */
+    setBulkItem(&items[7], UA_NODECLASS_OBJECT, "bulk.parent", objects, organizes, &oattr, otype);
+    setBulkItem(&items[8], UA_NODECLASS_OBJECT, "bulk.existing", objects, organizes, &oattr, otype);
+    items[8].requestedNewNodeId.nodeId = objects;
+
+    UA_StatusCode retval = UA_Server_addNodes(server, 9, items, NULL, results);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[1].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[2].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[3].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_uint_eq(results[4].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_uint_eq(results[5].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_uint_eq(results[6].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_uint_eq(results[7].statusCode, UA_STATUSCODE_BADNODEIDEXISTS);
+    ck_assert_uint_eq(results[8].statusCode, UA_STATUSCODE_BADNODEIDEXISTS);
+
+    /* The failed nodes were never inserted */
+    UA_RCU_LOCK();
+    for(size_t i = 3; i < 7; ++i) {
+        ck_assert(UA_NodeId_isNull(&results[i].addedNodeId));
+        ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore,
+                                          &items[i].requestedNewNodeId.nodeId), NULL);
+    }
+    const UA_NodeId reftype = UA_NODEID_STRING(1, "bulk.reftype");
+    ck_assert(UA_TypeIndex_isSubtype(&server->typeIndex, &reftype, &organizes));
+    UA_NodeId parent = UA_NODEID_STRING(1, "bulk.parent");
+    const UA_Node *parentNode = UA_NodeStore_get(server->nodestore, &parent);
+    ck_assert_ptr_ne(UA_Node_findReference(parentNode, &reftype,
+                                           &items[0].requestedNewNodeId.nodeId, false), NULL);
+    UA_RCU_UNLOCK();
+    checkReferenceIndex(server, &parent);
+
+    for(size_t i = 0; i < 9; ++i)
+        UA_NodeId_deleteMembers(&results[i].addedNodeId);
+
+    /* The AddNodes service adds the items one after the other. So the child
+     * cannot reference the parent from a later item. */
+    UA_AddNodesItem serviceItems[2];
+    setBulkItem(&serviceItems[0], UA_NODECLASS_OBJECT, "service.child",
+                UA_NODEID_STRING(1, "service.parent"), organizes, &oattr, otype);
+    setBulkItem(&serviceItems[1], UA_NODECLASS_OBJECT, "service.parent", objects, organizes,
+                &oattr, otype);
+    UA_AddNodesRequest request;
+    UA_AddNodesRequest_init(&request);
+    request.nodesToAdd = serviceItems;
+    request.nodesToAddSize = 2;
+    UA_AddNodesResponse response;
+    UA_AddNodesResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_AddNodes(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.resultsSize, 2);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_uint_eq(response.results[1].statusCode, UA_STATUSCODE_GOOD);
+    UA_AddNodesResponse_deleteMembers(&response);
+
+    UA_Server_delete(server);
+} END_TEST
+
+static size_t
+countHierarchicalReferences(UA_Server *server, UA_UInt32 nodeId) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, nodeId);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    bd.includeSubtypes = true;
+    bd.browseDirection = UA_BROWSEDIRECTION_BOTH;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    size_t count = br.referencesSize;
+    UA_BrowseResult_deleteMembers(&br);
+    return count;
+}
+
+START_TEST(SaveAndLoadSnapshot) {
+    /* A server with an additional namespace and variable */
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_UInt16 nsIndex = UA_Server_addNamespace(server, "urn:snapshot");
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_NodeId varId = UA_NODEID_STRING(nsIndex, "snapshot.var");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(nsIndex, "Var"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    size_t serverRefs = countHierarchicalReferences(server, UA_NS0ID_SERVER);
+    size_t objectsRefs = countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER);
+
+    UA_ByteString snapshot;
+    retval = UA_Server_saveSnapshot(server, &snapshot);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(snapshot.length, 0);
+    UA_Server_delete(server);
+
+    /* A corrupt image does not change the address space */
+    server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ByteString truncated = snapshot;
+    truncated.length = snapshot.length / 2;
+    retval = UA_Server_loadSnapshot(server, &truncated);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADDECODINGERROR);
+    ck_assert_uint_eq(server->namespacesSize, 2);
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER),
+                      objectsRefs - 1);
+
+    /* An image of another library version is rejected. The version follows
+     * the magic number and the format version. */
+    UA_ByteString otherVersion;
+    UA_ByteString_copy(&snapshot, &otherVersion);
+    ++otherVersion.data[8];
+    retval = UA_Server_loadSnapshot(server, &otherVersion);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADDECODINGERROR);
+    UA_ByteString_deleteMembers(&otherVersion);
+
+    /* Restore the address space in a new server */
+    retval = UA_Server_loadSnapshot(server, &snapshot);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(server->namespacesSize, 3);
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_SERVER), serverRefs);
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER), objectsRefs);
+    checkReferenceIndex(server, &varId);
+
+    /* The browse name hashes of the targets are computed when loading */
+    UA_RCU_LOCK();
+    UA_NodeId objectsId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    const UA_Node *objects = UA_NodeStore_get(server->nodestore, &objectsId);
+    const UA_NodeReference *ref = UA_Node_findReference(objects, &organizes, &varId, false);
+    ck_assert_ptr_ne(ref, NULL);
+    ck_assert_ptr_ne(objects->referenceIndex.nameHashes, NULL);
+    UA_QualifiedName varName = UA_QUALIFIEDNAME(nsIndex, "Var");
+    ck_assert_uint_eq(objects->referenceIndex.nameHashes[ref - objects->references],
+                      UA_Node_browseNameHash(&varName));
+    UA_RCU_UNLOCK();
+    UA_NodeId hasComponent = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    UA_NodeId aggregates = UA_NODEID_NUMERIC(0, UA_NS0ID_AGGREGATES);
+    ck_assert(UA_TypeIndex_isSubtype(&server->typeIndex, &hasComponent, &aggregates));
+
+    UA_Variant out;
+    retval = UA_Server_readValue(server, varId, &out);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)out.data, 42);
+    UA_Variant_deleteMembers(&out);
+
+    /* The data sources of namespace zero were taken over */
+    retval = UA_Server_readValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                 &out);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(out.type, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_deleteMembers(&out);
+
+    /* Nodes that are not in the snapshot are removed */
+    UA_NodeId otherId = UA_NODEID_STRING(1, "snapshot.other");
+    retval = UA_Server_addVariableNode(server, otherId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                       UA_QUALIFIEDNAME(1, "Other"), UA_NODEID_NULL,
+                                       attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_loadSnapshot(server, &snapshot);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_LOCK();
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &otherId), NULL);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER), objectsRefs);
+
+    UA_ByteString_deleteMembers(&snapshot);
+    UA_Server_delete(server);
+} END_TEST
+
+#define STATIC_STRING(s) {sizeof(s) - 1, (UA_Byte*)(uintptr_t)s}
+#define STATIC_NUMERIC(ns, i) {ns, UA_NODEIDTYPE_NUMERIC, {i}}
+#define STATIC_STRINGID(ns, s) {ns, UA_NODEIDTYPE_STRING, {.string = STATIC_STRING(s)}}
+
+static const UA_StaticReference staticTypeReferences[] = {
+    {STATIC_NUMERIC(0, UA_NS0ID_HASSUBTYPE), STATIC_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), false}};
+
+static const UA_StaticReference staticObjectReferences[] = {
+    {STATIC_NUMERIC(0, UA_NS0ID_ORGANIZES), STATIC_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), false},
+    {STATIC_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION), STATIC_NUMERIC(1, 1000), true},
+    {STATIC_NUMERIC(0, UA_NS0ID_HASCOMPONENT), STATIC_STRINGID(1, "static.var"), true},
+    {STATIC_NUMERIC(0, UA_NS0ID_ORGANIZES), STATIC_NUMERIC(1, 9999), true}}; /* unknown */
+
+/* The reference from the object is listed again in the inverse direction */
+static const UA_StaticReference staticVariableReferences[] = {
+    {STATIC_NUMERIC(0, UA_NS0ID_HASCOMPONENT), STATIC_STRINGID(1, "static.obj"), false},
+    {STATIC_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION),
+     STATIC_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), true}};
+
+static const UA_StaticNode staticNodes[] = {
+    {.nodeClass = UA_NODECLASS_OBJECTTYPE, .nodeId = STATIC_NUMERIC(1, 1000),
+     .browseName = {1, STATIC_STRING("StaticType")},
+     .displayName = {STATIC_STRING("en"), STATIC_STRING("StaticType")},
+     .referencesSize = 1, .references = staticTypeReferences},
+    {.nodeClass = UA_NODECLASS_OBJECT, .nodeId = STATIC_STRINGID(1, "static.obj"),
+     .browseName = {1, STATIC_STRING("StaticObject")},
+     .displayName = {STATIC_STRING("en"), STATIC_STRING("StaticObject")},
+     .referencesSize = 4, .references = staticObjectReferences},
+    {.nodeClass = UA_NODECLASS_VARIABLE, .nodeId = STATIC_STRINGID(1, "static.var"),
+     .browseName = {1, STATIC_STRING("Var")},
+     .displayName = {STATIC_STRING("en"), STATIC_STRING("Var")},
+     .dataType = STATIC_NUMERIC(0, UA_NS0ID_INT32), .valueRank = -1,
+     .accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE,
+     .userAccessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE,
+     .referencesSize = 2, .references = staticVariableReferences}};
+
+static UA_StatusCode
+translateSingle(UA_Server *server, const UA_NodeId *start, UA_UInt32 referenceType,
+                const UA_QualifiedName *targetName, UA_NodeId *target) {
+    UA_RelativePathElement elem;
+    UA_RelativePathElement_init(&elem);
+    elem.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    elem.targetName = *targetName;
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = *start;
+    bp.relativePath.elementsSize = 1;
+    bp.relativePath.elements = &elem;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    UA_StatusCode retval = bpr.statusCode;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_uint_eq(bpr.targetsSize, 1);
+        UA_NodeId_copy(&bpr.targets[0].targetId.nodeId, target);
+    }
+    UA_BrowsePathResult_deleteMembers(&bpr);
+    return retval;
+}
+
+START_TEST(AddStaticNodes) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    size_t objectsRefs = countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER);
+    size_t nodesSize = sizeof(staticNodes) / sizeof(UA_StaticNode);
+    UA_StatusCode retval = UA_Server_addStaticNodes(server, nodesSize, staticNodes);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Inverse references to nodes outside the table were added */
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER),
+                      objectsRefs + 1);
+    UA_NodeId typeId = staticNodes[0].nodeId;
+    UA_NodeId baseObjectType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
+    ck_assert(UA_TypeIndex_isSubtype(&server->typeIndex, &typeId, &baseObjectType));
+
+    /* The reference listed in both directions was added once. The reference to
+     * the unknown node was skipped. */
+    UA_NodeId objId = staticNodes[1].nodeId;
+    UA_NodeId varId = staticNodes[2].nodeId;
+    checkReferenceIndex(server, &objId);
+    checkReferenceIndex(server, &varId);
+    ck_assert_uint_eq(countBrowsedReferences(server, &objId, UA_NS0ID_HASCOMPONENT), 1);
+    ck_assert_uint_eq(countBrowsedReferences(server, &objId, UA_NS0ID_ORGANIZES), 0);
+    UA_RCU_LOCK();
+    const UA_Node *var = UA_NodeStore_get(server->nodestore, &varId);
+    ck_assert_ptr_ne(var, NULL);
+    ck_assert_uint_eq(var->referencesSize, 2);
+#ifndef UA_ENABLE_MULTITHREADING
+    ck_assert_ptr_ne(var->stringPool, NULL);
+#endif
+    ck_assert_ptr_ne(var->nodeId.identifier.string.data, varId.identifier.string.data);
+    UA_RCU_UNLOCK();
+
+    /* The browse names of the targets are indexed */
+    UA_NodeId objectsFolder = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId found;
+    retval = translateSingle(server, &objectsFolder, UA_NS0ID_ORGANIZES,
+                             &staticNodes[1].browseName, &found);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_NodeId_equal(&found, &objId));
+    UA_NodeId_deleteMembers(&found);
+    retval = translateSingle(server, &objId, UA_NS0ID_HASCOMPONENT,
+                             &staticNodes[2].browseName, &found);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_NodeId_equal(&found, &varId));
+    UA_NodeId_deleteMembers(&found);
+
+    /* The variable has no value until it is written */
+    UA_Int32 value = 42;
+    UA_Variant in;
+    UA_Variant_setScalar(&in, &value, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, varId, in);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Variant out;
+    retval = UA_Server_readValue(server, varId, &out);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)out.data, 42);
+    UA_Variant_deleteMembers(&out);
+
+    /* The nodes exist already */
+    retval = UA_Server_addStaticNodes(server, nodesSize, staticNodes);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADNODEIDEXISTS);
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER),
+                      objectsRefs + 1);
+
+    /* The nodes can be deleted */
+    retval = UA_Server_deleteNode(server, objId, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(countHierarchicalReferences(server, UA_NS0ID_OBJECTSFOLDER), objectsRefs);
+    UA_Server_delete(server);
+} END_TEST
+
 static Suite * testSuite_services_nodemanagement(void) {
     Suite *s = suite_create("services_nodemanagement");
 
@@ -252,10 +1093,24 @@ static Suite * testSuite_services_nodemanagement(void) {
     tcase_add_test(tc_addnodes, AddComplexTypeWithInheritance);
     tcase_add_test(tc_addnodes, AddNodeTwiceGivesError);
     tcase_add_test(tc_addnodes, AddObjectWithConstructor);
+    tcase_add_test(tc_addnodes, AddNodeWithChangedReferenceTypeHierarchy);
+#ifdef UA_ENABLE_MULTITHREADING
+    tcase_add_test(tc_addnodes, QueryTypeIndexWhileUpdating);
+    tcase_add_test(tc_addnodes, TypeIndexViewAfterQueries);
+#endif
+    tcase_add_test(tc_addnodes, AddAndDeleteManyReferences);
+    tcase_add_test(tc_addnodes, AddNodesInBulk);
+    tcase_add_test(tc_addnodes, AddNodesInBulkChecksFirst);
+    tcase_add_test(tc_addnodes, SaveAndLoadSnapshot);
+    tcase_add_test(tc_addnodes, AddStaticNodes);
 
     TCase *tc_deletenodes = tcase_create("deletenodes");
     tcase_add_test(tc_addnodes, DeleteObjectWithDestructor);
+    tcase_add_test(tc_addnodes, DeleteObjectWithDeletedType);
     tcase_add_test(tc_addnodes, DeleteObjectAndReferences);
+#ifdef UA_ENABLE_METHODCALLS
+    tcase_add_test(tc_addnodes, CallMethodWithChangedArguments);
+#endif
 
     suite_add_tcase(s, tc_addnodes);
     suite_add_tcase(s, tc_deletenodes);
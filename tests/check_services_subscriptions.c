@@ -6,10 +6,16 @@
 #include "server/ua_services.h"
 #include "server/ua_server_internal.h"
 #include "server/ua_subscription.h"
+#include "ua_types_encoding_binary.h"
 #include "ua_config_standard.h"
 
 #include "check.h"
 #include "testing_clock.h"
+#include <pthread.h>
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <time.h>
+#endif
 
 UA_Server *server = NULL;
 
@@ -23,6 +29,24 @@ static void teardown(void) {
     UA_Server_delete(server);
 }
 
+/* Runs one iteration of the main loop. With multithreading, new repeated jobs
+ * are only registered in the main loop and due jobs are dispatched to the
+ * worker threads. Wait until they are processed. */
+static void iterate(void) {
+    UA_Server_run_iterate(server, false);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The testing clock does not sleep. Wait in real time until the queue is
+     * empty and the worker has not finished another job for 10ms. */
+    struct timespec ts = {0, 10 * 1000 * 1000};
+    UA_UInt32 counter;
+    do {
+        counter = server->workers[0].counter;
+        nanosleep(&ts, NULL);
+    } while(!cds_wfcq_empty(&server->dispatchQueue_head, &server->dispatchQueue_tail) ||
+            counter != server->workers[0].counter);
+#endif
+}
+
 UA_UInt32 subscriptionId;
 UA_UInt32 monitoredItemId;
 
@@ -35,7 +59,9 @@ START_TEST(Server_createSubscription) {
     UA_CreateSubscriptionResponse response;
     UA_CreateSubscriptionResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_CreateSubscription(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     subscriptionId = response.subscriptionId;
 
@@ -58,7 +84,9 @@ START_TEST(Server_modifySubscription) {
     UA_ModifySubscriptionResponse response;
     UA_ModifySubscriptionResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_ModifySubscription(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
 
     UA_ModifySubscriptionResponse_deleteMembers(&response);
@@ -75,7 +103,9 @@ START_TEST(Server_setPublishingMode) {
     UA_SetPublishingModeResponse response;
     UA_SetPublishingModeResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_SetPublishingMode(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(response.resultsSize, 1);
     ck_assert_uint_eq(response.results[0], UA_STATUSCODE_GOOD);
@@ -93,7 +123,9 @@ START_TEST(Server_republish) {
     UA_RepublishResponse response;
     UA_RepublishResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_Republish(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_BADMESSAGENOTAVAILABLE);
 
     UA_RepublishResponse_deleteMembers(&response);
@@ -111,7 +143,9 @@ START_TEST(Server_republish_invalid) {
     UA_RepublishResponse response;
     UA_RepublishResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_Republish(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID);
 
     UA_RepublishResponse_deleteMembers(&response);
@@ -119,6 +153,88 @@ START_TEST(Server_republish_invalid) {
 }
 END_TEST
 
+START_TEST(Server_retransmissionBudget) {
+    /* Create two subscriptions */
+    UA_Subscription *subs[2];
+    for(size_t i = 0; i < 2; ++i) {
+        UA_CreateSubscriptionRequest request;
+        UA_CreateSubscriptionRequest_init(&request);
+        request.publishingEnabled = true;
+        UA_CreateSubscriptionResponse response;
+        UA_CreateSubscriptionResponse_init(&response);
+        UA_RCU_LOCK();
+        Service_CreateSubscription(server, &adminSession, &request, &response);
+        UA_RCU_UNLOCK();
+        ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+        subs[i] = UA_Session_getSubscriptionByID(&adminSession, response.subscriptionId);
+        UA_CreateSubscriptionResponse_deleteMembers(&response);
+    }
+
+    /* The budget holds three (equally sized) messages */
+    UA_NotificationMessage message;
+    UA_NotificationMessage_init(&message);
+    message.publishTime = UA_DateTime_now();
+    size_t messageSize = UA_calcSizeBinary(&message, &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE]);
+    server->config.maxRetransmissionBytes = 3 * messageSize;
+
+    /* Two messages for each subscription. The oldest message is evicted. */
+    for(UA_UInt32 seq = 1; seq <= 2; ++seq) {
+        for(size_t i = 0; i < 2; ++i) {
+            message.sequenceNumber = seq;
+            UA_StatusCode retval =
+                UA_Subscription_addRetransmissionMessage(server, subs[i], &message);
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        }
+    }
+    UA_RetransmissionStatistics stats;
+    UA_Server_getRetransmissionStatistics(server, &stats);
+    ck_assert_uint_eq(stats.messagesHeld, 3);
+    ck_assert_uint_eq(stats.bytesHeld, 3 * messageSize);
+    ck_assert_uint_eq(stats.evictions, 1);
+    ck_assert_uint_eq(subs[0]->retransmissionQueueSize, 1);
+    ck_assert_uint_eq(subs[1]->retransmissionQueueSize, 2);
+
+    /* Republish a held and an evicted message */
+    UA_RepublishRequest request;
+    UA_RepublishRequest_init(&request);
+    request.subscriptionId = subs[1]->subscriptionID;
+    request.retransmitSequenceNumber = 1;
+    UA_RepublishResponse response;
+    UA_RepublishResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Republish(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.notificationMessage.sequenceNumber, 1);
+    ck_assert(response.notificationMessage.publishTime == message.publishTime);
+    UA_RepublishResponse_deleteMembers(&response);
+
+    request.subscriptionId = subs[0]->subscriptionID;
+    UA_RepublishResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_Republish(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult,
+                      UA_STATUSCODE_BADMESSAGENOTAVAILABLE);
+    UA_RepublishResponse_deleteMembers(&response);
+
+    UA_Server_getRetransmissionStatistics(server, &stats);
+    ck_assert_uint_eq(stats.republishRequests, 2);
+    ck_assert_uint_eq(stats.republishHits, 1);
+
+    /* Acknowledge a message and delete a subscription with held messages */
+    ck_assert_uint_eq(UA_Subscription_removeRetransmissionMessage(server, subs[0], 2),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Session_deleteSubscription(server, &adminSession,
+                                                    subs[1]->subscriptionID),
+                      UA_STATUSCODE_GOOD);
+    UA_Session_deleteSubscription(server, &adminSession, subs[0]->subscriptionID);
+    UA_Server_getRetransmissionStatistics(server, &stats);
+    ck_assert_uint_eq(stats.messagesHeld, 0);
+    ck_assert_uint_eq(stats.bytesHeld, 0);
+}
+END_TEST
+
 START_TEST(Server_deleteSubscription) {
     /* Remove the subscription */
     UA_DeleteSubscriptionsRequest del_request;
@@ -129,7 +245,9 @@ START_TEST(Server_deleteSubscription) {
     UA_DeleteSubscriptionsResponse del_response;
     UA_DeleteSubscriptionsResponse_init(&del_response);
 
+    UA_RCU_LOCK();
     Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(del_response.resultsSize, 1);
     ck_assert_uint_eq(del_response.results[0], UA_STATUSCODE_GOOD);
 
@@ -145,7 +263,9 @@ START_TEST(Server_publishCallback) {
     UA_CreateSubscriptionRequest_init(&request);
     request.publishingEnabled = true;
     UA_CreateSubscriptionResponse_init(&response);
+    UA_RCU_LOCK();
     Service_CreateSubscription(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     UA_UInt32 subscriptionId1 = response.subscriptionId;
     UA_CreateSubscriptionResponse_deleteMembers(&response);
@@ -154,13 +274,16 @@ START_TEST(Server_publishCallback) {
     UA_CreateSubscriptionRequest_init(&request);
     request.publishingEnabled = true;
     UA_CreateSubscriptionResponse_init(&response);
+    UA_RCU_LOCK();
     Service_CreateSubscription(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     UA_UInt32 subscriptionId2 = response.subscriptionId;
     UA_Double publishingInterval = response.revisedPublishingInterval;
     ck_assert(publishingInterval > 0.0f);
     UA_CreateSubscriptionResponse_deleteMembers(&response);
 
+    iterate();
     /* Sleep until the publishing interval times out */
     UA_sleep((UA_DateTime)publishingInterval + 1);
 
@@ -169,12 +292,7 @@ START_TEST(Server_publishCallback) {
     LIST_FOREACH(sub, &adminSession.serverSubscriptions, listEntry)
         ck_assert_uint_eq(sub->currentKeepAliveCount, sub->maxKeepAliveCount);
 
-    UA_Server_run_iterate(server, false);
-#ifdef UA_ENABLE_MULTITHREADING
-    UA_sleep(publishingInterval + 1);
-    UA_Server_run_iterate(server, false);
-    UA_sleep(publishingInterval + 1);
-#endif
+    iterate();
 
     LIST_FOREACH(sub, &adminSession.serverSubscriptions, listEntry)
         ck_assert_uint_eq(sub->currentKeepAliveCount, sub->maxKeepAliveCount+1);
@@ -189,7 +307,9 @@ START_TEST(Server_publishCallback) {
     UA_DeleteSubscriptionsResponse del_response;
     UA_DeleteSubscriptionsResponse_init(&del_response);
 
+    UA_RCU_LOCK();
     Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(del_response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(del_response.resultsSize, 2);
     ck_assert_uint_eq(del_response.results[0], UA_STATUSCODE_GOOD);
@@ -199,6 +319,69 @@ START_TEST(Server_publishCallback) {
 }
 END_TEST
 
+START_TEST(Server_readySubscriptionPriority) {
+    /* Create subscriptions with priorities 1, 5, 5 and 3 */
+    UA_Byte priorities[4] = {1, 5, 5, 3};
+    UA_Subscription *subs[4];
+    for(size_t i = 0; i < 4; ++i) {
+        UA_CreateSubscriptionRequest request;
+        UA_CreateSubscriptionRequest_init(&request);
+        request.publishingEnabled = true;
+        request.priority = priorities[i];
+        UA_CreateSubscriptionResponse response;
+        UA_CreateSubscriptionResponse_init(&response);
+        UA_RCU_LOCK();
+        Service_CreateSubscription(server, &adminSession, &request, &response);
+        UA_RCU_UNLOCK();
+        ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+        subs[i] = UA_Session_getSubscriptionByID(&adminSession, response.subscriptionId);
+        ck_assert_ptr_ne(subs[i], NULL);
+        UA_CreateSubscriptionResponse_deleteMembers(&response);
+    }
+
+    /* All subscriptions wait for a PublishRequest */
+    for(size_t i = 0; i < 4; ++i)
+        UA_Session_setSubscriptionReady(&adminSession, subs[i]);
+    UA_Session_setSubscriptionReady(&adminSession, subs[0]); /* no duplicates */
+
+    /* Raise the priority of the first subscription above the others */
+    UA_ModifySubscriptionRequest modRequest;
+    UA_ModifySubscriptionRequest_init(&modRequest);
+    modRequest.subscriptionId = subs[0]->subscriptionID;
+    modRequest.priority = 7;
+    UA_ModifySubscriptionResponse modResponse;
+    UA_ModifySubscriptionResponse_init(&modResponse);
+    UA_RCU_LOCK();
+    Service_ModifySubscription(server, &adminSession, &modRequest, &modResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(modResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_ModifySubscriptionResponse_deleteMembers(&modResponse);
+
+    /* Served by descending priority, FIFO within the same priority */
+    ck_assert_ptr_eq(UA_Session_popReadySubscription(&adminSession), subs[0]);
+    ck_assert_ptr_eq(UA_Session_popReadySubscription(&adminSession), subs[1]);
+    ck_assert_ptr_eq(UA_Session_popReadySubscription(&adminSession), subs[2]);
+
+    /* Deleted subscriptions leave the ready queue */
+    UA_Session_setSubscriptionReady(&adminSession, subs[1]);
+    UA_UInt32 removeIds[4];
+    for(size_t i = 0; i < 4; ++i)
+        removeIds[i] = subs[i]->subscriptionID;
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 4;
+    del_request.subscriptionIds = removeIds;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(del_response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+    ck_assert_ptr_eq(UA_Session_popReadySubscription(&adminSession), NULL);
+}
+END_TEST
+
 START_TEST(Server_createMonitoredItems) {
 
     UA_CreateMonitoredItemsRequest request;
@@ -224,7 +407,9 @@ START_TEST(Server_createMonitoredItems) {
     UA_CreateMonitoredItemsResponse response;
     UA_CreateMonitoredItemsResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(response.resultsSize, 1);
     ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
@@ -260,7 +445,9 @@ START_TEST(Server_modifyMonitoredItems) {
     UA_ModifyMonitoredItemsResponse response;
     UA_ModifyMonitoredItemsResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_ModifyMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(response.resultsSize, 1);
     ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
@@ -282,7 +469,9 @@ START_TEST(Server_setMonitoringMode) {
     UA_SetMonitoringModeResponse response;
     UA_SetMonitoringModeResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_SetMonitoringMode(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(response.resultsSize, 1);
     ck_assert_uint_eq(response.results[0], UA_STATUSCODE_GOOD);
@@ -302,7 +491,9 @@ START_TEST(Server_deleteMonitoredItems) {
     UA_DeleteMonitoredItemsResponse response;
     UA_DeleteMonitoredItemsResponse_init(&response);
 
+    UA_RCU_LOCK();
     Service_DeleteMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
     ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
     ck_assert_uint_eq(response.resultsSize, 1);
     ck_assert_uint_eq(response.results[0], UA_STATUSCODE_GOOD);
@@ -314,6 +505,537 @@ START_TEST(Server_deleteMonitoredItems) {
 END_TEST
 
 
+START_TEST(Server_samplingGroups) {
+    /* Add a variable to sample */
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 myInteger = 0;
+    UA_Variant_setScalar(&vattr.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    const UA_NodeId varId = UA_NODEID_STRING(1, "sampled.variable");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "sampled variable"),
+                                  UA_NODEID_NULL, vattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Create a subscription */
+    UA_CreateSubscriptionRequest subRequest;
+    UA_CreateSubscriptionRequest_init(&subRequest);
+    subRequest.publishingEnabled = true;
+    UA_CreateSubscriptionResponse subResponse;
+    UA_CreateSubscriptionResponse_init(&subResponse);
+    UA_RCU_LOCK();
+    Service_CreateSubscription(server, &adminSession, &subRequest, &subResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(subResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = subResponse.subscriptionId;
+    UA_CreateSubscriptionResponse_deleteMembers(&subResponse);
+
+    /* Two items with the same sampling interval and one with another interval */
+    UA_MonitoredItemCreateRequest items[3];
+    UA_Double intervals[3] = {100.0, 100.0, 250.0};
+    for(size_t i = 0; i < 3; ++i) {
+        UA_MonitoredItemCreateRequest_init(&items[i]);
+        items[i].itemToMonitor.nodeId = varId;
+        items[i].itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+        items[i].monitoringMode = UA_MONITORINGMODE_REPORTING;
+        items[i].requestedParameters.samplingInterval = intervals[i];
+        items[i].requestedParameters.queueSize = 10;
+    }
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.itemsToCreateSize = 3;
+    request.itemsToCreate = items;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    iterate();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 3);
+    UA_UInt32 itemIds[3];
+    for(size_t i = 0; i < 3; ++i) {
+        ck_assert_uint_eq(response.results[i].statusCode, UA_STATUSCODE_GOOD);
+        itemIds[i] = response.results[i].monitoredItemId;
+    }
+    UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+
+    /* The items are sorted into two groups */
+    UA_Subscription *sub = UA_Session_getSubscriptionByID(&adminSession, subId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_MonitoredItem *mon0 = UA_Subscription_getMonitoredItem(sub, itemIds[0]);
+    UA_MonitoredItem *mon1 = UA_Subscription_getMonitoredItem(sub, itemIds[1]);
+    UA_MonitoredItem *mon2 = UA_Subscription_getMonitoredItem(sub, itemIds[2]);
+    ck_assert_ptr_eq(mon0->samplingGroup, mon1->samplingGroup);
+    ck_assert_ptr_ne(mon0->samplingGroup, mon2->samplingGroup);
+    ck_assert_uint_eq(mon0->samplingGroup->itemsSize, 2);
+    ck_assert_uint_eq(mon2->samplingGroup->itemsSize, 1);
+    ck_assert_uint_eq(mon0->currentQueueSize, 1); /* The initial sample */
+
+    /* Change the value. Only the items in the faster group are sampled. */
+    myInteger = 42;
+    UA_Variant value;
+    UA_Variant_setScalar(&value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_Server_writeValue(server, varId, value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_sleep(101);
+    iterate();
+    ck_assert_uint_eq(mon0->currentQueueSize, 2);
+    ck_assert_uint_eq(mon1->currentQueueSize, 2);
+    ck_assert_uint_eq(mon2->currentQueueSize, 1);
+
+    /* An unchanged value is not sampled again */
+    UA_sleep(101);
+    iterate();
+    ck_assert_uint_eq(mon0->currentQueueSize, 2);
+
+    /* Removing an item moves the last item of the table into its slot */
+    UA_SamplingGroup *group = mon0->samplingGroup;
+    ck_assert_uint_eq(UA_Subscription_deleteMonitoredItem(server, sub, mon0->itemId),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(group->itemsSize, 1);
+    ck_assert_ptr_eq(group->items[0], mon1);
+    ck_assert_uint_eq(mon1->samplingGroupIndex, 0);
+
+    /* Remove the subscription with the remaining items and groups */
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 1;
+    del_request.subscriptionIds = &subId;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(del_response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+    ck_assert_ptr_eq(LIST_FIRST(&server->samplingGroups), NULL);
+}
+END_TEST
+
+static size_t readBatchCalls = 0;
+static UA_UInt32 batchValue = 0;
+
+static UA_StatusCode
+readBatchValues(void *handle, size_t itemsSize, const UA_NodeId *nodeIds,
+                UA_Boolean sourceTimeStamp, const UA_NumericRange * const *ranges,
+                UA_DataValue *values) {
+    ++readBatchCalls;
+    for(size_t i = 0; i < itemsSize; ++i) {
+        UA_Variant_setScalarCopy(&values[i].value, &batchValue, &UA_TYPES[UA_TYPES_UINT32]);
+        values[i].hasValue = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(Server_samplingBatchRead) {
+    /* Add two variables of a data source with batch reads */
+    UA_DataSource dataSource = (UA_DataSource) {.handle = NULL, .read = NULL, .write = NULL};
+    UA_DataSourceExtension extension =
+        (UA_DataSourceExtension) {.readAsync = NULL, .readBatch = readBatchValues};
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    for(UA_UInt32 i = 0; i < 2; ++i) {
+        UA_StatusCode retval =
+            UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 60000 + i),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                UA_QUALIFIEDNAME(1, "batch"),
+                                                UA_NODEID_NULL, vattr, dataSource, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Server_setVariableNode_dataSourceExtension(server,
+                                                               UA_NODEID_NUMERIC(1, 60000 + i),
+                                                               extension);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_CreateSubscriptionRequest subRequest;
+    UA_CreateSubscriptionRequest_init(&subRequest);
+    subRequest.publishingEnabled = true;
+    UA_CreateSubscriptionResponse subResponse;
+    UA_CreateSubscriptionResponse_init(&subResponse);
+    UA_RCU_LOCK();
+    Service_CreateSubscription(server, &adminSession, &subRequest, &subResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(subResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = subResponse.subscriptionId;
+    UA_CreateSubscriptionResponse_deleteMembers(&subResponse);
+
+    /* Both items are in the same sampling group */
+    UA_MonitoredItemCreateRequest items[2];
+    for(size_t i = 0; i < 2; ++i) {
+        UA_MonitoredItemCreateRequest_init(&items[i]);
+        items[i].itemToMonitor.nodeId = UA_NODEID_NUMERIC(1, 60000 + (UA_UInt32)i);
+        items[i].itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+        items[i].monitoringMode = UA_MONITORINGMODE_REPORTING;
+        items[i].requestedParameters.samplingInterval = 100.0;
+        items[i].requestedParameters.queueSize = 10;
+    }
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.itemsToCreateSize = 2;
+    request.itemsToCreate = items;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    iterate();
+    ck_assert_uint_eq(response.resultsSize, 2);
+    UA_Subscription *sub = UA_Session_getSubscriptionByID(&adminSession, subId);
+    UA_MonitoredItem *mon0 =
+        UA_Subscription_getMonitoredItem(sub, response.results[0].monitoredItemId);
+    UA_MonitoredItem *mon1 =
+        UA_Subscription_getMonitoredItem(sub, response.results[1].monitoredItemId);
+    UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+    ck_assert_ptr_eq(mon0->samplingGroup, mon1->samplingGroup);
+
+    /* The group is sampled with one call */
+    batchValue = 42;
+    readBatchCalls = 0;
+    UA_sleep(101);
+    iterate();
+    ck_assert_uint_eq(readBatchCalls, 1);
+    ck_assert_uint_eq(mon0->currentQueueSize, 2);
+    ck_assert_uint_eq(mon1->currentQueueSize, 2);
+    MonitoredItem_queuedValue *last = TAILQ_LAST(&mon1->queue, QueueOfQueueDataValues);
+    ck_assert_uint_eq(*(UA_UInt32*)last->value.value.data, 42);
+
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 1;
+    del_request.subscriptionIds = &subId;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+}
+END_TEST
+
+/* Removes the items of the sampling group during the sweep */
+static UA_Subscription *removeSub = NULL;
+static UA_UInt32 removeItemIds[2];
+
+static UA_StatusCode
+readBatchAndRemove(void *handle, size_t itemsSize, const UA_NodeId *nodeIds,
+                   UA_Boolean sourceTimeStamp, const UA_NumericRange * const *ranges,
+                   UA_DataValue *values) {
+    for(size_t i = 0; removeSub && i < 2; ++i)
+        UA_Subscription_deleteMonitoredItem(server, removeSub, removeItemIds[i]);
+    return readBatchValues(handle, itemsSize, nodeIds, sourceTimeStamp, ranges, values);
+}
+
+START_TEST(Server_samplingGroupEmptiedInSweep) {
+    UA_DataSource dataSource = (UA_DataSource) {.handle = NULL, .read = NULL, .write = NULL};
+    UA_DataSourceExtension extension =
+        (UA_DataSourceExtension) {.readAsync = NULL, .readBatch = readBatchAndRemove};
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    for(UA_UInt32 i = 0; i < 2; ++i) {
+        UA_StatusCode retval =
+            UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 61000 + i),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                UA_QUALIFIEDNAME(1, "remove"),
+                                                UA_NODEID_NULL, vattr, dataSource, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Server_setVariableNode_dataSourceExtension(server,
+                                                               UA_NODEID_NUMERIC(1, 61000 + i),
+                                                               extension);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_CreateSubscriptionRequest subRequest;
+    UA_CreateSubscriptionRequest_init(&subRequest);
+    subRequest.publishingEnabled = true;
+    UA_CreateSubscriptionResponse subResponse;
+    UA_CreateSubscriptionResponse_init(&subResponse);
+    UA_RCU_LOCK();
+    Service_CreateSubscription(server, &adminSession, &subRequest, &subResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(subResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = subResponse.subscriptionId;
+    UA_CreateSubscriptionResponse_deleteMembers(&subResponse);
+
+    /* Both items are in the same sampling group. The first sweep removes
+     * them. */
+    UA_MonitoredItemCreateRequest items[2];
+    for(size_t i = 0; i < 2; ++i) {
+        UA_MonitoredItemCreateRequest_init(&items[i]);
+        items[i].itemToMonitor.nodeId = UA_NODEID_NUMERIC(1, 61000 + (UA_UInt32)i);
+        items[i].itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+        items[i].monitoringMode = UA_MONITORINGMODE_REPORTING;
+        items[i].requestedParameters.samplingInterval = 100.0;
+        items[i].requestedParameters.queueSize = 10;
+    }
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.itemsToCreateSize = 2;
+    request.itemsToCreate = items;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    removeSub = NULL;
+    UA_RCU_LOCK();
+    Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    iterate();
+    ck_assert_uint_eq(response.resultsSize, 2);
+    removeSub = UA_Session_getSubscriptionByID(&adminSession, subId);
+    for(size_t i = 0; i < 2; ++i)
+        removeItemIds[i] = response.results[i].monitoredItemId;
+    UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+    ck_assert_ptr_ne(LIST_FIRST(&server->samplingGroups), NULL);
+
+    /* The group is removed after the sweep */
+    UA_sleep(101);
+    iterate();
+    ck_assert_ptr_eq(LIST_FIRST(&removeSub->monitoredItems), NULL);
+    ck_assert_ptr_eq(LIST_FIRST(&server->samplingGroups), NULL);
+
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 1;
+    del_request.subscriptionIds = &subId;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+}
+END_TEST
+
+START_TEST(Server_samplingValueHandle) {
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 myInteger = 0;
+    UA_Variant_setScalar(&vattr.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    const UA_NodeId varId = UA_NODEID_STRING(1, "handle.variable");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "handle variable"),
+                                  UA_NODEID_NULL, vattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_ValueHandle *handle = NULL;
+    retval = UA_Server_addValueHandle(server, varId, &UA_TYPES[UA_TYPES_INT32], 0, 8, &handle);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_CreateSubscriptionRequest subRequest;
+    UA_CreateSubscriptionRequest_init(&subRequest);
+    subRequest.publishingEnabled = true;
+    UA_CreateSubscriptionResponse subResponse;
+    UA_CreateSubscriptionResponse_init(&subResponse);
+    UA_RCU_LOCK();
+    Service_CreateSubscription(server, &adminSession, &subRequest, &subResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(subResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = subResponse.subscriptionId;
+    UA_CreateSubscriptionResponse_deleteMembers(&subResponse);
+
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = varId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.samplingInterval = 100.0;
+    item.requestedParameters.queueSize = 10;
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.itemsToCreateSize = 1;
+    request.itemsToCreate = &item;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    iterate();
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_Subscription *sub = UA_Session_getSubscriptionByID(&adminSession, subId);
+    UA_MonitoredItem *mon =
+        UA_Subscription_getMonitoredItem(sub, response.results[0].monitoredItemId);
+    UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+    ck_assert_uint_eq(mon->currentQueueSize, 1); /* The initial sample */
+
+    /* All updates between two samplings are queued */
+    for(UA_Int32 i = 1; i <= 3; ++i)
+        UA_ValueHandle_update(handle, &i, UA_STATUSCODE_GOOD, 0);
+    UA_sleep(101);
+    iterate();
+    ck_assert_uint_eq(mon->currentQueueSize, 4);
+    MonitoredItem_queuedValue *last = TAILQ_LAST(&mon->queue, QueueOfQueueDataValues);
+    ck_assert_int_eq(*(UA_Int32*)last->value.value.data, 3);
+    ck_assert(last->value.hasSourceTimestamp);
+
+    /* Updates that were overwritten in the ring are lost */
+    for(UA_Int32 i = 4; i <= 20; ++i)
+        UA_ValueHandle_update(handle, &i, UA_STATUSCODE_GOOD, 0);
+    UA_sleep(101);
+    iterate();
+    ck_assert_uint_eq(mon->currentQueueSize, 10);
+    last = TAILQ_LAST(&mon->queue, QueueOfQueueDataValues);
+    ck_assert_int_eq(*(UA_Int32*)last->value.value.data, 20);
+
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 1;
+    del_request.subscriptionIds = &subId;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+    retval = UA_Server_removeValueHandle(server, handle);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+END_TEST
+
+/* The producer writes arrays where all entries are equal. A torn value mixes
+ * entries of two updates. */
+#define PRODUCER_ARRAYLENGTH 256
+
+static volatile UA_Boolean producerRunning;
+static volatile UA_Int32 producerUpdates;
+
+static void *
+produceValues(void *h) {
+    UA_ValueHandle *handle = (UA_ValueHandle*)h;
+    UA_Int32 values[PRODUCER_ARRAYLENGTH];
+    for(UA_Int32 i = 1; producerRunning; ++i) {
+        for(size_t j = 0; j < PRODUCER_ARRAYLENGTH; ++j)
+            values[j] = i;
+        /* Do not read the testing clock from the producer thread */
+        UA_ValueHandle_update(handle, values, UA_STATUSCODE_GOOD, i);
+        producerUpdates = i;
+    }
+    return NULL;
+}
+
+static void
+checkConsistent(const UA_Variant *value) {
+    ck_assert_ptr_eq(value->type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_uint_eq(value->arrayLength, PRODUCER_ARRAYLENGTH);
+    const UA_Int32 *values = (const UA_Int32*)value->data;
+    for(size_t j = 1; j < PRODUCER_ARRAYLENGTH; ++j)
+        ck_assert_int_eq(values[j], values[0]);
+}
+
+START_TEST(Server_samplingValueHandleConcurrent) {
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 initial[PRODUCER_ARRAYLENGTH] = {0};
+    UA_Variant_setArray(&vattr.value, initial, PRODUCER_ARRAYLENGTH, &UA_TYPES[UA_TYPES_INT32]);
+    vattr.valueRank = 1;
+    const UA_NodeId varId = UA_NODEID_STRING(1, "handle.array");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "handle array"),
+                                  UA_NODEID_NULL, vattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    /* Two samples, so that the producer overwrites samples while they are read */
+    UA_ValueHandle *handle = NULL;
+    retval = UA_Server_addValueHandle(server, varId, &UA_TYPES[UA_TYPES_INT32],
+                                      PRODUCER_ARRAYLENGTH, 2, &handle);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_CreateSubscriptionRequest subRequest;
+    UA_CreateSubscriptionRequest_init(&subRequest);
+    subRequest.publishingEnabled = true;
+    UA_CreateSubscriptionResponse subResponse;
+    UA_CreateSubscriptionResponse_init(&subResponse);
+    UA_RCU_LOCK();
+    Service_CreateSubscription(server, &adminSession, &subRequest, &subResponse);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(subResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = subResponse.subscriptionId;
+    UA_CreateSubscriptionResponse_deleteMembers(&subResponse);
+
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = varId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.samplingInterval = 100.0;
+    item.requestedParameters.queueSize = 10;
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.itemsToCreateSize = 1;
+    request.itemsToCreate = &item;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_CreateMonitoredItems(server, &adminSession, &request, &response);
+    UA_RCU_UNLOCK();
+    iterate();
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_Subscription *sub = UA_Session_getSubscriptionByID(&adminSession, subId);
+    UA_MonitoredItem *mon =
+        UA_Subscription_getMonitoredItem(sub, response.results[0].monitoredItemId);
+    UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+
+    /* Read and sample while the producer overwrites the ring */
+    pthread_t producer;
+    producerRunning = true;
+    producerUpdates = 0;
+    ck_assert_int_eq(pthread_create(&producer, NULL, produceValues, handle), 0);
+    while(producerUpdates == 0) {} /* Wait until the producer runs */
+    UA_Variant value;
+    for(size_t round = 0; round < 10; ++round) {
+        for(size_t i = 0; i < 10000; ++i) {
+            retval = UA_Server_readValue(server, varId, &value);
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+            checkConsistent(&value);
+            UA_Variant_deleteMembers(&value);
+        }
+        UA_sleep(101);
+        iterate();
+        MonitoredItem_queuedValue *qv;
+        TAILQ_FOREACH(qv, &mon->queue, listEntry)
+            checkConsistent(&qv->value.value);
+    }
+    producerRunning = false;
+    pthread_join(producer, NULL);
+
+    /* The most recent value is read after the producer stopped */
+    retval = UA_Server_readValue(server, varId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    checkConsistent(&value);
+    ck_assert_int_eq(*(UA_Int32*)value.data, producerUpdates);
+    UA_Variant_deleteMembers(&value);
+
+    UA_DeleteSubscriptionsRequest del_request;
+    UA_DeleteSubscriptionsRequest_init(&del_request);
+    del_request.subscriptionIdsSize = 1;
+    del_request.subscriptionIds = &subId;
+    UA_DeleteSubscriptionsResponse del_response;
+    UA_DeleteSubscriptionsResponse_init(&del_response);
+    UA_RCU_LOCK();
+    Service_DeleteSubscriptions(server, &adminSession, &del_request, &del_response);
+    UA_RCU_UNLOCK();
+    UA_DeleteSubscriptionsResponse_deleteMembers(&del_response);
+    retval = UA_Server_removeValueHandle(server, handle);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+END_TEST
+
 static Suite* testSuite_Client(void) {
     Suite *s = suite_create("Server Subscription");
     TCase *tc_server = tcase_create("Server Subscription Basic");
@@ -328,7 +1050,14 @@ static Suite* testSuite_Client(void) {
     tcase_add_test(tc_server, Server_republish);
     tcase_add_test(tc_server, Server_deleteSubscription);
     tcase_add_test(tc_server, Server_republish_invalid);
+    tcase_add_test(tc_server, Server_retransmissionBudget);
     tcase_add_test(tc_server, Server_publishCallback);
+    tcase_add_test(tc_server, Server_readySubscriptionPriority);
+    tcase_add_test(tc_server, Server_samplingGroups);
+    tcase_add_test(tc_server, Server_samplingBatchRead);
+    tcase_add_test(tc_server, Server_samplingGroupEmptiedInSweep);
+    tcase_add_test(tc_server, Server_samplingValueHandle);
+    tcase_add_test(tc_server, Server_samplingValueHandleConcurrent);
     suite_add_tcase(s, tc_server);
 
     return s;
@@ -119,15 +119,260 @@ START_TEST(Service_TranslateBrowsePathsToNodeIds)
     }
 END_TEST
 
+static UA_StatusCode
+translateSingle(UA_Server *server, const UA_NodeId *start, const UA_NodeId *referenceTypeId,
+                UA_Boolean isInverse, const UA_QualifiedName *targetName, UA_NodeId *target) {
+    UA_RelativePathElement elem;
+    UA_RelativePathElement_init(&elem);
+    elem.referenceTypeId = *referenceTypeId;
+    elem.isInverse = isInverse;
+    elem.includeSubtypes = true;
+    elem.targetName = *targetName;
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = *start;
+    bp.relativePath.elementsSize = 1;
+    bp.relativePath.elements = &elem;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    UA_StatusCode retval = bpr.statusCode;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_uint_eq(bpr.targetsSize, 1);
+        UA_NodeId_copy(&bpr.targets[0].targetId.nodeId, target);
+    }
+    UA_BrowsePathResult_deleteMembers(&bpr);
+    return retval;
+}
+
+START_TEST(Service_TranslateBrowsePathsToNodeIds_WideFolder)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+        UA_NodeId folder = UA_NODEID_STRING(1, "wide.folder");
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Wide"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        char name[32];
+        for(UA_UInt32 i = 0; i < 200; ++i) {
+            snprintf(name, sizeof(name), "Child%u", i);
+            retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 3000 + i), folder,
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                             UA_QUALIFIEDNAME(1, name),
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                             oattr, NULL, NULL);
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        }
+
+        /* The children are indexed by their browse name */
+        UA_RCU_LOCK();
+        const UA_Node *node = UA_NodeStore_get(server->nodestore, &folder);
+        ck_assert_uint_ge(node->referenceIndex.namesCount, 200);
+        ck_assert_ptr_ne(node->referenceIndex.names, NULL);
+        UA_RCU_UNLOCK();
+
+        UA_NodeId hierarchical = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        UA_QualifiedName childName = UA_QUALIFIEDNAME(1, "Child123");
+        UA_NodeId target;
+        retval = translateSingle(server, &folder, &hierarchical, false, &childName, &target);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_NodeId child = UA_NODEID_NUMERIC(1, 3123);
+        ck_assert(UA_NodeId_equal(&target, &child));
+
+        /* Wrong namespace */
+        UA_QualifiedName otherNs = UA_QUALIFIEDNAME(0, "Child123");
+        retval = translateSingle(server, &folder, &hierarchical, false, &otherNs, &target);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_BADNOMATCH);
+
+        /* Renaming the child updates the index of the folder */
+        UA_QualifiedName newName = UA_QUALIFIEDNAME(1, "Renamed");
+        retval = UA_Server_writeBrowseName(server, child, newName);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = translateSingle(server, &folder, &hierarchical, false, &childName, &target);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_BADNOMATCH);
+        retval = translateSingle(server, &folder, &hierarchical, false, &newName, &target);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&target, &child));
+
+        /* Inverse references are searched without the index */
+        UA_QualifiedName folderName = UA_QUALIFIEDNAME(1, "Wide");
+        retval = translateSingle(server, &child, &hierarchical, true, &folderName, &target);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&target, &folder));
+        UA_NodeId_deleteMembers(&target);
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
+START_TEST(Service_TranslateBrowsePathsToNodeIds_ReplacedTarget)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+        UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+        UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        UA_NodeId target = UA_NODEID_NUMERIC(1, 7001);
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, target, objects, organizes,
+                                    UA_QUALIFIEDNAME(1, "Old"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                    oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        /* The reference from the objects folder remains and points to a node
+         * with another browse name. (The reference from FolderType also
+         * remains, so take another type.) */
+        retval = UA_Server_deleteNode(server, target, false);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Server_addObjectNode(server, target, UA_NODEID_NUMERIC(0, UA_NS0ID_VIEWSFOLDER),
+                                         organizes, UA_QUALIFIEDNAME(1, "New"),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                         oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        UA_QualifiedName oldName = UA_QUALIFIEDNAME(1, "Old");
+        UA_QualifiedName newName = UA_QUALIFIEDNAME(1, "New");
+        UA_NodeId found;
+        retval = translateSingle(server, &objects, &organizes, false, &oldName, &found);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_BADNOMATCH);
+        retval = translateSingle(server, &objects, &organizes, false, &newName, &found);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&found, &target));
+
+        /* Renaming a node that references itself */
+        UA_ExpandedNodeId self = UA_EXPANDEDNODEID_NUMERIC(1, 7001);
+        retval = UA_Server_addReference(server, target, organizes, self, true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_QualifiedName otherName = UA_QUALIFIEDNAME(1, "Other");
+        retval = UA_Server_writeBrowseName(server, target, otherName);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = translateSingle(server, &target, &organizes, false, &otherName, &found);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&found, &target));
+        retval = translateSingle(server, &objects, &organizes, false, &otherName, &found);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(UA_NodeId_equal(&found, &target));
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
+static UA_Boolean
+browseFindsTarget(UA_Server *server, const UA_NodeId *target, UA_Boolean includeSubtypes) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.includeSubtypes = includeSubtypes;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_Boolean found = false;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        if(UA_NodeId_equal(&br.references[i].nodeId.nodeId, target))
+            found = true;
+    }
+    UA_BrowseResult_deleteMembers(&br);
+    return found;
+}
+
+START_TEST(Service_Browse_IncludeSubtypes)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+        /* A reference type two levels below Organizes */
+        UA_NodeId midType = UA_NODEID_STRING(1, "test.organizes");
+        UA_NodeId refType = UA_NODEID_STRING(1, "test.organizes.sub");
+        UA_ReferenceTypeAttributes rattr;
+        UA_ReferenceTypeAttributes_init(&rattr);
+        UA_StatusCode retval =
+            UA_Server_addReferenceTypeNode(server, midType, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                           UA_QUALIFIEDNAME(1, "TestOrganizes"), rattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        retval = UA_Server_addReferenceTypeNode(server, refType, midType,
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                                UA_QUALIFIEDNAME(1, "TestOrganizesSub"),
+                                                rattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        /* An object that is only referenced with the new reference type */
+        UA_NodeId target = UA_NODEID_STRING(1, "test.target");
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        retval = UA_Server_addObjectNode(server, target, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                         UA_QUALIFIEDNAME(1, "Target"),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                         oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_ExpandedNodeId targetId = UA_EXPANDEDNODEID_STRING(1, "test.target");
+        retval = UA_Server_addReference(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                        refType, targetId, true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+        ck_assert(browseFindsTarget(server, &target, true));
+        ck_assert(!browseFindsTarget(server, &target, false));
+
+        /* Removing the intermediate type cuts the hierarchy */
+        retval = UA_Server_deleteNode(server, midType, true);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(!browseFindsTarget(server, &target, true));
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
+START_TEST(Service_Browse_ReplacedTarget)
+    {
+        UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+        UA_NodeId target = UA_NODEID_NUMERIC(1, 7000);
+        UA_ObjectAttributes oattr;
+        UA_ObjectAttributes_init(&oattr);
+        UA_StatusCode retval =
+            UA_Server_addObjectNode(server, target, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, "Target"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(browseFindsTarget(server, &target, false));
+
+        /* The reference to the deleted node remains but has no target */
+        retval = UA_Server_deleteNode(server, target, false);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(!browseFindsTarget(server, &target, false));
+
+        /* A new node with the NodeId becomes the target again. (The old
+         * reference from BaseObjectType also remains, so take another type.) */
+        retval = UA_Server_addObjectNode(server, target, UA_NODEID_NUMERIC(0, UA_NS0ID_VIEWSFOLDER),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                         UA_QUALIFIEDNAME(1, "Target"),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                         oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(browseFindsTarget(server, &target, false));
+
+        UA_Server_delete(server);
+    }
+END_TEST
+
 static Suite *testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
     Suite *s = suite_create("Service_TranslateBrowsePathsToNodeIds");
     TCase *tc_browse = tcase_create("Browse Service");
     tcase_add_test(tc_browse, Service_Browse_WithBrowseName);
+    tcase_add_test(tc_browse, Service_Browse_IncludeSubtypes);
+    tcase_add_test(tc_browse, Service_Browse_ReplacedTarget);
     suite_add_tcase(s, tc_browse);
 
     TCase *tc_translate = tcase_create("TranslateBrowsePathsToNodeIds");
     tcase_add_unchecked_fixture(tc_translate, setup_server, teardown_server);
     tcase_add_test(tc_translate, Service_TranslateBrowsePathsToNodeIds);
+    tcase_add_test(tc_translate, Service_TranslateBrowsePathsToNodeIds_WideFolder);
+    tcase_add_test(tc_translate, Service_TranslateBrowsePathsToNodeIds_ReplacedTarget);
 
     suite_add_tcase(s, tc_translate);
     return s;
@@ -6,6 +6,9 @@
 #include <stdlib.h>
 
 #include "ua_types.h"
+#include "ua_server.h"
+#include "ua_config_standard.h"
+#include "server/ua_server_internal.h"
 #include "server/ua_services.h"
 #include "check.h"
 
@@ -46,11 +49,270 @@ START_TEST(Session_updateLifetime_ShallWork) {
 }
 END_TEST
 
+static UA_StatusCode
+readValueWithSession(UA_Server *server, UA_Session *session,
+                     const UA_NodeId *nodeId, UA_Int32 *value) {
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = *nodeId;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue dv;
+    UA_DataValue_init(&dv);
+    UA_RCU_LOCK();
+    Service_Read_single(server, session, UA_TIMESTAMPSTORETURN_NEITHER, 0, &rvi, &dv);
+    UA_RCU_UNLOCK();
+    UA_StatusCode retval = dv.hasStatus ? dv.status : UA_STATUSCODE_GOOD;
+    if(retval == UA_STATUSCODE_GOOD)
+        *value = *(UA_Int32*)dv.value.data;
+    UA_DataValue_deleteMembers(&dv);
+    return retval;
+}
+
+static void
+addIntVariable(UA_Server *server, const UA_NodeId *nodeId, UA_Int32 value) {
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, *nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "registered"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+START_TEST(Session_registerNodes_Alias) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "registered.variable");
+    addIntVariable(server, &nodeId, 42);
+
+    UA_Session session;
+    UA_Session_init(&session);
+
+    UA_NodeId nodes[2] = {nodeId, UA_NODEID_STRING(1, "unknown")};
+    UA_RegisterNodesRequest request;
+    UA_RegisterNodesRequest_init(&request);
+    request.nodesToRegister = nodes;
+    request.nodesToRegisterSize = 2;
+    UA_RegisterNodesResponse response;
+    UA_RegisterNodesResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_RegisterNodes(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.registeredNodeIdsSize, 2);
+
+    /* Existing nodes get a numeric alias, unknown nodes are returned as is */
+    UA_NodeId alias = response.registeredNodeIds[0];
+    ck_assert_uint_eq(alias.identifierType, UA_NODEIDTYPE_NUMERIC);
+    ck_assert(UA_NodeId_equal(&response.registeredNodeIds[1], &nodes[1]));
+
+    UA_Int32 value = 0;
+    ck_assert_uint_eq(readValueWithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 42);
+
+    /* The alias is only valid for the session */
+    ck_assert_uint_eq(readValueWithSession(server, &adminSession, &alias, &value),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    /* Writes go through the alias */
+    UA_Int32 newValue = 43;
+    UA_WriteValue wv;
+    UA_WriteValue_init(&wv);
+    wv.nodeId = alias;
+    wv.attributeId = UA_ATTRIBUTEID_VALUE;
+    wv.value.hasValue = true;
+    UA_Variant_setScalar(&wv.value.value, &newValue, &UA_TYPES[UA_TYPES_INT32]);
+    UA_WriteRequest wreq;
+    UA_WriteRequest_init(&wreq);
+    wreq.nodesToWrite = &wv;
+    wreq.nodesToWriteSize = 1;
+    UA_WriteResponse wresp;
+    UA_WriteResponse_init(&wresp);
+    UA_RCU_LOCK();
+    Service_Write(server, &session, &wreq, &wresp);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(wresp.results[0], UA_STATUSCODE_GOOD);
+    UA_WriteResponse_deleteMembers(&wresp);
+    ck_assert_uint_eq(readValueWithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 43);
+
+    /* Deleting the node invalidates the cached node. A replacement under
+     * the same NodeId is found again. */
+    UA_Server_deleteNode(server, nodeId, true);
+    ck_assert_uint_eq(readValueWithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+    addIntVariable(server, &nodeId, 44);
+    ck_assert_uint_eq(readValueWithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value, 44);
+
+    /* Unregistered aliases are unknown, also when the entry is reused */
+    UA_UnregisterNodesRequest ureq;
+    UA_UnregisterNodesRequest_init(&ureq);
+    ureq.nodesToUnregister = &alias;
+    ureq.nodesToUnregisterSize = 1;
+    UA_UnregisterNodesResponse uresp;
+    UA_UnregisterNodesResponse_init(&uresp);
+    UA_RCU_LOCK();
+    Service_UnregisterNodes(server, &session, &ureq, &uresp);
+    UA_RCU_UNLOCK();
+    ck_assert_uint_eq(uresp.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_RegisterNodesResponse_deleteMembers(&response);
+    UA_RegisterNodesResponse_init(&response);
+    request.nodesToRegisterSize = 1;
+    UA_RCU_LOCK();
+    Service_RegisterNodes(server, &session, &request, &response);
+    UA_RCU_UNLOCK();
+    ck_assert(!UA_NodeId_equal(&response.registeredNodeIds[0], &alias));
+    ck_assert_uint_eq(readValueWithSession(server, &session, &alias, &value),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert_uint_eq(readValueWithSession(server, &session,
+                                           &response.registeredNodeIds[0], &value),
+                      UA_STATUSCODE_GOOD);
+
+    UA_RegisterNodesResponse_deleteMembers(&response);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Session_registerNodes_GenerationWraps) {
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 1000);
+
+    /* Register and unregister until the generation of the entry wraps */
+    UA_NodeId first;
+    ck_assert_uint_eq(UA_Session_registerNode(&session, &nodeId, &first),
+                      UA_STATUSCODE_GOOD);
+    UA_NodeId alias = first;
+    for(size_t i = 0; i < 0xffff; ++i) {
+        UA_Session_unregisterNode(&session, &alias);
+        ck_assert_uint_eq(UA_Session_registerNode(&session, &nodeId, &alias),
+                          UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(alias.identifier.numeric & 0xffff,
+                          first.identifier.numeric & 0xffff);
+    }
+    UA_Session_unregisterNode(&session, &alias);
+
+    /* The entry is retired. The alias of the first generation stays unknown. */
+    ck_assert_uint_eq(UA_Session_registerNode(&session, &nodeId, &alias),
+                      UA_STATUSCODE_GOOD);
+    ck_assert(!UA_NodeId_equal(&alias, &first));
+    ck_assert_ptr_eq(UA_Session_resolveNodeId(&session, &first), NULL);
+
+    UA_Session_deleteMembersCleanup(&session, NULL);
+}
+END_TEST
+
+static void
+collectBrowsed(const UA_BrowseResult *br, UA_UInt32 *seen, size_t seenSize) {
+    ck_assert_uint_eq(br->statusCode, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < br->referencesSize; ++i) {
+        UA_UInt32 id = br->references[i].nodeId.nodeId.identifier.numeric - 4000;
+        ck_assert_uint_lt(id, seenSize);
+        ++seen[id];
+    }
+}
+
+START_TEST(Session_browseNext_Resume) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_NodeId folder = UA_NODEID_STRING(1, "paged.folder");
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, folder, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Paged"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    /* The 51st child is added while browsing */
+    for(UA_UInt32 i = 0; i < 50; ++i) {
+        retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 4000 + i), folder,
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                         UA_QUALIFIEDNAME(1, "Child"),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                         oattr, NULL, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_BrowseDescription descr;
+    UA_BrowseDescription_init(&descr);
+    descr.nodeId = folder;
+    descr.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    descr.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    descr.resultMask = UA_BROWSERESULTMASK_ALL;
+
+    UA_UInt32 seen[51] = {0};
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    UA_RCU_LOCK();
+    Service_Browse_single(server, &session, NULL, &descr, 10, &br);
+    UA_RCU_UNLOCK();
+    collectBrowsed(&br, seen, 51);
+    ck_assert_uint_eq(br.referencesSize, 10);
+
+    /* The continuation point stores the position in the references */
+    UA_RCU_LOCK();
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &folder);
+    struct ContinuationPointEntry *cp = LIST_FIRST(&session.continuationPoints);
+    ck_assert_ptr_ne(cp, NULL);
+    ck_assert_uint_eq(cp->referencesVersion, node->referenceIndex.version);
+    UA_RCU_UNLOCK();
+
+    size_t pages = 1;
+    while(br.continuationPoint.length > 0) {
+        UA_BrowseNextRequest request;
+        UA_BrowseNextRequest_init(&request);
+        request.continuationPoints = &br.continuationPoint;
+        request.continuationPointsSize = 1;
+        UA_BrowseNextResponse response;
+        UA_BrowseNextResponse_init(&response);
+        UA_RCU_LOCK();
+        Service_BrowseNext(server, &session, &request, &response);
+        UA_RCU_UNLOCK();
+        ck_assert_uint_eq(response.resultsSize, 1);
+        collectBrowsed(&response.results[0], seen, 51);
+        UA_BrowseResult_deleteMembers(&br);
+        br = response.results[0];
+        UA_BrowseResult_init(&response.results[0]);
+        UA_BrowseNextResponse_deleteMembers(&response);
+        ++pages;
+
+        /* Changing the references falls back to skipping the references
+         * that were already returned */
+        if(pages == 2) {
+            retval = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 4050), folder,
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                             UA_QUALIFIEDNAME(1, "Child"),
+                                             UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                             oattr, NULL, NULL);
+            ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        }
+    }
+    UA_BrowseResult_deleteMembers(&br);
+    ck_assert_uint_eq(pages, 6);
+    for(size_t i = 0; i < 51; ++i)
+        ck_assert_uint_eq(seen[i], 1);
+    ck_assert_ptr_eq(LIST_FIRST(&session.continuationPoints), NULL);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
 static Suite* testSuite_Session(void) {
     Suite *s = suite_create("Session");
     TCase *tc_core = tcase_create("Core");
     tcase_add_test(tc_core, Session_init_ShallWork);
     tcase_add_test(tc_core, Session_updateLifetime_ShallWork);
+    tcase_add_test(tc_core, Session_registerNodes_Alias);
+    tcase_add_test(tc_core, Session_registerNodes_GenerationWraps);
+    tcase_add_test(tc_core, Session_browseNext_Resume);
 
     suite_add_tcase(s,tc_core);
     return s;
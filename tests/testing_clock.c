@@ -14,6 +14,11 @@ UA_DateTime UA_DateTime_nowMonotonic(void) {
     return testingClock;
 }
 
+void UA_DateTime_sleepUntilMonotonic(UA_DateTime deadline) {
+    if(deadline > testingClock)
+        testingClock = deadline;
+}
+
 void
 UA_sleep(UA_DateTime duration) {
     testingClock += duration * UA_MSEC_TO_DATETIME;
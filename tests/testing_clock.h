@@ -12,7 +12,8 @@
  * deterministic time that can be advanced manually with UA_sleep.
  *
  * UA_DateTime UA_EXPORT UA_DateTime_now(void);
- * UA_DateTime UA_EXPORT UA_DateTime_nowMonotonic(void); */
+ * UA_DateTime UA_EXPORT UA_DateTime_nowMonotonic(void);
+ * void UA_EXPORT UA_DateTime_sleepUntilMonotonic(UA_DateTime deadline); */
 
 /* Forwards the testing clock by the given duration in ms */
  void UA_sleep(UA_DateTime duration);
@@ -64,6 +64,11 @@ parser.add_argument('-s','--suppress',
                     default=[],
                     help="Suppresses the generation of some node attributes. Currently supported options are 'description', 'browseName', 'displayName', 'writeMask', 'userWriteMask' and 'nodeid'.")
 
+parser.add_argument('-t','--tables',
+                    action='store_true',
+                    dest="tables",
+                    help='Print the nodes as static tables that are added in bulk by UA_Server_addStaticNodes instead of code that adds every node with the services. The values of variables are still written with code.')
+
 parser.add_argument('-v','--verbose', action='count', help='Make the script more verbose. Can be applied up to 4 times')
 
 args = parser.parse_args()
@@ -171,7 +176,10 @@ for ignore in args.ignoreFiles:
 logger.info("Generating Header")
 # Returns a tuple of (["Header","lines"],["Code","lines","generated"])
 from os.path import basename
-generatedCode = ns.printOpen62541Header(ignoreNodes, args.suppressedAttributes, outfilename=basename(args.outputFile))
+if args.tables:
+  generatedCode = ns.printOpen62541Tables(ignoreNodes, args.suppressedAttributes, outfilename=basename(args.outputFile))
+else:
+  generatedCode = ns.printOpen62541Header(ignoreNodes, args.suppressedAttributes, outfilename=basename(args.outputFile))
 for line in generatedCode[0]:
   outfileh.write(line+"\n")
 for line in generatedCode[1]:
@@ -105,6 +105,44 @@ class open62541_MacroHelper():
     else:
       return ""
 
+  def getStaticString(self, data):
+    """ Returns an initializer for a UA_String that points to a C string literal.
+        Non-printable characters are escaped. The length is the length of the
+        UTF-8 encoding.
+    """
+    if not isinstance(data, bytes):
+      data = data.encode('utf-8')
+    if len(data) == 0:
+      return "{0, NULL}"
+    literal = ""
+    for c in bytearray(data):
+      if c == 34 or c == 92:
+        literal += "\\" + chr(c)
+      elif c >= 32 and c < 127 and c != 63: # escape '?' to avoid trigraphs
+        literal += chr(c)
+      else:
+        literal += "\\%03o" % c
+    return "{" + str(len(data)) + ", (UA_Byte*)\"" + literal + "\"}"
+
+  def getStaticNodeId(self, nodeid):
+    """ Returns an initializer for a UA_NodeId or None if the identifier type
+        cannot be initialized statically.
+    """
+    if nodeid.i != None:
+      return "{" + str(nodeid.ns) + ", UA_NODEIDTYPE_NUMERIC, {" + str(nodeid.i) + "}}"
+    elif nodeid.s != None:
+      return "{" + str(nodeid.ns) + ", UA_NODEIDTYPE_STRING, {.string = " + self.getStaticString(nodeid.s) + "}}"
+    return None
+
+  def getStaticQualifiedName(self, browseName):
+    extrNs = browseName.split(":", 1)
+    if len(extrNs) > 1 and extrNs[0].isdigit():
+      return "{" + extrNs[0] + ", " + self.getStaticString(extrNs[1]) + "}"
+    return "{0, " + self.getStaticString(browseName) + "}"
+
+  def getStaticLocalizedText(self, text):
+    return "{" + self.getStaticString("en_US") + ", " + self.getStaticString(text) + "}"
+
   def getCreateStandaloneReference(self, sourcenode, reference):
     code = []
 
@@ -283,7 +321,7 @@ class open62541_MacroHelper():
       code.append("/* undefined nodeclass */")
       return;
 
-    code.append("UA_" + nodetype + "Node *" + node.getCodePrintableID() + " = UA_NodeStore_new" + nodetype + "Node();")
+    code.append("UA_" + nodetype + "Node *" + node.getCodePrintableID() + " = UA_NodeStore_new" + nodetype + "Node(server->nodestore);")
     if not "browsename" in self.supressGenerationOfAttribute:
       extrNs = node.browseName().split(":")
       if len(extrNs) > 1:
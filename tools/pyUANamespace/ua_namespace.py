@@ -644,39 +644,8 @@ class opcua_namespace():
     header.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
     code.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
 
-    header.append('#ifndef '+outfilename.upper()+'_H_')
-    header.append('#define '+outfilename.upper()+'_H_')
-    header.append('#ifdef UA_NO_AMALGAMATION')
-    header.append(  '#include "server/ua_server_internal.h"')
-    header.append(  '#include "server/ua_nodes.h"')
-    header.append('  #include "ua_util.h"')
-    header.append('  #include "ua_types.h"')
-    header.append('  #include "ua_types_encoding_binary.h"')
-    header.append('  #include "ua_types_generated_encoding_binary.h"')
-    header.append('  #include "ua_transport_generated_encoding_binary.h"')
-    header.append('#else')
-    header.append('  #include "open62541.h"')
-    header.append('#endif')
-    header.append('')
-    header.append('/* Definition that (in userspace models) may be ')
-    header.append(' * - not included in the amalgamated header or')
-    header.append(' * - not part of public headers or')
-    header.append(' * - not exported in the shared object in combination with any of the above')
-    header.append(' * but are required for value encoding.')
-    header.append(' * NOTE: Userspace UA_(decode|encode)Binary /wo amalgamations requires UA_EXPORT to be appended to the appropriate definitions. */')
-    header.append('#ifndef UA_ENCODINGOFFSET_BINARY')
-    header.append('#  define UA_ENCODINGOFFSET_BINARY 2')
-    header.append('#endif')
-    header.append('#ifndef NULL')
-    header.append('  #define NULL ((void *)0)')
-    header.append('#endif')
-    header.append('#ifndef UA_malloc')
-    header.append('  #define UA_malloc(_p_size) malloc(_p_size)')
-    header.append('#endif')
-    header.append('#ifndef UA_free')
-    header.append('  #define UA_free(_p_ptr) free(_p_ptr)')
-    header.append('#endif')
-    
+    header = header + self.getOpen62541HeaderIncludes(outfilename)
+
     code.append('#include "'+outfilename+'.h"')
     code.append("UA_INLINE UA_StatusCode "+outfilename+"(UA_Server *server) {")
     code.append('UA_StatusCode retval = UA_STATUSCODE_GOOD; ')
@@ -753,6 +722,177 @@ class opcua_namespace():
     code.append("}")
     return (header,code)
 
+  def getOpen62541HeaderIncludes(self, outfilename):
+    header = []
+    header.append('#ifndef '+outfilename.upper()+'_H_')
+    header.append('#define '+outfilename.upper()+'_H_')
+    header.append('#ifdef UA_NO_AMALGAMATION')
+    header.append(  '#include "server/ua_server_internal.h"')
+    header.append(  '#include "server/ua_nodes.h"')
+    header.append('  #include "ua_util.h"')
+    header.append('  #include "ua_types.h"')
+    header.append('  #include "ua_types_encoding_binary.h"')
+    header.append('  #include "ua_types_generated_encoding_binary.h"')
+    header.append('  #include "ua_transport_generated_encoding_binary.h"')
+    header.append('#else')
+    header.append('  #include "open62541.h"')
+    header.append('#endif')
+    header.append('')
+    header.append('/* Definition that (in userspace models) may be ')
+    header.append(' * - not included in the amalgamated header or')
+    header.append(' * - not part of public headers or')
+    header.append(' * - not exported in the shared object in combination with any of the above')
+    header.append(' * but are required for value encoding.')
+    header.append(' * NOTE: Userspace UA_(decode|encode)Binary /wo amalgamations requires UA_EXPORT to be appended to the appropriate definitions. */')
+    header.append('#ifndef UA_ENCODINGOFFSET_BINARY')
+    header.append('#  define UA_ENCODINGOFFSET_BINARY 2')
+    header.append('#endif')
+    header.append('#ifndef NULL')
+    header.append('  #define NULL ((void *)0)')
+    header.append('#endif')
+    header.append('#ifndef UA_malloc')
+    header.append('  #define UA_malloc(_p_size) malloc(_p_size)')
+    header.append('#endif')
+    header.append('#ifndef UA_free')
+    header.append('  #define UA_free(_p_ptr) free(_p_ptr)')
+    header.append('#endif')
+    return header
+
+  def printOpen62541Tables(self, printedExternally=[], supressGenerationOfAttribute=[], outfilename=""):
+    """ printOpen62541Tables
+
+        Prints the nodes as static tables of UA_StaticNode and UA_StaticReference
+        that are added in bulk by UA_Server_addStaticNodes. Only the variable
+        values are written with code. Returns the header and code lines.
+    """
+    code = []
+    header = []
+    codegen = open62541_MacroHelper(supressGenerationOfAttribute=supressGenerationOfAttribute)
+    nodeClassNames = {NODE_CLASS_OBJECT: "UA_NODECLASS_OBJECT", NODE_CLASS_VARIABLE: "UA_NODECLASS_VARIABLE",
+                      NODE_CLASS_METHOD: "UA_NODECLASS_METHOD", NODE_CLASS_OBJECTTYPE: "UA_NODECLASS_OBJECTTYPE",
+                      NODE_CLASS_VARIABLETYPE: "UA_NODECLASS_VARIABLETYPE",
+                      NODE_CLASS_REFERENCETYPE: "UA_NODECLASS_REFERENCETYPE",
+                      NODE_CLASS_DATATYPE: "UA_NODECLASS_DATATYPE", NODE_CLASS_VIEW: "UA_NODECLASS_VIEW"}
+
+    header.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+    code.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+    header = header + self.getOpen62541HeaderIncludes(outfilename)
+    for n in self.nodes:
+      if n.id().ns != 0:
+        nc = n.nodeClass()
+        if nc != NODE_CLASS_OBJECT and nc != NODE_CLASS_VARIABLE and nc != NODE_CLASS_VIEW:
+          header = header + codegen.getNodeIdDefineString(n)
+    header.append("extern UA_StatusCode "+outfilename+"(UA_Server *server);\n")
+    header.append("#endif /* "+outfilename.upper()+"_H_ */")
+    code.append('#include "'+outfilename+'.h"')
+    code.append("")
+
+    # Print the references of each node as a separate array
+    tableNodes = []
+    for n in self.nodes:
+      if n in printedExternally:
+        logger.debug("Node " + str(n.id()) + " is being ignored.")
+        continue
+      if not n.nodeClass() in nodeClassNames or codegen.getStaticNodeId(n.id()) == None:
+        logger.warn("Node " + str(n.id()) + " cannot be printed to the table.")
+        continue
+      refs = []
+      for r in n.getReferences():
+        if r.target() == None or r.target().id() == None or r.referenceType() == None:
+          continue
+        targetId = codegen.getStaticNodeId(r.target().id())
+        refTypeId = codegen.getStaticNodeId(r.referenceType().id())
+        if targetId == None or refTypeId == None:
+          continue
+        refs.append("    {" + refTypeId + ", " + targetId + ", " + ("true" if r.isForward() else "false") + "}")
+      if len(refs) > 0:
+        code.append("static const UA_StaticReference " + outfilename + "_references_" + str(len(tableNodes)) + "[] = {")
+        code.append(",\n".join(refs) + "};")
+      tableNodes.append((n, len(refs)))
+
+    # Print the nodes. Attributes with the default value are left out.
+    code.append("")
+    code.append("static const UA_StaticNode " + outfilename + "_nodes[] = {")
+    entries = []
+    for (n, refsSize) in tableNodes:
+      fields = []
+      nc = n.nodeClass()
+      fields.append(".nodeClass = " + nodeClassNames[nc])
+      fields.append(".nodeId = " + codegen.getStaticNodeId(n.id()))
+      if not "browseName" in supressGenerationOfAttribute:
+        fields.append(".browseName = " + codegen.getStaticQualifiedName(n.browseName()))
+      if not "displayName" in supressGenerationOfAttribute:
+        fields.append(".displayName = " + codegen.getStaticLocalizedText(n.displayName()))
+      if not "description" in supressGenerationOfAttribute and len(n.description()) > 0:
+        fields.append(".description = " + codegen.getStaticLocalizedText(n.description()))
+      if not "writeMask" in supressGenerationOfAttribute and n.writeMask() != 0:
+        fields.append(".writeMask = " + str(n.writeMask()))
+      if not "userWriteMask" in supressGenerationOfAttribute and n.userWriteMask() != 0:
+        fields.append(".userWriteMask = " + str(n.userWriteMask()))
+      if nc in [NODE_CLASS_OBJECTTYPE, NODE_CLASS_VARIABLETYPE, NODE_CLASS_REFERENCETYPE, NODE_CLASS_DATATYPE] and n.isAbstract():
+        fields.append(".isAbstract = true")
+      if nc == NODE_CLASS_REFERENCETYPE:
+        if n.symmetric():
+          fields.append(".symmetric = true")
+        if len(n.inverseName()) > 0:
+          fields.append(".inverseName = " + codegen.getStaticLocalizedText(n.inverseName()))
+      if nc in [NODE_CLASS_OBJECT, NODE_CLASS_VIEW] and n.eventNotifier():
+        fields.append(".eventNotifier = " + str(n.eventNotifier()))
+      if nc == NODE_CLASS_VIEW and n.containsNoLoops():
+        fields.append(".containsNoLoops = true")
+      if nc in [NODE_CLASS_VARIABLE, NODE_CLASS_VARIABLETYPE]:
+        if n.dataType() != None and isinstance(n.dataType().target(), opcua_node_t):
+          dataTypeId = codegen.getStaticNodeId(n.dataType().target().id())
+          if dataTypeId != None:
+            fields.append(".dataType = " + dataTypeId)
+        fields.append(".valueRank = " + str(n.valueRank()))
+      if nc == NODE_CLASS_VARIABLE:
+        fields.append(".accessLevel = " + str(n.accessLevel()))
+        fields.append(".userAccessLevel = " + str(n.userAccessLevel()))
+        if n.minimumSamplingInterval():
+          fields.append(".minimumSamplingInterval = " + str(n.minimumSamplingInterval()))
+        if n.historizing():
+          fields.append(".historizing = true")
+      if nc == NODE_CLASS_METHOD:
+        if n.executable():
+          fields.append(".executable = true")
+        if n.userExecutable():
+          fields.append(".userExecutable = true")
+      if refsSize > 0:
+        fields.append(".referencesSize = " + str(refsSize))
+        fields.append(".references = " + outfilename + "_references_" + str(len(entries)))
+      entries.append("    {" + ",\n     ".join(fields) + "}")
+    code.append(",\n".join(entries) + "};")
+    code.append("")
+
+    code.append("UA_StatusCode "+outfilename+"(UA_Server *server) {")
+    # Before adding nodes, we need to request additional namespace arrays from the server
+    for nsid in self.namespaceIdentifiers:
+      if nsid == 0 or nsid==1:
+        continue
+      name =  self.namespaceIdentifiers[nsid]
+      name = name.replace("\"","\\\"")
+      code.append("if (UA_Server_addNamespace(server, \"{0}\") != {1})\n    return UA_STATUSCODE_BADUNEXPECTEDERROR;".format(name, nsid))
+    code.append("UA_StatusCode retval = UA_Server_addStaticNodes(server, " + str(len(entries)) + ", " + outfilename + "_nodes);")
+
+    # The values are not part of the table
+    for (n, refsSize) in tableNodes:
+      if n.nodeClass() != NODE_CLASS_VARIABLE and n.nodeClass() != NODE_CLASS_VARIABLETYPE:
+        continue
+      valueCode = n.printOpen62541CCode_SubtypeEarly(bootstrapping = False)
+      if len(valueCode) == 0:
+        continue
+      code.append("do {")
+      code.append("UA_VariableAttributes attr;")
+      code.append("UA_VariableAttributes_init(&attr);")
+      code = code + valueCode
+      code.append("UA_NodeId nodeId = " + codegen.getStaticNodeId(n.id()) + ";")
+      code.append("UA_Server_writeValue(server, nodeId, attr.value);")
+      code.append("} while(0);")
+    code.append("return retval;")
+    code.append("}")
+    return (header,code)
+
 ###
 ### Testing
 ###